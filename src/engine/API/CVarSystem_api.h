@@ -111,6 +111,35 @@ typedef struct
     cvarHandle_t handle;
 } vmConvar_t;
 
+#define CVAR_HASH_SIZE 1024
+
+/*
+==================
+CVarHashValue
+
+compile time version of idCVarSystemLocal::generateHashValue
+==================
+*/
+static constexpr S64 CVarHashValue( StringEntry name, S32 i = 0, S64 hash = 0 )
+{
+    return name[i] == '\0' ? ( hash & ( CVAR_HASH_SIZE - 1 ) ) :
+           CVarHashValue( name, i + 1, hash + ( S64 )( ( name[i] >= 'A' && name[i] <= 'Z' ) ? name[i] - 'A' + 'a' : name[i] ) * ( i + 119 ) );
+}
+
+// engine code that reads a cvar by name every frame or every packet keeps
+// one of these in a static instead: the name is hashed at compile time and
+// the index into the cvar table is looked up once, after that reads and
+// change polling are O(1) and never touch the name again
+typedef struct
+{
+    StringEntry name;
+    S64 hash;
+    cvarHandle_t handle;	// -1 until the cvar has been found
+    S32 modificationCount;	// last count seen by RefModified
+} cvarRef_t;
+
+#define CVAR_REF( name ) { name, CVarHashValue( name ), -1, -1 }
+
 //
 // idCVarSystem
 //
@@ -142,6 +171,11 @@ public:
     virtual void CheckRange( convar_t* var, F32 min, F32 max, bool integral ) = 0;
     virtual void Register( vmConvar_t* vmCvar, StringEntry varName, StringEntry defaultValue, S32 flags, StringEntry description ) = 0;
     virtual void Update( vmConvar_t* vmCvar ) = 0;
+    virtual convar_t* Resolve( cvarRef_t* ref ) = 0;
+    virtual F32 RefValue( cvarRef_t* ref ) = 0;
+    virtual S32 RefIntegerValue( cvarRef_t* ref ) = 0;
+    virtual UTF8* RefString( cvarRef_t* ref ) = 0;
+    virtual bool RefModified( cvarRef_t* ref ) = 0;
     virtual void Init( void ) = 0;
     virtual void Shutdown( void ) = 0;
 };
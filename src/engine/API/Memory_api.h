@@ -33,7 +33,8 @@ typedef enum
     TAG_BOTLIB,
     TAG_RENDERER,
     TAG_SMALL,
-    TAG_STATIC
+    TAG_STATIC,
+    TAG_SLAB
 } memtag_t;
 
 //
@@ -63,6 +64,11 @@ public:
     virtual UTF8* CopyString( StringEntry in ) = 0;
     virtual void Shutdown( void ) = 0;
     virtual void GetHunkInfo( S32* hunkused, S32* hunkexpected ) = 0;
+    virtual void FrameInit( void ) = 0;
+    
+    // scratch memory of the calling thread, it is not cleared and stays
+    // valid until that thread allocates again after the next FrameInit
+    virtual void* FrameAlloc( size_t size ) = 0;
 };
 
 extern idMemorySystem* memorySystem;
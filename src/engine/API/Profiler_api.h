@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   Profiler_api.h
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: scoped zone frame profiler
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PROFILER_API_H__
+#define __PROFILER_API_H__
+
+//
+// idProfilerSystem
+//
+class idProfilerSystem
+{
+public:
+    virtual void Init( void ) = 0;
+    virtual void Shutdown( void ) = 0;
+    virtual void Frame( void ) = 0;
+    
+    // zone names must be string literals, only the pointer is recorded
+    virtual void BeginZone( StringEntry name ) = 0;
+    virtual void EndZone( void ) = 0;
+    
+    // one-off benchmarks run by profile_bench <name> [args], which hands
+    // the bench its own arguments from Argv( 1 ) on. name and description
+    // must be string literals
+    virtual void AddBench( StringEntry name, void ( *function )( void ), StringEntry description ) = 0;
+    virtual void RemoveBench( StringEntry name ) = 0;
+    
+    // read inline by idProfileZone, so a zone costs a load and a branch
+    // while com_profile is off
+    bool recording;
+};
+
+extern idProfilerSystem* profilerSystem;
+
+//
+// idProfileZone
+//
+class idProfileZone
+{
+public:
+    idProfileZone( StringEntry name ) : active( profilerSystem->recording )
+    {
+        if ( active )
+        {
+            profilerSystem->BeginZone( name );
+        }
+    }
+    
+    ~idProfileZone( void )
+    {
+        if ( active )
+        {
+            profilerSystem->EndZone();
+        }
+    }
+    
+private:
+    bool active;
+};
+
+// without USE_PROFILER the zones are not compiled in at all
+#ifdef USE_PROFILER
+#define PROFILE_ZONE( name ) idProfileZone profileZone( name )
+#else
+#define PROFILE_ZONE( name )
+#endif
+
+#endif //!__PROFILER_API_H__
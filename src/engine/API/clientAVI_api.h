@@ -38,6 +38,7 @@ public:
     virtual bool CloseAVI( void ) = 0;
     virtual bool VideoRecording( void ) = 0;
     virtual bool OpenAVIForWriting( StringEntry fileName ) = 0;
+    virtual void CaptureAVIVideoFrame( const U8* frame, S32 padding ) = 0;
 };
 
 extern idClientAVISystemAPI* clientAVISystem;
@@ -87,6 +87,7 @@ struct rendererImports_t
     idClientAVISystemAPI* clientAVISystem;
     idMemorySystem* memorySystem;
     idClientMainSystem* clientMainSystem;
+    idProfilerSystem* profilerSystem;
 };
 
 //
@@ -125,7 +126,8 @@ public:
     virtual void RemapShader( StringEntry oldShader, StringEntry newShader, StringEntry offsetTime ) = 0;
     virtual bool GetEntityToken( UTF8* buffer, S32 size ) = 0;
     virtual bool inPVS( const vec3_t p1, const vec3_t p2 ) = 0;
-    virtual void TakeVideoFrame( S32 h, S32 w, U8* captureBuffer, U8* encodeBuffer, bool motionJpeg ) = 0;
+    virtual void TakeVideoFrame( S32 width, S32 height, U8* captureBuffer ) = 0;
+    virtual S32 EncodeVideoFrame( U8* encodeBuffer, S32 encodeSize, const U8* captureBuffer, S32 width, S32 height, S32 padding, bool motionJpeg ) = 0;
 };
 
 extern idRenderSystem* renderSystem;
@@ -51,6 +51,10 @@ public:
     virtual void Thread_Join( qthread_t* thread ) = 0;
     virtual void Thread_Yield( void ) = 0;
     virtual S32 Thread_Cancel( qthread_t* thread ) = 0;
+    virtual S32 CondVar_Create( qcondvar_t** pcond ) = 0;
+    virtual void CondVar_Destroy( qcondvar_t* cond ) = 0;
+    virtual bool CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec ) = 0;
+    virtual void CondVar_Wake( qcondvar_t* cond ) = 0;
 };
 
 extern idSystemThreadsSystem* systemThreadsSystem;
@@ -84,6 +84,7 @@ public:
     virtual UTF8* GetCurrentUser( void ) = 0;
     virtual bool RandomBytes( U8* string, S32 len ) = 0;
     virtual S32 Milliseconds( void ) = 0;
+    virtual U64 Nanoseconds( void ) = 0;
     virtual UTF8* DefaultHomePath( UTF8* buffer, S32 size ) = 0;
 #ifndef DEDICATED
     virtual void DeactivateMouse( void ) = 0;
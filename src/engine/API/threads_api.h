@@ -52,6 +52,14 @@ struct qcondvar_t
     SDL_cond* c;
 };
 
+#define COND_WAIT_FOREVER 0xFFFFFFFF
+
+// jobs added with the same group can be waited on together
+struct qjobGroup_t
+{
+    S32 pending;	// queued or running jobs, guarded by the job queue
+};
+
 //
 // idSystemThreadsSystem
 //
@@ -64,8 +72,16 @@ public:
     virtual void Mutex_Unlock( qmutex_t* mutex ) = 0;
     virtual qthread_t* Thread_Create( void * ( *routine )( void* ), void* param ) = 0;
     virtual void Thread_Join( qthread_t* thread ) = 0;
+    virtual qcondvar_t* CondVar_Create( void ) = 0;
+    virtual void CondVar_Destroy( qcondvar_t** pcond ) = 0;
+    virtual bool CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec ) = 0;
+    virtual void CondVar_Wake( qcondvar_t* cond ) = 0;
     virtual void Threads_Init( void ) = 0;
     virtual void Threads_Shutdown( void ) = 0;
+    virtual void Jobs_Init( void ) = 0;
+    virtual void Jobs_Shutdown( void ) = 0;
+    virtual void Job_Add( qjobGroup_t* group, void ( *func )( void* ), void* data ) = 0;
+    virtual void Job_Wait( qjobGroup_t* group ) = 0;
 };
 
 extern idThreadsSystem* threadsSystem;
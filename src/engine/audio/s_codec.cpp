@@ -115,6 +115,8 @@ void S_CodecInit( void )
     codecs = nullptr;
     S_CodecRegister( &wav_codec );
     S_CodecRegister( &ogg_codec );
+    
+    S_PrefetchInit();
 }
 
 /*
@@ -124,6 +126,8 @@ S_CodecShutdown
 */
 void S_CodecShutdown( void )
 {
+    S_PrefetchShutdown();
+    
     codecs = nullptr;
 }
 
@@ -184,6 +188,66 @@ snd_stream_t* S_CodecOpenStream( StringEntry filename )
     return codec->open( fn );
 }
 
+/*
+=================
+S_CodecFindFile
+
+Picks the codec for a sound and fills fn with the name of the file to read
+=================
+*/
+snd_codec_t* S_CodecFindFile( StringEntry filename, UTF8* fn, S32 size )
+{
+    snd_codec_t* codec;
+    
+    codec = S_FindCodecForFile( filename );
+    if ( !codec )
+    {
+        Com_Printf( "Unknown extension for %s\n", filename );
+        return nullptr;
+    }
+    
+    Q_strncpyz( fn, filename, size );
+    COM_DefaultExtension( fn, size, codec->ext );
+    
+    return codec;
+}
+
+/*
+=================
+S_CodecDecode
+
+Decodes a whole file read by the caller, it doesn't touch the file system or
+print so it can run on a worker thread. The samples are freed with ::free
+=================
+*/
+void* S_CodecDecode( snd_codec_t* codec, const void* data, S32 length, snd_info_t* info )
+{
+    if ( !codec->decode )
+    {
+        return nullptr;
+    }
+    
+    return codec->decode( data, length, info );
+}
+
+/*
+=================
+S_CodecInfo
+
+Reads the header of a file read by the caller, returns false if it can't be
+decoded
+=================
+*/
+bool S_CodecInfo( snd_codec_t* codec, const void* data, S32 length, snd_info_t* info )
+{
+    if ( !codec->info )
+    {
+        return false;
+    }
+    
+    return codec->info( data, length, info ) && info->rate > 0 && info->samples > 0;
+}
+
 void S_CodecCloseStream( snd_stream_t* stream )
 {
     stream->codec->close( stream );
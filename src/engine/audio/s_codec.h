@@ -61,6 +61,8 @@ typedef void* ( *CODEC_LOAD )( StringEntry filename, snd_info_t* info );
 typedef snd_stream_t* ( *CODEC_OPEN )( StringEntry filename );
 typedef S32( *CODEC_READ )( snd_stream_t* stream, S32 bytes, void* buffer );
 typedef void ( *CODEC_CLOSE )( snd_stream_t* stream );
+typedef void* ( *CODEC_DECODE )( const void* data, S32 length, snd_info_t* info );
+typedef bool ( *CODEC_INFO )( const void* data, S32 length, snd_info_t* info );
 
 // Codec data structure
 struct snd_codec_s
@@ -70,6 +72,8 @@ struct snd_codec_s
     CODEC_OPEN open;
     CODEC_READ read;
     CODEC_CLOSE close;
+    CODEC_DECODE decode; // a file already read into memory, safe on any thread
+    CODEC_INFO info; // only the header of a file in memory
     snd_codec_t* next;
 };
 
@@ -81,6 +85,20 @@ void* S_CodecLoad( StringEntry filename, snd_info_t* info );
 snd_stream_t* S_CodecOpenStream( StringEntry filename );
 void S_CodecCloseStream( snd_stream_t* stream );
 S32 S_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer );
+snd_codec_t* S_CodecFindFile( StringEntry filename, UTF8* fn, S32 size );
+void* S_CodecDecode( snd_codec_t* codec, const void* data, S32 length, snd_info_t* info );
+bool S_CodecInfo( snd_codec_t* codec, const void* data, S32 length, snd_info_t* info );
+
+// Prefetch, decodes a stream ahead of the mixer on a worker thread
+typedef struct sndPrefetch_s sndPrefetch_t;
+
+void S_PrefetchInit( void );
+void S_PrefetchShutdown( void );
+sndPrefetch_t* S_PrefetchOpen( StringEntry intro, StringEntry loop );
+void S_PrefetchClose( sndPrefetch_t* prefetch );
+S32 S_PrefetchAvailable( sndPrefetch_t* prefetch, snd_info_t* info );
+S32 S_PrefetchRead( sndPrefetch_t* prefetch, S32 bytes, void* buffer );
+void S_PrefetchInfo( sndPrefetch_t* prefetch );
 
 // Util functions (used by codecs)
 snd_stream_t* S_CodecUtilOpen( StringEntry filename, snd_codec_t* codec );
@@ -92,6 +110,8 @@ void* S_WAV_CodecLoad( StringEntry filename, snd_info_t* info );
 snd_stream_t* S_WAV_CodecOpenStream( StringEntry filename );
 void S_WAV_CodecCloseStream( snd_stream_t* stream );
 S32 S_WAV_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer );
+void* S_WAV_CodecDecode( const void* data, S32 length, snd_info_t* info );
+bool S_WAV_CodecInfo( const void* data, S32 length, snd_info_t* info );
 
 // Ogg Vorbis codec
 extern snd_codec_t ogg_codec;
@@ -99,5 +119,7 @@ void* S_OGG_CodecLoad( StringEntry filename, snd_info_t* info );
 snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename );
 void S_OGG_CodecCloseStream( snd_stream_t* stream );
 S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer );
+void* S_OGG_CodecDecode( const void* data, S32 length, snd_info_t* info );
+bool S_OGG_CodecInfo( const void* data, S32 length, snd_info_t* info );
 
 #endif // !_SND_CODEC_H_
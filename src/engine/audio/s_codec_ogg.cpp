@@ -43,6 +43,8 @@ snd_codec_t ogg_codec =
     S_OGG_CodecOpenStream,
     S_OGG_CodecReadStream,
     S_OGG_CodecCloseStream,
+    S_OGG_CodecDecode,
+    S_OGG_CodecInfo,
     nullptr
 };
 
@@ -216,12 +218,25 @@ const ov_callbacks S_OGG_Callbacks =
     &S_OGG_Callback_tell
 };
 
+// without a seek function the codec only reads forwards and doesn't scan the file when opening it
+static const ov_callbacks S_OGG_StreamCallbacks =
+{
+    &S_OGG_Callback_read,
+    nullptr,
+    &S_OGG_Callback_close,
+    nullptr
+};
+
 /*
 =================
-S_OGG_CodecOpenStream
+S_OGG_OpenStream
+
+A seekable stream knows its length, which takes reading the whole file
+when it is inflated from a pk3. Otherwise only the headers are read
+and the length is left at 0.
 =================
 */
-snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
+static snd_stream_t* S_OGG_OpenStream( StringEntry filename, bool seekable )
 {
     snd_stream_t* stream;
     
@@ -255,7 +270,7 @@ snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
     }
     
     // open the codec with our callbacks and stream as the generic pointer
-    if ( ov_open_callbacks( stream, vf, nullptr, 0, S_OGG_Callbacks ) != 0 )
+    if ( ov_open_callbacks( stream, vf, nullptr, 0, seekable ? S_OGG_Callbacks : S_OGG_StreamCallbacks ) != 0 )
     {
         memorySystem->Free( vf );
         
@@ -265,7 +280,7 @@ snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
     }
     
     // the stream must be seekable
-    if ( !ov_seekable( vf ) )
+    if ( seekable && !ov_seekable( vf ) )
     {
         ov_clear( vf );
         
@@ -302,7 +317,7 @@ snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
     }
     
     // get the number of sample-frames in the OGG
-    numSamples = ( S64 )ov_pcm_total( vf, 0 );
+    numSamples = seekable ? ( S64 )ov_pcm_total( vf, 0 ) : 0;
     
     // fill in the info-structure in the stream
     stream->info.rate = OGGInfo->rate;
@@ -321,6 +336,18 @@ snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
     return stream;
 }
 
+/*
+=================
+S_OGG_CodecOpenStream
+
+Streams only read forwards, so they are opened unseekable
+=================
+*/
+snd_stream_t* S_OGG_CodecOpenStream( StringEntry filename )
+{
+    return S_OGG_OpenStream( filename, false );
+}
+
 /*
 =================
 S_OGG_CodecCloseStream
@@ -346,10 +373,10 @@ void S_OGG_CodecCloseStream( snd_stream_t* stream )
 
 /*
 =================
-S_OGG_CodecReadStream
+S_OGG_ReadPCM
 =================
 */
-S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
+static S32 S_OGG_ReadPCM( OggVorbis_File* vf, S32 bytes, void* buffer )
 {
     // buffer handling
     S32 bytesRead, bytesLeft, c;
@@ -365,17 +392,6 @@ S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
     IsBigEndian = 1;
 #	endif // Q3_BIG_ENDIAN
     
-    // check if input is valid
-    if ( !( stream && buffer ) )
-    {
-        return 0;
-    }
-    
-    if ( bytes <= 0 )
-    {
-        return 0;
-    }
-    
     bytesRead = 0;
     bytesLeft = bytes;
     bufPtr = static_cast<UTF8*>( buffer );
@@ -384,7 +400,7 @@ S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
     while ( -1 )
     {
         // read some bytes from the OGG codec
-        c = ov_read( ( OggVorbis_File* ) stream->ptr, bufPtr, bytesLeft, IsBigEndian, OGG_SAMPLEWIDTH, 1, &BS );
+        c = ov_read( vf, bufPtr, bytesLeft, IsBigEndian, OGG_SAMPLEWIDTH, 1, &BS );
         
         // no more bytes are left
         if ( c <= 0 )
@@ -406,6 +422,37 @@ S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
     return bytesRead;
 }
 
+/*
+=================
+S_OGG_CodecReadStream
+=================
+*/
+S32 S_OGG_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
+{
+    vorbis_info* OGGInfo;
+    
+    // check if input is valid
+    if ( !( stream && buffer ) )
+    {
+        return 0;
+    }
+    
+    if ( bytes <= 0 )
+    {
+        return 0;
+    }
+    
+    // an unseekable stream only finds a chained file that changes format
+    // once it gets there, it ends where the format changes
+    OGGInfo = ov_info( ( OggVorbis_File* ) stream->ptr, -1 );
+    if ( !OGGInfo || OGGInfo->rate != stream->info.rate || OGGInfo->channels != stream->info.channels )
+    {
+        return 0;
+    }
+    
+    return S_OGG_ReadPCM( ( OggVorbis_File* ) stream->ptr, bytes, buffer );
+}
+
 /*
 =====================================================================
 S_OGG_CodecLoad
@@ -426,8 +473,8 @@ void* S_OGG_CodecLoad( StringEntry filename, snd_info_t* info )
         return nullptr;
     }
     
-    // open the file as a stream
-    stream = S_OGG_CodecOpenStream( filename );
+    // open the file as a stream, seekable for its length
+    stream = S_OGG_OpenStream( filename, true );
     if ( !stream )
     {
         return nullptr;
@@ -467,3 +514,172 @@ void* S_OGG_CodecLoad( StringEntry filename, snd_info_t* info )
     
     return buffer;
 }
+
+// callbacks for decoding a file already in memory
+typedef struct
+{
+    const U8* data;
+    S32 length;
+    S32 pos;
+} oggMemory_t;
+
+static size_t S_OGG_Memory_read( void* ptr, size_t size, size_t nmemb, void* datasource )
+{
+    oggMemory_t* memory = static_cast<oggMemory_t*>( datasource );
+    size_t bytes;
+    
+    if ( !( size && nmemb ) )
+    {
+        return 0;
+    }
+    
+    bytes = size * nmemb;
+    if ( bytes > ( size_t )( memory->length - memory->pos ) )
+    {
+        bytes = memory->length - memory->pos;
+    }
+    
+    ::memcpy( ptr, memory->data + memory->pos, bytes );
+    memory->pos += ( S32 )bytes;
+    
+    return bytes / size;
+}
+
+static S32 S_OGG_Memory_seek( void* datasource, ogg_int64_t offset, S32 whence )
+{
+    oggMemory_t* memory = static_cast<oggMemory_t*>( datasource );
+    ogg_int64_t pos;
+    
+    switch ( whence )
+    {
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = memory->pos + offset;
+            break;
+        case SEEK_END:
+            pos = memory->length + offset;
+            break;
+        default:
+            return -1;
+    }
+    
+    if ( pos < 0 || pos > memory->length )
+    {
+        return -1;
+    }
+    
+    memory->pos = ( S32 )pos;
+    return 0;
+}
+
+static long S_OGG_Memory_tell( void* datasource )
+{
+    return static_cast<oggMemory_t*>( datasource )->pos;
+}
+
+static const ov_callbacks S_OGG_MemoryCallbacks =
+{
+    &S_OGG_Memory_read,
+    &S_OGG_Memory_seek,
+    &S_OGG_Callback_close,
+    &S_OGG_Memory_tell
+};
+
+/*
+=================
+S_OGG_OpenMemory
+
+Opens a file in memory for ov_read and reads its header, memory has to
+outlive vf
+=================
+*/
+static bool S_OGG_OpenMemory( OggVorbis_File* vf, oggMemory_t* memory, const void* data, S32 length, snd_info_t* info )
+{
+    vorbis_info* OGGInfo;
+    
+    memory->data = static_cast<const U8*>( data );
+    memory->length = length;
+    memory->pos = 0;
+    
+    if ( ov_open_callbacks( memory, vf, nullptr, 0, S_OGG_MemoryCallbacks ) != 0 )
+    {
+        return false;
+    }
+    
+    // the same restrictions as a stream
+    OGGInfo = ov_info( vf, 0 );
+    if ( !ov_seekable( vf ) || ov_streams( vf ) != 1 || !OGGInfo )
+    {
+        ov_clear( vf );
+        return false;
+    }
+    
+    info->rate = OGGInfo->rate;
+    info->width = OGG_SAMPLEWIDTH;
+    info->channels = OGGInfo->channels;
+    info->samples = ( S32 )ov_pcm_total( vf, 0 );
+    info->size = info->samples * info->channels * info->width;
+    info->dataofs = 0;
+    
+    return true;
+}
+
+/*
+=================
+S_OGG_CodecInfo
+=================
+*/
+bool S_OGG_CodecInfo( const void* data, S32 length, snd_info_t* info )
+{
+    OggVorbis_File vf;
+    oggMemory_t memory;
+    
+    if ( !S_OGG_OpenMemory( &vf, &memory, data, length, info ) )
+    {
+        return false;
+    }
+    
+    ov_clear( &vf );
+    
+    return true;
+}
+
+/*
+=================
+S_OGG_CodecDecode
+
+S_OGG_CodecLoad for a file the caller has read, without touching the file
+system so it can run on a worker thread
+=================
+*/
+void* S_OGG_CodecDecode( const void* data, S32 length, snd_info_t* info )
+{
+    OggVorbis_File vf;
+    oggMemory_t memory;
+    U8* buffer;
+    
+    if ( !S_OGG_OpenMemory( &vf, &memory, data, length, info ) )
+    {
+        return nullptr;
+    }
+    
+    buffer = static_cast<U8*>( ::malloc( info->size ) );
+    if ( !buffer )
+    {
+        ov_clear( &vf );
+        return nullptr;
+    }
+    
+    if ( S_OGG_ReadPCM( &vf, info->size, buffer ) <= 0 )
+    {
+        ::free( buffer );
+        ov_clear( &vf );
+        return nullptr;
+    }
+    
+    ov_clear( &vf );
+    
+    return buffer;
+}
@@ -209,6 +209,8 @@ snd_codec_t wav_codec =
     S_WAV_CodecOpenStream,
     S_WAV_CodecReadStream,
     S_WAV_CodecCloseStream,
+    S_WAV_CodecDecode,
+    S_WAV_CodecInfo,
     nullptr
 };
 
@@ -319,3 +321,136 @@ S32 S_WAV_CodecReadStream( snd_stream_t* stream, S32 bytes, void* buffer )
     
     return bytes;
 }
+
+/*
+=================
+S_FindRIFFChunkInMemory
+
+The memory version of S_FindRIFFChunk, returns the chunk data or nullptr
+=================
+*/
+static const U8* S_FindRIFFChunkInMemory( const U8* p, const U8* end, StringEntry chunk, S32* length )
+{
+    S32 len;
+    
+    while ( end - p >= 8 )
+    {
+        len = LittleLong( *( const S32* )( p + 4 ) );
+        if ( len < 0 )
+        {
+            return nullptr;
+        }
+        
+        // If this is the right chunk, return
+        if ( !Q_strncmp( ( StringEntry )p, chunk, 4 ) )
+        {
+            *length = len;
+            return p + 8;
+        }
+        
+        p += 8;
+        len = PAD( len, 2 );
+        
+        // Not the right chunk - skip it
+        if ( end - p < len )
+        {
+            return nullptr;
+        }
+        p += len;
+    }
+    
+    return nullptr;
+}
+
+/*
+=================
+S_ReadRIFFHeaderInMemory
+
+The memory version of S_ReadRIFFHeader, returns the samples or nullptr
+=================
+*/
+static const U8* S_ReadRIFFHeaderInMemory( const void* data, S32 length, snd_info_t* info )
+{
+    const U8* p = static_cast<const U8*>( data );
+    const U8* end = p + length;
+    const U8* chunk;
+    S32 len, bits;
+    
+    // skip the riff wav header
+    if ( length < 12 )
+    {
+        return nullptr;
+    }
+    p += 12;
+    
+    // Scan for the format chunk
+    chunk = S_FindRIFFChunkInMemory( p, end, "fmt ", &len );
+    if ( !chunk || len < 16 || end - chunk < 16 )
+    {
+        return nullptr;
+    }
+    
+    // Save the parameters
+    info->channels = LittleShort( *( const S16* )( chunk + 2 ) );
+    info->rate = LittleLong( *( const S32* )( chunk + 4 ) );
+    bits = LittleShort( *( const S16* )( chunk + 14 ) );
+    
+    if ( bits < 8 || info->channels < 1 )
+    {
+        return nullptr;
+    }
+    
+    info->width = bits / 8;
+    info->dataofs = 0;
+    
+    // Scan for the data chunk, after the format chunk
+    p = chunk + PAD( len, 2 );
+    if ( p > end || !( chunk = S_FindRIFFChunkInMemory( p, end, "data", &len ) ) )
+    {
+        return nullptr;
+    }
+    
+    // a truncated file plays what it has
+    info->size = ( S32 )( end - chunk ) < len ? ( S32 )( end - chunk ) : len;
+    info->samples = ( info->size / info->width ) / info->channels;
+    
+    return chunk;
+}
+
+/*
+=================
+S_WAV_CodecInfo
+=================
+*/
+bool S_WAV_CodecInfo( const void* data, S32 length, snd_info_t* info )
+{
+    return S_ReadRIFFHeaderInMemory( data, length, info ) != nullptr;
+}
+
+/*
+=================
+S_WAV_CodecDecode
+=================
+*/
+void* S_WAV_CodecDecode( const void* data, S32 length, snd_info_t* info )
+{
+    const U8* chunk;
+    void* buffer;
+    
+    chunk = S_ReadRIFFHeaderInMemory( data, length, info );
+    if ( !chunk )
+    {
+        return nullptr;
+    }
+    
+    buffer = ::malloc( info->size );
+    if ( !buffer )
+    {
+        return nullptr;
+    }
+    
+    ::memcpy( buffer, chunk, info->size );
+    S_ByteSwapRawSamples( info->samples, info->width, info->channels, static_cast< U8* >( buffer ) );
+    
+    return buffer;
+}
@@ -40,7 +40,7 @@ void S_Base_StopBackgroundTrack( void );
 idSoundSystemLocal soundSystemLocal;
 idSoundSystem* soundSystem = &soundSystemLocal;
 
-snd_stream_t*	s_backgroundStream = nullptr;
+sndPrefetch_t*	s_backgroundStream = nullptr;
 static UTF8		s_backgroundLoop[MAX_QPATH];
 //static UTF8		s_backgroundMusic[MAX_QPATH]; //TTimo: unused
 
@@ -117,6 +117,7 @@ void S_Base_SoundInfo( void )
         if ( s_backgroundStream )
         {
             Com_Printf( "Background file: %s\n", s_backgroundLoop );
+            S_PrefetchInfo( s_backgroundStream );
         }
         else
         {
@@ -342,6 +343,8 @@ void S_DefaultSound( sfx_t* sfx )
     {
         sfx->soundData->sndChunk[i] = i;
     }
+    
+    SND_IndexChunks( sfx );
 }
 
 /*
@@ -398,7 +401,7 @@ sfxHandle_t	S_Base_RegisterSound( StringEntry name, bool compressed )
     sfx->inMemory = false;
     sfx->soundCompressed = compressed;
     
-    S_memoryLoad( sfx );
+    S_LoadQueueSound( sfx );
     
     if ( sfx->defaultSound )
     {
@@ -419,6 +422,8 @@ void S_Base_BeginRegistration( void )
     // we can play again
     s_soundMuted = false;
     
+    S_LoadQueueBegin();
+    
     if ( s_numSfx == 0 )
     {
         SND_setup();
@@ -443,13 +448,25 @@ void S_Base_BeginRegistration( void )
 
 void S_memoryLoad( sfx_t*	sfx )
 {
-    // load the sound file
-    if ( !S_LoadSound( sfx ) )
+    bool loaded;
+    
+    // queued by registration, the load jobs have done the rest
+    if ( S_LoadQueueFinish( sfx ) )
+    {
+        return;
+    }
+    
+    // load the sound file, it only takes the mixer lock to store it
+    loaded = S_LoadSound( sfx );
+    
+    S_MixThread_Lock();
+    if ( !loaded )
     {
         //		Com_Printf( S_COLOR_YELLOW "WARNING: couldn't load sound: %s\n", sfx->soundName );
         sfx->defaultSound = true;
     }
     sfx->inMemory = true;
+    S_MixThread_Unlock();
 }
 
 //=============================================================================
@@ -824,6 +841,18 @@ Include velocity in case I get around to doing doppler...
 ==================
 */
 void S_Base_AddLoopingSound( S32 entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle )
+{
+    S_Base_AddLoopingSoundOnFrame( entityNum, origin, velocity, sfxHandle, cls.framecount );
+}
+
+/*
+==================
+S_Base_AddLoopingSoundOnFrame
+
+The mixer thread runs looping sounds a frame or so after they were added
+==================
+*/
+void S_Base_AddLoopingSoundOnFrame( S32 entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle, S32 framecount )
 {
     sfx_t* sfx;
     
@@ -870,7 +899,7 @@ void S_Base_AddLoopingSound( S32 entityNum, const vec3_t origin, const vec3_t ve
         VectorAdd( loopSounds[entityNum].origin, loopSounds[entityNum].velocity, out );
         lenb = DistanceSquared( loopSounds[listener_number].origin, out );
         
-        if ( ( loopSounds[entityNum].framenum + 1 ) != cls.framecount )
+        if ( ( loopSounds[entityNum].framenum + 1 ) != framecount )
         {
             loopSounds[entityNum].oldDopplerScale = 1.0;
         }
@@ -891,7 +920,7 @@ void S_Base_AddLoopingSound( S32 entityNum, const vec3_t origin, const vec3_t ve
         }
     }
     
-    loopSounds[entityNum].framenum = cls.framecount;
+    loopSounds[entityNum].framenum = framecount;
 }
 
 /*
@@ -1353,6 +1382,9 @@ void S_Base_Update( void )
         Com_Printf( "----(%i)---- painted: %i\n", total, s_paintedtime );
     }
     
+    // store sounds the load jobs have finished
+    S_LoadQueueUpdate();
+    
     // add raw data from streamed samples
     S_UpdateBackgroundTrack();
     
@@ -1501,40 +1533,11 @@ void S_Base_StopBackgroundTrack( void )
         return;
     }
     
-    S_CodecCloseStream( s_backgroundStream );
+    S_PrefetchClose( s_backgroundStream );
     s_backgroundStream = nullptr;
     s_rawend = 0;
 }
 
-/*
-======================
-S_OpenBackgroundStream
-======================
-*/
-static void S_OpenBackgroundStream( StringEntry filename )
-{
-    // close the background track, but DON'T reset s_rawend
-    // if restarting the same back ground track
-    if ( s_backgroundStream )
-    {
-        S_CodecCloseStream( s_backgroundStream );
-        s_backgroundStream = nullptr;
-    }
-    
-    // Open stream
-    s_backgroundStream = S_CodecOpenStream( filename );
-    if ( !s_backgroundStream )
-    {
-        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't open music file %s\n", filename );
-        return;
-    }
-    
-    if ( s_backgroundStream->info.channels != 2 || s_backgroundStream->info.rate != 22050 )
-    {
-        Com_DPrintf( S_COLOR_YELLOW "WARNING: music file %s is not 22k stereo\n", filename );
-    }
-}
-
 /*
 ======================
 S_StartBackgroundTrack
@@ -1542,6 +1545,8 @@ S_StartBackgroundTrack
 */
 void S_Base_StartBackgroundTrack( StringEntry intro, StringEntry loop )
 {
+    snd_info_t info;
+    
     if ( !intro )
     {
         intro = "";
@@ -1559,21 +1564,37 @@ void S_Base_StartBackgroundTrack( StringEntry intro, StringEntry loop )
         return;
     }
     
-    if ( !loop )
+    Q_strncpyz( s_backgroundLoop, loop, sizeof( s_backgroundLoop ) );
+    
+    // close the background track, but DON'T reset s_rawend
+    // if restarting the same back ground track
+    if ( s_backgroundStream )
     {
-        s_backgroundLoop[0] = 0;
+        S_PrefetchClose( s_backgroundStream );
+        s_backgroundStream = nullptr;
     }
-    else
+    
+    // the intro and loop are decoded on the prefetch thread
+    s_backgroundStream = S_PrefetchOpen( intro, loop );
+    if ( !s_backgroundStream )
     {
-        Q_strncpyz( s_backgroundLoop, loop, sizeof( s_backgroundLoop ) );
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't open music file %s\n", intro );
+        return;
     }
     
-    S_OpenBackgroundStream( intro );
+    S_PrefetchAvailable( s_backgroundStream, &info );
+    if ( info.channels != 2 || info.rate != 22050 )
+    {
+        Com_DPrintf( S_COLOR_YELLOW "WARNING: music file %s is not 22k stereo\n", intro );
+    }
 }
 
 /*
 ======================
 S_UpdateBackgroundTrack
+
+Never waits on the decoder, whatever it hasn't
+prefetched yet is picked up next frame
 ======================
 */
 void S_UpdateBackgroundTrack( void )
@@ -1582,7 +1603,8 @@ void S_UpdateBackgroundTrack( void )
     S32	fileSamples;
     U8 raw[30000];		// just enough to fit in a mac stack frame
     S32	fileBytes;
-    S32	r;
+    S32	r, frameSize;
+    snd_info_t info;
     static F32 musicVolume = 0.5f;
     
     if ( !s_backgroundStream )
@@ -1607,10 +1629,23 @@ void S_UpdateBackgroundTrack( void )
     
     while ( s_rawend < s_soundtime + MAX_RAW_SAMPLES )
     {
+        r = S_PrefetchAvailable( s_backgroundStream, &info );
+        if ( r < 0 )
+        {
+            // played out and no loop
+            S_Base_StopBackgroundTrack();
+            return;
+        }
+        
+        if ( !r )
+        {
+            return;
+        }
+        
         bufferSamples = MAX_RAW_SAMPLES - ( s_rawend - s_soundtime );
         
         // decide how much data needs to be read from the file
-        fileSamples = ( bufferSamples * dma.speed ) / s_backgroundStream->info.rate;
+        fileSamples = ( bufferSamples * dma.speed ) / info.rate;
         
         if ( !fileSamples )
         {
@@ -1618,44 +1653,24 @@ void S_UpdateBackgroundTrack( void )
         }
         
         // our max buffer size
-        fileBytes = fileSamples * ( s_backgroundStream->info.width * s_backgroundStream->info.channels );
+        frameSize = info.width * info.channels;
+        fileBytes = fileSamples * frameSize;
         if ( fileBytes > sizeof( raw ) )
         {
-            fileBytes = sizeof( raw );
-            fileSamples = fileBytes / ( s_backgroundStream->info.width * s_backgroundStream->info.channels );
+            fileBytes = sizeof( raw ) - sizeof( raw ) % frameSize;
         }
         
-        // Read
-        r = S_CodecReadStream( s_backgroundStream, fileBytes, raw );
-        if ( r < fileBytes )
+        if ( fileBytes > r )
         {
             fileBytes = r;
-            fileSamples = r / ( s_backgroundStream->info.width * s_backgroundStream->info.channels );
         }
         
-        if ( r > 0 )
-        {
-            // add to raw buffer
-            S_Base_RawSamples( fileSamples, s_backgroundStream->info.rate, s_backgroundStream->info.width, s_backgroundStream->info.channels, raw, musicVolume );
-        }
-        else
-        {
-            // loop
-            if ( s_backgroundLoop[0] )
-            {
-                S_OpenBackgroundStream( s_backgroundLoop );
-                if ( !s_backgroundStream )
-                {
-                    return;
-                }
-            }
-            else
-            {
-                S_Base_StopBackgroundTrack();
-                return;
-            }
-        }
+        fileSamples = fileBytes / frameSize;
+        
+        S_PrefetchRead( s_backgroundStream, fileBytes, raw );
         
+        // add to raw buffer
+        S_Base_RawSamples( fileSamples, info.rate, info.width, info.channels, raw, musicVolume );
     }
 }
 
@@ -1696,6 +1711,7 @@ void S_FreeOldestSound( void )
         SND_free( buffer );
         buffer = nbuffer;
     }
+    SND_FreeChunkIndex( sfx );
     sfx->inMemory = false;
     sfx->soundData = nullptr;
 }
@@ -1706,19 +1722,30 @@ void S_FreeOldestSound( void )
 
 void S_Base_Shutdown( void )
 {
+    S32 i;
+    
     if ( !s_soundStarted )
     {
         return;
     }
     
+    S_Base_StopBackgroundTrack();
+    S_LoadQueueShutdown();
+    
     SNDDMA_Shutdown();
     SND_shutdown();
     
+    for ( i = 0; i < s_numSfx; i++ )
+    {
+        SND_FreeChunkIndex( &s_knownSfx[i] );
+    }
+    
     s_soundStarted = 0;
     s_numSfx = 0;
     
     cmdSystem->RemoveCommand( "s_info" );
     cmdSystem->RemoveCommand( "s_devlist" );
+    profilerSystem->RemoveBench( "mix" );
 }
 
 /*
@@ -1768,6 +1795,8 @@ void idSoundSystemLocal::Reload( void )
     
     Com_Printf( "reloading sounds...\n" );
     
+    S_MixThread_Lock();
+    
     soundSystem->StopAllSounds();
     
     for ( sfx = s_knownSfx, i = 0; i < s_numSfx; i++, sfx++ )
@@ -1775,6 +1804,8 @@ void idSoundSystemLocal::Reload( void )
         sfx->inMemory = false;
         S_memoryLoad( sfx );
     }
+    
+    S_MixThread_Unlock();
 }
 
 /*
@@ -1801,6 +1832,9 @@ bool S_Base_Init( soundInterface_t* si )
     
     cmdSystem->AddCommand( "s_devlist", S_dmaHD_devlist, "description" );
     
+    S_InitMixKernels();
+    profilerSystem->AddBench( "mix", S_MixBench_f, "Times painting a channel at offsets through a long sound, args: [seconds] [paints]" );
+    
     r = SNDDMA_Init( s_khz->integer );
     
     if ( r )
@@ -1815,6 +1849,8 @@ bool S_Base_Init( soundInterface_t* si )
         s_paintedtime = 0;
         
         S_Base_StopAllSounds( );
+        
+        S_LoadQueueInit();
     }
     else
     {
@@ -1844,8 +1880,15 @@ bool S_Base_Init( soundInterface_t* si )
     
     if ( dmaHD_Enabled() )
     {
-        return dmaHD_Init( si );
+        if ( !dmaHD_Init( si ) )
+        {
+            return false;
+        }
+        
+        S_MixThread_Init( si, dmaHD_Update_Mix );
+        return true;
     }
     
+    S_MixThread_Init( si, S_Update_ );
     return true;
 }
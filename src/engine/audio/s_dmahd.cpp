@@ -389,27 +389,58 @@ S32( *dmaHD_GetInterpolatedSample )( F32 t, S32 samples, U8* data, S32( *dmaHD_G
 
 /*
 ================
-dmaHD_ResampleSfx
+dmaHD_ResampledLength
 
-resample / decimate to the current source rate
+length of a sound once resampled to the current source rate
 ================
 */
-void dmaHD_ResampleSfx( sfx_t* sfx, S32 channels, S32 inrate, S32 inwidth, U8* data, bool compressed )
+S32 dmaHD_ResampledLength( S32 inrate, S32 samples )
+{
+    return ( S32 )( ( F32 )samples / ( ( F32 )inrate / ( F32 )dma.speed ) );
+}
+
+/*
+================
+dmaHD_InterpolationMode
+
+the dmaHD_interpolation in effect, sounds resampled with another are different
+================
+*/
+S32 dmaHD_InterpolationMode( void )
+{
+    if ( dmaHD_GetInterpolatedSample == dmaHD_GetNoInterpolationSample )
+    {
+        return 0;
+    }
+    else if ( dmaHD_GetInterpolatedSample == dmaHD_GetInterpolatedSampleLinear )
+    {
+        return 1;
+    }
+    else if ( dmaHD_GetInterpolatedSample == dmaHD_GetInterpolatedSampleCubic )
+    {
+        return 2;
+    }
+    
+    return 3;
+}
+
+/*
+================
+dmaHD_ResampleSamples
+
+resample / decimate to the current source rate, outcount high passed samples
+followed by outcount low passed ones. Only reads its arguments so the sound
+registration threads can call it
+================
+*/
+void dmaHD_ResampleSamples( S16* buffer, S32 outcount, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data )
 {
-    S16* buffer;
     S32( *dmaHD_GetSampleRaw )( S32, S32, U8* );
     F32 stepscale, idx_smp, sample, bsample;
     F32 lp_inva, lp_a, hp_a, lp_data, lp_last, hp_data, hp_last, hp_lastsample;
-    S32 outcount, idx_hp, idx_lp;
+    S32 idx_hp, idx_lp;
     
     stepscale = ( F32 )inrate / ( F32 )dma.speed;
-    outcount = ( S32 )( ( F32 )sfx->soundLength / stepscale );
-    
-    // Create secondary buffer for bass sound while performing lowpass filter;
-    buffer = dmaHD_AllocateSoundBuffer( outcount * 2 );
-    
-    // Check if this is a weapon sound.
-    sfx->weaponsound = ( ::memcmp( sfx->soundName, "sound/weapons/", 14 ) == 0 ) ? true : false;
     
     if ( channels == 2 )
     {
@@ -422,8 +453,8 @@ void dmaHD_ResampleSfx( sfx_t* sfx, S32 channels, S32 inrate, S32 inwidth, U8* d
     
     // Get last sample from sound effect.
     idx_smp = -( stepscale * 4.0f );
-    sample = ( F32 )dmaHD_GetInterpolatedSample( idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw );
-    bsample = ( F32 )dmaHD_GetNoInterpolationSample( idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw );
+    sample = ( F32 )dmaHD_GetInterpolatedSample( idx_smp, samples, data, dmaHD_GetSampleRaw );
+    bsample = ( F32 )dmaHD_GetNoInterpolationSample( idx_smp, samples, data, dmaHD_GetSampleRaw );
     idx_smp += stepscale;
     
     // Set up high pass filter.
@@ -442,8 +473,8 @@ void dmaHD_ResampleSfx( sfx_t* sfx, S32 channels, S32 inrate, S32 inwidth, U8* d
     // Now do actual high/low pass on actual data.
     for ( ; idx_hp < outcount; idx_hp++ )
     {
-        sample = ( F32 )dmaHD_GetInterpolatedSample( idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw );
-        bsample = ( F32 )dmaHD_GetNoInterpolationSample( idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw );
+        sample = ( F32 )dmaHD_GetInterpolatedSample( idx_smp, samples, data, dmaHD_GetSampleRaw );
+        bsample = ( F32 )dmaHD_GetNoInterpolationSample( idx_smp, samples, data, dmaHD_GetSampleRaw );
         idx_smp += stepscale;
         
         // High pass.
@@ -457,46 +488,76 @@ void dmaHD_ResampleSfx( sfx_t* sfx, S32 channels, S32 inrate, S32 inwidth, U8* d
         buffer[idx_lp++] = ( S16 )SMPCLAMP( lp_data );
         lp_last = lp_data;
     }
+}
+
+/*
+================
+dmaHD_StoreSound
+
+takes the output of dmaHD_ResampleSamples for a sound
+================
+*/
+void dmaHD_StoreSound( sfx_t* sfx, const S16* samples, S32 outcount )
+{
+    S16* buffer;
     
+    buffer = dmaHD_AllocateSoundBuffer( outcount * 2 );
+    ::memcpy( buffer, samples, outcount * 2 * sizeof( S16 ) );
+    
+    sfx->weaponsound = ( ::memcmp( sfx->soundName, "sound/weapons/", 14 ) == 0 ) ? true : false;
+    sfx->soundCompressionMethod = 0;
     sfx->soundData = ( sndBuffer* )buffer;
     sfx->soundLength = outcount;
 }
 
-bool dmaHD_LoadSound( sfx_t* sfx )
+/*
+================
+dmaHD_SoundFileName
+
+a sound may have a _dmahd version next to it, name gets the file to load
+================
+*/
+void dmaHD_SoundFileName( const sfx_t* sfx, UTF8* name )
 {
-    U8* data;
-    snd_info_t info;
     UTF8 dmahd_soundName[MAX_QPATH];
-    UTF8* lpext;
-    
-    // Player specific sounds are never directly loaded.
-    if ( sfx->soundName[0] == '*' ) return false;
+    StringEntry lpext;
     
-    strcpy( dmahd_soundName, sfx->soundName );
+    Q_strncpyz( dmahd_soundName, sfx->soundName, sizeof( dmahd_soundName ) );
     if ( ( lpext = strrchr( sfx->soundName, '.' ) ) != nullptr )
     {
-        strcpy( dmahd_soundName, sfx->soundName );
         *( strrchr( dmahd_soundName, '.' ) ) = '\0'; // for sure there is a '.'
     }
-    strcat( dmahd_soundName, "_dmahd" );
-    if ( lpext != nullptr ) strcat( dmahd_soundName, lpext );
+    Q_strcat( dmahd_soundName, sizeof( dmahd_soundName ), "_dmahd" );
+    if ( lpext != nullptr ) Q_strcat( dmahd_soundName, sizeof( dmahd_soundName ), lpext );
     
     // Just check if file exists
     if ( fileSystem->FOpenFileRead( dmahd_soundName, nullptr, true ) )
     {
-        // Load it in.
-        if ( !( data = static_cast<U8*>( S_CodecLoad( dmahd_soundName, &info ) ) ) )
-        {
-            return false;
-        }
+        Q_strncpyz( name, dmahd_soundName, MAX_QPATH );
     }
     else
     {
-        // Load it in.
-        if ( !( data = static_cast<U8*>( S_CodecLoad( sfx->soundName, &info ) ) ) )
-        {
-            return false;
-        }
+        Q_strncpyz( name, sfx->soundName, MAX_QPATH );
+    }
+}
+
+bool dmaHD_LoadSound( sfx_t* sfx )
+{
+    U8* data;
+    S16* samples;
+    S32 outcount;
+    snd_info_t info;
+    UTF8 dmahd_soundName[MAX_QPATH];
+    
+    // Player specific sounds are never directly loaded.
+    if ( sfx->soundName[0] == '*' ) return false;
+    
+    dmaHD_SoundFileName( sfx, dmahd_soundName );
+    
+    // Load it in.
+    if ( !( data = static_cast<U8*>( S_CodecLoad( dmahd_soundName, &info ) ) ) )
+    {
+        return false;
     }
     
     // Information
@@ -513,16 +574,18 @@ bool dmaHD_LoadSound( sfx_t* sfx )
     
     Com_DPrintf( "\n" );
     
-    sfx->lastTimeUsed = Com_Milliseconds() + 1;
+    // Resample outside the mixer lock, only the store needs it.
+    outcount = dmaHD_ResampledLength( info.rate, info.samples );
+    samples = static_cast<S16*>( memorySystem->AllocateTempMemory( outcount * 2 * sizeof( S16 ) ) );
+    dmaHD_ResampleSamples( samples, outcount, info.channels, info.rate, info.width, info.samples, data + info.dataofs );
     
-    // Do not compress.
-    sfx->soundCompressionMethod = 0;
-    sfx->soundLength = info.samples;
-    sfx->soundData = nullptr;
-    
-    dmaHD_ResampleSfx( sfx, info.channels, info.rate, info.width, data + info.dataofs, false );
+    S_MixThread_Lock();
+    sfx->lastTimeUsed = Com_Milliseconds() + 1;
+    dmaHD_StoreSound( sfx, samples, outcount );
+    S_MixThread_Unlock();
     
     // Free data allocated by Codec
+    memorySystem->FreeTempMemory( samples );
     memorySystem->FreeTempMemory( data );
     
     return true;
@@ -536,11 +599,9 @@ PART#02: dmaHD: Mixing
 
 static void dmaHD_PaintChannelFrom16_HHRTF( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset, S32 chan )
 {
-    S32 vol, i, so;
+    S32 vol, so;
     portable_samplepair_t* samp = &dmaHD_paintbuffer[bufferOffset];
     S16* samples;
-    S16* tsamples;
-    S32* out;
     ch_side_t* chs = ( chan == 0 ) ? &ch->l : &ch->r;
     
     if ( dmaHD_snd_vol <= 0 ) return;
@@ -569,22 +630,9 @@ static void dmaHD_PaintChannelFrom16_HHRTF( channel_t* ch, const sfx_t* sc, S32
         // Select bass frequency offset (just after high frequency)
         samples = &( ( S16* )sc->soundData )[sc->soundLength];
         
-        // Calculate volumes.
+        // Calculate volumes, the other side gets nothing added.
         vol = chs->bassvol * dmaHD_snd_vol;
-        tsamples = &samples[so];
-        out = ( S32* )samp;
-        if ( chan == 1 )
-        {
-            out++;
-        }
-        
-        for ( i = 0; i < count; i++ )
-        {
-            *out += ( *tsamples * vol ) >> 8;
-            ++tsamples;
-            ++out;
-            ++out;
-        }
+        s_mix->PaintMono( ( S32* )samp, &samples[so], count, ( chan == 0 ) ? vol : 0, ( chan == 1 ) ? vol : 0 );
     }
     
     // Process high frequency
@@ -593,33 +641,17 @@ static void dmaHD_PaintChannelFrom16_HHRTF( channel_t* ch, const sfx_t* sc, S32
         // Select high frequency offset.
         samples = ( S16* )sc->soundData;
         
-        // Calculate volumes.
+        // Calculate volumes, the other side gets nothing added.
         vol = chs->vol * dmaHD_snd_vol;
-        tsamples = &samples[so];
-        out = ( S32* )samp;
-        
-        if ( chan == 1 )
-        {
-            out++;
-        }
-        
-        for ( i = 0; i < count; i++ )
-        {
-            *out += ( *tsamples * vol ) >> 8;
-            ++tsamples;
-            ++out;
-            ++out;
-        }
+        s_mix->PaintMono( ( S32* )samp, &samples[so], count, ( chan == 0 ) ? vol : 0, ( chan == 1 ) ? vol : 0 );
     }
 }
 
 static void dmaHD_PaintChannelFrom16_dmaEX2( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
 {
-    S32 data, rvol, lvol, i, so;
+    S32 rvol, lvol, so;
     portable_samplepair_t* samp = &dmaHD_paintbuffer[bufferOffset];
     S16* samples;
-    S16* tsamples;
-    S32* out;
     
     if ( dmaHD_snd_vol <= 0 )
     {
@@ -649,19 +681,9 @@ static void dmaHD_PaintChannelFrom16_dmaEX2( channel_t* ch, const sfx_t* sc, S32
     {
         samples = &( ( S16* )sc->soundData )[sc->soundLength]; // Select bass frequency offset (just after high frequency)
         
-        // Calculate volumes.
+        // Calculate volumes, bass is the same on both sides.
         lvol = ch->l.bassvol * dmaHD_snd_vol;
-        tsamples = &samples[so];
-        out = ( S32* )samp;
-        for ( i = 0; i < count; i++ )
-        {
-            data = ( *tsamples * lvol ) >> 8;
-            ++tsamples;
-            *out += data;
-            ++out; // L
-            *out += data;
-            ++out; // R
-        }
+        s_mix->PaintMono( ( S32* )samp, &samples[so], count, lvol, lvol );
     }
     
     // Process high frequency.
@@ -687,16 +709,7 @@ static void dmaHD_PaintChannelFrom16_dmaEX2( channel_t* ch, const sfx_t* sc, S32
             }
         }
         
-        tsamples = &samples[so];
-        out = ( S32* )samp;
-        for ( i = 0; i < count; i++ )
-        {
-            *out += ( *tsamples * lvol ) >> 8;
-            ++out; // L
-            *out += ( *tsamples * rvol ) >> 8;
-            ++out; // R
-            ++tsamples;
-        }
+        s_mix->PaintMono( ( S32* )samp, &samples[so], count, lvol, rvol );
     }
     
     // Process high frequency reverb.
@@ -720,26 +733,15 @@ static void dmaHD_PaintChannelFrom16_dmaEX2( channel_t* ch, const sfx_t* sc, S32
         // Calculate volumes for reverb.
         lvol = ch->l.reverbvol * dmaHD_snd_vol;
         rvol = ch->r.reverbvol * dmaHD_snd_vol;
-        tsamples = &samples[so];
-        out = ( S32* )samp;
-        
-        for ( i = 0; i < count; i++ )
-        {
-            *out += ( *tsamples * lvol ) >> 8;
-            ++out; // L
-            *out += ( *tsamples * rvol ) >> 8;
-            ++out; // R
-            ++tsamples;
-        }
+        s_mix->PaintMono( ( S32* )samp, &samples[so], count, lvol, rvol );
     }
 }
 
 static void dmaHD_PaintChannelFrom16_dmaEX( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
 {
-    S32 rvol, lvol, i, so;
+    S32 rvol, lvol, so;
     portable_samplepair_t* samp = &dmaHD_paintbuffer[bufferOffset];
     S16* samples, *bsamples;
-    S32* out;
     
     if ( dmaHD_snd_vol <= 0 )
     {
@@ -784,16 +786,10 @@ static void dmaHD_PaintChannelFrom16_dmaEX( channel_t* ch, const sfx_t* sc, S32
             rvol = -rvol;
         }
     }
-    out = ( S32* )samp;
-    for ( i = 0; i < count; i++ )
-    {
-        *out += ( ( *samples * lvol ) >> 8 ) + ( ( *bsamples * lvol ) >> 8 );
-        ++out; // L
-        *out += ( ( *samples * rvol ) >> 8 ) + ( ( *bsamples * rvol ) >> 8 );
-        ++out; // R
-        ++samples;
-        ++bsamples;
-    }
+    
+    // paint the high then the bass frequencies
+    s_mix->PaintMono( ( S32* )samp, samples, count, lvol, rvol );
+    s_mix->PaintMono( ( S32* )samp, bsamples, count, lvol, rvol );
 }
 
 static void dmaHD_PaintChannelFrom16( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
@@ -826,12 +822,9 @@ void dmaHD_TransferPaintBuffer( S32 endtime )
 {
     S32 lpos;
     S32 ls_paintedtime;
-    S32 i;
-    S32 val;
     S32* snd_p;
     S32 snd_linear_count;
     S16* snd_out;
-    S16* snd_outtmp;
     U64* pbuf = ( U64* )dma.buffer;
     
     snd_p = ( S32* )dmaHD_paintbuffer;
@@ -853,11 +846,8 @@ void dmaHD_TransferPaintBuffer( S32 endtime )
         snd_linear_count <<= 1;
         
         // write a linear blast of samples
-        for ( snd_outtmp = snd_out, i = 0; i < snd_linear_count; ++i )
-        {
-            val = *snd_p++ >> 8;
-            *snd_outtmp++ = SMPCLAMP( val );
-        }
+        s_mix->ClampTo16( snd_out, snd_p, snd_linear_count );
+        snd_p += snd_linear_count;
         
         ls_paintedtime += ( snd_linear_count >> 1 );
         
@@ -878,6 +868,7 @@ void dmaHD_PaintChannels( S32 endtime )
     S32 sampleOffset;
     
     dmaHD_snd_vol = ( S32 )s_volume->value * 256;
+    S_UpdateMixKernels();
     
     while ( s_paintedtime < endtime )
     {
@@ -1485,6 +1476,9 @@ void dmaHD_Update( void )
         return;
     }
     
+    // store sounds the load jobs have finished
+    S_LoadQueueUpdate();
+    
     // add raw data from streamed samples
     S_UpdateBackgroundTrack();
     
@@ -25,7 +25,13 @@ freely, subject to the following restrictions:
 #define __SND_DMAHD_H__
 
 bool dmaHD_LoadSound( sfx_t* sfx );
+void dmaHD_SoundFileName( const sfx_t* sfx, UTF8* name );
+S32 dmaHD_ResampledLength( S32 inrate, S32 samples );
+S32 dmaHD_InterpolationMode( void );
+void dmaHD_ResampleSamples( S16* buffer, S32 outcount, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data );
+void dmaHD_StoreSound( sfx_t* sfx, const S16* samples, S32 outcount );
 bool dmaHD_Enabled( void );
 bool dmaHD_Init( soundInterface_t* si );
+void dmaHD_Update_Mix( void );
 
 #endif//__SND_DMAEX_H__
@@ -0,0 +1,735 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2019 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   s_load.cpp
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: decodes and resamples registered sounds on worker threads
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <framework/precompiled.h>
+
+/*
+===============================================================================
+
+Sounds registered during a map load are read on the main thread, as the file
+system is not thread safe, and queued as jobs on the job pool. The jobs decode
+and resample them into plain memory, and the main thread moves the result into sound
+memory when the sound is first needed or on the next update. Resampled sounds
+are written to soundcache/, named by the checksum of the source file, the
+output rate and the resampler, so later loads of the same sound only read it.
+
+===============================================================================
+*/
+
+// MAX_SFX may be larger than MAX_SOUNDS because of custom player sounds
+#define MAX_SFX 4096 // This must be the same as the s_dma.cpp
+
+#define SOUNDCACHE_IDENT	( ( 'C' << 24 ) + ( 'N' << 16 ) + ( 'D' << 8 ) + 'S' )
+#define SOUNDCACHE_VERSION	1
+
+extern sfx_t s_knownSfx[];
+extern S32 s_numSfx;
+
+// a soundcache file, followed by count samples
+typedef struct
+{
+    S32 ident;
+    S32 version;
+    U32 checksum;			// of the source file
+    S32 sourceLength;
+    S32 rate;				// dma.speed
+    S32 resampler;			// 0 for the base one, 1 + dmaHD_interpolation for dmaHD
+    S32 channels;
+    S32 length;				// sfx->soundLength
+    S32 count;
+} sndCacheHeader_t;
+
+typedef enum
+{
+    LOAD_IDLE,
+    LOAD_QUEUED,
+    LOAD_RUNNING,
+    LOAD_DONE
+} loadState_t;
+
+// one per sfx, the state is guarded by s_loadMutex
+typedef struct
+{
+    loadState_t state;
+    
+    snd_codec_t* codec;
+    U8* source;				// the file, freed once decoded
+    S32 sourceLength;
+    
+    sndCacheHeader_t key;
+    sndCacheHeader_t* block;	// the resampled sound, nullptr when it couldn't be decoded
+    bool cached;			// block came from soundcache/
+    
+    F64 decodeSeconds;
+} sndLoadJob_t;
+
+static sndLoadJob_t s_loadJobs[MAX_SFX];
+static S32 s_loadPending;			// jobs not stored yet, main thread only
+
+static bool s_loadEnabled;
+static qmutex_t* s_loadMutex;
+static qcondvar_t* s_loadDone;		// a job was decoded
+static qjobGroup_t s_loadGroup;
+
+// since the last S_LoadQueueBegin
+static struct
+{
+    bool active;
+    S32 sounds;
+    S32 cached;
+    S32 failed;
+    Uint64 start;
+    F64 mainSeconds;		// spent registering on the main thread
+    F64 decodeSeconds;		// in the load jobs
+} s_loadStats;
+
+static convar_t* s_loadThreads;
+static convar_t* s_soundCache;
+
+/*
+=================
+S_LoadQueueSeconds
+=================
+*/
+static F64 S_LoadQueueSeconds( Uint64 start )
+{
+    return ( SDL_GetPerformanceCounter() - start ) / ( F64 )SDL_GetPerformanceFrequency();
+}
+
+/*
+=================
+S_LoadQueueDecode
+
+Decodes and resamples a job, runs in a pool job
+=================
+*/
+static void S_LoadQueueDecode( sndLoadJob_t* job )
+{
+    snd_info_t info;
+    U8* data;
+    S32 length, count;
+    sndCacheHeader_t* block;
+    
+    data = static_cast<U8*>( S_CodecDecode( job->codec, job->source, job->sourceLength, &info ) );
+    
+    ::free( job->source );
+    job->source = nullptr;
+    
+    if ( !data )
+    {
+        return;
+    }
+    
+    if ( info.rate <= 0 || info.samples <= 0 )
+    {
+        ::free( data );
+        return;
+    }
+    
+    if ( job->key.resampler )
+    {
+        // high and low passed halves
+        length = dmaHD_ResampledLength( info.rate, info.samples );
+        count = length * 2;
+    }
+    else
+    {
+        length = S_ResampledLength( info.rate, info.samples );
+        count = length * info.channels;
+    }
+    
+    block = static_cast<sndCacheHeader_t*>( ::malloc( sizeof( *block ) + count * sizeof( S16 ) ) );
+    if ( block && length > 0 )
+    {
+        *block = job->key;
+        block->channels = info.channels;
+        block->length = length;
+        block->count = count;
+        
+        if ( block->resampler )
+        {
+            dmaHD_ResampleSamples( ( S16* )( block + 1 ), length, info.channels, info.rate, info.width, info.samples, data + info.dataofs );
+        }
+        else
+        {
+            ResampleSfxRaw( ( S16* )( block + 1 ), info.channels, info.rate, info.width, info.samples, data + info.dataofs );
+        }
+        
+        job->block = block;
+    }
+    else
+    {
+        ::free( block );
+    }
+    
+    ::free( data );
+}
+
+/*
+=================
+S_LoadJob
+
+Skips a job the main thread took over or dropped while it was queued
+=================
+*/
+static void S_LoadJob( void* data )
+{
+    sndLoadJob_t* job = static_cast<sndLoadJob_t*>( data );
+    Uint64 start;
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    if ( job->state != LOAD_QUEUED )
+    {
+        threadsSystem->Mutex_Unlock( s_loadMutex );
+        return;
+    }
+    job->state = LOAD_RUNNING;
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    start = SDL_GetPerformanceCounter();
+    S_LoadQueueDecode( job );
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    job->decodeSeconds = S_LoadQueueSeconds( start );
+    job->state = LOAD_DONE;
+    threadsSystem->CondVar_Wake( s_loadDone );
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+}
+
+/*
+=================
+S_LoadQueueCacheName
+=================
+*/
+static void S_LoadQueueCacheName( const sndCacheHeader_t* key, UTF8* name, S32 size )
+{
+    Q_snprintf( name, size, "soundcache/%08x_%i_%i.pcm", key->checksum, key->rate, key->resampler );
+}
+
+/*
+=================
+S_LoadQueueReadCache
+
+Returns the cached block for key, or nullptr when there is none or it is stale
+=================
+*/
+static sndCacheHeader_t* S_LoadQueueReadCache( const sndCacheHeader_t* key )
+{
+    UTF8 name[MAX_QPATH];
+    fileHandle_t f;
+    S32 length;
+    sndCacheHeader_t* block;
+    
+    S_LoadQueueCacheName( key, name, sizeof( name ) );
+    
+    length = fileSystem->FOpenFileRead( name, &f, true );
+    if ( !f )
+    {
+        return nullptr;
+    }
+    
+    if ( length < ( S32 )sizeof( *block ) || !( block = static_cast<sndCacheHeader_t*>( ::malloc( length ) ) ) )
+    {
+        fileSystem->FCloseFile( f );
+        return nullptr;
+    }
+    
+    fileSystem->Read( block, length, f );
+    fileSystem->FCloseFile( f );
+    
+    if ( block->ident != SOUNDCACHE_IDENT || block->version != SOUNDCACHE_VERSION ||
+            block->checksum != key->checksum || block->sourceLength != key->sourceLength ||
+            block->rate != key->rate || block->resampler != key->resampler ||
+            block->length <= 0 || block->count < 0 || length != ( S32 )( sizeof( *block ) + block->count * sizeof( S16 ) ) )
+    {
+        ::free( block );
+        return nullptr;
+    }
+    
+    return block;
+}
+
+/*
+=================
+S_LoadQueueDefault
+
+Gives a sound that couldn't be loaded a short silence, so registering it
+again finds it loaded and returns 0 without reading the file again
+=================
+*/
+static void S_LoadQueueDefault( sfx_t* sfx )
+{
+    static const S16 silence[2 * 64] = { 0 };
+    
+    sfx->defaultSound = true;
+    sfx->inMemory = true;
+    
+    if ( sfx->soundData )
+    {
+        return;
+    }
+    
+    if ( dmaHD_Enabled() )
+    {
+        dmaHD_StoreSound( sfx, silence, 64 );
+    }
+    else
+    {
+        S_StoreSound( sfx, 1, 64, silence );
+    }
+}
+
+/*
+=================
+S_LoadQueueStore
+
+Moves a finished job into sound memory, with the mixer thread locked out
+=================
+*/
+static void S_LoadQueueStore( S32 index )
+{
+    sfx_t* sfx = &s_knownSfx[index];
+    sndLoadJob_t* job = &s_loadJobs[index];
+    sndCacheHeader_t* block = job->block;
+    UTF8 name[MAX_QPATH];
+    
+    // written before the mixer is locked out
+    if ( block && !job->cached && s_soundCache->integer )
+    {
+        S_LoadQueueCacheName( block, name, sizeof( name ) );
+        fileSystem->WriteFile( name, block, sizeof( *block ) + block->count * sizeof( S16 ) );
+    }
+    
+    S_MixThread_Lock();
+    
+    if ( block )
+    {
+        if ( block->resampler )
+        {
+            dmaHD_StoreSound( sfx, ( S16* )( block + 1 ), block->length );
+        }
+        else
+        {
+            S_StoreSound( sfx, block->channels, block->length, ( S16* )( block + 1 ) );
+        }
+        
+        ::free( block );
+        
+        if ( job->cached )
+        {
+            s_loadStats.cached++;
+        }
+    }
+    else
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: could not load %s - using default\n", sfx->soundName );
+        S_LoadQueueDefault( sfx );
+        s_loadStats.failed++;
+    }
+    
+    s_loadStats.decodeSeconds += job->decodeSeconds;
+    
+    sfx->inMemory = true;
+    
+    job->block = nullptr;
+    job->state = LOAD_IDLE;
+    s_loadPending--;
+    
+    S_MixThread_Unlock();
+}
+
+/*
+=================
+S_LoadQueueAdd
+
+Reads a sound and queues it for the job pool, returns false when it has
+to be loaded the usual way. The header is checked here so a sound that can't
+be decoded fails its registration instead of once it has been queued
+=================
+*/
+static bool S_LoadQueueAdd( sfx_t* sfx )
+{
+    S32 index = ( S32 )( sfx - s_knownSfx );
+    sndLoadJob_t* job = &s_loadJobs[index];
+    UTF8 name[MAX_QPATH], fn[MAX_QPATH];
+    snd_codec_t* codec;
+    snd_info_t info;
+    fileHandle_t f;
+    S32 length;
+    U8* source;
+    
+    // registered again before it was stored
+    if ( job->state != LOAD_IDLE )
+    {
+        return true;
+    }
+    
+    // player specific sounds are never directly loaded, and ADPCM is encoded in sound memory
+    if ( !s_loadEnabled || sfx->soundName[0] == '*' || sfx->soundCompressed )
+    {
+        return false;
+    }
+    
+    if ( dmaHD_Enabled() )
+    {
+        dmaHD_SoundFileName( sfx, name );
+    }
+    else
+    {
+        Q_strncpyz( name, sfx->soundName, sizeof( name ) );
+    }
+    
+    codec = S_CodecFindFile( name, fn, sizeof( fn ) );
+    if ( !codec || !codec->decode || !codec->info )
+    {
+        return false;
+    }
+    
+    // missing files are reported by the usual load
+    length = fileSystem->FOpenFileRead( fn, &f, true );
+    if ( !f )
+    {
+        return false;
+    }
+    
+    source = length > 0 ? static_cast<U8*>( ::malloc( length ) ) : nullptr;
+    if ( !source )
+    {
+        fileSystem->FCloseFile( f );
+        return false;
+    }
+    
+    fileSystem->Read( source, length, f );
+    fileSystem->FCloseFile( f );
+    
+    if ( !S_CodecInfo( codec, source, length, &info ) )
+    {
+        ::free( source );
+        
+        S_MixThread_Lock();
+        S_LoadQueueDefault( sfx );
+        S_MixThread_Unlock();
+        return true;
+    }
+    
+    job->codec = codec;
+    job->cached = false;
+    job->decodeSeconds = 0;
+    
+    job->key.ident = SOUNDCACHE_IDENT;
+    job->key.version = SOUNDCACHE_VERSION;
+    job->key.checksum = MD4System->BlockChecksum( source, length );
+    job->key.sourceLength = length;
+    job->key.rate = dma.speed;
+    job->key.resampler = dmaHD_Enabled() ? 1 + dmaHD_InterpolationMode() : 0;
+    job->key.channels = 0;
+    job->key.length = 0;
+    job->key.count = 0;
+    
+    sfx->lastTimeUsed = Com_Milliseconds() + 1;
+    s_loadPending++;
+    
+    if ( s_soundCache->integer && ( job->block = S_LoadQueueReadCache( &job->key ) ) != nullptr )
+    {
+        ::free( source );
+        
+        job->cached = true;
+        job->state = LOAD_DONE;
+        S_LoadQueueStore( index );
+        return true;
+    }
+    
+    job->source = source;
+    job->sourceLength = length;
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    job->state = LOAD_QUEUED;
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    threadsSystem->Job_Add( &s_loadGroup, S_LoadJob, job );
+    
+    return true;
+}
+
+/*
+=================
+S_LoadQueueCollect
+
+Stores the jobs the pool has finished
+=================
+*/
+static void S_LoadQueueCollect( void )
+{
+    static S32 done[MAX_SFX];
+    S32 i, numDone;
+    
+    if ( !s_loadPending )
+    {
+        return;
+    }
+    
+    numDone = 0;
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    for ( i = 0; i < s_numSfx; i++ )
+    {
+        if ( s_loadJobs[i].state == LOAD_DONE )
+        {
+            done[numDone++] = i;
+        }
+    }
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    for ( i = 0; i < numDone; i++ )
+    {
+        S_LoadQueueStore( done[i] );
+    }
+}
+
+/*
+=================
+S_LoadQueueInit
+=================
+*/
+void S_LoadQueueInit( void )
+{
+    s_loadThreads = cvarSystem->Get( "s_loadThreads", "1", CVAR_ARCHIVE | CVAR_LATCH, "Decodes and resamples the sounds registered on map load on the job pool, 0 loads each one on the main thread as it is registered" );
+    s_soundCache = cvarSystem->Get( "s_soundCache", "0", CVAR_ARCHIVE, "Keeps sounds resampled by the load jobs in soundcache/ so later map loads only read them" );
+    
+    ::memset( s_loadJobs, 0, sizeof( s_loadJobs ) );
+    ::memset( &s_loadStats, 0, sizeof( s_loadStats ) );
+    s_loadPending = 0;
+    
+    if ( !s_loadThreads->integer )
+    {
+        return;
+    }
+    
+    s_loadMutex = threadsSystem->Mutex_Create();
+    s_loadDone = threadsSystem->CondVar_Create();
+    if ( !s_loadMutex || !s_loadDone )
+    {
+        threadsSystem->CondVar_Destroy( &s_loadDone );
+        threadsSystem->Mutex_Destroy( &s_loadMutex );
+        return;
+    }
+    
+    s_loadEnabled = true;
+}
+
+/*
+=================
+S_LoadQueueShutdown
+
+Drops the jobs still pending, the sounds are freed after this
+=================
+*/
+void S_LoadQueueShutdown( void )
+{
+    S32 i;
+    
+    if ( !s_loadEnabled )
+    {
+        return;
+    }
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    for ( i = 0; i < MAX_SFX; i++ )
+    {
+        if ( s_loadJobs[i].state == LOAD_QUEUED )
+        {
+            s_loadJobs[i].state = LOAD_IDLE;
+        }
+    }
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    // only the running jobs are left to finish
+    threadsSystem->Job_Wait( &s_loadGroup );
+    s_loadEnabled = false;
+    
+    for ( i = 0; i < MAX_SFX; i++ )
+    {
+        ::free( s_loadJobs[i].source );
+        ::free( s_loadJobs[i].block );
+    }
+    ::memset( s_loadJobs, 0, sizeof( s_loadJobs ) );
+    s_loadPending = 0;
+    
+    threadsSystem->CondVar_Destroy( &s_loadDone );
+    threadsSystem->Mutex_Destroy( &s_loadMutex );
+}
+
+/*
+=================
+S_LoadQueueBegin
+
+Starts timing a registration, reported once all of its sounds are stored
+=================
+*/
+void S_LoadQueueBegin( void )
+{
+    ::memset( &s_loadStats, 0, sizeof( s_loadStats ) );
+    s_loadStats.active = true;
+    s_loadStats.start = SDL_GetPerformanceCounter();
+}
+
+/*
+=================
+S_LoadQueueSound
+
+Loads a registered sound, through the job pool unless s_loadThreads is 0
+=================
+*/
+void S_LoadQueueSound( sfx_t* sfx )
+{
+    Uint64 start;
+    
+    start = SDL_GetPerformanceCounter();
+    
+    if ( s_loadJobs[sfx - s_knownSfx].state == LOAD_IDLE )
+    {
+        s_loadStats.sounds++;
+    }
+    
+    if ( !S_LoadQueueAdd( sfx ) )
+    {
+        S_memoryLoad( sfx );
+    }
+    
+    if ( sfx->defaultSound && s_loadJobs[sfx - s_knownSfx].state == LOAD_IDLE )
+    {
+        if ( !sfx->soundData )
+        {
+            S_MixThread_Lock();
+            S_LoadQueueDefault( sfx );
+            S_MixThread_Unlock();
+        }
+        
+        s_loadStats.failed++;
+    }
+    
+    S_LoadQueueCollect();
+    
+    s_loadStats.mainSeconds += S_LoadQueueSeconds( start );
+}
+
+/*
+=================
+S_LoadQueueFinish
+
+Called by S_memoryLoad, stores a queued sound once it has been decoded, taking
+it over from the pool if no job has started on it. Returns false if
+the sound isn't queued
+=================
+*/
+bool S_LoadQueueFinish( sfx_t* sfx )
+{
+    S32 index = ( S32 )( sfx - s_knownSfx );
+    sndLoadJob_t* job = &s_loadJobs[index];
+    bool steal;
+    Uint64 start;
+    
+    if ( !s_loadPending || job->state == LOAD_IDLE )
+    {
+        return false;
+    }
+    
+    start = SDL_GetPerformanceCounter();
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    steal = ( job->state == LOAD_QUEUED );
+    if ( steal )
+    {
+        job->state = LOAD_RUNNING;
+    }
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    if ( steal )
+    {
+        S_LoadQueueDecode( job );
+        job->decodeSeconds = S_LoadQueueSeconds( start );
+        
+        threadsSystem->Mutex_Lock( s_loadMutex );
+        job->state = LOAD_DONE;
+        threadsSystem->Mutex_Unlock( s_loadMutex );
+    }
+    
+    threadsSystem->Mutex_Lock( s_loadMutex );
+    while ( job->state != LOAD_DONE )
+    {
+        threadsSystem->CondVar_Wait( s_loadDone, s_loadMutex, COND_WAIT_FOREVER );
+    }
+    threadsSystem->Mutex_Unlock( s_loadMutex );
+    
+    S_LoadQueueStore( index );
+    
+    s_loadStats.mainSeconds += S_LoadQueueSeconds( start );
+    
+    return true;
+}
+
+/*
+=================
+S_LoadQueueUpdate
+
+Called every frame, stores finished sounds and reports the registration time
+once nothing is left
+=================
+*/
+void S_LoadQueueUpdate( void )
+{
+    Uint64 start;
+    
+    if ( s_loadPending )
+    {
+        start = SDL_GetPerformanceCounter();
+        S_LoadQueueCollect();
+        s_loadStats.mainSeconds += S_LoadQueueSeconds( start );
+    }
+    
+    if ( !s_loadStats.active || s_loadPending || !s_loadStats.sounds )
+    {
+        return;
+    }
+    
+    s_loadStats.active = false;
+    
+    if ( s_loadEnabled )
+    {
+        Com_Printf( "Sound registration: %i sounds (%i cached, %i failed) in %i msec on the main thread, "
+                    "%i msec decoding in jobs, done %i msec after it began\n",
+                    s_loadStats.sounds, s_loadStats.cached, s_loadStats.failed, ( S32 )( s_loadStats.mainSeconds * 1000.0 ),
+                    ( S32 )( s_loadStats.decodeSeconds * 1000.0 ), ( S32 )( S_LoadQueueSeconds( s_loadStats.start ) * 1000.0 ) );
+    }
+    else
+    {
+        Com_Printf( "Sound registration: %i sounds (%i failed) in %i msec on the main thread\n",
+                    s_loadStats.sounds, s_loadStats.failed, ( S32 )( s_loadStats.mainSeconds * 1000.0 ) );
+    }
+}
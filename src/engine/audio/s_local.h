@@ -61,6 +61,8 @@ typedef	struct sndBuffer_s
 typedef struct sfx_s
 {
     sndBuffer* soundData;
+    sndBuffer** soundChunks; // soundData by chunk number, so the mixer can seek in O(1)
+    S32 soundNumChunks;
     bool defaultSound; // couldn't be loaded, so use buzz
     bool inMemory; // not in Memory
     bool soundCompressed; // not in Memory
@@ -220,13 +222,41 @@ extern convar_t* s_doppler;
 extern convar_t* s_testsound;
 
 bool S_LoadSound( sfx_t* sfx );
+S32 S_ResampledLength( S32 inrate, S32 samples );
+S32 ResampleSfxRaw( S16* sfx, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data );
+void S_StoreSound( sfx_t* sfx, S32 channels, S32 length, const S16* samples );
 
 void SND_free( sndBuffer* v );
 sndBuffer* SND_malloc( void );
 void SND_setup( void );
 void SND_shutdown( void );
+void SND_IndexChunks( sfx_t* sfx );
+void SND_FreeChunkIndex( sfx_t* sfx );
 
 void S_PaintChannels( S32 endtime );
+void S_MixBench_f( void );
+
+// mixing kernels, s_mix_simd.cpp
+typedef struct
+{
+    StringEntry name;
+    
+    // out[i * 2] += ( samples[i] * leftvol ) >> 8, out[i * 2 + 1] += ( samples[i] * rightvol ) >> 8
+    void ( *PaintMono )( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol );
+    
+    // the same from interleaved left/right samples
+    void ( *PaintStereo )( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol );
+    
+    // out[i] = in[i] >> 8 clamped to 16 bits
+    void ( *ClampTo16 )( S16* out, const S32* in, S32 count );
+} sndMixKernels_t;
+
+extern convar_t* s_mixSIMD;
+extern const sndMixKernels_t* s_mix;
+
+void S_InitMixKernels( void );
+void S_UpdateMixKernels( void );
+void S_MixTest_f( void );
 
 void S_memoryLoad( sfx_t* sfx );
 portable_samplepair_t* S_GetRawSamplePointer( void );
@@ -257,6 +287,20 @@ extern sfx_t* sfxScratchPointer;
 extern S32 sfxScratchIndex;
 
 bool S_Base_Init( soundInterface_t* si );
+void S_Base_AddLoopingSoundOnFrame( S32 entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle, S32 framecount );
+
+// mixer thread, s_mixthread.cpp
+void S_MixThread_Init( soundInterface_t* si, void ( *mix )( void ) );
+void S_MixThread_Lock( void );
+void S_MixThread_Unlock( void );
+
+// sound registration, s_load.cpp
+void S_LoadQueueInit( void );
+void S_LoadQueueShutdown( void );
+void S_LoadQueueBegin( void );
+void S_LoadQueueSound( sfx_t* sfx );
+bool S_LoadQueueFinish( sfx_t* sfx );
+void S_LoadQueueUpdate( void );
 
 // OpenAL stuff
 typedef enum
@@ -483,6 +483,9 @@ void idSoundSystemLocal::Init( void )
     s_doppler = cvarSystem->Get( "s_doppler", "1", CVAR_ARCHIVE, "description" );
     s_backend = cvarSystem->Get( "s_backend", "", CVAR_ROM, "description" );
     
+    // the mixing test needs no sound device
+    cmdSystem->AddCommand( "s_mixtest", S_MixTest_f, "Mixes scripted channels with every mixing kernel set and compares them to the scalar mix, usage: s_mixtest [channels] [frames] [seed] [passes]" );
+    
     cv = cvarSystem->Get( "s_initsound", "1", 0, "description" );
     if ( !cv->integer )
     {
@@ -557,6 +560,7 @@ void idSoundSystemLocal::Shutdown( void )
     cmdSystem->RemoveCommand( "s_list" );
     cmdSystem->RemoveCommand( "s_stop" );
     cmdSystem->RemoveCommand( "s_info" );
+    cmdSystem->RemoveCommand( "s_mixtest" );
     
     S_CodecShutdown( );
 }
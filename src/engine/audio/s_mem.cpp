@@ -74,6 +74,43 @@ redo:
     return v;
 }
 
+/*
+================
+SND_IndexChunks
+
+Builds the chunk table of a loaded sound, the mixers index it by chunk number
+instead of walking the chain from the head on every paint
+================
+*/
+void SND_IndexChunks( sfx_t* sfx )
+{
+    S32 numChunks;
+    sndBuffer* chunk;
+    
+    numChunks = 0;
+    for ( chunk = sfx->soundData; chunk != nullptr; chunk = chunk->next )
+    {
+        numChunks++;
+    }
+    
+    sfx->soundChunks = static_cast<sndBuffer**>( ::realloc( sfx->soundChunks, ( numChunks + 1 ) * sizeof( sndBuffer* ) ) );
+    sfx->soundNumChunks = numChunks;
+    
+    numChunks = 0;
+    for ( chunk = sfx->soundData; chunk != nullptr; chunk = chunk->next )
+    {
+        sfx->soundChunks[numChunks++] = chunk;
+    }
+    sfx->soundChunks[numChunks] = nullptr;
+}
+
+void SND_FreeChunkIndex( sfx_t* sfx )
+{
+    ::free( sfx->soundChunks );
+    sfx->soundChunks = nullptr;
+    sfx->soundNumChunks = 0;
+}
+
 void SND_shutdown( void )
 {
     free( sfxScratchBuffer );
@@ -112,92 +149,55 @@ void SND_setup( void )
 
 /*
 ================
-ResampleSfx
+S_ResampledLength
 
-resample / decimate to the current source rate
+what ResampleSfxRaw returns for a sound, the one place the output
+length is worked out
 ================
 */
-static S32 ResampleSfx( sfx_t* sfx, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data, bool compressed )
+S32 S_ResampledLength( S32 inrate, S32 samples )
 {
-    S32 outcount;
-    S32 srcsample;
-    F32 stepscale;
-    S32 i, j;
-    S32 sample, samplefrac, fracstep;
-    S32 part;
-    sndBuffer*	chunk;
-    
-    stepscale = ( F32 )( inrate / dma.speed );	// this is usually 0.5, 1, or 2
-    
-    outcount = ( S32 )( samples / stepscale );
-    
-    samplefrac = 0;
-    fracstep = ( S32 )stepscale * 256 * channels;
-    chunk = sfx->soundData;
-    
-    for ( i = 0 ; i < outcount ; i++ )
-    {
-        srcsample = samplefrac >> 8;
-        samplefrac += fracstep;
-        for ( j = 0 ; j < channels ; j++ )
-        {
-            if ( inwidth == 2 )
-            {
-                sample = ( ( ( S16* )data )[srcsample + j] );
-            }
-            else
-            {
-                sample = ( S32 )( ( U8 )( data[srcsample + j] ) - 128 ) << 8;
-            }
-            part = ( i * channels + j ) & ( SND_CHUNK_SIZE - 1 );
-            if ( part == 0 )
-            {
-                sndBuffer*	newchunk;
-                newchunk = SND_malloc();
-                if ( chunk == nullptr )
-                {
-                    sfx->soundData = newchunk;
-                }
-                else
-                {
-                    chunk->next = newchunk;
-                }
-                chunk = newchunk;
-            }
-            
-            chunk->sndChunk[part] = sample;
-        }
-    }
-    
-    return outcount;
+    return ( S32 )( samples / ( ( F32 )inrate / dma.speed ) );
 }
 
 /*
 ================
-ResampleSfx
+ResampleSfxRaw
 
-resample / decimate to the current source rate
+resample / decimate to the current source rate, into a plain buffer. Only
+reads its arguments so the sound registration threads can call it
 ================
 */
-static S32 ResampleSfxRaw( S16* sfx, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data )
+S32 ResampleSfxRaw( S16* sfx, S32 channels, S32 inrate, S32 inwidth, S32 samples, U8* data )
 {
     S32 outcount;
     S32 srcsample;
     F32 stepscale;
     S32 i, j;
-    S32 sample, samplefrac, fracstep;
+    S32 sample;
+    S64 samplefrac, fracstep;
     
     stepscale = ( F32 )inrate / dma.speed;	// this is usually 0.5, 1, or 2
     
-    outcount = ( S32 )( samples / stepscale );
+    outcount = S_ResampledLength( inrate, samples );
     
+    // source position in frames, 16.16 fixed point so rates that
+    // aren't a power of two apart don't drift
     samplefrac = 0;
-    fracstep = ( S32 )stepscale * 256 * channels;
+    fracstep = ( S64 )( stepscale * 65536 );
     
     for ( i = 0 ; i < outcount ; i++ )
     {
-        srcsample = samplefrac >> 8;
+        srcsample = ( S32 )( samplefrac >> 16 );
         samplefrac += fracstep;
+        
+        if ( srcsample >= samples )
+        {
+            srcsample = samples - 1;
+        }
+        
+        srcsample *= channels;
+        
         for ( j = 0 ; j < channels ; j++ )
         {
             if ( inwidth == 2 )
@@ -227,8 +227,9 @@ bool S_LoadSound( sfx_t* sfx )
     U8*	data;
     S16* samples;
     snd_info_t	info;
+    S32 length;
     //	S32		size;
-    
+
 #ifndef NO_DMAHD
     if ( dmaHD_Enabled() )
     {
@@ -259,7 +260,12 @@ bool S_LoadSound( sfx_t* sfx )
         Com_DPrintf( S_COLOR_YELLOW "WARNING: %s is not a 22kHz wav file\n", sfx->soundName );
     }
     
-    samples = static_cast<S16*>( memorySystem->AllocateTempMemory( info.channels * info.samples * sizeof( short ) * 2 ) );
+    samples = static_cast<S16*>( memorySystem->AllocateTempMemory( info.channels * S_ResampledLength( info.rate, info.samples ) * sizeof( S16 ) ) );
+    
+    // same resampler as the load threads use, only the store below locks the mixer out
+    length = ResampleSfxRaw( samples, info.channels, info.rate, info.width, info.samples, data + info.dataofs );
+    
+    S_MixThread_Lock();
     
     sfx->lastTimeUsed = Com_Milliseconds() + 1;
     
@@ -273,33 +279,34 @@ bool S_LoadSound( sfx_t* sfx )
     {
         sfx->soundCompressionMethod = 1;
         sfx->soundData = nullptr;
-        sfx->soundLength = ResampleSfxRaw( samples, info.channels, info.rate, info.width, info.samples, data + info.dataofs );
+        sfx->soundLength = length;
         S_AdpcmEncodeSound( sfx, samples );
+        
+        sfx->soundChannels = info.channels;
+        SND_IndexChunks( sfx );
 #if 0
     }
     else if ( info.channels == 1 && info.samples > ( SND_CHUNK_SIZE * 16 ) && info.width > 1 )
     {
         sfx->soundCompressionMethod = 3;
         sfx->soundData = nullptr;
-        sfx->soundLength = ResampleSfxRaw( samples, info.channels, info.rate, info.width, info.samples, ( data + info.dataofs ) );
+        sfx->soundLength = length;
         encodeMuLaw( sfx, samples );
     }
     else if ( info.channels == 1 && info.samples > ( SND_CHUNK_SIZE * 6400 ) && info.width > 1 )
     {
         sfx->soundCompressionMethod = 2;
         sfx->soundData = nullptr;
-        sfx->soundLength = ResampleSfxRaw( samples, info.channels, info.rate, info.width, info.samples, ( data + info.dataofs ) );
+        sfx->soundLength = length;
         encodeWavelet( sfx, samples );
 #endif
     }
     else
     {
-        sfx->soundCompressionMethod = 0;
-        sfx->soundData = nullptr;
-        sfx->soundLength = ResampleSfx( sfx, info.channels, info.rate, info.width, info.samples, data + info.dataofs, false );
+        S_StoreSound( sfx, info.channels, length, samples );
     }
     
-    sfx->soundChannels = info.channels;
+    S_MixThread_Unlock();
     
     memorySystem->FreeTempMemory( samples );
     memorySystem->FreeTempMemory( data );
@@ -315,4 +322,46 @@ idSoundSystemLocal::DisplayFreeMemory
 void idSoundSystemLocal::DisplayFreeMemory( void )
 {
     Com_Printf( "%d bytes free sound buffer memory, %d total used\n", inUse, totalInUse );
-}
\ No newline at end of file
+}
+
+/*
+==============
+S_StoreSound
+
+Copies samples resampled by ResampleSfxRaw into sound memory
+==============
+*/
+void S_StoreSound( sfx_t* sfx, S32 channels, S32 length, const S16* samples )
+{
+    S32 i, part, count;
+    sndBuffer* chunk;
+    sndBuffer* newchunk;
+    
+    sfx->soundCompressionMethod = 0;
+    sfx->soundData = nullptr;
+    sfx->soundLength = length;
+    sfx->soundChannels = channels;
+    
+    chunk = nullptr;
+    count = length * channels;
+    
+    for ( i = 0; i < count; i += part )
+    {
+        part = count - i < SND_CHUNK_SIZE ? count - i : SND_CHUNK_SIZE;
+        
+        newchunk = SND_malloc();
+        if ( chunk == nullptr )
+        {
+            sfx->soundData = newchunk;
+        }
+        else
+        {
+            chunk->next = newchunk;
+        }
+        chunk = newchunk;
+        
+        ::memcpy( chunk->sndChunk, samples + i, part * sizeof( S16 ) );
+    }
+    
+    SND_IndexChunks( sfx );
+}
@@ -39,40 +39,7 @@ S16*   snd_out;
 
 void S_WriteLinearBlastStereo16( void )
 {
-    S32	i, val;
-    
-    for ( i = 0 ; i < snd_linear_count ; i += 2 )
-    {
-        val = snd_p[i] >> 8;
-        
-        if ( val > 0x7fff )
-        {
-            snd_out[i] = 0x7fff;
-        }
-        else if ( val < -32768 )
-        {
-            snd_out[i] = -32768;
-        }
-        else
-        {
-            snd_out[i] = val;
-        }
-        
-        val = snd_p[i + 1] >> 8;
-        
-        if ( val > 0x7fff )
-        {
-            snd_out[i + 1] = 0x7fff;
-        }
-        else if ( val < -32768 )
-        {
-            snd_out[i + 1] = -32768;
-        }
-        else
-        {
-            snd_out[i + 1] = val;
-        }
-    }
+    s_mix->ClampTo16( snd_out, snd_p, snd_linear_count );
 }
 
 
@@ -209,11 +176,39 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-static void S_PaintChannelFrom16_scalar( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
+/*
+===================
+S_SeekChunk
+
+Looks up the chunk holding sampleOffset in the chunk index, wrapping past the
+end like the chain walk did, and leaves the offset inside that chunk
+===================
+*/
+static sndBuffer* S_SeekChunk( const sfx_t* sc, S32* sampleOffset, S32 chunkSamples, S32* chunkNum )
 {
-    S32 data, aoff, boff;
+    S32 i;
+    
+    i = *sampleOffset / chunkSamples;
+    *sampleOffset -= i * chunkSamples;
+    
+    if ( i >= sc->soundNumChunks )
+    {
+        i %= sc->soundNumChunks;
+    }
+    
+    if ( chunkNum )
+    {
+        *chunkNum = i;
+    }
+    
+    return sc->soundChunks[i];
+}
+
+static void S_PaintChannelFrom16( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
+{
+    S32 aoff, boff;
     S32 leftvol, rightvol;
-    S32 i, j;
+    S32 i, j, n;
     portable_samplepair_t* samp;
     sndBuffer* chunk;
     S16* samples;
@@ -236,37 +231,35 @@ static void S_PaintChannelFrom16_scalar( channel_t* ch, const sfx_t* sc, S32 cou
         }
     }
     
-    chunk = sc->soundData;
-    while ( sampleOffset >= SND_CHUNK_SIZE )
-    {
-        chunk = chunk->next;
-        sampleOffset -= SND_CHUNK_SIZE;
-        if ( !chunk )
-        {
-            chunk = sc->soundData;
-        }
-    }
+    chunk = S_SeekChunk( sc, &sampleOffset, SND_CHUNK_SIZE, nullptr );
     
     if ( !ch->doppler || ch->dopplerScale == 1.0f )
     {
         leftvol = ch->leftvol * snd_vol;
         rightvol = ch->rightvol * snd_vol;
-        samples = chunk->sndChunk;
-        for ( i = 0 ; i < count ; i++ )
+        
+        // mix a chunk at a time
+        for ( i = 0 ; i < count ; i += n )
         {
-            data  = samples[sampleOffset++];
-            samp[i].left += ( data * leftvol ) >> 8;
+            n = ( SND_CHUNK_SIZE - sampleOffset ) / sc->soundChannels;
+            if ( n > count - i )
+            {
+                n = count - i;
+            }
             
             if ( sc->soundChannels == 2 )
             {
-                data = samples[sampleOffset++];
+                s_mix->PaintStereo( &samp[i].left, chunk->sndChunk + sampleOffset, n, leftvol, rightvol );
+            }
+            else
+            {
+                s_mix->PaintMono( &samp[i].left, chunk->sndChunk + sampleOffset, n, leftvol, rightvol );
             }
-            samp[i].right += ( data * rightvol ) >> 8;
             
+            sampleOffset += n * sc->soundChannels;
             if ( sampleOffset == SND_CHUNK_SIZE )
             {
                 chunk = chunk->next;
-                samples = chunk->sndChunk;
                 sampleOffset = 0;
             }
         }
@@ -317,11 +310,6 @@ static void S_PaintChannelFrom16_scalar( channel_t* ch, const sfx_t* sc, S32 cou
     }
 }
 
-static void S_PaintChannelFrom16( channel_t* ch, const sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
-{
-    S_PaintChannelFrom16_scalar( ch, sc, count, sampleOffset, bufferOffset );
-}
-
 void S_PaintChannelFromWavelet( channel_t* ch, sfx_t* sc, S32 count, S32 sampleOffset, S32 bufferOffset )
 {
     S32 data;
@@ -334,15 +322,8 @@ void S_PaintChannelFromWavelet( channel_t* ch, sfx_t* sc, S32 count, S32 sampleO
     leftvol = ch->leftvol * snd_vol;
     rightvol = ch->rightvol * snd_vol;
     
-    i = 0;
     samp = &paintbuffer[ bufferOffset ];
-    chunk = sc->soundData;
-    while ( sampleOffset >= ( SND_CHUNK_SIZE_FLOAT * 4 ) )
-    {
-        chunk = chunk->next;
-        sampleOffset -= ( SND_CHUNK_SIZE_FLOAT * 4 );
-        i++;
-    }
+    chunk = S_SeekChunk( sc, &sampleOffset, SND_CHUNK_SIZE_FLOAT * 4, &i );
     
     if ( i != sfxScratchIndex || sfxScratchPointer != sc )
     {
@@ -381,21 +362,14 @@ void S_PaintChannelFromADPCM( channel_t* ch, sfx_t* sc, S32 count, S32 sampleOff
     leftvol = ch->leftvol * snd_vol;
     rightvol = ch->rightvol * snd_vol;
     
-    i = 0;
     samp = &paintbuffer[ bufferOffset ];
-    chunk = sc->soundData;
     
     if ( ch->doppler )
     {
         sampleOffset = ( S32 )( sampleOffset * ch->oldDopplerScale );
     }
     
-    while ( sampleOffset >= ( SND_CHUNK_SIZE * 4 ) )
-    {
-        chunk = chunk->next;
-        sampleOffset -= ( SND_CHUNK_SIZE * 4 );
-        i++;
-    }
+    chunk = S_SeekChunk( sc, &sampleOffset, SND_CHUNK_SIZE * 4, &i );
     
     if ( i != sfxScratchIndex || sfxScratchPointer != sc )
     {
@@ -436,16 +410,7 @@ void S_PaintChannelFromMuLaw( channel_t* ch, sfx_t* sc, S32 count, S32 sampleOff
     rightvol = ch->rightvol * snd_vol;
     
     samp = &paintbuffer[ bufferOffset ];
-    chunk = sc->soundData;
-    while ( sampleOffset >= ( SND_CHUNK_SIZE * 2 ) )
-    {
-        chunk = chunk->next;
-        sampleOffset -= ( SND_CHUNK_SIZE * 2 );
-        if ( !chunk )
-        {
-            chunk = sc->soundData;
-        }
-    }
+    chunk = S_SeekChunk( sc, &sampleOffset, SND_CHUNK_SIZE * 2, nullptr );
     
     if ( !ch->doppler )
     {
@@ -502,6 +467,7 @@ void S_PaintChannels( S32 endtime )
     S32 sampleOffset;
     
     snd_vol = ( S32 )( s_volume->value * 255 );
+    S_UpdateMixKernels();
     
     //Com_Printf ("%i to %i\n", s_paintedtime, endtime);
     while ( s_paintedtime < endtime )
@@ -645,3 +611,128 @@ void S_PaintChannels( S32 endtime )
         s_paintedtime = end;
     }
 }
+
+/*
+===================
+S_MixBench_f
+
+Paints a channel from offsets spread through a long generated sound, as
+16 bit and as adpcm samples, and prints what a paint costs at each offset
+===================
+*/
+void S_MixBench_f( void )
+{
+    S32 i, j, k, seconds, paints, count, offset, part, start, msec, method, oldVol;
+    S16* samples;
+    sfx_t sfx;
+    channel_t ch;
+    sndBuffer* chunk, *next;
+    
+    if ( dma.speed <= 0 )
+    {
+        Com_Printf( "Sound is not started\n" );
+        return;
+    }
+    
+    seconds = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : 60;
+    seconds = ( S32 )Com_Clamp( 1, 600, seconds );
+    paints = cmdSystem->Argc() > 2 ? atoi( cmdSystem->Argv( 2 ) ) : 2000;
+    paints = ( S32 )Com_Clamp( 1, 1000000, paints );
+    count = 512;
+    
+    ::memset( &sfx, 0, sizeof( sfx ) );
+    Q_strncpyz( sfx.soundName, "*mixbench", sizeof( sfx.soundName ) );
+    sfx.soundLength = seconds * dma.speed;
+    sfx.soundChannels = 1;
+    
+    samples = static_cast<S16*>( memorySystem->AllocateTempMemory( sfx.soundLength * sizeof( S16 ) ) );
+    for ( i = 0; i < sfx.soundLength; i++ )
+    {
+        samples[i] = ( S16 )( sinf( i * 0.1f ) * 16000 );
+    }
+    
+    // the paint buffer, the scratch chunk and the mix volume belong to
+    // the mixer thread, it waits until the bench is done
+    S_MixThread_Lock();
+    
+    // keep the volume low so the paint buffer doesn't overflow over many paints
+    ::memset( &ch, 0, sizeof( ch ) );
+    ch.leftvol = 1;
+    ch.rightvol = 1;
+    oldVol = snd_vol;
+    snd_vol = 1;
+    S_UpdateMixKernels();
+    
+    for ( method = 0; method < 2; method++ )
+    {
+        sfx.soundCompressionMethod = method;
+        sfx.soundData = nullptr;
+        
+        if ( method == 1 )
+        {
+            S_AdpcmEncodeSound( &sfx, samples );
+        }
+        else
+        {
+            chunk = nullptr;
+            for ( i = 0; i < sfx.soundLength; i++ )
+            {
+                part = i & ( SND_CHUNK_SIZE - 1 );
+                if ( part == 0 )
+                {
+                    next = SND_malloc();
+                    if ( chunk == nullptr )
+                    {
+                        sfx.soundData = next;
+                    }
+                    else
+                    {
+                        chunk->next = next;
+                    }
+                    chunk = next;
+                }
+                chunk->sndChunk[part] = samples[i];
+            }
+        }
+        SND_IndexChunks( &sfx );
+        
+        Com_Printf( "%s, %i seconds in %i chunks, %i samples per paint:\n", method ? "adpcm" : "16 bit", seconds, sfx.soundNumChunks, count );
+        for ( j = 0; j < 8; j++ )
+        {
+            offset = ( sfx.soundLength - count ) / 7 * j;
+            sfxScratchPointer = nullptr;
+            
+            start = idsystem->Milliseconds();
+            for ( k = 0; k < paints; k++ )
+            {
+                if ( method == 1 )
+                {
+                    S_PaintChannelFromADPCM( &ch, &sfx, count, offset, 0 );
+                }
+                else
+                {
+                    S_PaintChannelFrom16( &ch, &sfx, count, offset, 0 );
+                }
+            }
+            msec = idsystem->Milliseconds() - start;
+            
+            Com_Printf( "  at %6.1f s: %5i msec, %7.2f usec/paint\n", offset / ( F32 )dma.speed, msec, msec * 1000.0 / paints );
+        }
+        
+        for ( chunk = sfx.soundData; chunk != nullptr; chunk = next )
+        {
+            next = chunk->next;
+            SND_free( chunk );
+        }
+        SND_FreeChunkIndex( &sfx );
+    }
+    
+    sfxScratchPointer = nullptr;
+    ::memset( paintbuffer, 0, sizeof( paintbuffer ) );
+    snd_vol = oldVol;
+    S_UpdateMixKernels();
+    
+    S_MixThread_Unlock();
+    
+    memorySystem->FreeTempMemory( samples );
+}
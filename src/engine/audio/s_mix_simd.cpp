@@ -0,0 +1,556 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2019 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   s_mix_simd.cpp
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: scalar, SSE2 and AVX2 mixing kernels for s_mix.cpp and s_dmahd.cpp
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <framework/precompiled.h>
+#include <immintrin.h>
+
+#if defined( _MSC_VER )
+#define S_TARGET_AVX2
+#else
+#define S_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#endif
+
+convar_t* s_mixSIMD;
+
+const sndMixKernels_t* s_mix;
+
+/*
+===============================================================================
+
+SCALAR KERNELS
+
+The reference every other kernel has to match bit for bit
+
+===============================================================================
+*/
+
+static void S_PaintMono_scalar( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i, data;
+    
+    for ( i = 0; i < count; i++ )
+    {
+        data = samples[i];
+        out[i * 2] += ( data * leftvol ) >> 8;
+        out[i * 2 + 1] += ( data * rightvol ) >> 8;
+    }
+}
+
+static void S_PaintStereo_scalar( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i;
+    
+    for ( i = 0; i < count; i++ )
+    {
+        out[i * 2] += ( samples[i * 2] * leftvol ) >> 8;
+        out[i * 2 + 1] += ( samples[i * 2 + 1] * rightvol ) >> 8;
+    }
+}
+
+static void S_ClampTo16_scalar( S16* out, const S32* in, S32 count )
+{
+    S32 i, val;
+    
+    for ( i = 0; i < count; i++ )
+    {
+        val = in[i] >> 8;
+        
+        if ( val > 0x7fff )
+        {
+            out[i] = 0x7fff;
+        }
+        else if ( val < -32768 )
+        {
+            out[i] = -32768;
+        }
+        else
+        {
+            out[i] = val;
+        }
+    }
+}
+
+static const sndMixKernels_t s_mixScalar =
+{
+    "scalar",
+    S_PaintMono_scalar,
+    S_PaintStereo_scalar,
+    S_ClampTo16_scalar
+};
+
+/*
+===============================================================================
+
+SSE2 KERNELS
+
+SSE2 has no 32 bit multiply, so the volume is split into its sign extended
+low half and the rest, vol = lo + hi * 65536. The low half goes through the
+16x16->32 bit multiplies and only the low 16 bits of data * hi can reach
+the 32 bit result, so the sum wraps exactly like the scalar multiply
+
+===============================================================================
+*/
+
+static ID_INLINE __m128i S_MulVol_sse2( __m128i data, __m128i vlo, __m128i vhi, __m128i* high )
+{
+    __m128i lo, hi, carry;
+    
+    lo = _mm_mullo_epi16( data, vlo );
+    hi = _mm_mulhi_epi16( data, vlo );
+    carry = _mm_mullo_epi16( data, vhi );
+    
+    *high = _mm_add_epi32( _mm_unpackhi_epi16( lo, hi ), _mm_unpackhi_epi16( _mm_setzero_si128(), carry ) );
+    return _mm_add_epi32( _mm_unpacklo_epi16( lo, hi ), _mm_unpacklo_epi16( _mm_setzero_si128(), carry ) );
+}
+
+// paints 4 left/right pairs from 8 interleaved samples
+static ID_INLINE void S_PaintPairs_sse2( S32* out, __m128i data, __m128i vlo, __m128i vhi )
+{
+    __m128i p0, p1;
+    
+    p0 = S_MulVol_sse2( data, vlo, vhi, &p1 );
+    p0 = _mm_srai_epi32( p0, 8 );
+    p1 = _mm_srai_epi32( p1, 8 );
+    
+    _mm_storeu_si128( ( __m128i* )out, _mm_add_epi32( _mm_loadu_si128( ( const __m128i* )out ), p0 ) );
+    _mm_storeu_si128( ( __m128i* )( out + 4 ), _mm_add_epi32( _mm_loadu_si128( ( const __m128i* )( out + 4 ) ), p1 ) );
+}
+
+static void S_SplitVolumes_sse2( S32 leftvol, S32 rightvol, __m128i* vlo, __m128i* vhi )
+{
+    S16 llo, rlo;
+    
+    llo = ( S16 )leftvol;
+    rlo = ( S16 )rightvol;
+    
+    *vlo = _mm_setr_epi16( llo, rlo, llo, rlo, llo, rlo, llo, rlo );
+    *vhi = _mm_setr_epi16( ( S16 )( ( leftvol - llo ) >> 16 ), ( S16 )( ( rightvol - rlo ) >> 16 ),
+                           ( S16 )( ( leftvol - llo ) >> 16 ), ( S16 )( ( rightvol - rlo ) >> 16 ),
+                           ( S16 )( ( leftvol - llo ) >> 16 ), ( S16 )( ( rightvol - rlo ) >> 16 ),
+                           ( S16 )( ( leftvol - llo ) >> 16 ), ( S16 )( ( rightvol - rlo ) >> 16 ) );
+}
+
+static void S_PaintMono_sse2( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i;
+    __m128i vlo, vhi, data;
+    
+    S_SplitVolumes_sse2( leftvol, rightvol, &vlo, &vhi );
+    
+    for ( i = 0; i + 8 <= count; i += 8 )
+    {
+        data = _mm_loadu_si128( ( const __m128i* )( samples + i ) );
+        S_PaintPairs_sse2( out + i * 2, _mm_unpacklo_epi16( data, data ), vlo, vhi );
+        S_PaintPairs_sse2( out + i * 2 + 8, _mm_unpackhi_epi16( data, data ), vlo, vhi );
+    }
+    
+    S_PaintMono_scalar( out + i * 2, samples + i, count - i, leftvol, rightvol );
+}
+
+static void S_PaintStereo_sse2( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i;
+    __m128i vlo, vhi;
+    
+    S_SplitVolumes_sse2( leftvol, rightvol, &vlo, &vhi );
+    
+    for ( i = 0; i + 4 <= count; i += 4 )
+    {
+        S_PaintPairs_sse2( out + i * 2, _mm_loadu_si128( ( const __m128i* )( samples + i * 2 ) ), vlo, vhi );
+    }
+    
+    S_PaintStereo_scalar( out + i * 2, samples + i * 2, count - i, leftvol, rightvol );
+}
+
+static void S_ClampTo16_sse2( S16* out, const S32* in, S32 count )
+{
+    S32 i;
+    __m128i a, b;
+    
+    // packs saturates to the same range the scalar clamp does
+    for ( i = 0; i + 8 <= count; i += 8 )
+    {
+        a = _mm_srai_epi32( _mm_loadu_si128( ( const __m128i* )( in + i ) ), 8 );
+        b = _mm_srai_epi32( _mm_loadu_si128( ( const __m128i* )( in + i + 4 ) ), 8 );
+        _mm_storeu_si128( ( __m128i* )( out + i ), _mm_packs_epi32( a, b ) );
+    }
+    
+    S_ClampTo16_scalar( out + i, in + i, count - i );
+}
+
+static const sndMixKernels_t s_mixSSE2 =
+{
+    "SSE2",
+    S_PaintMono_sse2,
+    S_PaintStereo_sse2,
+    S_ClampTo16_sse2
+};
+
+/*
+===============================================================================
+
+AVX2 KERNELS
+
+AVX2 has the 32 bit multiply, so the samples are widened and multiplied
+as they are
+
+===============================================================================
+*/
+
+// paints 4 left/right pairs from 8 interleaved samples
+static S_TARGET_AVX2 ID_INLINE void S_PaintPairs_avx2( S32* out, __m128i data, __m256i vol )
+{
+    __m256i p;
+    
+    p = _mm256_srai_epi32( _mm256_mullo_epi32( _mm256_cvtepi16_epi32( data ), vol ), 8 );
+    _mm256_storeu_si256( ( __m256i* )out, _mm256_add_epi32( _mm256_loadu_si256( ( const __m256i* )out ), p ) );
+}
+
+static S_TARGET_AVX2 void S_PaintMono_avx2( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i;
+    __m128i data;
+    __m256i vol;
+    
+    vol = _mm256_setr_epi32( leftvol, rightvol, leftvol, rightvol, leftvol, rightvol, leftvol, rightvol );
+    
+    for ( i = 0; i + 8 <= count; i += 8 )
+    {
+        data = _mm_loadu_si128( ( const __m128i* )( samples + i ) );
+        S_PaintPairs_avx2( out + i * 2, _mm_unpacklo_epi16( data, data ), vol );
+        S_PaintPairs_avx2( out + i * 2 + 8, _mm_unpackhi_epi16( data, data ), vol );
+    }
+    
+    S_PaintMono_scalar( out + i * 2, samples + i, count - i, leftvol, rightvol );
+}
+
+static S_TARGET_AVX2 void S_PaintStereo_avx2( S32* out, const S16* samples, S32 count, S32 leftvol, S32 rightvol )
+{
+    S32 i;
+    __m256i vol;
+    
+    vol = _mm256_setr_epi32( leftvol, rightvol, leftvol, rightvol, leftvol, rightvol, leftvol, rightvol );
+    
+    for ( i = 0; i + 8 <= count; i += 8 )
+    {
+        S_PaintPairs_avx2( out + i * 2, _mm_loadu_si128( ( const __m128i* )( samples + i * 2 ) ), vol );
+        S_PaintPairs_avx2( out + i * 2 + 8, _mm_loadu_si128( ( const __m128i* )( samples + i * 2 + 8 ) ), vol );
+    }
+    
+    S_PaintStereo_scalar( out + i * 2, samples + i * 2, count - i, leftvol, rightvol );
+}
+
+static S_TARGET_AVX2 void S_ClampTo16_avx2( S16* out, const S32* in, S32 count )
+{
+    S32 i;
+    __m256i a, b;
+    
+    // packs works within each 128 bit lane, the permute puts the quarters back in order
+    for ( i = 0; i + 16 <= count; i += 16 )
+    {
+        a = _mm256_srai_epi32( _mm256_loadu_si256( ( const __m256i* )( in + i ) ), 8 );
+        b = _mm256_srai_epi32( _mm256_loadu_si256( ( const __m256i* )( in + i + 8 ) ), 8 );
+        _mm256_storeu_si256( ( __m256i* )( out + i ), _mm256_permute4x64_epi64( _mm256_packs_epi32( a, b ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+    }
+    
+    S_ClampTo16_scalar( out + i, in + i, count - i );
+}
+
+static const sndMixKernels_t s_mixAVX2 =
+{
+    "AVX2",
+    S_PaintMono_avx2,
+    S_PaintStereo_avx2,
+    S_ClampTo16_avx2
+};
+
+/*
+===============================================================================
+
+KERNEL SELECTION
+
+===============================================================================
+*/
+
+/*
+=================
+S_MixKernels
+
+Returns the kernels for a s_mixSIMD level, or the best the cpu has below it
+=================
+*/
+static const sndMixKernels_t* S_MixKernels( S32 level )
+{
+    if ( level >= 2 && SDL_HasAVX2() )
+    {
+        return &s_mixAVX2;
+    }
+    if ( level >= 1 && SDL_HasSSE2() )
+    {
+        return &s_mixSSE2;
+    }
+    return &s_mixScalar;
+}
+
+/*
+=================
+S_InitMixKernels
+=================
+*/
+void S_InitMixKernels( void )
+{
+    s_mixSIMD = cvarSystem->Get( "s_mixSIMD", "2", CVAR_ARCHIVE, "Mixing kernels, 0 = scalar, 1 = SSE2, 2 = AVX2 when the cpu has it" );
+    s_mixSIMD->modified = false;
+    s_mix = S_MixKernels( s_mixSIMD->integer );
+}
+
+/*
+=================
+S_UpdateMixKernels
+
+Picks up s_mixSIMD changes, called before every mix
+=================
+*/
+void S_UpdateMixKernels( void )
+{
+    if ( s_mix && !s_mixSIMD->modified )
+    {
+        return;
+    }
+    
+    S_InitMixKernels();
+    Com_DPrintf( "Mixing with the %s kernels\n", s_mix->name );
+}
+
+/*
+===============================================================================
+
+MIXING TEST
+
+Mixes a scripted set of channels with every kernel set the cpu has, writes
+each mix to a wav file and compares it against the scalar reference. It
+needs no sound device, so it also runs with s_initsound 0
+
+===============================================================================
+*/
+
+typedef struct
+{
+    S32 start, length, channels;
+    S32 leftvol, rightvol;
+    S16* samples;
+} mixTestChannel_t;
+
+static U32 s_mixTestSeed;
+
+static S32 S_MixTestRand( S32 range )
+{
+    s_mixTestSeed = s_mixTestSeed * 1664525 + 1013904223;
+    return ( S32 )( ( s_mixTestSeed >> 8 ) % ( U32 )range );
+}
+
+/*
+=================
+S_MixTestVolume
+
+Volumes as the mixers make them, spatialized volume times snd_vol, with the
+sign flip of dmaHD behind the listener, and anything else the 16 bit split
+of the SSE2 kernels has to cover
+=================
+*/
+static S32 S_MixTestVolume( void )
+{
+    S32 vol;
+    
+    switch ( S_MixTestRand( 8 ) )
+    {
+        case 0:
+            return 0;
+        case 1:
+            return S_MixTestRand( 256 ) * 256;
+        case 2:
+            return -S_MixTestRand( 256 ) * 256;
+        case 3:
+            return S_MixTestRand( 131071 ) - 65535;
+        default:
+            vol = S_MixTestRand( 256 ) * S_MixTestRand( 256 );
+            return S_MixTestRand( 4 ) ? vol : -vol;
+    }
+}
+
+static void S_MixTestWrite( StringEntry name, const S16* mix, S32 frames, S32 rate )
+{
+    S32 size;
+    U8* buffer;
+    
+    size = 44 + frames * 4;
+    buffer = static_cast<U8*>( memorySystem->AllocateTempMemory( size ) );
+    
+    ::memcpy( buffer, "RIFF", 4 );
+    *( S32* )( buffer + 4 ) = LittleLong( size - 8 );
+    ::memcpy( buffer + 8, "WAVEfmt ", 8 );
+    *( S32* )( buffer + 16 ) = LittleLong( 16 );
+    *( S16* )( buffer + 20 ) = LittleShort( WAV_FORMAT_PCM );
+    *( S16* )( buffer + 22 ) = LittleShort( 2 );
+    *( S32* )( buffer + 24 ) = LittleLong( rate );
+    *( S32* )( buffer + 28 ) = LittleLong( rate * 4 );
+    *( S16* )( buffer + 32 ) = LittleShort( 4 );
+    *( S16* )( buffer + 34 ) = LittleShort( 16 );
+    ::memcpy( buffer + 36, "data", 4 );
+    *( S32* )( buffer + 40 ) = LittleLong( frames * 4 );
+    ::memcpy( buffer + 44, mix, frames * 4 );
+    
+    fileSystem->WriteFile( name, buffer, size );
+    memorySystem->FreeTempMemory( buffer );
+}
+
+/*
+=================
+S_MixTest_f
+
+usage: s_mixtest [channels] [frames] [seed] [passes]
+=================
+*/
+void S_MixTest_f( void )
+{
+    S32 i, j, k, numChannels, frames, passes, start, msec, failed;
+    S32* paint, *reference;
+    S16* mix, *referenceMix;
+    mixTestChannel_t* channels, *tc;
+    const sndMixKernels_t* kernels[3];
+    
+    numChannels = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : MAX_CHANNELS;
+    numChannels = ( S32 )Com_Clamp( 1, 1024, numChannels );
+    frames = cmdSystem->Argc() > 2 ? atoi( cmdSystem->Argv( 2 ) ) : 4096;
+    frames = ( S32 )Com_Clamp( 16, 1048576, frames );
+    s_mixTestSeed = cmdSystem->Argc() > 3 ? atoi( cmdSystem->Argv( 3 ) ) : 1;
+    passes = cmdSystem->Argc() > 4 ? atoi( cmdSystem->Argv( 4 ) ) : 100;
+    passes = ( S32 )Com_Clamp( 1, 100000, passes );
+    
+    // script the channels: odd starts and lengths so every kernel runs its tails,
+    // full scale noise so the clamp saturates
+    channels = static_cast<mixTestChannel_t*>( memorySystem->AllocateTempMemory( numChannels * sizeof( *channels ) ) );
+    for ( i = 0; i < numChannels; i++ )
+    {
+        tc = &channels[i];
+        tc->start = S_MixTestRand( frames );
+        tc->length = 1 + S_MixTestRand( frames - tc->start );
+        tc->channels = 1 + S_MixTestRand( 2 );
+        tc->leftvol = S_MixTestVolume();
+        tc->rightvol = S_MixTestVolume();
+        tc->samples = static_cast<S16*>( memorySystem->AllocateTempMemory( tc->length * tc->channels * sizeof( S16 ) ) );
+        for ( j = 0; j < tc->length * tc->channels; j++ )
+        {
+            tc->samples[j] = ( S16 )( S_MixTestRand( 65536 ) - 32768 );
+        }
+    }
+    
+    paint = static_cast<S32*>( memorySystem->AllocateTempMemory( frames * 2 * sizeof( S32 ) ) );
+    reference = static_cast<S32*>( memorySystem->AllocateTempMemory( frames * 2 * sizeof( S32 ) ) );
+    mix = static_cast<S16*>( memorySystem->AllocateTempMemory( frames * 2 * sizeof( S16 ) ) );
+    referenceMix = static_cast<S16*>( memorySystem->AllocateTempMemory( frames * 2 * sizeof( S16 ) ) );
+    
+    kernels[0] = &s_mixScalar;
+    kernels[1] = S_MixKernels( 1 );
+    kernels[2] = S_MixKernels( 2 );
+    
+    Com_Printf( "%i channels, %i frames, %i passes\n", numChannels, frames, passes );
+    
+    failed = 0;
+    for ( k = 0; k < 3; k++ )
+    {
+        if ( k > 0 && kernels[k] == kernels[k - 1] )
+        {
+            continue;
+        }
+        
+        start = idsystem->Milliseconds();
+        for ( j = 0; j < passes; j++ )
+        {
+            ::memset( paint, 0, frames * 2 * sizeof( S32 ) );
+            for ( i = 0; i < numChannels; i++ )
+            {
+                tc = &channels[i];
+                if ( tc->channels == 2 )
+                {
+                    kernels[k]->PaintStereo( paint + tc->start * 2, tc->samples, tc->length, tc->leftvol, tc->rightvol );
+                }
+                else
+                {
+                    kernels[k]->PaintMono( paint + tc->start * 2, tc->samples, tc->length, tc->leftvol, tc->rightvol );
+                }
+            }
+            kernels[k]->ClampTo16( mix, paint, frames * 2 );
+        }
+        msec = idsystem->Milliseconds() - start;
+        
+        S_MixTestWrite( va( "mixtest/%s.wav", kernels[k]->name ), mix, frames, 22050 );
+        
+        if ( k == 0 )
+        {
+            ::memcpy( reference, paint, frames * 2 * sizeof( S32 ) );
+            ::memcpy( referenceMix, mix, frames * 2 * sizeof( S16 ) );
+            Com_Printf( "%-6s: %5i msec, reference\n", kernels[k]->name, msec );
+            continue;
+        }
+        
+        for ( i = 0; i < frames * 2; i++ )
+        {
+            if ( paint[i] != reference[i] || mix[i] != referenceMix[i] )
+            {
+                break;
+            }
+        }
+        
+        if ( i < frames * 2 )
+        {
+            Com_Printf( S_COLOR_RED "%-6s: %5i msec, differs at frame %i: %i/%i, reference %i/%i\n", kernels[k]->name, msec, i / 2, paint[i], mix[i], reference[i], referenceMix[i] );
+            failed++;
+        }
+        else
+        {
+            Com_Printf( "%-6s: %5i msec, identical\n", kernels[k]->name, msec );
+        }
+    }
+    
+    if ( failed )
+    {
+        Com_Printf( S_COLOR_RED "s_mixtest: %i kernel sets differ from the scalar mix\n", failed );
+    }
+    
+    memorySystem->FreeTempMemory( referenceMix );
+    memorySystem->FreeTempMemory( mix );
+    memorySystem->FreeTempMemory( reference );
+    memorySystem->FreeTempMemory( paint );
+    for ( i = numChannels - 1; i >= 0; i-- )
+    {
+        memorySystem->FreeTempMemory( channels[i].samples );
+    }
+    memorySystem->FreeTempMemory( channels );
+}
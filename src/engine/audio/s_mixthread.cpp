@@ -0,0 +1,825 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2019 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   s_mixthread.cpp
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: optional mixer thread for the base and dmaHD sound backends
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <framework/precompiled.h>
+
+/*
+===============================================================================
+
+With s_mixThread 1 the channels, loop sounds and paint buffer belong to a
+thread of their own that mixes every s_mixThreadMsec. The per frame calls of
+the game thread (sound starts, loop sounds, spatialization) go through a
+single producer / single consumer command queue and never wait on a mix.
+Everything else (raw samples, the background track) takes the mixer lock,
+after running the commands still queued so calls keep their order.
+Registration reads and decodes without it and only locks to store the sound.
+The mixer never loads a sound: a start that finds its sound paged out waits
+for the game thread to load it again.
+
+===============================================================================
+*/
+
+void S_UpdateBackgroundTrack( void );
+
+extern S32 s_soundStarted;
+extern bool s_soundMuted;
+extern S32 s_soundtime;
+
+extern sfx_t s_knownSfx[];
+extern S32 s_numSfx;
+
+// must be a power of two
+#define S_CMD_QUEUE_SIZE 1024
+
+#define S_DEFER_QUEUE_SIZE 64
+
+typedef enum
+{
+    SCMD_START_SOUND,
+    SCMD_START_LOCAL_SOUND,
+    SCMD_CLEAR_LOOPING_SOUNDS,
+    SCMD_ADD_LOOPING_SOUND,
+    SCMD_ADD_REAL_LOOPING_SOUND,
+    SCMD_STOP_LOOPING_SOUND,
+    SCMD_RESPATIALIZE,
+    SCMD_UPDATE_ENTITY_POSITION
+} sndCmdType_t;
+
+typedef struct
+{
+    sndCmdType_t type;
+    S32 time;				// when it was posted, for the latency counters
+    S32 entityNum;
+    S32 channel;			// entchannel, or inwater for SCMD_RESPATIALIZE
+    sfxHandle_t sfx;
+    S32 frame;				// client frame an SCMD_ADD_LOOPING_SOUND was added on
+    bool fixedOrigin;
+    bool killall;
+    vec3_t origin;
+    vec3_t velocity;
+    vec3_t axis[3];
+} sndCmd_t;
+
+typedef struct
+{
+    S32 commands;
+    S32 latencyTotal;
+    S32 latencyMax;
+    S32 mixes;
+    S32 mixMsecTotal;
+    S32 mixMsecMax;
+    S32 underruns;
+    S32 stalls;				// posts that found the queue full
+    S32 deferred;			// commands that found their sound paged out
+} sndMixThreadStats_t;
+
+static convar_t* s_mixThread;
+static convar_t* s_mixThreadMsec;
+
+static soundInterface_t s_mixBase;		// the backend functions the commands run
+static void ( *s_mixUpdate )( void );	// S_Update_ or dmaHD_Update_Mix
+
+static qthread_t* s_mixer;
+static qmutex_t* s_mixMutex;
+static qcondvar_t* s_mixWake;			// cuts the wait between mixes short on shutdown
+static SDL_atomic_t s_mixQuit;
+
+static sndCmd_t s_cmdQueue[S_CMD_QUEUE_SIZE];
+static sndCmd_t s_cmdOverflow;
+static SDL_atomic_t s_cmdHead;			// next command to run, only moved by the lock holder
+static SDL_atomic_t s_cmdTail;			// next free slot, only moved by the game thread
+
+static sndCmd_t s_deferQueue[S_DEFER_QUEUE_SIZE];	// only touched by the lock holder
+static S32 s_numDeferred;
+
+static sndMixThreadStats_t s_mixStats;
+
+/*
+=================
+S_MixThread_DeferCommand
+
+The game thread pages a sound in before posting it, but another load can page
+it out again before the command runs. The backend would load it right there,
+in the mixer, so the command is set aside for S_MixThread_LoadDeferred instead.
+Returns false when the sound is in memory and the command can run.
+=================
+*/
+static bool S_MixThread_DeferCommand( sndCmd_t* cmd )
+{
+    switch ( cmd->type )
+    {
+        case SCMD_START_SOUND:
+        case SCMD_START_LOCAL_SOUND:
+        case SCMD_ADD_LOOPING_SOUND:
+        case SCMD_ADD_REAL_LOOPING_SOUND:
+            break;
+        default:
+            return false;
+    }
+    
+    if ( s_knownSfx[cmd->sfx].inMemory )
+    {
+        return false;
+    }
+    
+    // a full queue drops the start, the sound is still loaded for the next one
+    if ( s_numDeferred < S_DEFER_QUEUE_SIZE )
+    {
+        s_deferQueue[s_numDeferred++] = *cmd;
+    }
+    
+    s_mixStats.deferred++;
+    
+    return true;
+}
+
+/*
+=================
+S_MixThread_RunCommand
+=================
+*/
+static void S_MixThread_RunCommand( sndCmd_t* cmd )
+{
+    if ( S_MixThread_DeferCommand( cmd ) )
+    {
+        return;
+    }
+    
+    switch ( cmd->type )
+    {
+        case SCMD_START_SOUND:
+            s_mixBase.StartSound( cmd->fixedOrigin ? cmd->origin : nullptr, cmd->entityNum, cmd->channel, cmd->sfx );
+            break;
+        case SCMD_START_LOCAL_SOUND:
+            s_mixBase.StartLocalSound( cmd->sfx, cmd->channel );
+            break;
+        case SCMD_CLEAR_LOOPING_SOUNDS:
+            s_mixBase.ClearLoopingSounds( cmd->killall );
+            break;
+        case SCMD_ADD_LOOPING_SOUND:
+            // the doppler smoothing needs the frame it was added on, not the current one
+            S_Base_AddLoopingSoundOnFrame( cmd->entityNum, cmd->origin, cmd->velocity, cmd->sfx, cmd->frame );
+            break;
+        case SCMD_ADD_REAL_LOOPING_SOUND:
+            s_mixBase.AddRealLoopingSound( cmd->entityNum, cmd->origin, cmd->velocity, cmd->sfx );
+            break;
+        case SCMD_STOP_LOOPING_SOUND:
+            s_mixBase.StopLoopingSound( cmd->entityNum );
+            break;
+        case SCMD_RESPATIALIZE:
+            s_mixBase.Respatialize( cmd->entityNum, cmd->origin, cmd->axis, cmd->channel );
+            break;
+        case SCMD_UPDATE_ENTITY_POSITION:
+            s_mixBase.UpdateEntityPosition( cmd->entityNum, cmd->origin );
+            break;
+    }
+}
+
+/*
+=================
+S_MixThread_RunCommands
+
+Runs everything the game thread has posted, the caller holds the mixer lock
+=================
+*/
+static void S_MixThread_RunCommands( void )
+{
+    S32 head, tail, now, latency;
+    
+    head = SDL_AtomicGet( &s_cmdHead );
+    tail = SDL_AtomicGet( &s_cmdTail );
+    
+    if ( head == tail )
+    {
+        return;
+    }
+    
+    now = idsystem->Milliseconds();
+    
+    for ( ; head != tail; head++ )
+    {
+        sndCmd_t* cmd = &s_cmdQueue[head & ( S_CMD_QUEUE_SIZE - 1 )];
+        
+        S_MixThread_RunCommand( cmd );
+        
+        latency = now - cmd->time;
+        s_mixStats.commands++;
+        s_mixStats.latencyTotal += latency;
+        if ( latency > s_mixStats.latencyMax )
+        {
+            s_mixStats.latencyMax = latency;
+        }
+    }
+    
+    // hand the slots back to the game thread
+    SDL_AtomicSet( &s_cmdHead, head );
+}
+
+/*
+=================
+S_MixThread_Lock
+
+Holds off the mixer thread and brings the channels up to date with every
+posted command. A no-op without the thread. The lock is recursive.
+=================
+*/
+void S_MixThread_Lock( void )
+{
+    if ( !s_mixMutex )
+    {
+        return;
+    }
+    
+    threadsSystem->Mutex_Lock( s_mixMutex );
+    S_MixThread_RunCommands();
+}
+
+/*
+=================
+S_MixThread_Unlock
+=================
+*/
+void S_MixThread_Unlock( void )
+{
+    if ( !s_mixMutex )
+    {
+        return;
+    }
+    
+    threadsSystem->Mutex_Unlock( s_mixMutex );
+}
+
+/*
+=================
+S_MixThread_AllocCommand
+
+Only the game thread posts. When the mixer has fallen a whole queue behind
+the command is run in place by S_MixThread_PostCommand instead of dropped.
+=================
+*/
+static sndCmd_t* S_MixThread_AllocCommand( sndCmdType_t type )
+{
+    U32 head, tail;
+    sndCmd_t* cmd;
+    
+    head = ( U32 )SDL_AtomicGet( &s_cmdHead );
+    tail = ( U32 )SDL_AtomicGet( &s_cmdTail );
+    
+    if ( tail - head < S_CMD_QUEUE_SIZE )
+    {
+        cmd = &s_cmdQueue[tail & ( S_CMD_QUEUE_SIZE - 1 )];
+    }
+    else
+    {
+        cmd = &s_cmdOverflow;
+    }
+    
+    cmd->type = type;
+    cmd->time = idsystem->Milliseconds();
+    
+    return cmd;
+}
+
+/*
+=================
+S_MixThread_PostCommand
+=================
+*/
+static void S_MixThread_PostCommand( sndCmd_t* cmd )
+{
+    if ( cmd == &s_cmdOverflow )
+    {
+        S_MixThread_Lock();
+        S_MixThread_RunCommand( cmd );
+        s_mixStats.stalls++;
+        S_MixThread_Unlock();
+        return;
+    }
+    
+    // the add is a full barrier, the mixer sees the command before the new tail
+    SDL_AtomicAdd( &s_cmdTail, 1 );
+}
+
+/*
+=================
+S_MixThread_LoadSfx
+
+Checks a handle and pages the sound in on the game thread,
+so the mixer never touches the file system
+=================
+*/
+static bool S_MixThread_LoadSfx( sfxHandle_t sfxHandle, StringEntry caller )
+{
+    sfx_t* sfx;
+    
+    if ( sfxHandle < 0 || sfxHandle >= s_numSfx )
+    {
+        Com_Printf( S_COLOR_YELLOW "%s: handle %i out of range\n", caller, sfxHandle );
+        return false;
+    }
+    
+    sfx = &s_knownSfx[sfxHandle];
+    
+    // reads the file without the mixer lock, only the store takes it
+    if ( sfx->inMemory == false )
+    {
+        S_memoryLoad( sfx );
+    }
+    
+    return true;
+}
+
+/*
+=================
+S_MixThread_LoadDeferred
+
+Pages the sounds of the deferred commands back in on the game thread and runs
+the sound starts. The loop sounds are added again by the next frame anyway.
+=================
+*/
+static void S_MixThread_LoadDeferred( void )
+{
+    sndCmd_t deferred[S_DEFER_QUEUE_SIZE];
+    S32 i, numDeferred;
+    
+    S_MixThread_Lock();
+    numDeferred = s_numDeferred;
+    ::memcpy( deferred, s_deferQueue, numDeferred * sizeof( deferred[0] ) );
+    s_numDeferred = 0;
+    S_MixThread_Unlock();
+    
+    if ( !numDeferred )
+    {
+        return;
+    }
+    
+    for ( i = 0; i < numDeferred; i++ )
+    {
+        S_MixThread_LoadSfx( deferred[i].sfx, "S_Update" );
+    }
+    
+    S_MixThread_Lock();
+    for ( i = 0; i < numDeferred; i++ )
+    {
+        if ( deferred[i].type == SCMD_START_SOUND || deferred[i].type == SCMD_START_LOCAL_SOUND )
+        {
+            S_MixThread_RunCommand( &deferred[i] );
+        }
+    }
+    S_MixThread_Unlock();
+}
+
+/*
+===============================================================================
+
+GAME THREAD FUNCTIONS
+
+Errors are raised here, before posting, as the mixer thread can't longjmp
+
+===============================================================================
+*/
+
+static void S_Thread_StartSound( vec3_t origin, S32 entityNum, S32 entchannel, sfxHandle_t sfxHandle )
+{
+    sndCmd_t* cmd;
+    
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    if ( !origin && ( entityNum < 0 || entityNum > MAX_GENTITIES ) )
+    {
+        Com_Error( ERR_DROP, "S_StartSound: bad entitynum %i", entityNum );
+    }
+    
+    if ( !S_MixThread_LoadSfx( sfxHandle, "S_StartSound" ) )
+    {
+        return;
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_START_SOUND );
+    cmd->entityNum = entityNum;
+    cmd->channel = entchannel;
+    cmd->sfx = sfxHandle;
+    cmd->fixedOrigin = ( origin != nullptr );
+    if ( origin )
+    {
+        VectorCopy( origin, cmd->origin );
+    }
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_StartLocalSound( sfxHandle_t sfxHandle, S32 channelNum )
+{
+    sndCmd_t* cmd;
+    
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    if ( !S_MixThread_LoadSfx( sfxHandle, "S_StartLocalSound" ) )
+    {
+        return;
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_START_LOCAL_SOUND );
+    cmd->channel = channelNum;
+    cmd->sfx = sfxHandle;
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_ClearLoopingSounds( bool killall )
+{
+    sndCmd_t* cmd;
+    
+    cmd = S_MixThread_AllocCommand( SCMD_CLEAR_LOOPING_SOUNDS );
+    cmd->killall = killall;
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_AddLoopingSound( S32 entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle )
+{
+    sndCmd_t* cmd;
+    
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    if ( !S_MixThread_LoadSfx( sfxHandle, "S_AddLoopingSound" ) )
+    {
+        return;
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_ADD_LOOPING_SOUND );
+    cmd->entityNum = entityNum;
+    cmd->sfx = sfxHandle;
+    cmd->frame = cls.framecount;
+    VectorCopy( origin, cmd->origin );
+    VectorCopy( velocity, cmd->velocity );
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_AddRealLoopingSound( S32 entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle )
+{
+    sndCmd_t* cmd;
+    
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    if ( !S_MixThread_LoadSfx( sfxHandle, "S_AddRealLoopingSound" ) )
+    {
+        return;
+    }
+    
+    if ( !s_knownSfx[sfxHandle].soundLength )
+    {
+        Com_Error( ERR_DROP, "%s has length 0", s_knownSfx[sfxHandle].soundName );
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_ADD_REAL_LOOPING_SOUND );
+    cmd->entityNum = entityNum;
+    cmd->sfx = sfxHandle;
+    VectorCopy( origin, cmd->origin );
+    VectorCopy( velocity, cmd->velocity );
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_StopLoopingSound( S32 entityNum )
+{
+    sndCmd_t* cmd;
+    
+    cmd = S_MixThread_AllocCommand( SCMD_STOP_LOOPING_SOUND );
+    cmd->entityNum = entityNum;
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_Respatialize( S32 entityNum, const vec3_t head, vec3_t axis[3], S32 inwater )
+{
+    sndCmd_t* cmd;
+    
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_RESPATIALIZE );
+    cmd->entityNum = entityNum;
+    cmd->channel = inwater;
+    VectorCopy( head, cmd->origin );
+    VectorCopy( axis[0], cmd->axis[0] );
+    VectorCopy( axis[1], cmd->axis[1] );
+    VectorCopy( axis[2], cmd->axis[2] );
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_UpdateEntityPosition( S32 entityNum, const vec3_t origin )
+{
+    sndCmd_t* cmd;
+    
+    if ( entityNum < 0 || entityNum > MAX_GENTITIES )
+    {
+        Com_Error( ERR_DROP, "S_UpdateEntityPosition: bad entitynum %i", entityNum );
+    }
+    
+    cmd = S_MixThread_AllocCommand( SCMD_UPDATE_ENTITY_POSITION );
+    cmd->entityNum = entityNum;
+    VectorCopy( origin, cmd->origin );
+    S_MixThread_PostCommand( cmd );
+}
+
+static void S_Thread_Update( void )
+{
+    if ( !s_soundStarted || s_soundMuted )
+    {
+        return;
+    }
+    
+    S_MixThread_LoadDeferred();
+    
+    if ( clientAVISystem->VideoRecording( ) )
+    {
+        // capture advances the sound time once per client frame, so mix here
+        S_MixThread_Lock();
+        s_mixBase.Update();
+        S_MixThread_Unlock();
+        return;
+    }
+    
+    // stores the finished loads, taking the lock for each
+    S_LoadQueueUpdate();
+    
+    S_MixThread_Lock();
+    S_UpdateBackgroundTrack();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_StartBackgroundTrack( StringEntry intro, StringEntry loop )
+{
+    S_MixThread_Lock();
+    s_mixBase.StartBackgroundTrack( intro, loop );
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_StopBackgroundTrack( void )
+{
+    S_MixThread_Lock();
+    s_mixBase.StopBackgroundTrack();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_RawSamples( S32 samples, S32 rate, S32 width, S32 channels, const U8* data, F32 volume )
+{
+    S_MixThread_Lock();
+    s_mixBase.RawSamples( samples, rate, width, channels, data, volume );
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_StopAllSounds( void )
+{
+    S_MixThread_Lock();
+    s_numDeferred = 0;
+    s_mixBase.StopAllSounds();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_DisableSounds( void )
+{
+    S_MixThread_Lock();
+    s_numDeferred = 0;
+    s_mixBase.DisableSounds();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_BeginRegistration( void )
+{
+    S_MixThread_Lock();
+    s_mixBase.BeginRegistration();
+    S_MixThread_Unlock();
+}
+
+/*
+=================
+S_Thread_RegisterSound
+
+Not locked, the mixer only looks at sounds the game thread has posted and
+never pages one in or out. The backend takes the lock to store the sound.
+=================
+*/
+static sfxHandle_t S_Thread_RegisterSound( StringEntry sample, bool compressed )
+{
+    return s_mixBase.RegisterSound( sample, compressed );
+}
+
+static void S_Thread_ClearSoundBuffer( void )
+{
+    S_MixThread_Lock();
+    s_mixBase.ClearSoundBuffer();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_SoundList( void )
+{
+    S_MixThread_Lock();
+    s_mixBase.SoundList();
+    S_MixThread_Unlock();
+}
+
+static void S_Thread_SoundInfo( void )
+{
+    S_MixThread_Lock();
+    
+    s_mixBase.SoundInfo();
+    
+    Com_Printf( "----- Mixer Thread -----\n" );
+    Com_Printf( "%5d msec between mixes\n", s_mixThreadMsec->integer );
+    Com_Printf( "%5d commands, %.2f msec average latency, %i msec max\n", s_mixStats.commands,
+                s_mixStats.commands ? s_mixStats.latencyTotal / ( F32 )s_mixStats.commands : 0.0f, s_mixStats.latencyMax );
+    Com_Printf( "%5d mixes, %.2f msec average, %i msec max\n", s_mixStats.mixes,
+                s_mixStats.mixes ? s_mixStats.mixMsecTotal / ( F32 )s_mixStats.mixes : 0.0f, s_mixStats.mixMsecMax );
+    Com_Printf( "%5d underruns\n", s_mixStats.underruns );
+    Com_Printf( "%5d queue stalls\n", s_mixStats.stalls );
+    Com_Printf( "%5d commands deferred for a paged out sound\n", s_mixStats.deferred );
+    Com_Printf( "------------------------\n" );
+    
+    S_MixThread_Unlock();
+}
+
+/*
+=================
+S_MixThread
+
+Paced rather than a pool job, a mix queued behind decode jobs would underrun.
+The lock is only given up while waiting for the next mix.
+=================
+*/
+static void* S_MixThread( void* param )
+{
+    S32 start, msec, soundtime, painted;
+    
+    S_MixThread_Lock();
+    
+    while ( !SDL_AtomicGet( &s_mixQuit ) )
+    {
+        start = idsystem->Milliseconds();
+        
+        if ( !clientAVISystem->VideoRecording( ) )
+        {
+            soundtime = s_soundtime;
+            painted = s_paintedtime;
+            
+            s_mixUpdate();
+            
+            // the update returns early until the device has moved on
+            if ( s_soundtime != soundtime )
+            {
+                // the device played past the end of the last mix
+                if ( painted > 0 && s_soundtime > painted )
+                {
+                    s_mixStats.underruns++;
+                }
+                
+                msec = idsystem->Milliseconds() - start;
+                s_mixStats.mixes++;
+                s_mixStats.mixMsecTotal += msec;
+                if ( msec > s_mixStats.mixMsecMax )
+                {
+                    s_mixStats.mixMsecMax = msec;
+                }
+            }
+        }
+        
+        threadsSystem->CondVar_Wait( s_mixWake, s_mixMutex, ( U32 )Com_Clamp( 1, 50, s_mixThreadMsec->integer ) );
+        S_MixThread_RunCommands();
+    }
+    
+    S_MixThread_Unlock();
+    
+    return nullptr;
+}
+
+/*
+=================
+S_MixThread_Shutdown
+=================
+*/
+static void S_MixThread_Shutdown( void )
+{
+    threadsSystem->Mutex_Lock( s_mixMutex );
+    SDL_AtomicSet( &s_mixQuit, 1 );
+    threadsSystem->CondVar_Wake( s_mixWake );
+    threadsSystem->Mutex_Unlock( s_mixMutex );
+    
+    threadsSystem->Thread_Join( s_mixer );
+    s_mixer = nullptr;
+    
+    threadsSystem->CondVar_Destroy( &s_mixWake );
+    threadsSystem->Mutex_Destroy( &s_mixMutex );
+    
+    // whatever is still queued goes with the channels
+    SDL_AtomicSet( &s_cmdHead, 0 );
+    SDL_AtomicSet( &s_cmdTail, 0 );
+    s_numDeferred = 0;
+    
+    s_mixBase.Shutdown();
+}
+
+/*
+=================
+S_MixThread_Init
+
+Called last by S_Base_Init, mix is the backend's mixing half of Update
+=================
+*/
+void S_MixThread_Init( soundInterface_t* si, void ( *mix )( void ) )
+{
+    s_mixThread = cvarSystem->Get( "s_mixThread", "0", CVAR_ARCHIVE | CVAR_LATCH, "Mixes on a thread of its own instead of in the client frame. The base and dmaHD backends only." );
+    s_mixThreadMsec = cvarSystem->Get( "s_mixThreadMsec", "5", CVAR_ARCHIVE, "Milliseconds the mixer thread waits between mixes" );
+    
+    if ( !s_mixThread->integer )
+    {
+        return;
+    }
+    
+    s_mixBase = *si;
+    s_mixUpdate = mix;
+    
+    ::memset( &s_mixStats, 0, sizeof( s_mixStats ) );
+    SDL_AtomicSet( &s_cmdHead, 0 );
+    SDL_AtomicSet( &s_cmdTail, 0 );
+    SDL_AtomicSet( &s_mixQuit, 0 );
+    s_numDeferred = 0;
+    
+    s_mixMutex = threadsSystem->Mutex_Create();
+    s_mixWake = threadsSystem->CondVar_Create();
+    if ( !s_mixMutex || !s_mixWake )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't create the mixer lock, mixing in the client frame\n" );
+        threadsSystem->CondVar_Destroy( &s_mixWake );
+        threadsSystem->Mutex_Destroy( &s_mixMutex );
+        return;
+    }
+    
+    si->Shutdown = S_MixThread_Shutdown;
+    si->StartSound = S_Thread_StartSound;
+    si->StartLocalSound = S_Thread_StartLocalSound;
+    si->StartBackgroundTrack = S_Thread_StartBackgroundTrack;
+    si->StopBackgroundTrack = S_Thread_StopBackgroundTrack;
+    si->RawSamples = S_Thread_RawSamples;
+    si->StopAllSounds = S_Thread_StopAllSounds;
+    si->ClearLoopingSounds = S_Thread_ClearLoopingSounds;
+    si->AddLoopingSound = S_Thread_AddLoopingSound;
+    si->AddRealLoopingSound = S_Thread_AddRealLoopingSound;
+    si->StopLoopingSound = S_Thread_StopLoopingSound;
+    si->Respatialize = S_Thread_Respatialize;
+    si->UpdateEntityPosition = S_Thread_UpdateEntityPosition;
+    si->Update = S_Thread_Update;
+    si->DisableSounds = S_Thread_DisableSounds;
+    si->BeginRegistration = S_Thread_BeginRegistration;
+    si->RegisterSound = S_Thread_RegisterSound;
+    si->ClearSoundBuffer = S_Thread_ClearSoundBuffer;
+    si->SoundInfo = S_Thread_SoundInfo;
+    si->SoundList = S_Thread_SoundList;
+    
+    s_mixer = threadsSystem->Thread_Create( S_MixThread, nullptr );
+    if ( !s_mixer )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't start the mixer thread, mixing in the client frame\n" );
+        *si = s_mixBase;
+        threadsSystem->CondVar_Destroy( &s_mixWake );
+        threadsSystem->Mutex_Destroy( &s_mixMutex );
+        return;
+    }
+    
+    Com_Printf( "Mixing on a separate thread\n" );
+}
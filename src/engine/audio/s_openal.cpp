@@ -1492,9 +1492,7 @@ static srcHandle_t musicSourceHandle = -1;
 static U32 musicSource;
 static U32 musicBuffers[NUM_MUSIC_BUFFERS];
 
-static snd_stream_t* mus_stream;
-static snd_stream_t* intro_stream;
-static UTF8 s_backgroundLoop[MAX_QPATH];
+static sndPrefetch_t* mus_stream;
 
 static U8 decode_buffer[MUSIC_BUFFER_SIZE];
 
@@ -1545,15 +1543,9 @@ S_AL_CloseMusicFiles
 */
 static void S_AL_CloseMusicFiles( void )
 {
-    if ( intro_stream )
-    {
-        S_CodecCloseStream( intro_stream );
-        intro_stream = nullptr;
-    }
-    
     if ( mus_stream )
     {
-        S_CodecCloseStream( mus_stream );
+        S_PrefetchClose( mus_stream );
         mus_stream = nullptr;
     }
 }
@@ -1598,52 +1590,28 @@ static void S_AL_MusicProcess( U32 b )
     S32 error;
     S32 l;
     U32 format;
-    snd_stream_t* curstream;
+    snd_info_t info;
     
-    if ( intro_stream )
-    {
-        curstream = intro_stream;
-    }
-    else
+    if ( !mus_stream )
     {
-        curstream = mus_stream;
+        return;
     }
     
-    if ( !curstream )
+    // the intro and loop are decoded on the prefetch thread
+    l = S_PrefetchAvailable( mus_stream, &info );
+    
+    if ( l < 0 )
     {
+        S_AL_StopBackgroundTrack();
         return;
     }
     
-    l = S_CodecReadStream( curstream, MUSIC_BUFFER_SIZE, decode_buffer );
-    
-    // Run out data to read, start at the beginning again
-    if ( l == 0 )
+    if ( l > MUSIC_BUFFER_SIZE )
     {
-        S_CodecCloseStream( curstream );
-        
-        // the intro stream just finished playing so we don't need to reopen
-        // the music stream.
-        if ( intro_stream )
-        {
-            intro_stream = nullptr;
-        }
-        else
-        {
-            mus_stream = S_CodecOpenStream( s_backgroundLoop );
-        }
-        
-        curstream = mus_stream;
-        
-        if ( !curstream )
-        {
-            S_AL_StopBackgroundTrack();
-            return;
-        }
-        
-        l = S_CodecReadStream( curstream, MUSIC_BUFFER_SIZE, decode_buffer );
+        l = MUSIC_BUFFER_SIZE - MUSIC_BUFFER_SIZE % ( info.width * info.channels );
     }
     
-    format = S_AL_Format( curstream->info.width, curstream->info.channels );
+    format = S_AL_Format( info.width, info.channels );
     
     if ( l == 0 )
     {
@@ -1654,7 +1622,8 @@ static void S_AL_MusicProcess( U32 b )
     }
     else
     {
-        alBufferData( b, format, decode_buffer, l, curstream->info.rate );
+        S_PrefetchRead( mus_stream, l, decode_buffer );
+        alBufferData( b, format, decode_buffer, l, info.rate );
     }
     
     if ( ( error = alGetError( ) ) != AL_NO_ERROR )
@@ -1705,24 +1674,11 @@ static void S_AL_StartBackgroundTrack( StringEntry intro, StringEntry loop )
         issame = false;
     }
     
-    // Copy the loop over
-    ::strncpy( s_backgroundLoop, loop, sizeof( s_backgroundLoop ) );
-    
-    if ( !issame )
-    {
-        // Open the intro and don't mind whether it succeeds.
-        // The important part is the loop.
-        intro_stream = S_CodecOpenStream( intro );
-    }
-    else
-    {
-        intro_stream = nullptr;
-    }
-    
-    mus_stream = S_CodecOpenStream( s_backgroundLoop );
+    // An intro that fails to open is skipped.
+    // The important part is the loop.
+    mus_stream = S_PrefetchOpen( issame ? nullptr : intro, loop );
     if ( !mus_stream )
     {
-        S_AL_CloseMusicFiles();
         S_AL_MusicSourceFree();
         return;
     }
@@ -1951,6 +1907,11 @@ void S_AL_SoundInfo( void )
         Com_Printf( "  Device:     %s\n", alcGetString( alDevice, ALC_DEVICE_SPECIFIER ) );
         Com_Printf( "Available Devices:\n%s", s_alAvailableDevices->string );
     }
+    
+    if ( mus_stream )
+    {
+        S_PrefetchInfo( mus_stream );
+    }
 }
 
 /*
@@ -0,0 +1,508 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2019 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   s_stream.cpp
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: decodes music streams ahead of the mixer on a worker thread
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <framework/precompiled.h>
+
+/*
+===============================================================================
+
+A prefetch plays an intro and then repeats a loop file. Files are opened and
+closed on the calling thread, as the file system is not thread safe; fill
+jobs on the job pool only read and decode through handles they have been
+given, into a ring the caller drains with S_PrefetchRead. Streams are opened
+unseekable, so opening one only reads its headers. Opening, reading
+and queueing the loop each kick a fill job when none is pending. The ring
+keeps a single format, so when the loop differs from the intro the fill
+waits for the ring to empty. A
+file that ends in the middle of a sample frame has the torn frame cut off, so
+every file starts on a frame boundary of the ring.
+
+===============================================================================
+*/
+
+// must be powers of two
+#define PREFETCH_RING_SIZE		( 256 * 1024 )
+#define PREFETCH_CHUNK_SIZE		( 16 * 1024 )
+
+#define MAX_PREFETCHES			4
+
+struct sndPrefetch_s
+{
+    UTF8 name[MAX_QPATH];
+    UTF8 loop[MAX_QPATH];
+    
+    // the rest is guarded by s_prefetchMutex
+    snd_stream_t* stream;		// being decoded
+    snd_stream_t* next;			// opened by the caller, waiting for the fill job
+    snd_stream_t* done;			// fully decoded, for the caller to close
+    bool busy;					// a fill job is queued or running
+    bool closing;				// no more fill jobs
+    qjobGroup_t jobs;
+    
+    snd_info_t info;			// format of the bytes in the ring
+    U8* ring;
+    U32 readPos;
+    U32 writePos;
+    U32 streamBytes;			// written by stream
+    
+    F64 decodeSeconds;			// time spent decoding
+    F64 decodedSeconds;			// of audio
+};
+
+static sndPrefetch_t* s_prefetches[MAX_PREFETCHES];
+static qmutex_t* s_prefetchMutex;
+
+/*
+=================
+S_PrefetchSameFormat
+=================
+*/
+static bool S_PrefetchSameFormat( const snd_info_t* a, const snd_info_t* b )
+{
+    return a->rate == b->rate && a->width == b->width && a->channels == b->channels;
+}
+
+/*
+=================
+S_PrefetchNextChunk
+
+Finds room for the next chunk of a prefetch, the caller holds the lock
+=================
+*/
+static bool S_PrefetchNextChunk( sndPrefetch_t* prefetch, S32* bytes )
+{
+    U32 room, contiguous;
+    
+    if ( prefetch->closing )
+    {
+        return false;
+    }
+    
+    // move on to the loop once what is left of the last file
+    // can share the ring with it
+    if ( !prefetch->stream && prefetch->next )
+    {
+        if ( prefetch->readPos != prefetch->writePos && !S_PrefetchSameFormat( &prefetch->info, &prefetch->next->info ) )
+        {
+            return false;
+        }
+        
+        prefetch->stream = prefetch->next;
+        prefetch->next = nullptr;
+        prefetch->info = prefetch->stream->info;
+        prefetch->streamBytes = 0;
+    }
+    
+    if ( !prefetch->stream )
+    {
+        return false;
+    }
+    
+    room = PREFETCH_RING_SIZE - ( prefetch->writePos - prefetch->readPos );
+    if ( room < PREFETCH_CHUNK_SIZE )
+    {
+        return false;
+    }
+    
+    contiguous = PREFETCH_RING_SIZE - ( prefetch->writePos & ( PREFETCH_RING_SIZE - 1 ) );
+    *bytes = ( S32 )( contiguous < PREFETCH_CHUNK_SIZE ? contiguous : PREFETCH_CHUNK_SIZE );
+    
+    return true;
+}
+
+/*
+=================
+S_PrefetchFill
+
+Job that decodes into the ring until it is full or the file ends
+=================
+*/
+static void S_PrefetchFill( void* data )
+{
+    sndPrefetch_t* prefetch = static_cast<sndPrefetch_t*>( data );
+    S32 bytes, read, frameSize;
+    Uint64 start, ticks;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    
+    while ( S_PrefetchNextChunk( prefetch, &bytes ) )
+    {
+        threadsSystem->Mutex_Unlock( s_prefetchMutex );
+        
+        start = SDL_GetPerformanceCounter();
+        read = S_CodecReadStream( prefetch->stream, bytes, prefetch->ring + ( prefetch->writePos & ( PREFETCH_RING_SIZE - 1 ) ) );
+        ticks = SDL_GetPerformanceCounter() - start;
+        
+        threadsSystem->Mutex_Lock( s_prefetchMutex );
+        
+        if ( read > 0 )
+        {
+            prefetch->writePos += read;
+            prefetch->streamBytes += read;
+            prefetch->decodeSeconds += ticks / ( F64 )SDL_GetPerformanceFrequency();
+            prefetch->decodedSeconds += read / ( F64 )( prefetch->info.rate * prefetch->info.width * prefetch->info.channels );
+        }
+        else
+        {
+            // the caller only reads whole frames, so the torn one is
+            // still in the ring
+            frameSize = prefetch->info.width * prefetch->info.channels;
+            if ( frameSize > 0 )
+            {
+                prefetch->writePos -= prefetch->streamBytes % frameSize;
+            }
+            
+            prefetch->done = prefetch->stream;
+            prefetch->stream = nullptr;
+        }
+    }
+    
+    prefetch->busy = false;
+    
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+}
+
+/*
+=================
+S_PrefetchKick
+
+Queues a fill job unless one is already queued or running
+=================
+*/
+static void S_PrefetchKick( sndPrefetch_t* prefetch )
+{
+    bool kick;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    kick = !prefetch->busy && !prefetch->closing;
+    if ( kick )
+    {
+        prefetch->busy = true;
+    }
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    if ( kick )
+    {
+        threadsSystem->Job_Add( &prefetch->jobs, S_PrefetchFill, prefetch );
+    }
+}
+
+/*
+=================
+S_PrefetchInit
+=================
+*/
+void S_PrefetchInit( void )
+{
+    ::memset( s_prefetches, 0, sizeof( s_prefetches ) );
+    
+    s_prefetchMutex = threadsSystem->Mutex_Create();
+}
+
+/*
+=================
+S_PrefetchShutdown
+=================
+*/
+void S_PrefetchShutdown( void )
+{
+    S32 i;
+    
+    if ( !s_prefetchMutex )
+    {
+        return;
+    }
+    
+    for ( i = 0; i < MAX_PREFETCHES; i++ )
+    {
+        if ( s_prefetches[i] )
+        {
+            S_PrefetchClose( s_prefetches[i] );
+        }
+    }
+    
+    threadsSystem->Mutex_Destroy( &s_prefetchMutex );
+}
+
+/*
+=================
+S_PrefetchOpen
+
+Starts decoding intro, or loop when there is no intro or it can't be opened,
+and repeats loop after it when one is given
+=================
+*/
+sndPrefetch_t* S_PrefetchOpen( StringEntry intro, StringEntry loop )
+{
+    S32 i;
+    snd_stream_t* stream;
+    sndPrefetch_t* prefetch;
+    
+    if ( !s_prefetchMutex )
+    {
+        return nullptr;
+    }
+    
+    if ( !intro )
+    {
+        intro = "";
+    }
+    
+    if ( !loop )
+    {
+        loop = "";
+    }
+    
+    stream = nullptr;
+    
+    if ( intro[0] )
+    {
+        stream = S_CodecOpenStream( intro );
+    }
+    
+    if ( !stream && loop[0] )
+    {
+        stream = S_CodecOpenStream( loop );
+    }
+    
+    if ( !stream )
+    {
+        return nullptr;
+    }
+    
+    prefetch = static_cast<sndPrefetch_t*>( memorySystem->Malloc( sizeof( sndPrefetch_t ) ) );
+    prefetch->ring = static_cast<U8*>( memorySystem->Malloc( PREFETCH_RING_SIZE ) );
+    
+    Q_strncpyz( prefetch->name, intro[0] ? intro : loop, sizeof( prefetch->name ) );
+    Q_strncpyz( prefetch->loop, loop, sizeof( prefetch->loop ) );
+    prefetch->stream = stream;
+    prefetch->info = stream->info;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    
+    for ( i = 0; i < MAX_PREFETCHES; i++ )
+    {
+        if ( !s_prefetches[i] )
+        {
+            s_prefetches[i] = prefetch;
+            break;
+        }
+    }
+    
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    if ( i == MAX_PREFETCHES )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: more than %i streams playing, %s dropped\n", MAX_PREFETCHES, prefetch->name );
+        S_CodecCloseStream( stream );
+        memorySystem->Free( prefetch->ring );
+        memorySystem->Free( prefetch );
+        return nullptr;
+    }
+    
+    S_PrefetchKick( prefetch );
+    
+    return prefetch;
+}
+
+/*
+=================
+S_PrefetchClose
+=================
+*/
+void S_PrefetchClose( sndPrefetch_t* prefetch )
+{
+    S32 i;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    
+    prefetch->closing = true;
+    
+    for ( i = 0; i < MAX_PREFETCHES; i++ )
+    {
+        if ( s_prefetches[i] == prefetch )
+        {
+            s_prefetches[i] = nullptr;
+        }
+    }
+    
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    // a running fill stops after at most one chunk
+    threadsSystem->Job_Wait( &prefetch->jobs );
+    
+    if ( prefetch->stream )
+    {
+        S_CodecCloseStream( prefetch->stream );
+    }
+    
+    if ( prefetch->next )
+    {
+        S_CodecCloseStream( prefetch->next );
+    }
+    
+    if ( prefetch->done )
+    {
+        S_CodecCloseStream( prefetch->done );
+    }
+    
+    memorySystem->Free( prefetch->ring );
+    memorySystem->Free( prefetch );
+}
+
+/*
+=================
+S_PrefetchAvailable
+
+Returns how many bytes S_PrefetchRead can hand out right now, in whole
+sample frames of the format put in info, or -1 once the last file has been
+played out. Also closes finished files and opens the loop ahead of time.
+=================
+*/
+S32 S_PrefetchAvailable( sndPrefetch_t* prefetch, snd_info_t* info )
+{
+    snd_stream_t* done, *next;
+    bool needLoop, ended;
+    S32 available, frameSize;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    done = prefetch->done;
+    prefetch->done = nullptr;
+    needLoop = !prefetch->stream && !prefetch->next && prefetch->loop[0];
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    if ( done )
+    {
+        S_CodecCloseStream( done );
+    }
+    
+    if ( needLoop )
+    {
+        next = S_CodecOpenStream( prefetch->loop );
+        
+        if ( next )
+        {
+            threadsSystem->Mutex_Lock( s_prefetchMutex );
+            prefetch->next = next;
+            threadsSystem->Mutex_Unlock( s_prefetchMutex );
+            
+            S_PrefetchKick( prefetch );
+        }
+        else
+        {
+            Com_Printf( S_COLOR_YELLOW "WARNING: couldn't open music file %s\n", prefetch->loop );
+            prefetch->loop[0] = '\0';
+        }
+    }
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    
+    *info = prefetch->info;
+    frameSize = info->width * info->channels;
+    available = ( S32 )( prefetch->writePos - prefetch->readPos );
+    available -= available % frameSize;
+    ended = !prefetch->stream && !prefetch->next && !prefetch->loop[0];
+    
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    if ( ended && !available )
+    {
+        return -1;
+    }
+    
+    return available;
+}
+
+/*
+=================
+S_PrefetchRead
+
+Copies out up to bytes, never more than S_PrefetchAvailable last returned
+=================
+*/
+S32 S_PrefetchRead( sndPrefetch_t* prefetch, S32 bytes, void* buffer )
+{
+    U32 offset, first;
+    S32 available;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    available = ( S32 )( prefetch->writePos - prefetch->readPos );
+    offset = prefetch->readPos & ( PREFETCH_RING_SIZE - 1 );
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    if ( bytes > available )
+    {
+        bytes = available;
+    }
+    
+    if ( bytes <= 0 )
+    {
+        return 0;
+    }
+    
+    // the fill job only writes past writePos, so the copy can go unlocked
+    first = PREFETCH_RING_SIZE - offset;
+    if ( first > ( U32 )bytes )
+    {
+        first = bytes;
+    }
+    
+    ::memcpy( buffer, prefetch->ring + offset, first );
+    ::memcpy( static_cast<U8*>( buffer ) + first, prefetch->ring, bytes - first );
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    prefetch->readPos += bytes;
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    S_PrefetchKick( prefetch );
+    
+    return bytes;
+}
+
+/*
+=================
+S_PrefetchInfo
+=================
+*/
+void S_PrefetchInfo( sndPrefetch_t* prefetch )
+{
+    F64 decodeSeconds, seconds;
+    S32 buffered, bytesPerSecond;
+    
+    threadsSystem->Mutex_Lock( s_prefetchMutex );
+    decodeSeconds = prefetch->decodeSeconds;
+    seconds = prefetch->decodedSeconds;
+    buffered = ( S32 )( prefetch->writePos - prefetch->readPos );
+    bytesPerSecond = prefetch->info.rate * prefetch->info.width * prefetch->info.channels;
+    threadsSystem->Mutex_Unlock( s_prefetchMutex );
+    
+    Com_Printf( "%s: %.1f sec decoded, %.2f msec decode per sec of audio, %.2f sec buffered\n", prefetch->name, seconds,
+                seconds > 0 ? decodeSeconds * 1000.0 / seconds : 0.0,
+                bytesPerSecond ? buffered / ( F64 )bytesPerSecond : 0.0 );
+}
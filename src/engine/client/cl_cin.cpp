@@ -150,6 +150,40 @@ static cin_cache cinTable[MAX_VIDEO_HANDLES];
 static S32      currentHandle = -1;
 static S32      CL_handle = -1;
 
+// VQ frames are decoded in a pool job while the main thread gets on with the
+// rest of the client frame, the decoded frame is shown from the next
+// CIN_RunCinematic on. Anything that touches the codebooks, the quad lists,
+// cin.file or linbuf waits for the frame being decoded first.
+typedef struct
+{
+    qjobGroup_t     jobs;
+    SDL_atomic_t    pending;
+    
+    S32             handle;
+    void ( *VQ )( U8* status, void* qdata );
+    U8**            status;
+    U8*             data;
+    U8*             buf;
+    
+    bool            reference;	// scalar codebooks on the main thread, what the cin bench checks against
+} cinDecoder_t;
+
+typedef struct
+{
+    bool            active;
+    S32             pass;
+    S32             frames;
+    S32             mismatch;	// first frame that didn't match the reference, -1 for none
+    U32*            sums;
+    S32             maxSums;
+    U64             checksumTime;
+} cinBench_t;
+
+static cinDecoder_t cinDecoder;
+static cinBench_t cinBench;
+
+static void CIN_FinishFrame( void );
+
 void CIN_CloseAllVideos( void )
 {
     S32		i;
@@ -161,6 +195,8 @@ void CIN_CloseAllVideos( void )
             CIN_StopCinematic( i );
         }
     }
+    
+    CIN_FinishFrame();
 }
 
 
@@ -357,10 +393,14 @@ S64 RllDecodeStereoToMono( U8* from, S16* to, U32 size, UTF8 signedOutput, U16 f
 static void move8_32( U8* src, U8* dst, S32 spl )
 {
     S32 i;
+    __m128i a, b;
     
     for ( i = 0; i < 8; ++i )
     {
-        memcpy( dst, src, 32 );
+        a = _mm_loadu_si128( ( __m128i* )src );
+        b = _mm_loadu_si128( ( __m128i* )( src + 16 ) );
+        _mm_storeu_si128( ( __m128i* )dst, a );
+        _mm_storeu_si128( ( __m128i* )( dst + 16 ), b );
         src += spl;
         dst += spl;
     }
@@ -380,7 +420,7 @@ static void move4_32( U8* src, U8* dst, S32 spl )
     
     for ( i = 0; i < 4; ++i )
     {
-        memcpy( dst, src, 16 );
+        _mm_storeu_si128( ( __m128i* )dst, _mm_loadu_si128( ( __m128i* )src ) );
         src += spl;
         dst += spl;
     }
@@ -400,7 +440,8 @@ static void blit8_32( U8* src, U8* dst, S32 spl )
     
     for ( i = 0; i < 8; ++i )
     {
-        memcpy( dst, src, 32 );
+        _mm_storeu_si128( ( __m128i* )dst, _mm_loadu_si128( ( __m128i* )src ) );
+        _mm_storeu_si128( ( __m128i* )( dst + 16 ), _mm_loadu_si128( ( __m128i* )( src + 16 ) ) );
         src += 32;
         dst += spl;
     }
@@ -419,7 +460,7 @@ static void blit4_32( U8* src, U8* dst, S32 spl )
     
     for ( i = 0; i < 4; ++i )
     {
-        memmove( dst, src, 16 );
+        _mm_storeu_si128( ( __m128i* )dst, _mm_loadu_si128( ( __m128i* )src ) );
         src += 16;
         dst += spl;
     }
@@ -435,8 +476,10 @@ static void blit4_32( U8* src, U8* dst, S32 spl )
 
 static void blit2_32( U8* src, U8* dst, S32 spl )
 {
-    memcpy( dst, src, 8 );
-    memcpy( dst + spl, src + 8, 8 );
+    __m128i a = _mm_loadu_si128( ( __m128i* )src );
+    
+    _mm_storel_epi64( ( __m128i* )dst, a );
+    _mm_storel_epi64( ( __m128i* )( dst + spl ), _mm_srli_si128( a, 8 ) );
 }
 
 /******************************************************************************
@@ -653,6 +696,77 @@ static U32 yuv_to_rgb24( S64 y, S64 u, S64 v )
     return LittleLong( ( r ) | ( g << 8 ) | ( b << 16 ) | ( 255 << 24 ) );
 }
 
+/*
+==================
+decodeCodeBook32
+
+decodeCodeBook for full size 32 bit frames, four pixels at a time. The
+YUV conversion adds and shifts the same table entries as yuv_to_rgb24 and
+the saturating packs clamp to 0..255 the way it does, so the codebooks
+come out the same byte for byte
+==================
+*/
+static void decodeCodeBook32( U8* input, S64 two, S64 four )
+{
+    S64 i, j;
+    U32* aptr, *bptr, *cptr, *dptr;
+    S32 u, v;
+    __m128i yy, r, g, b, rb, ga, rgba, alpha, ab, lo, hi;
+    
+    alpha = _mm_set1_epi32( 255 );
+    bptr = ( U32* )vq2;
+    
+    for ( i = 0; i < two; i++ )
+    {
+        yy = _mm_setr_epi32( ( S32 )ROQ_YY_tab[input[0]], ( S32 )ROQ_YY_tab[input[1]], ( S32 )ROQ_YY_tab[input[2]], ( S32 )ROQ_YY_tab[input[3]] );
+        u = input[4];
+        v = input[5];
+        input += 6;
+        
+        r = _mm_srai_epi32( _mm_add_epi32( yy, _mm_set1_epi32( ( S32 )ROQ_VR_tab[v] ) ), 6 );
+        g = _mm_srai_epi32( _mm_add_epi32( yy, _mm_set1_epi32( ( S32 )( ROQ_UG_tab[u] + ROQ_VG_tab[v] ) ) ), 6 );
+        b = _mm_srai_epi32( _mm_add_epi32( yy, _mm_set1_epi32( ( S32 )ROQ_UB_tab[u] ) ), 6 );
+        
+        // r0-3 b0-3 g0-3 a0-3, then interleaved to r0 g0 b0 a0 r1 ...
+        rb = _mm_packs_epi32( r, b );
+        ga = _mm_packs_epi32( g, alpha );
+        rgba = _mm_packus_epi16( rb, ga );
+        rgba = _mm_unpacklo_epi8( rgba, _mm_srli_si128( rgba, 8 ) );
+        rgba = _mm_unpacklo_epi16( rgba, _mm_srli_si128( rgba, 8 ) );
+        
+        _mm_storeu_si128( ( __m128i* )bptr, rgba );
+        bptr += 4;
+    }
+    
+    cptr = ( U32* )vq4;
+    dptr = ( U32* )vq8;
+    
+    for ( i = 0; i < four; i++ )
+    {
+        aptr = ( U32* )vq2 + ( *input++ ) * 4;
+        bptr = ( U32* )vq2 + ( *input++ ) * 4;
+        
+        // a 4x4 cell from two 2x2 cells, and the same doubled to 8x8
+        for ( j = 0; j < 2; j++ )
+        {
+            ab = _mm_unpacklo_epi64( _mm_loadl_epi64( ( __m128i* )aptr ), _mm_loadl_epi64( ( __m128i* )bptr ) );
+            lo = _mm_unpacklo_epi32( ab, ab );
+            hi = _mm_unpackhi_epi32( ab, ab );
+            
+            _mm_storeu_si128( ( __m128i* )cptr, ab );
+            _mm_storeu_si128( ( __m128i* )dptr, lo );
+            _mm_storeu_si128( ( __m128i* )( dptr + 4 ), hi );
+            _mm_storeu_si128( ( __m128i* )( dptr + 8 ), lo );
+            _mm_storeu_si128( ( __m128i* )( dptr + 12 ), hi );
+            
+            aptr += 2;
+            bptr += 2;
+            cptr += 4;
+            dptr += 16;
+        }
+    }
+}
+
 /******************************************************************************
 *
 * Function:
@@ -686,6 +800,8 @@ static void decodeCodeBook( U8* input, U16 roq_flags )
     
     four *= 2;
     
+    PROFILE_ZONE( "CIN_DecodeCodeBook" );
+    
     bptr = ( U16* )vq2;
     
     if ( !cinTable[currentHandle].half )
@@ -724,6 +840,12 @@ static void decodeCodeBook( U8* input, U16 roq_flags )
             }
             else if ( cinTable[currentHandle].samplesPerPixel == 4 )
             {
+                if ( !cinDecoder.reference )
+                {
+                    decodeCodeBook32( input, two, four );
+                    return;
+                }
+                
                 ibptr.s = bptr;
                 for ( i = 0; i < two; i++ )
                 {
@@ -1178,9 +1300,11 @@ static U8* RoQFetchInterlaced( U8 *source ) {
 */
 static void RoQReset( void )
 {
-
+    
     if ( currentHandle < 0 ) return;
     
+    CIN_FinishFrame();
+    
     fileSystem->FCloseFile( cinTable[currentHandle].iFile );
     fileSystem->FOpenFileRead( cinTable[currentHandle].fileName, &cinTable[currentHandle].iFile, true );
     // let the background thread start reading ahead
@@ -1189,6 +1313,133 @@ static void RoQReset( void )
     cinTable[currentHandle].status = FMV_LOOPED;
 }
 
+/*
+==================
+CIN_DecodeJob
+==================
+*/
+static void CIN_DecodeJob( void* data )
+{
+    PROFILE_ZONE( "CIN_DecodeFrame" );
+    
+    cinDecoder.VQ( ( U8* )cinDecoder.status, cinDecoder.data );
+    
+    SDL_AtomicSet( &cinDecoder.pending, 0 );
+}
+
+/*
+==================
+CIN_BenchFrame
+
+Checksums a decoded frame for the cin bench, the first pass keeps the sums and
+the second compares against them
+==================
+*/
+static void CIN_BenchFrame( S32 handle )
+{
+    U64 start = idsystem->Nanoseconds();
+    U32 sum;
+    
+    sum = MD4System->BlockChecksum( cinTable[handle].buf, cinTable[handle].samplesPerLine * cinTable[handle].ysize );
+    
+    if ( !cinBench.pass )
+    {
+        if ( cinBench.frames == cinBench.maxSums )
+        {
+            cinBench.maxSums = cinBench.maxSums ? cinBench.maxSums * 2 : 1024;
+            cinBench.sums = ( U32* )::realloc( cinBench.sums, cinBench.maxSums * sizeof( U32 ) );
+        }
+        cinBench.sums[cinBench.frames] = sum;
+    }
+    else if ( cinBench.mismatch < 0 && ( cinBench.frames >= cinBench.maxSums || cinBench.sums[cinBench.frames] != sum ) )
+    {
+        cinBench.mismatch = cinBench.frames;
+    }
+    
+    cinBench.frames++;
+    cinBench.checksumTime += idsystem->Nanoseconds() - start;
+}
+
+/*
+==================
+CIN_PublishFrame
+
+Makes a decoded frame the one that is drawn
+==================
+*/
+static void CIN_PublishFrame( S32 handle, U8* buf )
+{
+    cinTable[handle].buf = buf;
+    cinTable[handle].dirty = true;
+    
+    if ( cinBench.active )
+    {
+        CIN_BenchFrame( handle );
+    }
+}
+
+/*
+==================
+CIN_FinishFrame
+
+Waits for the frame in the decode job and shows it
+==================
+*/
+static void CIN_FinishFrame( void )
+{
+    if ( !cinDecoder.buf )
+    {
+        return;
+    }
+    
+    if ( SDL_AtomicGet( &cinDecoder.pending ) )
+    {
+        PROFILE_ZONE( "CIN_FrameStall" );
+        
+        threadsSystem->Job_Wait( &cinDecoder.jobs );
+    }
+    
+    CIN_PublishFrame( cinDecoder.handle, cinDecoder.buf );
+    cinDecoder.buf = nullptr;
+}
+
+/*
+==================
+CIN_DecodeFrame
+
+Decodes a VQ frame into buf, in a pool job with cl_cinematicThread. The
+first frame is decoded here, both halves of linbuf get it and on a loop
+the other half may still be on screen
+==================
+*/
+static void CIN_DecodeFrame( void ( *VQ )( U8* status, void* qdata ), U8** status, U8* data, U8* buf )
+{
+    if ( cl_cinematicThread->integer && !cinDecoder.reference && cinTable[currentHandle].numQuads != 0 )
+    {
+        cinDecoder.handle = currentHandle;
+        cinDecoder.VQ = VQ;
+        cinDecoder.status = status;
+        cinDecoder.data = data;
+        cinDecoder.buf = buf;
+        SDL_AtomicSet( &cinDecoder.pending, 1 );
+        
+        threadsSystem->Job_Add( &cinDecoder.jobs, CIN_DecodeJob, nullptr );
+        return;
+    }
+    
+    {
+        PROFILE_ZONE( "CIN_DecodeFrame" );
+        VQ( ( U8* )status, data );
+    }
+    
+    if ( cinTable[currentHandle].numQuads == 0 )  		// first frame
+    {
+        ::memcpy( cin.linbuf + cinTable[currentHandle].screenDelta, cin.linbuf, cinTable[currentHandle].samplesPerLine * cinTable[currentHandle].ysize );
+    }
+    
+    CIN_PublishFrame( currentHandle, buf );
+}
+
 /******************************************************************************
 *
 * Function:
@@ -1205,6 +1456,9 @@ static void RoQInterrupt( void )
     
     if ( currentHandle < 0 ) return;
     
+    // cin.file still holds the frame in the decode job
+    CIN_FinishFrame();
+    
     fileSystem->Read( cin.file, cinTable[currentHandle].RoQFrameSize + 8, cinTable[currentHandle].iFile );
     if ( cinTable[currentHandle].RoQPlayed >= cinTable[currentHandle].ROQSize )
     {
@@ -1234,28 +1488,23 @@ redump:
     switch ( cinTable[currentHandle].roq_id )
     {
         case	ROQ_QUAD_VQ:
+            CIN_FinishFrame();
             if ( ( cinTable[currentHandle].numQuads & 1 ) )
             {
                 cinTable[currentHandle].normalBuffer0 = cinTable[currentHandle].t[1];
                 RoQPrepMcomp( cinTable[currentHandle].roqF0, cinTable[currentHandle].roqF1 );
-                cinTable[currentHandle].VQ1( ( U8* )cin.qStatus[1], framedata );
-                cinTable[currentHandle].buf = 	cin.linbuf + cinTable[currentHandle].screenDelta;
+                CIN_DecodeFrame( cinTable[currentHandle].VQ1, cin.qStatus[1], framedata, cin.linbuf + cinTable[currentHandle].screenDelta );
             }
             else
             {
                 cinTable[currentHandle].normalBuffer0 = cinTable[currentHandle].t[0];
                 RoQPrepMcomp( cinTable[currentHandle].roqF0, cinTable[currentHandle].roqF1 );
-                cinTable[currentHandle].VQ0( ( U8* )cin.qStatus[0], framedata );
-                cinTable[currentHandle].buf = 	cin.linbuf;
-            }
-            if ( cinTable[currentHandle].numQuads == 0 )  		// first frame
-            {
-                ::memcpy( cin.linbuf + cinTable[currentHandle].screenDelta, cin.linbuf, cinTable[currentHandle].samplesPerLine * cinTable[currentHandle].ysize );
+                CIN_DecodeFrame( cinTable[currentHandle].VQ0, cin.qStatus[0], framedata, cin.linbuf );
             }
             cinTable[currentHandle].numQuads++;
-            cinTable[currentHandle].dirty = true;
             break;
         case	ROQ_CODEBOOK:
+            CIN_FinishFrame();
             decodeCodeBook( framedata, ( U16 )cinTable[currentHandle].roq_flags );
             break;
         case	ZA_SOUND_MONO:
@@ -1280,6 +1529,7 @@ redump:
         case	ROQ_QUAD_INFO:
             if ( cinTable[currentHandle].numQuads == -1 )
             {
+                CIN_FinishFrame();
                 readQuadInfo( framedata );
                 setupQuad( 0, 0 );
                 // we need to use clientMainSystem->ScaledMilliseconds because of the smp mode calls from the renderer
@@ -1400,6 +1650,8 @@ static void RoQShutdown( void )
 {
     StringEntry s;
     
+    CIN_FinishFrame();
+    
     if ( !cinTable[currentHandle].buf )
     {
         //FIXME: there could be something that should be "shutdowned" even if we don't have a output frame (at least in the ogm code)
@@ -1445,8 +1697,10 @@ CIN_StopCinematic
 */
 e_status CIN_StopCinematic( S32 handle )
 {
-
+    
     if ( handle < 0 || handle >= MAX_VIDEO_HANDLES || cinTable[handle].status == FMV_EOF ) return FMV_EOF;
+    
+    CIN_FinishFrame();
     currentHandle = handle;
     
     Com_DPrintf( "trFMV::stop(), closing %s\n", cinTable[currentHandle].fileName );
@@ -1485,6 +1739,9 @@ e_status CIN_RunCinematic( S32 handle )
     
     if ( handle < 0 || handle >= MAX_VIDEO_HANDLES || cinTable[handle].status == FMV_EOF ) return FMV_EOF;
     
+    // show the frame decoded since the last call
+    CIN_FinishFrame();
+    
     if ( cin.currentHandle != handle )
     {
         currentHandle = handle;
@@ -1617,6 +1874,7 @@ S32 CIN_PlayCinematic( StringEntry arg, S32 x, S32 y, S32 w, S32 h, S32 systemBi
     
     Com_DPrintf( "SCR_PlayCinematic( %s )\n", arg );
     
+    CIN_FinishFrame();
     ::memset( &cin, 0, sizeof( cinematics_t ) );
     currentHandle = CIN_HandleForVideo();
     
@@ -1745,7 +2003,7 @@ void CIN_DrawCinematic( S32 handle )
         }
         
         buf3 = ( S32* )buf;
-        buf2 = ( S32* )memorySystem->AllocateTempMemory( 256 * 256 * 4 );
+        buf2 = ( S32* )memorySystem->FrameAlloc( 256 * 256 * 4 );
         if ( xm == 2 && ym == 2 )
         {
             U8* bc2, *bc3;
@@ -1798,7 +2056,6 @@ void CIN_DrawCinematic( S32 handle )
         }
         renderSystem->DrawStretchRaw( ( S32 )x, ( S32 )y, ( S32 )w, ( S32 )h, 256, 256, ( U8* )buf2, handle, true );
         cinTable[handle].dirty = false;
-        memorySystem->FreeTempMemory( buf2 );
         return;
     }
     
@@ -1850,6 +2107,91 @@ void CL_PlayCinematic_f( void )
     }
 }
 
+/*
+==================
+CIN_Bench_f
+
+Decodes a RoQ as fast as it goes, first with the scalar codebooks on the
+main thread and then the way it plays, and checks the frames match
+==================
+*/
+void CIN_Bench_f( void )
+{
+    S32 handle, pass, frames[2];
+    U64 start, time[2];
+    
+    if ( cmdSystem->Argc() != 2 )
+    {
+        Com_Printf( "usage: profile_bench cin <video>\n" );
+        return;
+    }
+    
+    if ( cls.state == CA_CINEMATIC )
+    {
+        Com_Printf( "cin bench: stop the cinematic first\n" );
+        return;
+    }
+    
+    handle = CIN_PlayCinematic( cmdSystem->Argv( 1 ), 0, 0, 0, 0, CIN_silent );
+    if ( handle < 0 )
+    {
+        Com_Printf( "cin bench: couldn't play %s\n", cmdSystem->Argv( 1 ) );
+        return;
+    }
+    
+    cinBench.active = true;
+    cinBench.mismatch = -1;
+    
+    for ( pass = 0; pass < 2; pass++ )
+    {
+        cinDecoder.reference = ( pass == 0 );
+        cinBench.pass = pass;
+        cinBench.frames = 0;
+        cinBench.checksumTime = 0;
+        
+        currentHandle = cin.currentHandle = handle;
+        RoQReset();
+        cinTable[handle].status = FMV_PLAY;
+        
+        start = idsystem->Nanoseconds();
+        while ( cinTable[handle].status == FMV_PLAY )
+        {
+            RoQInterrupt();
+        }
+        CIN_FinishFrame();
+        
+        time[pass] = idsystem->Nanoseconds() - start - cinBench.checksumTime;
+        frames[pass] = cinBench.frames;
+    }
+    
+    if ( frames[1] != frames[0] && cinBench.mismatch < 0 )
+    {
+        cinBench.mismatch = Q_min( frames[0], frames[1] );
+    }
+    
+    Com_Printf( "cin bench: %s %ix%i, %i frames\n", cinTable[handle].fileName, ( S32 )cinTable[handle].xsize, ( S32 )cinTable[handle].ysize, frames[0] );
+    Com_Printf( "reference: %.1f frames/sec\n", frames[0] / Q_max( time[0] * 1e-9, 1e-6 ) );
+    Com_Printf( "SIMD%s: %.1f frames/sec\n", cl_cinematicThread->integer ? " + decode job" : "",
+                frames[1] / Q_max( time[1] * 1e-9, 1e-6 ) );
+    
+    if ( cinBench.mismatch < 0 )
+    {
+        Com_Printf( "output matches the reference\n" );
+    }
+    else
+    {
+        Com_Printf( S_COLOR_YELLOW "output differs from the reference from frame %i on\n", cinBench.mismatch );
+    }
+    
+    cinBench.active = false;
+    cinDecoder.reference = false;
+    ::free( cinBench.sums );
+    cinBench.sums = nullptr;
+    cinBench.maxSums = 0;
+    
+    cinTable[handle].status = FMV_PLAY;
+    CIN_StopCinematic( handle );
+}
 
 void SCR_DrawCinematic( void )
 {
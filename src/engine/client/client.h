@@ -74,24 +74,6 @@
 #define LIMBOCHAT_WIDTH     140	// NERVE - SMF - NOTE TTimo buffer size indicator, not related to screen bbox
 #define LIMBOCHAT_HEIGHT    7	// NERVE - SMF
 
-// snapshots are a view of the server at a given time
-typedef struct
-{
-    bool        valid;							// cleared if delta parsing was invalid
-    S32             snapFlags;						// rate delayed and dropped commands
-    S32             serverTime;						// server time the message is valid for (in msec)
-    S32             messageNum;						// copied from netchan->incoming_sequence
-    S32             deltaNum;						// messageNum the delta is from
-    S32             ping;							// time from when cmdNum-1 was sent to time packet was reeceived
-    U8            areamask[MAX_MAP_AREA_BYTES];	// portalarea visibility bits
-    S32             cmdNum;							// the next cmdNum the server is expecting
-    playerState_t   ps;								// complete information about the current player at this time
-    S32             numEntities;					// all of the entities that need to be presented
-    S32             parseEntitiesNum;				// at the time of this snapshot
-    S32             serverCommandNum;				// execute all commands up to this before
-    // making the snapshot current
-} clSnapshot_t;
-
 // Arnout: for double tapping
 typedef struct
 {
@@ -257,6 +239,8 @@ typedef struct
     bool				demowaiting;												// don't record until a non-delta message is received
     bool				firstDemoFrameSkipped;
     fileHandle_t			demofile;
+    S32						demoStartTime;												// serverTime of the first snapshot
+    S32						demoCommandFloor;											// server commands a demo seek skipped
     
     bool				waverecording;
     fileHandle_t			wavefile;
@@ -457,6 +441,7 @@ extern convar_t*  cl_autorecord;
 extern convar_t*  cl_allowDownload;
 extern convar_t*  cl_conXOffset;
 extern convar_t*  cl_inGameVideo;
+extern convar_t*  cl_cinematicThread;
 extern convar_t*  cl_authserver;
 
 extern convar_t*  cl_missionStats;
@@ -477,6 +462,8 @@ extern convar_t*  cl_consoleFontKerning;
 extern convar_t*  cl_consolePrompt;
 extern convar_t*  cl_aviFrameRate;
 extern convar_t*  cl_aviMotionJpeg;
+extern convar_t*  cl_aviEncodeThreads;
+extern convar_t*  cl_demoKeyframeInterval;
 extern convar_t*  cl_guidServerUniq;
 
 //bani
@@ -667,6 +654,7 @@ void            CIN_SetExtents( S32 handle, S32 x, S32 y, S32 w, S32 h );
 void            CIN_SetLooping( S32 handle, bool loop );
 void            CIN_UploadCinematic( S32 handle );
 void            CIN_CloseAllVideos( void );
+void            CIN_Bench_f( void );
 
 // yuv->rgb will be used for Theora(ogm)
 void			ROQ_GenYUVTables( void );
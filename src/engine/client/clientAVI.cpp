@@ -37,6 +37,8 @@ idClientAVISystemAPI* clientAVISystem = &clientAVILocal;
 static U8 buffer[MAX_AVI_BUFFER];
 static S32 bufIndex;
 
+static aviCapture_t avc;
+
 /*
 ===============
 idClientAVISystemLocal::idClientAVISystemLocal
@@ -313,12 +315,22 @@ void idClientAVISystemLocal::WriteAVIHeader( void )
 /*
 ===============
 idClientAVISystemLocal::OpenAVIForWriting
+===============
+*/
+bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
+{
+    return OpenAVI( fileName, cls.glconfig.vidWidth, cls.glconfig.vidHeight );
+}
+
+/*
+===============
+idClientAVISystemLocal::OpenAVI
 
 Creates an AVI file and gets it into a state where
 writing the actual data can begin
 ===============
 */
-bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
+bool idClientAVISystemLocal::OpenAVI( StringEntry fileName, S32 width, S32 height )
 {
     if ( afd.fileOpen )
     {
@@ -349,10 +361,15 @@ bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
     
     afd.frameRate = cl_aviFrameRate->integer;
     afd.framePeriod = ( S32 )( 1000000.0f / afd.frameRate );
-    afd.width = cls.glconfig.vidWidth;
-    afd.height = cls.glconfig.vidHeight;
+    afd.width = width;
+    afd.height = height;
     
-    if ( cl_aviMotionJpeg->integer )
+    // frames already in the ring were encoded for the old file
+    if ( avc.rollover )
+    {
+        afd.motionJpeg = avc.motionJpeg;
+    }
+    else if ( cl_aviMotionJpeg->integer )
     {
         afd.motionJpeg = true;
     }
@@ -361,14 +378,6 @@ bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
         afd.motionJpeg = false;
     }
     
-    // Buffers only need to store RGB pixels.
-    // Allocate a bit more space for the capture buffer to account for possible
-    // padding at the end of pixel lines, and padding for alignment
-#define MAX_PACK_LEN 16
-    afd.cBuffer = ( U8* )memorySystem->Malloc( ( afd.width * 3 + MAX_PACK_LEN - 1 ) * afd.height + MAX_PACK_LEN - 1 );
-    // raw avi files have pixel lines start on 4-U8 boundaries
-    afd.eBuffer = ( U8* )memorySystem->Malloc( PAD( afd.width * 3, AVI_LINE_PADDING ) * afd.height );
-    
     afd.a.rate = dma.speed;
     afd.a.format = WAV_FORMAT_PCM;
     afd.a.channels = dma.channels;
@@ -387,7 +396,7 @@ bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
         Com_Printf( S_COLOR_YELLOW "WARNING: cl_aviFrameRate is not a divisor " "of the audio rate, suggest %d\n", suggestRate );
     }
     
-    if ( !cvarSystem->VariableIntegerValue( "s_initsound" ) )
+    if ( !cvarSystem->VariableIntegerValue( "s_initsound" ) || avc.bench )
     {
         afd.audio = false;
     }
@@ -423,6 +432,15 @@ bool idClientAVISystemLocal::OpenAVIForWriting( StringEntry fileName )
     afd.moviSize = 4;			// For the "movi"
     afd.fileOpen = true;
     
+    // a new file after CheckFileSize keeps the frames already in the ring
+    if ( !avc.rollover && !StartCapture() )
+    {
+        fileSystem->FCloseFile( afd.idxF );
+        fileSystem->FCloseFile( afd.f );
+        afd.fileOpen = false;
+        return false;
+    }
+    
     return true;
 }
 
@@ -444,11 +462,19 @@ bool idClientAVISystemLocal::CheckFileSize( S32 bytesToAdd )
     // we target can handle a 2Gb file
     if ( newFileSize > INT_MAX )
     {
+        avc.rollover = true;
+        
         // Close the current file...
         clientAVILocal.CloseAVI();
         
-        // ...And open a new one
-        clientAVILocal.OpenAVIForWriting( va( "%s_", afd.fileName ) );
+        // ...And open a new one, WriteEncodedFrames may be walking the
+        // ring so it's stopped by the caller
+        if ( !OpenAVI( va( "%s_", afd.fileName ), afd.width, afd.height ) )
+        {
+            avc.stopPending = true;
+        }
+        
+        avc.rollover = false;
         
         return true;
     }
@@ -532,6 +558,11 @@ void idClientAVISystemLocal::WriteAVIAudioFrame( const U8* pcmBuffer, S32 size )
     // Chunk header + contents + padding
     if ( CheckFileSize( 8 + bytesInBuffer + size + 2 ) )
     {
+        if ( avc.stopPending )
+        {
+            avc.stopPending = false;
+            StopCapture();
+        }
         return;
     }
     
@@ -586,13 +617,405 @@ idClientAVISystemLocal::TakeVideoFrame
 */
 void idClientAVISystemLocal::TakeVideoFrame( void )
 {
+    aviFrame_t* frame;
+    
     // AVI file isn't open
     if ( !afd.fileOpen )
     {
         return;
     }
     
-    renderSystem->TakeVideoFrame( afd.width, afd.height, afd.cBuffer, afd.eBuffer, afd.motionJpeg );
+    frame = NextCaptureFrame();
+    if ( !frame )
+    {
+        return;
+    }
+    
+    renderSystem->TakeVideoFrame( afd.width, afd.height, frame->cBuffer );
+}
+
+/*
+===============
+idClientAVISystemLocal::CaptureAVIVideoFrame
+
+Called by the renderer with the frame it read back for TakeVideoFrame
+===============
+*/
+void idClientAVISystemLocal::CaptureAVIVideoFrame( const U8* frame, S32 padding )
+{
+    aviFrame_t* slot = nullptr;
+    S32 i;
+    
+    // the oldest frame waiting for its readback
+    for ( i = avc.written; i != avc.taken; i++ )
+    {
+        if ( avc.frames[i % avc.numFrames].state == AVI_FRAME_READBACK )
+        {
+            slot = &avc.frames[i % avc.numFrames];
+            break;
+        }
+    }
+    
+    if ( !slot )
+    {
+        return;
+    }
+    
+    slot->frame = frame;
+    slot->padding = padding;
+    
+    if ( !avc.encoders )
+    {
+        EncodeFrame( slot );
+        slot->state = AVI_FRAME_ENCODED;
+    }
+    else
+    {
+        threadsSystem->Mutex_Lock( avc.mutex );
+        slot->state = AVI_FRAME_CAPTURED;
+        threadsSystem->Mutex_Unlock( avc.mutex );
+        
+        threadsSystem->Job_Add( &avc.jobs, EncodeJob, slot );
+    }
+    
+    WriteEncodedFrames( 0 );
+}
+
+/*
+===============
+idClientAVISystemLocal::StartCapture
+
+Sets up the capture ring, with room for cl_aviEncodeThreads frames to encode
+on the job pool at once. With none the ring has a single frame that is encoded and written as soon as it is read back
+===============
+*/
+bool idClientAVISystemLocal::StartCapture( void )
+{
+    S32 i, cSize;
+    
+    ::memset( &avc.frames, 0, sizeof( avc.frames ) );
+    avc.taken = avc.written = 0;
+    avc.stopPending = false;
+    avc.numEncoded = avc.numDropped = avc.numStalls = avc.peakInFlight = 0;
+    avc.encodeSeconds = avc.stallSeconds = 0;
+    
+    avc.width = afd.width;
+    avc.height = afd.height;
+    avc.motionJpeg = afd.motionJpeg;
+    
+    avc.encoders = ( S32 )Com_Clamp( 0, MAX_AVI_ENCODERS, cl_aviEncodeThreads->integer );
+    avc.numFrames = avc.encoders ? avc.encoders + 2 : 1;
+    
+    // Buffers only need to store RGB pixels.
+    // Allocate a bit more space for the capture buffer to account for possible
+    // padding at the end of pixel lines, and padding for alignment
+#define MAX_PACK_LEN 16
+    cSize = ( afd.width * 3 + MAX_PACK_LEN - 1 ) * afd.height + MAX_PACK_LEN - 1;
+    // raw avi files have pixel lines start on 4-U8 boundaries
+    avc.encodeSize = PAD( afd.width * 3, AVI_LINE_PADDING ) * afd.height;
+    
+    for ( i = 0; i < avc.numFrames; i++ )
+    {
+        avc.frames[i].cBuffer = ( U8* )::malloc( cSize );
+        avc.frames[i].eBuffer = ( U8* )::malloc( avc.encodeSize );
+        
+        if ( !avc.frames[i].cBuffer || !avc.frames[i].eBuffer )
+        {
+            ::free( avc.frames[i].cBuffer );
+            ::free( avc.frames[i].eBuffer );
+            avc.frames[i].cBuffer = avc.frames[i].eBuffer = nullptr;
+            break;
+        }
+    }
+    
+    if ( !i )
+    {
+        Com_Printf( S_COLOR_RED "Couldn't allocate the video capture buffers\n" );
+        avc.numFrames = avc.encoders = 0;
+        return false;
+    }
+    
+    // run with what fits
+    if ( i < avc.numFrames )
+    {
+        avc.numFrames = i;
+        avc.encoders = Q_min( avc.encoders, i );
+    }
+    
+    avc.mutex = threadsSystem->Mutex_Create();
+    avc.encoded = threadsSystem->CondVar_Create();
+    
+    return true;
+}
+
+/*
+===============
+idClientAVISystemLocal::StopCapture
+===============
+*/
+void idClientAVISystemLocal::StopCapture( void )
+{
+    S32 i;
+    
+    if ( !avc.numFrames )
+    {
+        return;
+    }
+    
+    threadsSystem->Job_Wait( &avc.jobs );
+    
+    threadsSystem->CondVar_Destroy( &avc.encoded );
+    threadsSystem->Mutex_Destroy( &avc.mutex );
+    
+    for ( i = 0; i < avc.numFrames; i++ )
+    {
+        ::free( avc.frames[i].cBuffer );
+        ::free( avc.frames[i].eBuffer );
+    }
+    
+    Com_Printf( "Video capture: %i frames encoded %i at a time, %.1f msec each, %i of %i frames in flight at most\n",
+                avc.numEncoded, Q_max( avc.encoders, 1 ), avc.numEncoded ? avc.encodeSeconds * 1000.0 / avc.numEncoded : 0.0,
+                avc.peakInFlight, avc.numFrames );
+    
+    if ( avc.numStalls || avc.numDropped )
+    {
+        Com_Printf( "Video capture: waited %i times for the encoders, %.1f msec in all, %i frames dropped\n",
+                    avc.numStalls, avc.stallSeconds * 1000.0, avc.numDropped );
+    }
+    
+    ::memset( &avc.frames, 0, sizeof( avc.frames ) );
+    avc.numFrames = 0;
+    avc.encoders = 0;
+    avc.taken = avc.written = 0;
+}
+
+/*
+===============
+idClientAVISystemLocal::EncodeFrame
+===============
+*/
+void idClientAVISystemLocal::EncodeFrame( aviFrame_t* frame )
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    
+    frame->size = renderSystem->EncodeVideoFrame( frame->eBuffer, avc.encodeSize, frame->frame, avc.width, avc.height, frame->padding, avc.motionJpeg );
+    frame->encodeSeconds = ( SDL_GetPerformanceCounter() - start ) / ( F64 )SDL_GetPerformanceFrequency();
+}
+
+/*
+===============
+idClientAVISystemLocal::EncodeJob
+
+Encodes a captured frame, the main thread writes it once the frames before it
+are written
+===============
+*/
+void idClientAVISystemLocal::EncodeJob( void* data )
+{
+    aviFrame_t* frame = static_cast<aviFrame_t*>( data );
+    
+    threadsSystem->Mutex_Lock( avc.mutex );
+    frame->state = AVI_FRAME_ENCODING;
+    threadsSystem->Mutex_Unlock( avc.mutex );
+    
+    EncodeFrame( frame );
+    
+    threadsSystem->Mutex_Lock( avc.mutex );
+    frame->state = AVI_FRAME_ENCODED;
+    threadsSystem->CondVar_Wake( avc.encoded );
+    threadsSystem->Mutex_Unlock( avc.mutex );
+}
+
+/*
+===============
+idClientAVISystemLocal::WriteEncodedFrames
+
+Writes the encoded frames in the order they were taken, waiting for the
+oldest wait frames to be encoded first. Writing stops at the first frame
+that isn't encoded yet, or when a new file couldn't be opened for it
+===============
+*/
+void idClientAVISystemLocal::WriteEncodedFrames( S32 wait )
+{
+    aviFrame_t* frame;
+    aviFrameState_t state;
+    S32 waitFor = avc.written + wait;
+    
+    while ( avc.written != avc.taken && avc.numFrames && !avc.stopPending )
+    {
+        frame = &avc.frames[avc.written % avc.numFrames];
+        
+        threadsSystem->Mutex_Lock( avc.mutex );
+        state = frame->state;
+        while ( avc.written - waitFor < 0 && ( state == AVI_FRAME_CAPTURED || state == AVI_FRAME_ENCODING ) )
+        {
+            threadsSystem->CondVar_Wait( avc.encoded, avc.mutex, COND_WAIT_FOREVER );
+            state = frame->state;
+        }
+        threadsSystem->Mutex_Unlock( avc.mutex );
+        
+        if ( state == AVI_FRAME_ENCODED )
+        {
+            avc.numEncoded++;
+            avc.encodeSeconds += frame->encodeSeconds;
+            
+            if ( frame->size > 0 )
+            {
+                clientAVILocal.WriteAVIVideoFrame( frame->eBuffer, frame->size );
+            }
+            else
+            {
+                avc.numDropped++;
+            }
+        }
+        else if ( state == AVI_FRAME_DROPPED )
+        {
+            avc.numDropped++;
+        }
+        else
+        {
+            break;
+        }
+        
+        threadsSystem->Mutex_Lock( avc.mutex );
+        frame->state = AVI_FRAME_FREE;
+        threadsSystem->Mutex_Unlock( avc.mutex );
+        
+        avc.written++;
+    }
+    
+    if ( avc.stopPending )
+    {
+        avc.stopPending = false;
+        StopCapture();
+    }
+}
+
+/*
+===============
+idClientAVISystemLocal::NextCaptureFrame
+
+Hands out the next frame of the ring, waiting for the encoders when all of
+them are in flight. Returns nullptr when writing the ring stopped the capture
+===============
+*/
+aviFrame_t* idClientAVISystemLocal::NextCaptureFrame( void )
+{
+    aviFrame_t* frame;
+    Uint64 start;
+    S32 i;
+    
+    // the renderer skips the readback when it isn't registered or runs out
+    // of command buffer, don't wait for those
+    for ( i = avc.written; i != avc.taken; i++ )
+    {
+        frame = &avc.frames[i % avc.numFrames];
+        
+        if ( frame->state == AVI_FRAME_READBACK )
+        {
+            frame->state = AVI_FRAME_DROPPED;
+        }
+    }
+    
+    WriteEncodedFrames( 0 );
+    
+    if ( avc.numFrames && avc.taken - avc.written == avc.numFrames )
+    {
+        start = SDL_GetPerformanceCounter();
+        
+        WriteEncodedFrames( 1 );
+        
+        avc.numStalls++;
+        avc.stallSeconds += ( SDL_GetPerformanceCounter() - start ) / ( F64 )SDL_GetPerformanceFrequency();
+    }
+    
+    if ( !avc.numFrames )
+    {
+        return nullptr;
+    }
+    
+    frame = &avc.frames[avc.taken % avc.numFrames];
+    frame->sequence = avc.taken++;
+    frame->state = AVI_FRAME_READBACK;
+    
+    avc.peakInFlight = Q_max( avc.peakInFlight, avc.taken - avc.written );
+    
+    return frame;
+}
+
+/*
+===============
+idClientAVISystemLocal::AVIBench_f
+
+Runs generated frames through the capture ring as fast as it takes them,
+without the renderer reading anything back
+===============
+*/
+void idClientAVISystemLocal::AVIBench_f( void )
+{
+    aviFrame_t* frame;
+    S32 i, x, y, numFrames, width, height;
+    Uint64 start;
+    F64 seconds;
+    U8* p;
+    
+    if ( afd.fileOpen )
+    {
+        Com_Printf( "avi bench: stop the video recording first\n" );
+        return;
+    }
+    
+    numFrames = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : 200;
+    width = cmdSystem->Argc() > 2 ? atoi( cmdSystem->Argv( 2 ) ) : 1280;
+    height = cmdSystem->Argc() > 3 ? atoi( cmdSystem->Argv( 3 ) ) : 720;
+    
+    if ( numFrames <= 0 || width < 16 || height < 16 )
+    {
+        Com_Printf( "usage: profile_bench avi [frames] [width] [height]\n" );
+        return;
+    }
+    
+    avc.bench = true;
+    
+    if ( !clientAVILocal.OpenAVI( "videos/aviBench.avi", width, height ) )
+    {
+        avc.bench = false;
+        return;
+    }
+    
+    start = SDL_GetPerformanceCounter();
+    
+    for ( i = 0; i < numFrames && afd.fileOpen; i++ )
+    {
+        frame = NextCaptureFrame();
+        if ( !frame )
+        {
+            break;
+        }
+        
+        // a gradient that moves every frame, unpadded like a 1 byte pack alignment
+        p = frame->cBuffer;
+        for ( y = 0; y < height; y++ )
+        {
+            for ( x = 0; x < width; x++ )
+            {
+                *p++ = ( U8 )( x + i * 4 );
+                *p++ = ( U8 )( y + i * 2 );
+                *p++ = ( U8 )( ( x + y ) / 4 );
+            }
+        }
+        
+        clientAVILocal.CaptureAVIVideoFrame( frame->cBuffer, 0 );
+    }
+    
+    clientAVILocal.CloseAVI();
+    
+    seconds = ( SDL_GetPerformanceCounter() - start ) / ( F64 )SDL_GetPerformanceFrequency();
+    
+    Com_Printf( "avi bench: %i %ix%i %s frames in %.2f seconds, %.1f frames/sec\n", i, width, height,
+                afd.motionJpeg ? "MJPEG" : "raw", seconds, seconds > 0 ? i / seconds : 0.0 );
+    
+    avc.bench = false;
 }
 
 /*
@@ -604,9 +1027,8 @@ Closes the AVI file and writes an index chunk
 */
 bool idClientAVISystemLocal::CloseAVI( void )
 {
-    S32 indexRemainder;
-    S32 indexSize = afd.numIndices * 16;
-    StringEntry idxFileName = va( "%s" INDEX_FILE_EXTENSION, afd.fileName );
+    S32 i, indexRemainder, indexSize;
+    StringEntry idxFileName;
     
     // AVI file isn't open
     if ( !afd.fileOpen )
@@ -614,6 +1036,30 @@ bool idClientAVISystemLocal::CloseAVI( void )
         return false;
     }
     
+    // write the frames still in the ring, unless they go on in the next file
+    if ( !avc.rollover )
+    {
+        for ( i = avc.written; i != avc.taken; i++ )
+        {
+            if ( avc.frames[i % avc.numFrames].state == AVI_FRAME_READBACK )
+            {
+                avc.frames[i % avc.numFrames].state = AVI_FRAME_DROPPED;
+            }
+        }
+        
+        WriteEncodedFrames( avc.taken - avc.written );
+        
+        // the last frames started a new file which couldn't be opened
+        if ( !afd.fileOpen )
+        {
+            StopCapture();
+            return false;
+        }
+    }
+    
+    indexSize = afd.numIndices * 16;
+    idxFileName = va( "%s" INDEX_FILE_EXTENSION, afd.fileName );
+    
     afd.fileOpen = false;
     
     fileSystem->Seek( afd.idxF, 4, FS_SEEK_SET );
@@ -627,6 +1073,12 @@ bool idClientAVISystemLocal::CloseAVI( void )
     if ( ( indexSize = fileSystem->FOpenFileRead( idxFileName, &afd.idxF, true ) ) <= 0 )
     {
         fileSystem->FCloseFile( afd.f );
+        
+        if ( !avc.rollover )
+        {
+            StopCapture();
+        }
+        
         return false;
     }
     
@@ -661,12 +1113,15 @@ bool idClientAVISystemLocal::CloseAVI( void )
     
     SafeFS_Write( buffer, bufIndex, afd.f );
     
-    memorySystem->Free( afd.cBuffer );
-    memorySystem->Free( afd.eBuffer );
     fileSystem->FCloseFile( afd.f );
     
     Com_Printf( "Wrote %d:%d frames to %s\n", afd.numVideoFrames, afd.numAudioFrames, afd.fileName );
     
+    if ( !avc.rollover )
+    {
+        StopCapture();
+    }
+    
     return true;
 }
 
@@ -34,6 +34,9 @@
 
 #define MAX_RIFF_CHUNKS 16
 
+#define MAX_AVI_ENCODERS 8	// frames encoded at once
+#define MAX_AVI_FRAMES ( MAX_AVI_ENCODERS + 2 )
+
 typedef struct audioFormat_s
 {
     S32 rate;
@@ -59,8 +62,6 @@ typedef struct aviFileData_s
     S32 chunkStack[MAX_RIFF_CHUNKS];
     S32 chunkStackTop;
     UTF8 fileName[MAX_QPATH];
-    U8* cBuffer;
-    U8* eBuffer;
     bool fileOpen;
     bool motionJpeg;
     bool audio;
@@ -71,6 +72,56 @@ typedef struct aviFileData_s
 
 static aviFileData_t afd;
 
+typedef enum
+{
+    AVI_FRAME_FREE,
+    AVI_FRAME_READBACK,		// handed to the renderer, read back at the end of the frame
+    AVI_FRAME_CAPTURED,		// its encode job is queued
+    AVI_FRAME_ENCODING,
+    AVI_FRAME_ENCODED,		// waiting for the frames before it to be written
+    AVI_FRAME_DROPPED		// never read back, skipped by the writer
+} aviFrameState_t;
+
+typedef struct aviFrame_s
+{
+    aviFrameState_t state;
+    S32 sequence;
+    U8* cBuffer;
+    U8* eBuffer;
+    const U8* frame;		// the readback, somewhere in cBuffer
+    S32 padding;
+    S32 size;
+    F64 encodeSeconds;
+} aviFrame_t;
+
+// the capture ring, frame states are guarded by mutex
+typedef struct aviCapture_s
+{
+    aviFrame_t frames[MAX_AVI_FRAMES];
+    S32 numFrames;
+    S32 taken;				// frames handed out
+    S32 written;			// frames written or dropped, in order
+    S32 width, height;
+    S32 encodeSize;
+    bool motionJpeg;
+    bool rollover;			// CheckFileSize is moving to a new file
+    bool stopPending;		// the new file couldn't be opened, stop once the ring is left alone
+    bool bench;
+    
+    qmutex_t* mutex;
+    qcondvar_t* encoded;	// a frame was encoded
+    qjobGroup_t jobs;
+    S32 encoders;
+    
+    // back-pressure statistics
+    S32 numEncoded;
+    S32 numDropped;
+    S32 numStalls;
+    S32 peakInFlight;
+    F64 encodeSeconds;
+    F64 stallSeconds;
+} aviCapture_t;
+
 //
 // idServerBotSystemLocal
 //
@@ -86,6 +137,9 @@ public:
     virtual bool CloseAVI( void );
     virtual bool VideoRecording( void );
     virtual bool OpenAVIForWriting( StringEntry fileName );
+    virtual void CaptureAVIVideoFrame( const U8* frame, S32 padding );
+    
+    static void AVIBench_f( void );
     
     static void SafeFS_Write( const void* buffer, S32 len, fileHandle_t f );
     static void WRITE_STRING( StringEntry s );
@@ -96,6 +150,13 @@ public:
     static void END_CHUNK( void );
     static void WriteAVIHeader( void );
     static bool CheckFileSize( S32 bytesToAdd );
+    static bool OpenAVI( StringEntry fileName, S32 width, S32 height );
+    static bool StartCapture( void );
+    static void StopCapture( void );
+    static void EncodeJob( void* data );
+    static void EncodeFrame( aviFrame_t* frame );
+    static void WriteEncodedFrames( S32 wait );
+    static aviFrame_t* NextCaptureFrame( void );
 };
 
 extern idClientAVISystemLocal clientAVILocal;
@@ -0,0 +1,793 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf Engine.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   clientDemo.cpp
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: demo keyframe index and seeking
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <framework/precompiled.h>
+
+idClientDemoSystemLocal clientDemoSystemLocal;
+
+/*
+===============================================================================
+
+A demo can only be read forwards, as every snapshot is delta compressed from
+the ones before it. The index next to a demo holds a keyframe every
+cl_demoKeyframeInterval seconds of demo time: the snapshot written without
+delta compression, the configstrings and the server commands cgame hadn't
+executed yet. Seeking parses the last keyframe before the target, replays
+the configstrings that differ as server commands, moves the demo file to the
+message after the keyframe and reads forwards from there. cgame can't go back
+in time, so seeking backwards restarts the demo first.
+
+The index is written while recording, or by demoIndex for older demos.
+
+===============================================================================
+*/
+
+typedef struct
+{
+    demoKeyframe_t keyframe;
+    S32 dataOffset;			// in the index file
+} demoIndexEntry_t;
+
+// the index being written, while recording or for demoIndex
+static fileHandle_t demoIndexOut;
+static S32 demoIndexKeyframes;
+static S32 demoIndexLastTime;
+static UTF8 demoIndexRequest[MAX_QPATH];	// the demo demoIndex asked for
+static bool demoIndexing;			// demoIndex is playing the demo back
+static S32 demoIndexTimedemo;		// timedemo before demoIndex
+
+// the index of the demo being played back
+static fileHandle_t demoIndexIn;
+static demoIndexEntry_t* demoIndexEntries;
+static S32 demoIndexCount;
+
+// a seek waiting for the restarted demo
+static UTF8 demoSeekName[MAX_QPATH];
+static S32 demoSeekTime;
+static S32 demoSeekStart;
+
+// the server commands a seek replays, oldest first
+static UTF8 demoSeekCommands[MAX_RELIABLE_COMMANDS / 2][MAX_TOKEN_CHARS];
+
+/*
+===============
+idClientDemoSystemLocal::idClientDemoSystemLocal
+===============
+*/
+idClientDemoSystemLocal::idClientDemoSystemLocal( void )
+{
+}
+
+/*
+===============
+idClientDemoSystemLocal::~idClientDemoSystemLocal
+===============
+*/
+idClientDemoSystemLocal::~idClientDemoSystemLocal( void )
+{
+}
+
+/*
+===============
+DemoIndexPutLong
+===============
+*/
+static U8* DemoIndexPutLong( U8* p, S32 value )
+{
+    value = LittleLong( value );
+    ::memcpy( p, &value, 4 );
+    return p + 4;
+}
+
+/*
+===============
+DemoIndexGetLong
+===============
+*/
+static S32 DemoIndexGetLong( const U8** p )
+{
+    S32 value;
+    
+    ::memcpy( &value, *p, 4 );
+    *p += 4;
+    return LittleLong( value );
+}
+
+/*
+===============
+idClientDemoSystemLocal::IndexFileName
+===============
+*/
+void idClientDemoSystemLocal::IndexFileName( StringEntry demoFileName, UTF8* fileName, S32 size )
+{
+    Q_snprintf( fileName, size, "%s" DEMO_INDEX_EXTENSION, demoFileName );
+}
+
+/*
+===============
+idClientDemoSystemLocal::StartIndex
+
+Starts the index of a demo being recorded, or played back by demoIndex
+===============
+*/
+void idClientDemoSystemLocal::StartIndex( StringEntry demoFileName )
+{
+    demoIndexHeader_t header;
+    UTF8 name[MAX_OSPATH];
+    
+    if ( cl_demoKeyframeInterval->value <= 0 )
+    {
+        return;
+    }
+    
+    IndexFileName( demoFileName, name, sizeof( name ) );
+    
+    demoIndexOut = fileSystem->FOpenFileWrite( name );
+    if ( !demoIndexOut )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't open %s, the demo won't be seekable\n", name );
+        StopIndex();
+        return;
+    }
+    
+    header.ident = LittleLong( DEMOINDEX_IDENT );
+    header.version = LittleLong( DEMOINDEX_VERSION );
+    header.protocol = LittleLong( com_protocol->integer );
+    fileSystem->Write( &header, sizeof( header ), demoIndexOut );
+    
+    demoIndexKeyframes = 0;
+    demoIndexLastTime = 0;
+}
+
+/*
+===============
+idClientDemoSystemLocal::StopIndex
+===============
+*/
+void idClientDemoSystemLocal::StopIndex( void )
+{
+    if ( demoIndexOut )
+    {
+        fileSystem->FCloseFile( demoIndexOut );
+        demoIndexOut = 0;
+        
+        Com_Printf( "Wrote %i demo keyframes.\n", demoIndexKeyframes );
+    }
+    
+    if ( demoIndexing )
+    {
+        demoIndexing = false;
+        cvarSystem->Set( "timedemo", va( "%i", demoIndexTimedemo ) );
+    }
+}
+
+/*
+===============
+idClientDemoSystemLocal::LoadIndex
+
+Reads the keyframe headers of the index next to a demo about to be played,
+the keyframes themselves are read when seeking. Starts a new index instead
+if demoIndex asked for this demo
+===============
+*/
+void idClientDemoSystemLocal::LoadIndex( StringEntry demoFileName )
+{
+    demoIndexHeader_t header;
+    demoKeyframe_t keyframe;
+    UTF8 name[MAX_OSPATH];
+    S32 length, offset;
+    
+    if ( demoIndexRequest[0] )
+    {
+        demoIndexing = !Q_stricmp( demoIndexRequest, clc.demoName );
+        demoIndexRequest[0] = '\0';
+        
+        if ( demoIndexing )
+        {
+            demoIndexTimedemo = cl_timedemo->integer;
+            cvarSystem->Set( "timedemo", "1" );
+            
+            StartIndex( demoFileName );
+            return;
+        }
+    }
+    
+    IndexFileName( demoFileName, name, sizeof( name ) );
+    
+    length = fileSystem->FOpenFileRead( name, &demoIndexIn, true );
+    if ( !demoIndexIn )
+    {
+        return;
+    }
+    
+    if ( length < sizeof( header ) || fileSystem->Read( &header, sizeof( header ), demoIndexIn ) != sizeof( header ) ||
+            LittleLong( header.ident ) != DEMOINDEX_IDENT || LittleLong( header.version ) != DEMOINDEX_VERSION )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: %s is not a demo index\n", name );
+        CloseIndex();
+        return;
+    }
+    
+    demoIndexEntries = ( demoIndexEntry_t* )::malloc( ( length / sizeof( keyframe ) + 1 ) * sizeof( demoIndexEntry_t ) );
+    if ( !demoIndexEntries )
+    {
+        CloseIndex();
+        return;
+    }
+    
+    offset = sizeof( header );
+    
+    while ( offset + ( S32 )sizeof( keyframe ) <= length )
+    {
+        fileSystem->Read( &keyframe, sizeof( keyframe ), demoIndexIn );
+        offset += sizeof( keyframe );
+        
+        keyframe.serverTime = LittleLong( keyframe.serverTime );
+        keyframe.demoOffset = LittleLong( keyframe.demoOffset );
+        keyframe.messageSequence = LittleLong( keyframe.messageSequence );
+        keyframe.commandSequence = LittleLong( keyframe.commandSequence );
+        keyframe.length = LittleLong( keyframe.length );
+        
+        // the recording may have been cut short
+        if ( keyframe.length <= 0 || keyframe.length > length - offset )
+        {
+            break;
+        }
+        
+        demoIndexEntries[demoIndexCount].keyframe = keyframe;
+        demoIndexEntries[demoIndexCount].dataOffset = offset;
+        demoIndexCount++;
+        
+        offset += keyframe.length;
+        fileSystem->Seek( demoIndexIn, offset, FS_SEEK_SET );
+    }
+    
+    Com_Printf( "Demo index has %i keyframes.\n", demoIndexCount );
+}
+
+/*
+===============
+idClientDemoSystemLocal::CloseIndex
+===============
+*/
+void idClientDemoSystemLocal::CloseIndex( void )
+{
+    StopIndex();
+    
+    if ( demoIndexIn )
+    {
+        fileSystem->FCloseFile( demoIndexIn );
+        demoIndexIn = 0;
+    }
+    
+    ::free( demoIndexEntries );
+    demoIndexEntries = nullptr;
+    demoIndexCount = 0;
+}
+
+/*
+===============
+idClientDemoSystemLocal::DemoMessage
+
+Called after each demo message is parsed, while recording or playing back
+===============
+*/
+void idClientDemoSystemLocal::DemoMessage( void )
+{
+    if ( !clc.demoStartTime && cl.snap.valid )
+    {
+        clc.demoStartTime = cl.snap.serverTime;
+    }
+    
+    if ( demoIndexOut )
+    {
+        WriteKeyframe();
+    }
+}
+
+/*
+===============
+idClientDemoSystemLocal::WriteKeyframe
+===============
+*/
+void idClientDemoSystemLocal::WriteKeyframe( void )
+{
+    S32 i, len, count, first, size;
+    U8 bufData[MAX_MSGLEN];
+    demoKeyframe_t keyframe;
+    entityState_t* ent;
+    U8* data, *p, *countp;
+    msg_t buf;
+    UTF8* s;
+    
+    // only right after the message that brought in a snapshot
+    if ( !cl.snap.valid || cl.snap.messageNum != clc.serverMessageSequence )
+    {
+        return;
+    }
+    
+    if ( demoIndexKeyframes && cl.snap.serverTime - demoIndexLastTime < cl_demoKeyframeInterval->value * 1000 )
+    {
+        return;
+    }
+    
+    // the snapshot, as the server would send it to a client without a frame to delta from
+    MSG_Init( &buf, bufData, sizeof( bufData ) );
+    MSG_Bitstream( &buf );
+    
+    MSG_WriteLong( &buf, clc.reliableAcknowledge );
+    
+    MSG_WriteByte( &buf, svc_snapshot );
+    MSG_WriteLong( &buf, cl.snap.serverTime );
+    MSG_WriteByte( &buf, 0 );
+    MSG_WriteByte( &buf, cl.snap.snapFlags );
+    MSG_WriteByte( &buf, sizeof( cl.snap.areamask ) );
+    MSG_WriteData( &buf, cl.snap.areamask, sizeof( cl.snap.areamask ) );
+    MSG_WriteDeltaPlayerstate( &buf, nullptr, &cl.snap.ps );
+    
+    for ( i = 0; i < cl.snap.numEntities; i++ )
+    {
+        ent = &cl.parseEntities[( cl.snap.parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )];
+        MSG_WriteDeltaEntity( &buf, &cl.entityBaselines[ent->number], ent, true );
+    }
+    
+    MSG_WriteBits( &buf, ( MAX_GENTITIES - 1 ), GENTITYNUM_BITS );
+    MSG_WriteByte( &buf, svc_EOF );
+    
+    if ( buf.overflowed )
+    {
+        return;
+    }
+    
+    // server commands cgame hasn't executed yet, as many as a seek replays
+    first = Q_max( clc.lastExecutedServerCommand + 1, clc.serverCommandSequence - MAX_RELIABLE_COMMANDS / 2 + 1 );
+    
+    size = 12 + buf.cursize + MAX_CONFIGSTRINGS * 8 + MAX_GAMESTATE_CHARS + MAX_RELIABLE_COMMANDS / 2 * ( 4 + MAX_TOKEN_CHARS );
+    data = ( U8* )::malloc( size );
+    if ( !data )
+    {
+        return;
+    }
+    
+    p = DemoIndexPutLong( data, buf.cursize );
+    ::memcpy( p, buf.data, buf.cursize );
+    p += buf.cursize;
+    
+    countp = p;
+    p += 4;
+    
+    for ( i = 0, count = 0; i < MAX_CONFIGSTRINGS; i++ )
+    {
+        if ( !cl.gameState.stringOffsets[i] )
+        {
+            continue;
+        }
+        
+        s = cl.gameState.stringData + cl.gameState.stringOffsets[i];
+        len = ( S32 )::strlen( s ) + 1;
+        
+        p = DemoIndexPutLong( p, i );
+        p = DemoIndexPutLong( p, len );
+        ::memcpy( p, s, len );
+        p += len;
+        count++;
+    }
+    DemoIndexPutLong( countp, count );
+    
+    countp = p;
+    p += 4;
+    
+    for ( i = first, count = 0; i <= clc.serverCommandSequence; i++ )
+    {
+        s = clc.serverCommands[i & ( MAX_RELIABLE_COMMANDS - 1 )];
+        len = ( S32 )::strlen( s ) + 1;
+        
+        p = DemoIndexPutLong( p, len );
+        ::memcpy( p, s, len );
+        p += len;
+        count++;
+    }
+    DemoIndexPutLong( countp, count );
+    
+    keyframe.serverTime = LittleLong( cl.snap.serverTime );
+    keyframe.demoOffset = LittleLong( fileSystem->FTell( clc.demofile ) );
+    keyframe.messageSequence = LittleLong( clc.serverMessageSequence );
+    keyframe.commandSequence = LittleLong( clc.serverCommandSequence );
+    keyframe.length = LittleLong( ( S32 )( p - data ) );
+    
+    fileSystem->Write( &keyframe, sizeof( keyframe ), demoIndexOut );
+    fileSystem->Write( data, ( S32 )( p - data ), demoIndexOut );
+    
+    ::free( data );
+    
+    demoIndexKeyframes++;
+    demoIndexLastTime = cl.snap.serverTime;
+}
+
+/*
+===============
+idClientDemoSystemLocal::KeyframeCommands
+
+Fills demoSeekCommands with the configstrings of a keyframe that differ from
+the current ones, split like the server does, followed by the commands cgame
+hadn't executed. Returns the number of commands or -1 for a bad keyframe
+===============
+*/
+S32 idClientDemoSystemLocal::KeyframeCommands( const U8* p, const U8* end )
+{
+    static StringEntry strings[MAX_CONFIGSTRINGS];
+    const U8* pending;
+    S32 i, index, len, count, numPending, numCommands, numChunks, dropped, maxChunkSize = MAX_STRING_CHARS - 24;
+    StringEntry s, current;
+    UTF8 chunk[MAX_STRING_CHARS];
+    
+    for ( i = 0; i < MAX_CONFIGSTRINGS; i++ )
+    {
+        strings[i] = "";
+    }
+    
+    if ( end - p < 4 )
+    {
+        return -1;
+    }
+    
+    count = DemoIndexGetLong( &p );
+    for ( i = 0; i < count; i++ )
+    {
+        if ( end - p < 8 )
+        {
+            return -1;
+        }
+        
+        index = DemoIndexGetLong( &p );
+        len = DemoIndexGetLong( &p );
+        
+        if ( index < 0 || index >= MAX_CONFIGSTRINGS || len <= 0 || len > end - p || p[len - 1] )
+        {
+            return -1;
+        }
+        
+        strings[index] = ( StringEntry )p;
+        p += len;
+    }
+    
+    if ( end - p < 4 )
+    {
+        return -1;
+    }
+    
+    numPending = DemoIndexGetLong( &p );
+    if ( numPending < 0 || numPending > MAX_RELIABLE_COMMANDS / 2 )
+    {
+        return -1;
+    }
+    pending = p;
+    
+    numCommands = 0;
+    dropped = 0;
+    
+    for ( i = 0; i < MAX_CONFIGSTRINGS; i++ )
+    {
+        current = cl.gameState.stringOffsets[i] ? cl.gameState.stringData + cl.gameState.stringOffsets[i] : "";
+        
+        if ( !::strcmp( current, strings[i] ) )
+        {
+            continue;
+        }
+        
+        len = ( S32 )::strlen( strings[i] );
+        numChunks = len >= maxChunkSize ? ( len + maxChunkSize - 2 ) / ( maxChunkSize - 1 ) : 1;
+        
+        if ( numCommands + numChunks > MAX_RELIABLE_COMMANDS / 2 - numPending )
+        {
+            dropped++;
+            continue;
+        }
+        
+        if ( numChunks == 1 )
+        {
+            Q_snprintf( demoSeekCommands[numCommands++], MAX_TOKEN_CHARS, "cs %i \"%s\"\n", i, strings[i] );
+            continue;
+        }
+        
+        for ( s = strings[i]; *s; s += ::strlen( chunk ) )
+        {
+            Q_strncpyz( chunk, s, maxChunkSize );
+            
+            Q_snprintf( demoSeekCommands[numCommands++], MAX_TOKEN_CHARS, "%s %i \"%s\"\n",
+                        s == strings[i] ? "bcs0" : ( ( S32 )::strlen( s ) < maxChunkSize ? "bcs2" : "bcs1" ), i, chunk );
+        }
+    }
+    
+    if ( dropped )
+    {
+        Com_DPrintf( "demoSeek: %i configstrings changed too much to replay\n", dropped );
+    }
+    
+    p = pending;
+    for ( i = 0; i < numPending; i++ )
+    {
+        if ( end - p < 4 )
+        {
+            return -1;
+        }
+        
+        len = DemoIndexGetLong( &p );
+        if ( len <= 0 || len > end - p || p[len - 1] )
+        {
+            return -1;
+        }
+        
+        Q_strncpyz( demoSeekCommands[numCommands++], ( StringEntry )p, MAX_TOKEN_CHARS );
+        p += len;
+    }
+    
+    return numCommands;
+}
+
+/*
+===============
+idClientDemoSystemLocal::RestoreKeyframe
+
+Returns false without changing anything if the keyframe can't be used
+===============
+*/
+bool idClientDemoSystemLocal::RestoreKeyframe( S32 index )
+{
+    demoIndexEntry_t* entry = &demoIndexEntries[index];
+    demoKeyframe_t* keyframe = &entry->keyframe;
+    S32 i, snapshotLength, numCommands, sequence;
+    U8 bufData[MAX_MSGLEN];
+    const U8* p, *end;
+    U8* data;
+    msg_t buf;
+    
+    data = ( U8* )::malloc( keyframe->length );
+    if ( !data )
+    {
+        return false;
+    }
+    
+    fileSystem->Seek( demoIndexIn, entry->dataOffset, FS_SEEK_SET );
+    if ( fileSystem->Read( data, keyframe->length, demoIndexIn ) != keyframe->length )
+    {
+        ::free( data );
+        return false;
+    }
+    
+    p = data;
+    end = data + keyframe->length;
+    
+    snapshotLength = DemoIndexGetLong( &p );
+    if ( snapshotLength <= 0 || snapshotLength > sizeof( bufData ) || snapshotLength > end - p )
+    {
+        ::free( data );
+        return false;
+    }
+    
+    numCommands = KeyframeCommands( p + snapshotLength, end );
+    
+    // the replayed commands take the sequence numbers just before the
+    // keyframe, they must not run into the ones we have already
+    sequence = keyframe->commandSequence - numCommands;
+    if ( numCommands < 0 || sequence < clc.serverCommandSequence )
+    {
+        ::free( data );
+        return false;
+    }
+    
+    for ( i = 0; i < numCommands; i++ )
+    {
+        Q_strncpyz( clc.serverCommands[( sequence + 1 + i ) & ( MAX_RELIABLE_COMMANDS - 1 )], demoSeekCommands[i], sizeof( clc.serverCommands[0] ) );
+    }
+    
+    // cgame skips everything in between
+    clc.demoCommandFloor = sequence;
+    clc.serverCommandSequence = keyframe->commandSequence;
+    
+    MSG_Init( &buf, bufData, sizeof( bufData ) );
+    ::memcpy( buf.data, p, snapshotLength );
+    buf.cursize = snapshotLength;
+    
+    clc.serverMessageSequence = keyframe->messageSequence;
+    idClientParseSystemLocal::ParseServerMessage( &buf );
+    
+    fileSystem->Seek( clc.demofile, keyframe->demoOffset, FS_SEEK_SET );
+    
+    ::free( data );
+    
+    return true;
+}
+
+/*
+===============
+idClientDemoSystemLocal::Seek
+===============
+*/
+void idClientDemoSystemLocal::Seek( S32 serverTime, S32 startMsec )
+{
+    S32 i, keyframe = -1, messages = 0, seconds;
+    
+    if ( serverTime < cl.snap.serverTime )
+    {
+        // cgame can't go back in time, start over and seek from there
+        Q_strncpyz( demoSeekName, clc.demoName, sizeof( demoSeekName ) );
+        demoSeekTime = serverTime;
+        demoSeekStart = startMsec;
+        
+        cmdBufferSystem->AddText( va( "demo \"%s\"\n", demoSeekName ) );
+        return;
+    }
+    
+    // the last keyframe before the target, if it is ahead of us
+    for ( i = demoIndexCount - 1; i >= 0; i-- )
+    {
+        if ( demoIndexEntries[i].keyframe.serverTime <= serverTime )
+        {
+            break;
+        }
+    }
+    
+    if ( i >= 0 && demoIndexEntries[i].keyframe.serverTime > cl.snap.serverTime && RestoreKeyframe( i ) )
+    {
+        keyframe = i;
+    }
+    
+    while ( cls.state == CA_ACTIVE && cl.snap.serverTime < serverTime )
+    {
+        idClientMainSystemLocal::ReadDemoMessage();
+        messages++;
+    }
+    
+    // ran off the end of the demo
+    if ( cls.state != CA_ACTIVE )
+    {
+        return;
+    }
+    
+    // carry on from the new snapshot
+    cl.serverTimeDelta = cl.snap.serverTime - cls.realtime;
+    cl.serverTime = cl.oldServerTime = cl.snap.serverTime;
+    clc.timeDemoBaseTime = cl.snap.serverTime - clc.timeDemoFrames * 50;
+    
+    seconds = ( cl.snap.serverTime - clc.demoStartTime ) / 1000;
+    
+    if ( keyframe >= 0 )
+    {
+        Com_Printf( "demoSeek: %i:%02i in %i msec, from keyframe %i of %i and %i messages\n", seconds / 60, seconds % 60,
+                    idsystem->Milliseconds() - startMsec, keyframe + 1, demoIndexCount, messages );
+    }
+    else
+    {
+        Com_Printf( "demoSeek: %i:%02i in %i msec, %i messages read%s\n", seconds / 60, seconds % 60,
+                    idsystem->Milliseconds() - startMsec, messages, demoIndexCount ? "" : " (no demo index, see demoIndex)" );
+    }
+}
+
+/*
+===============
+idClientDemoSystemLocal::SeekPending
+
+Finishes a backwards seek once the restarted demo is running
+===============
+*/
+void idClientDemoSystemLocal::SeekPending( void )
+{
+    S32 serverTime;
+    
+    if ( !demoSeekTime )
+    {
+        return;
+    }
+    
+    if ( !clc.demoplaying || Q_stricmp( clc.demoName, demoSeekName ) )
+    {
+        demoSeekTime = 0;
+        return;
+    }
+    
+    if ( cls.state != CA_ACTIVE )
+    {
+        return;
+    }
+    
+    serverTime = demoSeekTime;
+    demoSeekTime = 0;
+    
+    Seek( Q_max( serverTime, cl.snap.serverTime ), demoSeekStart );
+}
+
+/*
+===============
+idClientDemoSystemLocal::Seek_f
+
+demoSeek <[+|-]seconds|minutes:seconds>
+===============
+*/
+void idClientDemoSystemLocal::Seek_f( void )
+{
+    S32 serverTime;
+    UTF8* arg;
+    
+    if ( cmdSystem->Argc() != 2 )
+    {
+        Com_Printf( "demoSeek <[+|-]seconds|minutes:seconds>\n" );
+        return;
+    }
+    
+    if ( !clc.demoplaying || cls.state != CA_ACTIVE )
+    {
+        Com_Printf( "Not playing a demo.\n" );
+        return;
+    }
+    
+    arg = cmdSystem->Argv( 1 );
+    
+    if ( arg[0] == '+' || arg[0] == '-' )
+    {
+        serverTime = cl.snap.serverTime + ( S32 )( atof( arg ) * 1000 );
+    }
+    else if ( strchr( arg, ':' ) )
+    {
+        serverTime = clc.demoStartTime + ( atoi( arg ) * 60 + atoi( strchr( arg, ':' ) + 1 ) ) * 1000;
+    }
+    else
+    {
+        serverTime = clc.demoStartTime + ( S32 )( atof( arg ) * 1000 );
+    }
+    
+    Seek( Q_max( serverTime, clc.demoStartTime ), idsystem->Milliseconds() );
+}
+
+/*
+===============
+idClientDemoSystemLocal::Index_f
+
+demoIndex <demoname>
+
+Plays a demo back as a timedemo to write its index
+===============
+*/
+void idClientDemoSystemLocal::Index_f( void )
+{
+    if ( cmdSystem->Argc() != 2 )
+    {
+        Com_Printf( "demoIndex <demoname>\n" );
+        return;
+    }
+    
+    if ( cl_demoKeyframeInterval->value <= 0 )
+    {
+        Com_Printf( "cl_demoKeyframeInterval is 0, there are no keyframes to write.\n" );
+        return;
+    }
+    
+    Q_strncpyz( demoIndexRequest, cmdSystem->Argv( 1 ), sizeof( demoIndexRequest ) );
+    cmdBufferSystem->AddText( va( "demo \"%s\"\n", cmdSystem->Argv( 1 ) ) );
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 1999 - 2010 id Software LLC, a ZeniMax Media company.
+// Copyright(C) 2011 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of OpenWolf Engine.
+//
+// OpenWolf is free software; you can redistribute it
+// and / or modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// OpenWolf is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110 - 1301  USA
+//
+// -------------------------------------------------------------------------------------
+// File name:   clientDemo.h
+// Version:     v1.00
+// Created:
+// Compilers:   Visual Studio 2019, gcc 7.3.0
+// Description: demo keyframe index and seeking
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __CLIENTDEMO_H__
+#define __CLIENTDEMO_H__
+
+#define DEMO_INDEX_EXTENSION ".idx"
+
+#define DEMOINDEX_IDENT		( ( 'X' << 24 ) + ( 'D' << 16 ) + ( 'I' << 8 ) + 'D' )
+#define DEMOINDEX_VERSION	1
+
+typedef struct
+{
+    S32 ident;
+    S32 version;
+    S32 protocol;
+} demoIndexHeader_t;
+
+// follows the header of an index file once per keyframe, followed by length
+// bytes of keyframe data: the snapshot as a non delta server message, the
+// configstrings and the server commands cgame hadn't executed yet
+typedef struct
+{
+    S32 serverTime;
+    S32 demoOffset;			// of the demo message after the keyframe
+    S32 messageSequence;	// of the snapshot
+    S32 commandSequence;	// clc.serverCommandSequence at the snapshot
+    S32 length;
+} demoKeyframe_t;
+
+//
+// idClientDemoSystemLocal
+//
+class idClientDemoSystemLocal
+{
+public:
+    idClientDemoSystemLocal();
+    ~idClientDemoSystemLocal();
+    
+    static void StartIndex( StringEntry demoFileName );
+    static void StopIndex( void );
+    static void LoadIndex( StringEntry demoFileName );
+    static void CloseIndex( void );
+    static void DemoMessage( void );
+    static void SeekPending( void );
+    static void Seek_f( void );
+    static void Index_f( void );
+    static void IndexFileName( StringEntry demoFileName, UTF8* fileName, S32 size );
+    static void WriteKeyframe( void );
+    static S32 KeyframeCommands( const U8* p, const U8* end );
+    static bool RestoreKeyframe( S32 keyframe );
+    static void Seek( S32 serverTime, S32 startMsec );
+};
+
+extern idClientDemoSystemLocal clientDemoSystemLocal;
+
+#endif //!__CLIENTDEMO_H__
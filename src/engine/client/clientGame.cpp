@@ -153,59 +153,11 @@ idClientGameSystemLocal::GetSnapshot
 */
 bool idClientGameSystemLocal::GetSnapshot( S32 snapshotNumber, snapshot_t* snapshot )
 {
-    S32 i, count;
-    clSnapshot_t* clSnap;
+    snapshotParse_t parse;
     
-    if ( snapshotNumber > cl.snap.messageNum )
-    {
-        Com_Error( ERR_DROP, "idClientGameSystemLocal::GetSnapshot: snapshotNumber > cl.snapshot.messageNum" );
-    }
-    
-    // if the frame has fallen out of the circular buffer, we can't return it
-    if ( cl.snap.messageNum - snapshotNumber >= PACKET_BACKUP )
-    {
-        return false;
-    }
-    
-    // if the frame is not valid, we can't return it
-    clSnap = &cl.snapshots[snapshotNumber & PACKET_MASK];
-    if ( !clSnap->valid )
-    {
-        return false;
-    }
-    
-    // if the entities in the frame have fallen out of their
-    // circular buffer, we can't return it
-    if ( cl.parseEntitiesNum - clSnap->parseEntitiesNum >= MAX_PARSE_ENTITIES )
-    {
-        return false;
-    }
-    
-    // write the snapshot
-    snapshot->snapFlags = clSnap->snapFlags;
-    snapshot->serverCommandSequence = clSnap->serverCommandNum;
-    snapshot->ping = clSnap->ping;
-    snapshot->serverTime = clSnap->serverTime;
-    ::memcpy( snapshot->areamask, clSnap->areamask, sizeof( snapshot->areamask ) );
-    snapshot->ps = clSnap->ps;
+    idClientParseSystemLocal::SetupParse( &parse );
     
-    count = clSnap->numEntities;
-    if ( count > MAX_ENTITIES_IN_SNAPSHOT )
-    {
-        Com_DPrintf( "idClientGameSystemLocal::GetSnapshot: truncated %i entities to %i\n", count, MAX_ENTITIES_IN_SNAPSHOT );
-        count = MAX_ENTITIES_IN_SNAPSHOT;
-    }
-    
-    snapshot->numEntities = count;
-    
-    for ( i = 0; i < count; i++ )
-    {
-        snapshot->entities[i] = cl.parseEntities[( clSnap->parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )];
-    }
-    
-    // FIXME: configstring changes and server commands!!!
-    
-    return true;
+    return idSnapshotParseSystemLocal::GetSnapshot( &parse, snapshotNumber, snapshot );
 }
 
 /*
@@ -463,6 +415,12 @@ bool idClientGameSystemLocal::GetServerCommand( S32 serverCommandNumber )
     UTF8* cmd;
     static UTF8 bigConfigString[BIG_INFO_STRING];
     
+    // a demo seek replaced these with the ones of its keyframe
+    if ( clc.demoplaying && serverCommandNumber <= clc.demoCommandFloor )
+    {
+        return false;
+    }
+    
     // if we have irretrievably lost a reliable command, drop the connection
     if ( serverCommandNumber <= clc.serverCommandSequence - MAX_RELIABLE_COMMANDS )
     {
@@ -1254,6 +1212,9 @@ void idClientGameSystemLocal::SetCGameTime( void )
         return;
     }
     
+    // finish a seek that had to restart the demo
+    idClientDemoSystemLocal::SeekPending();
+    
     // if we are playing a demo back, we can just keep reading
     // messages from the demo file until the cgame definately
     // has valid snapshots to interpolate between
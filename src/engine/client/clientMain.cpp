@@ -88,6 +88,7 @@ convar_t* cl_allowDownload;
 convar_t* cl_wwwDownload;
 convar_t* cl_conXOffset;
 convar_t* cl_inGameVideo;
+convar_t* cl_cinematicThread;
 convar_t* cl_serverStatusResendTime;
 convar_t* cl_trn;
 convar_t* cl_missionStats;
@@ -115,6 +116,8 @@ convar_t* cl_consolePrompt;
 convar_t* cl_gamename;
 convar_t* cl_altTab;
 convar_t* cl_aviMotionJpeg;
+convar_t* cl_aviEncodeThreads;
+convar_t* cl_demoKeyframeInterval;
 convar_t* cl_guidServerUniq;
 
 clientActive_t cl;
@@ -323,6 +326,8 @@ void idClientMainSystemLocal::WriteDemoMessage( msg_t* msg, S32 headerBytes )
     swlen = LittleLong( len );
     fileSystem->Write( &swlen, 4, clc.demofile );
     fileSystem->Write( msg->data + headerBytes, len, clc.demofile );
+    
+    idClientDemoSystemLocal::DemoMessage();
 }
 
 /*
@@ -349,6 +354,8 @@ void idClientMainSystemLocal::StopRecord_f( void )
     fileSystem->FCloseFile( clc.demofile );
     clc.demofile = 0;
     
+    idClientDemoSystemLocal::StopIndex();
+    
     clc.demorecording = false;
     
     cvarSystem->Set( "cl_demorecording", "0" );
@@ -533,6 +540,8 @@ void idClientMainSystemLocal::Record( StringEntry name )
     fileSystem->Write( &len, 4, clc.demofile );
     fileSystem->Write( buf.data, buf.cursize, clc.demofile );
     
+    idClientDemoSystemLocal::StartIndex( name );
+    
     // the rest of the demo file will be copied from net messages
 }
 
@@ -579,64 +588,23 @@ idClientMainSystemLocal::ReadDemoMessage
 
 void idClientMainSystemLocal::ReadDemoMessage( void )
 {
-    S32 r, s;
     U8 bufData[MAX_MSGLEN];
     msg_t buf;
     
-    if ( !clc.demofile )
-    {
-        DemoCompleted();
-        return;
-    }
-    
-    // get the sequence number
-    r = fileSystem->Read( &s, 4, clc.demofile );
-    if ( r != 4 )
-    {
-        DemoCompleted();
-        return;
-    }
-    
-    clc.serverMessageSequence = LittleLong( s );
-    
     // init the message
     MSG_Init( &buf, bufData, sizeof( bufData ) );
     
-    // get the length
-    r = fileSystem->Read( &buf.cursize, 4, clc.demofile );
-    
-    if ( r != 4 )
+    if ( !clc.demofile || !idSnapshotParseSystemLocal::ReadDemoMessage( clc.demofile, &buf, &clc.serverMessageSequence ) )
     {
         DemoCompleted();
         return;
     }
     
-    buf.cursize = LittleLong( buf.cursize );
-    
-    if ( buf.cursize == -1 )
-    {
-        DemoCompleted();
-        return;
-    }
-    
-    if ( buf.cursize > buf.maxsize )
-    {
-        Com_Error( ERR_DROP, "idClientMainSystemLocal::ReadDemoMessage: demoMsglen > MAX_MSGLEN" );
-    }
-    
-    r = fileSystem->Read( buf.data, buf.cursize, clc.demofile );
-    
-    if ( r != buf.cursize )
-    {
-        Com_Printf( "Demo file was truncated.\n" );
-        DemoCompleted();
-        return;
-    }
-    
     clc.lastPacketTime = cls.realtime;
-    buf.readcount = 0;
     
     idClientParseSystemLocal::ParseServerMessage( &buf );
+    
+    idClientDemoSystemLocal::DemoMessage();
 }
 
 /*
@@ -874,6 +842,8 @@ void idClientMainSystemLocal::PlayDemo_f( void )
     
     Q_strncpyz( clc.demoName, cmdSystem->Argv( 1 ), sizeof( clc.demoName ) );
     
+    idClientDemoSystemLocal::LoadIndex( name );
+    
     Con_Close();
     
     cls.state = CA_CONNECTED;
@@ -1257,6 +1227,8 @@ void idClientMainSystemLocal::Disconnect( bool showMainMenu )
         clc.demofile = 0;
     }
     
+    idClientDemoSystemLocal::CloseIndex();
+    
     if ( uivm && showMainMenu )
     {
         uiManager->SetActiveMenu( UIMENU_NONE );
@@ -3195,6 +3167,8 @@ idClientMainSystemLocal::Frame
 */
 void idClientMainSystemLocal::Frame( S32 msec )
 {
+    PROFILE_ZONE( "CL_Frame" );
+    
     if ( !com_cl_running->integer )
     {
         soundSystem->Update();
@@ -3820,6 +3794,7 @@ void idClientMainSystemLocal::InitExportTable( void )
     exports.clientAVISystem = clientAVISystem;
     exports.clientMainSystem = clientMainSystem;
     exports.memorySystem = memorySystem;
+    exports.profilerSystem = profilerSystem;
 }
 
 /*
@@ -4036,6 +4011,8 @@ void idClientMainSystemLocal::Init( void )
     cl_aviFrameRate = cvarSystem->Get( "cl_aviFrameRate", "25", CVAR_ARCHIVE, "description" );
     
     cl_aviMotionJpeg = cvarSystem->Get( "cl_aviMotionJpeg", "1", CVAR_ARCHIVE, "description" );
+    cl_aviEncodeThreads = cvarSystem->Get( "cl_aviEncodeThreads", "2", CVAR_ARCHIVE, "Video frames encoded at once on the job pool, 0 encodes each frame on the main thread as it is read back" );
+    cl_demoKeyframeInterval = cvarSystem->Get( "cl_demoKeyframeInterval", "10", CVAR_ARCHIVE, "Seconds of demo time between the keyframes demoSeek restores from, 0 records demos without an index" );
     
     rconAddress = cvarSystem->Get( "rconAddress", "", 0, "description" );
     
@@ -4076,6 +4053,7 @@ void idClientMainSystemLocal::Init( void )
     
     cl_conXOffset = cvarSystem->Get( "cl_conXOffset", "3", 0, "description" );
     cl_inGameVideo = cvarSystem->Get( "r_inGameVideo", "1", CVAR_ARCHIVE, "description" );
+    cl_cinematicThread = cvarSystem->Get( "cl_cinematicThread", "1", CVAR_ARCHIVE, "Decodes RoQ cinematic frames on the job pool, shown a frame later than they are read" );
     
     cl_serverStatusResendTime = cvarSystem->Get( "cl_serverStatusResendTime", "750", 0, "description" );
     
@@ -4186,7 +4164,11 @@ void idClientMainSystemLocal::Init( void )
     cmdSystem->AddCommand( "record", &idClientMainSystemLocal::Record_f, "description" );
     cmdSystem->AddCommand( "demo", &idClientMainSystemLocal::PlayDemo_f, "description" );
     cmdSystem->SetCommandCompletionFunc( "demo", &idClientMainSystemLocal::CompleteDemoName );
+    cmdSystem->AddCommand( "demoSeek", &idClientDemoSystemLocal::Seek_f, "Jumps to a time in the demo being played, from the nearest keyframe of its index" );
+    cmdSystem->AddCommand( "demoIndex", &idClientDemoSystemLocal::Index_f, "Plays a demo back as a timedemo to write the keyframe index demoSeek uses" );
+    cmdSystem->SetCommandCompletionFunc( "demoIndex", &idClientMainSystemLocal::CompleteDemoName );
     cmdSystem->AddCommand( "cinematic", CL_PlayCinematic_f, "description" );
+    profilerSystem->AddBench( "cin", CIN_Bench_f, "Decodes a RoQ video as fast as it goes and prints the frames/sec, checking the output against the reference decoder, args: <video>" );
     cmdSystem->AddCommand( "stoprecord", &idClientMainSystemLocal::StopRecord_f, "description" );
     cmdSystem->AddCommand( "connect", &idClientMainSystemLocal::Connect_f, "description" );
     cmdSystem->AddCommand( "reconnect", &idClientMainSystemLocal::Reconnect_f, "description" );
@@ -4222,6 +4204,7 @@ void idClientMainSystemLocal::Init( void )
     
     cmdSystem->AddCommand( "video", &idClientMainSystemLocal::Video_f, "description" );
     cmdSystem->AddCommand( "stopvideo", &idClientMainSystemLocal::StopVideo_f, "description" );
+    profilerSystem->AddBench( "avi", &idClientAVISystemLocal::AVIBench_f, "Encodes generated frames into videos/aviBench.avi and prints the encoded frames/sec, args: [frames] [width] [height]" );
     
     InitRef();
     
@@ -4293,7 +4276,10 @@ void idClientMainSystemLocal::Shutdown( void )
     cmdSystem->RemoveCommand( "disconnect" );
     cmdSystem->RemoveCommand( "record" );
     cmdSystem->RemoveCommand( "demo" );
+    cmdSystem->RemoveCommand( "demoSeek" );
+    cmdSystem->RemoveCommand( "demoIndex" );
     cmdSystem->RemoveCommand( "cinematic" );
+    profilerSystem->RemoveBench( "cin" );
     cmdSystem->RemoveCommand( "stoprecord" );
     cmdSystem->RemoveCommand( "connect" );
     cmdSystem->RemoveCommand( "reconnect" );
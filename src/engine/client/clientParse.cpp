@@ -213,204 +213,53 @@ bool idClientParseSystemLocal::isEntVisible( entityState_t* ent )
 
 /*
 ==================
-idClientParseSystemLocal::DeltaEntity
+idClientParseSystemLocal::AddEntity
 
-Parses deltas from the given base and adds the resulting entity
-to the current frame
+Only draw clients that are visible, for clc.onlyVisibleClients
 ==================
 */
-void idClientParseSystemLocal::DeltaEntity( msg_t* msg, clSnapshot_t* frame, S32 newnum, entityState_t* old, bool unchanged )
+void idClientParseSystemLocal::AddEntity( entityState_t* state, clSnapshot_t* frame )
 {
-    entityState_t*  state;
-    
-    // save the parsed entity state into the big circular buffer so
-    // it can be used as the source for a later delta
-    state = &cl.parseEntities[cl.parseEntitiesNum & ( MAX_PARSE_ENTITIES - 1 )];
-    
-    if ( unchanged )
-    {
-        *state = *old;
-    }
-    else
-    {
-        MSG_ReadDeltaEntity( msg, old, state, newnum );
-    }
-    
-    if ( state->number == ( MAX_GENTITIES - 1 ) )
-    {
-        return;					// entity was delta removed
-    }
-    
-#if 1
     // DHM - Nerve :: Only draw clients if visible
-    if ( clc.onlyVisibleClients )
+    if ( state->number < MAX_CLIENTS )
     {
-        if ( state->number < MAX_CLIENTS )
+        if ( isEntVisible( state ) )
         {
-            if ( isEntVisible( state ) )
-            {
-                entLastVisible[state->number] = frame->serverTime;
-                state->eFlags &= ~EF_NODRAW;
-            }
-            else
+            entLastVisible[state->number] = frame->serverTime;
+            state->eFlags &= ~EF_NODRAW;
+        }
+        else
+        {
+            if ( entLastVisible[state->number] < ( frame->serverTime - 600 ) )
             {
-                if ( entLastVisible[state->number] < ( frame->serverTime - 600 ) )
-                {
-                    state->eFlags |= EF_NODRAW;
-                }
+                state->eFlags |= EF_NODRAW;
             }
         }
     }
-#endif
-    
-    cl.parseEntitiesNum++;
-    frame->numEntities++;
 }
 
 /*
 ==================
-idClientParseSystemLocal::ParsePacketEntities
+idClientParseSystemLocal::SetupParse
+
+Points the shared snapshot parser at cl and clc
 ==================
 */
-void idClientParseSystemLocal::ParsePacketEntities( msg_t* msg, clSnapshot_t* oldframe, clSnapshot_t* newframe )
+void idClientParseSystemLocal::SetupParse( snapshotParse_t* parse )
 {
-    S32 newnum, oldindex, oldnum;
-    entityState_t*	oldstate;
-    
-    newframe->parseEntitiesNum = cl.parseEntitiesNum;
-    newframe->numEntities = 0;
-    
-    // delta from the entities present in oldframe
-    oldindex = 0;
-    oldstate = nullptr;
-    
-    if ( !oldframe )
-    {
-        oldnum = 99999;
-    }
-    else
-    {
-        if ( oldindex >= oldframe->numEntities )
-        {
-            oldnum = 99999;
-        }
-        else
-        {
-            oldstate = &cl.parseEntities[( oldframe->parseEntitiesNum + oldindex ) & ( MAX_PARSE_ENTITIES - 1 )];
-            oldnum = oldstate->number;
-        }
-    }
-    
-    while ( 1 )
-    {
-        // read the entity index number
-        newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
-        
-        if ( newnum == ( MAX_GENTITIES - 1 ) )
-        {
-            break;
-        }
-        
-        if ( msg->readcount > msg->cursize )
-        {
-            Com_Error( ERR_DROP, "idClientParseSystemLocal::ParsePacketEntities: end of message" );
-        }
-        
-        while ( oldnum < newnum )
-        {
-            // one or more entities from the old packet are unchanged
-            if ( cl_shownet->integer == 3 )
-            {
-                Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
-            }
-            
-            DeltaEntity( msg, newframe, oldnum, oldstate, true );
-            
-            oldindex++;
-            
-            if ( oldindex >= oldframe->numEntities )
-            {
-                oldnum = 99999;
-            }
-            else
-            {
-                oldstate = &cl.parseEntities[
-                               ( oldframe->parseEntitiesNum + oldindex ) & ( MAX_PARSE_ENTITIES - 1 )];
-                oldnum = oldstate->number;
-            }
-        }
-        if ( oldnum == newnum )
-        {
-            // delta from previous state
-            if ( cl_shownet->integer == 3 )
-            {
-                Com_Printf( "%3i:  delta: %i\n", msg->readcount, newnum );
-            }
-            
-            DeltaEntity( msg, newframe, newnum, oldstate, false );
-            
-            oldindex++;
-            
-            if ( oldindex >= oldframe->numEntities )
-            {
-                oldnum = 99999;
-            }
-            else
-            {
-                oldstate = &cl.parseEntities[
-                               ( oldframe->parseEntitiesNum + oldindex ) & ( MAX_PARSE_ENTITIES - 1 )];
-                oldnum = oldstate->number;
-            }
-            continue;
-        }
-        
-        if ( oldnum > newnum )
-        {
-            // delta from baseline
-            if ( cl_shownet->integer == 3 )
-            {
-                Com_Printf( "%3i:  baseline: %i\n", msg->readcount, newnum );
-            }
-            
-            DeltaEntity( msg, newframe, newnum, &cl.entityBaselines[newnum], false );
-            
-            continue;
-        }
-        
-    }
-    
-    // any remaining entities in the old frame are copied over
-    while ( oldnum != 99999 )
-    {
-        // one or more entities from the old packet are unchanged
-        if ( cl_shownet->integer == 3 )
-        {
-            Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
-        }
-        
-        DeltaEntity( msg, newframe, oldnum, oldstate, true );
-        
-        oldindex++;
-        
-        if ( oldindex >= oldframe->numEntities )
-        {
-            oldnum = 99999;
-        }
-        else
-        {
-            oldstate = &cl.parseEntities[
-                           ( oldframe->parseEntitiesNum + oldindex ) & ( MAX_PARSE_ENTITIES - 1 )];
-            oldnum = oldstate->number;
-        }
-    }
-    
-    if ( cl_shownuments->integer )
-    {
-        Com_Printf( "Entities in packet: %i\n", newframe->numEntities );
-    }
+    parse->gameState = &cl.gameState;
+    parse->baselines = cl.entityBaselines;
+    parse->snap = &cl.snap;
+    parse->snapshots = cl.snapshots;
+    parse->parseEntities = cl.parseEntities;
+    parse->maxParseEntities = MAX_PARSE_ENTITIES;
+    parse->parseEntitiesNum = &cl.parseEntitiesNum;
+    parse->serverCommandSequence = &clc.serverCommandSequence;
+    parse->serverMessageSequence = clc.serverMessageSequence;
+    parse->showNet = cl_shownet->integer;
+    parse->addEntity = clc.onlyVisibleClients ? AddEntity : nullptr;
 }
 
-
 /*
 ================
 idClientParseSystemLocal::ParseSnapshot
@@ -422,49 +271,34 @@ for any reason, no changes to the state will be made at all.
 */
 void idClientParseSystemLocal::ParseSnapshot( msg_t* msg )
 {
-    S32 i, packetNum, len, oldMessageNum, deltaNum;
-    clSnapshot_t* old, newSnap;
-    
-    // get the reliable sequence acknowledge number
-    // NOTE: now sent with all server to client messages
-    //clc.reliableAcknowledge = MSG_ReadLong( msg );
-    
-    // read in the new snapshot to a temporary buffer
-    // we will only copy to cl.snap if it is valid
-    ::memset( &newSnap, 0, sizeof( newSnap ) );
-    
-    // we will have read any new server commands in this
-    // message before we got to svc_snapshot
-    newSnap.serverCommandNum = clc.serverCommandSequence;
+    S32 i, packetNum;
+    clSnapshot_t newSnap;
+    snapshotParse_t parse;
+    bool valid;
     
-    newSnap.serverTime = MSG_ReadLong( msg );
+    SetupParse( &parse );
     
     // if we were just unpaused, we can only *now* really let the
     // change come into effect or the client hangs.
     cl_paused->modified = 0;
     
-    newSnap.messageNum = clc.serverMessageSequence;
+    valid = idSnapshotParseSystemLocal::ParseSnapshot( &parse, msg, &newSnap );
     
-    deltaNum = MSG_ReadByte( msg );
-    if ( !deltaNum )
+    if ( cl_shownuments->integer )
     {
-        newSnap.deltaNum = -1;
+        Com_Printf( "Entities in packet: %i\n", newSnap.numEntities );
     }
-    else
+    
+    // if not valid, dump the entire thing now that it has
+    // been properly read
+    if ( !valid )
     {
-        newSnap.deltaNum = newSnap.messageNum - deltaNum;
+        return;
     }
     
-    newSnap.snapFlags = MSG_ReadByte( msg );
-    
-    // If the frame is delta compressed from data that we
-    // no longer have available, we must suck up the rest of
-    // the frame, but not use it, then ask for a non-compressed
-    // message
     if ( newSnap.deltaNum <= 0 )
     {
-        newSnap.valid = true;	// uncompressed frame
-        old = NULL;
+        // uncompressed frame
         if ( clc.demorecording )
         {
             clc.demowaiting = false;	// we can start recording now
@@ -512,94 +346,21 @@ void idClientParseSystemLocal::ParseSnapshot( msg_t* msg )
             }
         }
     }
-    else
-    {
-        old = &cl.snapshots[newSnap.deltaNum & PACKET_MASK];
-        if ( !old->valid )
-        {
-            // should never happen
-            Com_Printf( "Delta from invalid frame (not supposed to happen!).\n" );
-        }
-        else if ( old->messageNum != newSnap.deltaNum )
-        {
-            // The frame that the server did the delta from
-            // is too old, so we can't reconstruct it properly.
-            Com_DPrintf( "Delta frame too old.\n" );
-        }
-        else if ( cl.parseEntitiesNum - old->parseEntitiesNum > MAX_PARSE_ENTITIES - 128 )
-        {
-            Com_DPrintf( "Delta parseEntitiesNum too old.\n" );
-        }
-        else
-        {
-            newSnap.valid = true;	// valid delta parse
-        }
-    }
-    
-    // read areamask
-    len = MSG_ReadByte( msg );
-    
-    if ( len > sizeof( newSnap.areamask ) )
-    {
-        Com_Error( ERR_DROP, "idClientParseSystemLocal::ParseSnapshot: Invalid size %d for areamask.", len );
-        return;
-    }
-    
-    MSG_ReadData( msg, &newSnap.areamask, len );
-    
-    // read playerinfo
-    ShowNet( msg, "playerstate" );
-    if ( old )
-    {
-        MSG_ReadDeltaPlayerstate( msg, &old->ps, &newSnap.ps );
-    }
-    else
-    {
-        MSG_ReadDeltaPlayerstate( msg, NULL, &newSnap.ps );
-    }
-    
-    // read packet entities
-    ShowNet( msg, "packet entities" );
-    
-    ParsePacketEntities( msg, old, &newSnap );
-    
-    // if not valid, dump the entire thing now that it has
-    // been properly read
-    if ( !newSnap.valid )
-    {
-        return;
-    }
-    
-    // clear the valid flags of any snapshots between the last
-    // received and this one, so if there was a dropped packet
-    // it won't look like something valid to delta from next
-    // time we wrap around in the buffer
-    oldMessageNum = cl.snap.messageNum + 1;
-    
-    if ( newSnap.messageNum - oldMessageNum >= PACKET_BACKUP )
-    {
-        oldMessageNum = newSnap.messageNum - ( PACKET_BACKUP - 1 );
-    }
-    for ( ; oldMessageNum < newSnap.messageNum; oldMessageNum++ )
-    {
-        cl.snapshots[oldMessageNum & PACKET_MASK].valid = false;
-    }
     
-    // copy to the current good spot
-    cl.snap = newSnap;
-    cl.snap.ping = 999;
+    newSnap.ping = 999;
     // calculate ping time
     for ( i = 0; i < PACKET_BACKUP; i++ )
     {
         packetNum = ( clc.netchan.outgoingSequence - 1 - i ) & PACKET_MASK;
-        if ( cl.snap.ps.commandTime >= cl.outPackets[packetNum].p_serverTime )
+        if ( newSnap.ps.commandTime >= cl.outPackets[packetNum].p_serverTime )
         {
-            cl.snap.ping = cls.realtime - cl.outPackets[packetNum].p_realtime;
+            newSnap.ping = cls.realtime - cl.outPackets[packetNum].p_realtime;
             break;
         }
     }
-    // save the frame off in the backup array for later delta comparisons
-    cl.snapshots[cl.snap.messageNum & PACKET_MASK] = cl.snap;
+    
+    // copy to the current good spot and save the frame off
+    idSnapshotParseSystemLocal::StoreSnapshot( &parse, &newSnap );
     
     if ( cl_shownet->integer == 3 )
     {
@@ -698,9 +459,7 @@ idClientParseSystemLocal::ParseGamestate
 */
 void idClientParseSystemLocal::ParseGamestate( msg_t* msg )
 {
-    S32 i, newnum, cmd;
-    UTF8* s;
-    entityState_t* es, nullstate;
+    snapshotParse_t parse;
     
     Con_Close();
     
@@ -709,62 +468,9 @@ void idClientParseSystemLocal::ParseGamestate( msg_t* msg )
     // wipe local client state
     idClientMainSystemLocal::ClearState();
     
-    // a gamestate always marks a server command sequence
-    clc.serverCommandSequence = MSG_ReadLong( msg );
-    
     // parse all the configstrings and baselines
-    cl.gameState.dataCount = 1;	// leave a 0 at the beginning for uninitialized configstrings
-    
-    while ( 1 )
-    {
-        cmd = MSG_ReadByte( msg );
-        
-        if ( cmd == svc_EOF )
-        {
-            break;
-        }
-        
-        if ( cmd == svc_configstring )
-        {
-            S32 len;
-            
-            i = MSG_ReadShort( msg );
-            if ( i < 0 || i >= MAX_CONFIGSTRINGS )
-            {
-                Com_Error( ERR_DROP, "configstring > MAX_CONFIGSTRINGS" );
-            }
-            
-            s = MSG_ReadBigString( msg );
-            len = ( S32 )::strlen( s );
-            
-            if ( len + 1 + cl.gameState.dataCount > MAX_GAMESTATE_CHARS )
-            {
-                Com_Error( ERR_DROP, "MAX_GAMESTATE_CHARS exceeded" );
-            }
-            
-            // append it to the gameState string buffer
-            cl.gameState.stringOffsets[i] = cl.gameState.dataCount;
-            ::memcpy( cl.gameState.stringData + cl.gameState.dataCount, s, len + 1 );
-            cl.gameState.dataCount += len + 1;
-        }
-        else if ( cmd == svc_baseline )
-        {
-            newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
-            
-            if ( newnum < 0 || newnum >= MAX_GENTITIES )
-            {
-                Com_Error( ERR_DROP, "Baseline number out of range: %i", newnum );
-            }
-            
-            ::memset( &nullstate, 0, sizeof( nullstate ) );
-            es = &cl.entityBaselines[newnum];
-            MSG_ReadDeltaEntity( msg, &nullstate, es, newnum );
-        }
-        else
-        {
-            Com_Error( ERR_DROP, "idClientParseSystemLocal::ParseGamestate: bad command byte" );
-        }
-    }
+    SetupParse( &parse );
+    idSnapshotParseSystemLocal::ParseGamestate( &parse, msg );
     
     clc.clientNum = MSG_ReadLong( msg );
     // read the checksum feed
@@ -972,20 +678,18 @@ when it transitions a snapshot
 */
 void idClientParseSystemLocal::ParseCommandString( msg_t* msg )
 {
-    S32 seq, index;
+    S32 index;
     UTF8* s;
-    
-    seq = MSG_ReadLong( msg );
-    s = MSG_ReadString( msg );
+    snapshotParse_t parse;
     
     // see if we have already executed stored it off
-    if ( clc.serverCommandSequence >= seq )
+    SetupParse( &parse );
+    if ( !idSnapshotParseSystemLocal::ParseCommandString( &parse, msg, &s ) )
     {
         return;
     }
-    clc.serverCommandSequence = seq;
     
-    index = seq & ( MAX_RELIABLE_COMMANDS - 1 );
+    index = clc.serverCommandSequence & ( MAX_RELIABLE_COMMANDS - 1 );
     Q_strncpyz( clc.serverCommands[index], s, sizeof( clc.serverCommands[index] ) );
 }
 
@@ -1023,33 +727,7 @@ void idClientParseSystemLocal::ParseServerMessage( msg_t* msg )
     // parse the message
     while ( 1 )
     {
-        if ( msg->readcount > msg->cursize )
-        {
-            Com_Error( ERR_DROP, "idClientParseSystemLocal::ParseServerMessage: read past end of server message" );
-            break;
-        }
-        
-        cmd = MSG_ReadByte( msg );
-        
-        // See if this is an extension command after the EOF, which means we
-        //  got data that a legacy client should ignore.
-        if ( ( cmd == svc_EOF ) && ( MSG_LookaheadByte( msg ) == svc_extension ) )
-        {
-            ShowNet( msg, "EXTENSION" );
-            
-            // throw the svc_extension byte away.
-            MSG_ReadByte( msg );
-            
-            // something legacy clients can't do!
-            cmd = MSG_ReadByte( msg );
-            
-            // sometimes you get a svc_extension at end of stream...dangling
-            //  bits in the huffman decoder giving a bogus value?
-            if ( cmd == -1 )
-            {
-                cmd = svc_EOF;
-            }
-        }
+        cmd = idSnapshotParseSystemLocal::ReadCommand( msg, cl_shownet->integer );
         
         if ( cmd == svc_EOF )
         {
@@ -52,8 +52,8 @@ public:
     static void ParseServerMessage( msg_t* msg );
     static void ShowNet( msg_t* msg, UTF8* s );
     static bool isEntVisible( entityState_t* ent );
-    static void DeltaEntity( msg_t* msg, clSnapshot_t* frame, S32 newnum, entityState_t* old, bool unchanged );
-    static void ParsePacketEntities( msg_t* msg, clSnapshot_t* oldframe, clSnapshot_t* newframe );
+    static void AddEntity( entityState_t* state, clSnapshot_t* frame );
+    static void SetupParse( snapshotParse_t* parse );
     static void ParseSnapshot( msg_t* msg );
     static void SystemInfoChanged( void );
     static void ParseGamestate( msg_t* msg );
@@ -95,7 +95,7 @@ S64 idCVarSystemLocal::generateHashValue( StringEntry fname )
         i++;
     }
     
-    hash &= ( FILE_HASH_SIZE - 1 );
+    hash &= ( CVAR_HASH_SIZE - 1 );
     
     return hash;
 }
@@ -1433,6 +1433,7 @@ updates an interpreted modules' version of a cvar
 void idCVarSystemLocal::Update( vmConvar_t* vmCvar )
 {
     convar_t* cv = NULL;	// bk001129
+    size_t len;
     
     // bk
     assert( vmCvar );
@@ -1457,22 +1458,213 @@ void idCVarSystemLocal::Update( vmConvar_t* vmCvar )
     
     vmCvar->modificationCount = cv->modificationCount;
     
+    len = strlen( cv->string );
+    
     // bk001129 - mismatches.
-    if ( strlen( cv->string ) + 1 > MAX_CVAR_VALUE_STRING )
+    if ( len + 1 > MAX_CVAR_VALUE_STRING )
     {
-        Com_Error( ERR_DROP, "idCVarSystemLocal::Update: src %s length %lu exceeds MAX_CVAR_VALUE_STRING(%lu)", cv->string, ( U64 )strlen( cv->string ), ( U64 )sizeof( vmCvar->string ) );
+        Com_Error( ERR_DROP, "idCVarSystemLocal::Update: src %s length %lu exceeds MAX_CVAR_VALUE_STRING(%lu)", cv->string, ( U64 )len, ( U64 )sizeof( vmCvar->string ) );
     }
-    // bk001212 - Q_strncpyz guarantees zero padding and dest[MAX_CVAR_VALUE_STRING-1]==0
-    // bk001129 - paranoia. Never trust the destination string.
-    // bk001129 - beware, sizeof(UTF8*) is always 4 (for cv->string).
-    //            sizeof(vmCvar->string) always MAX_CVAR_VALUE_STRING
-    //Q_strncpyz( vmCvar->string, cv->string, sizeof( vmCvar->string ) ); // id
-    Q_strncpyz( vmCvar->string, cv->string, MAX_CVAR_VALUE_STRING );
+    
+    // the length is already known, so copy the terminator along with the string
+    // instead of zero padding all MAX_CVAR_VALUE_STRING bytes every change
+    ::memcpy( vmCvar->string, cv->string, len + 1 );
     
     vmCvar->value = cv->value;
     vmCvar->integer = cv->integer;
 }
 
+/*
+=====================
+idCVarSystemLocal::Resolve
+
+returns the cvar a reference points at, looking it up with the precomputed
+hash only until it has been found
+=====================
+*/
+convar_t* idCVarSystemLocal::Resolve( cvarRef_t* ref )
+{
+    convar_t* var;
+    
+    if ( ref->handle >= 0 )
+    {
+        var = cvar_indexes + ref->handle;
+        
+        // cvar_restart clears user created cvars in place
+        if ( var->name )
+        {
+            return var;
+        }
+        
+        ref->handle = -1;
+        ref->modificationCount = -1;
+    }
+    
+    assert( ref->hash == generateHashValue( ref->name ) );
+    
+    for ( var = hashTable[ref->hash]; var; var = var->hashNext )
+    {
+        if ( var->name && !Q_stricmp( ref->name, var->name ) )
+        {
+            ref->handle = ( cvarHandle_t )( var - cvar_indexes );
+            return var;
+        }
+    }
+    
+    return nullptr;
+}
+
+/*
+=====================
+idCVarSystemLocal::RefValue
+=====================
+*/
+F32 idCVarSystemLocal::RefValue( cvarRef_t* ref )
+{
+    convar_t* var = Resolve( ref );
+    
+    if ( !var )
+    {
+        return 0;
+    }
+    
+    return var->value;
+}
+
+/*
+=====================
+idCVarSystemLocal::RefIntegerValue
+=====================
+*/
+S32 idCVarSystemLocal::RefIntegerValue( cvarRef_t* ref )
+{
+    convar_t* var = Resolve( ref );
+    
+    if ( !var )
+    {
+        return 0;
+    }
+    
+    return var->integer;
+}
+
+/*
+=====================
+idCVarSystemLocal::RefString
+=====================
+*/
+UTF8* idCVarSystemLocal::RefString( cvarRef_t* ref )
+{
+    convar_t* var = Resolve( ref );
+    
+    if ( !var )
+    {
+        return "";
+    }
+    
+    return var->string;
+}
+
+/*
+=====================
+idCVarSystemLocal::RefModified
+
+returns true once for every change of the cvar since the last call
+=====================
+*/
+bool idCVarSystemLocal::RefModified( cvarRef_t* ref )
+{
+    convar_t* var = Resolve( ref );
+    
+    if ( !var || var->modificationCount == ref->modificationCount )
+    {
+        return false;
+    }
+    
+    ref->modificationCount = var->modificationCount;
+    
+    return true;
+}
+
+/*
+=====================
+idCVarSystemLocal::Bench_f
+
+Times the cvar read path: lookups by name through FindVar, reads through
+cvarRef_t handles and polling of unchanged vmConvar_t copies, over the
+first cvars in the list
+=====================
+*/
+void idCVarSystemLocal::Bench_f( void )
+{
+    S32 i, j, iterations, numRefs, start, msec[3];
+    F32 sum;
+    convar_t* var;
+    cvarRef_t refs[16];
+    vmConvar_t vmCvars[16];
+    
+    iterations = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : 200000;
+    iterations = ( S32 )Com_Clamp( 1, 10000000, iterations );
+    
+    numRefs = 0;
+    for ( var = cvar_vars; var && numRefs < 16; var = var->next )
+    {
+        refs[numRefs].name = var->name;
+        refs[numRefs].hash = generateHashValue( var->name );
+        refs[numRefs].handle = -1;
+        refs[numRefs].modificationCount = -1;
+        
+        vmCvars[numRefs].handle = ( cvarHandle_t )( var - cvar_indexes );
+        vmCvars[numRefs].modificationCount = -1;
+        cvarSystemLocal.Update( &vmCvars[numRefs] );
+        
+        numRefs++;
+    }
+    
+    if ( !numRefs )
+    {
+        return;
+    }
+    
+    sum = 0;
+    
+    start = idsystem->Milliseconds();
+    for ( i = 0; i < iterations; i++ )
+    {
+        for ( j = 0; j < numRefs; j++ )
+        {
+            sum += cvarSystemLocal.VariableValue( refs[j].name );
+        }
+    }
+    msec[0] = idsystem->Milliseconds() - start;
+    
+    start = idsystem->Milliseconds();
+    for ( i = 0; i < iterations; i++ )
+    {
+        for ( j = 0; j < numRefs; j++ )
+        {
+            sum += cvarSystemLocal.RefValue( &refs[j] );
+        }
+    }
+    msec[1] = idsystem->Milliseconds() - start;
+    
+    start = idsystem->Milliseconds();
+    for ( i = 0; i < iterations; i++ )
+    {
+        for ( j = 0; j < numRefs; j++ )
+        {
+            cvarSystemLocal.Update( &vmCvars[j] );
+            sum += vmCvars[j].value;
+        }
+    }
+    msec[2] = idsystem->Milliseconds() - start;
+    
+    Com_Printf( "%i reads of %i cvars (checksum %g)\n", iterations * numRefs, numRefs, sum );
+    Com_Printf( "by name:    %5i msec, %6.1f ns/read\n", msec[0], msec[0] * 1e6 / ( ( F64 )iterations * numRefs ) );
+    Com_Printf( "by handle:  %5i msec, %6.1f ns/read\n", msec[1], msec[1] * 1e6 / ( ( F64 )iterations * numRefs ) );
+    Com_Printf( "vm update:  %5i msec, %6.1f ns/read\n", msec[2], msec[2] * 1e6 / ( ( F64 )iterations * numRefs ) );
+}
+
 /*
 ==================
 idCVarSystemLocal::CompleteCvarName
@@ -1544,6 +1736,7 @@ void idCVarSystemLocal::Init( void )
     
     cmdSystem->AddCommand( "cvarlist", &cvarSystemLocal.List_f, "description" );
     cmdSystem->AddCommand( "cvar_restart", &cvarSystemLocal.Restart_f, "description" );
+    profilerSystem->AddBench( "cvar", &idCVarSystemLocal::Bench_f, "Times cvar reads by name against cvar handles, args: [iterations]" );
 }
 
 /*
@@ -1563,6 +1756,7 @@ void idCVarSystemLocal::Shutdown( void )
     cmdSystem->RemoveCommand( "seta" );
     cmdSystem->RemoveCommand( "reset" );
     cmdSystem->RemoveCommand( "cvarlist" );
+    profilerSystem->RemoveBench( "cvar" );
     
     threadsSystem->Mutex_Destroy( &cvar_mutex );
 }
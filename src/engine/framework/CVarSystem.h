@@ -46,8 +46,7 @@ static convar_t* cvar_cheats;
 static convar_t cvar_indexes[MAX_CVARS];
 static S32 cvar_numIndexes;
 
-#define FILE_HASH_SIZE 1024
-static convar_t* hashTable[FILE_HASH_SIZE];
+static convar_t* hashTable[CVAR_HASH_SIZE];
 
 static qmutex_t* cvar_mutex = nullptr;
 
@@ -87,6 +86,11 @@ public:
     virtual void CheckRange( convar_t* var, F32 min, F32 max, bool integral );
     virtual void Register( vmConvar_t* vmCvar, StringEntry varName, StringEntry defaultValue, S32 flags, StringEntry description );
     virtual void Update( vmConvar_t* vmCvar );
+    virtual convar_t* Resolve( cvarRef_t* ref );
+    virtual F32 RefValue( cvarRef_t* ref );
+    virtual S32 RefIntegerValue( cvarRef_t* ref );
+    virtual UTF8* RefString( cvarRef_t* ref );
+    virtual bool RefModified( cvarRef_t* ref );
     virtual void WriteVariables( fileHandle_t f );
     virtual void Init( void );
     virtual void Shutdown( void );
@@ -103,6 +107,7 @@ public:
     static void Reset_f( void );
     static void List_f( void );
     static void Restart_f( void );
+    static void Bench_f( void );
     static void CompleteCvarName( UTF8* args, S32 argNum );
     static void FreeString( UTF8* string );
 };
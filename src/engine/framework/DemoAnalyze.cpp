@@ -0,0 +1,439 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   DemoAnalyze.cpp
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: headless batch analysis of client demos
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef UPDATE_SERVER
+#include <null/null_autoprecompiled.h>
+#elif DEDICATED
+#include <null/null_serverprecompiled.h>
+#else
+#include <framework/precompiled.h>
+#endif
+
+idDemoAnalyzeSystemLocal demoAnalyzeSystemLocal;
+
+/*
+===============
+idDemoAnalyzeSystemLocal::idDemoAnalyzeSystemLocal
+===============
+*/
+idDemoAnalyzeSystemLocal::idDemoAnalyzeSystemLocal( void )
+{
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::~idDemoAnalyzeSystemLocal
+===============
+*/
+idDemoAnalyzeSystemLocal::~idDemoAnalyzeSystemLocal( void )
+{
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::SortNames
+===============
+*/
+S32 idDemoAnalyzeSystemLocal::SortNames( const void* a, const void* b )
+{
+    return Q_stricmp( *( UTF8** )a, *( UTF8** )b );
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::ListDemos
+
+Finds the demos a name or a wildcard pattern refers to, sorted so every
+process of a sliced batch sees them in the same order
+===============
+*/
+S32 idDemoAnalyzeSystemLocal::ListDemos( StringEntry pattern, UTF8*** names )
+{
+    S32 i, j, protocol, numFiles, count = 0;
+    UTF8 extension[32], filter[MAX_QPATH], name[MAX_QPATH];
+    UTF8** list, **files;
+    
+    list = ( UTF8** )::malloc( sizeof( UTF8* ) );
+    *names = list;
+    
+    if ( !list )
+    {
+        return 0;
+    }
+    
+    // a single demo, named like the demo command takes it
+    if ( !::strchr( pattern, '*' ) && !::strchr( pattern, '?' ) )
+    {
+        for ( protocol = com_protocol->integer; protocol >= com_protocol->integer - 1; protocol-- )
+        {
+            Q_snprintf( extension, sizeof( extension ), ".dm_%d", protocol );
+            
+            if ( ::strlen( pattern ) > ::strlen( extension ) && !Q_stricmp( pattern + ::strlen( pattern ) - ::strlen( extension ), extension ) )
+            {
+                Q_snprintf( name, sizeof( name ), "demos/%s", pattern );
+            }
+            else
+            {
+                Q_snprintf( name, sizeof( name ), "demos/%s%s", pattern, extension );
+            }
+            
+            if ( fileSystem->ReadFile( name, nullptr ) > 0 )
+            {
+                list[count] = ( UTF8* )::malloc( ::strlen( name ) + 1 );
+                ::strcpy( list[count++], name );
+                break;
+            }
+        }
+        
+        return count;
+    }
+    
+    Q_strncpyz( filter, pattern, sizeof( filter ) );
+    
+    for ( protocol = com_protocol->integer; protocol >= com_protocol->integer - 1; protocol-- )
+    {
+        Q_snprintf( extension, sizeof( extension ), ".dm_%d", protocol );
+        
+        files = fileSystem->ListFiles( "demos", extension, &numFiles );
+        if ( !files )
+        {
+            continue;
+        }
+        
+        list = ( UTF8** )::realloc( list, ( count + numFiles + 1 ) * sizeof( UTF8* ) );
+        if ( !list )
+        {
+            fileSystem->FreeFileList( files );
+            break;
+        }
+        *names = list;
+        
+        for ( j = 0; j < numFiles; j++ )
+        {
+            if ( !Com_Filter( filter, files[j], false ) )
+            {
+                continue;
+            }
+            
+            Q_snprintf( name, sizeof( name ), "demos/%s", files[j] );
+            list[count] = ( UTF8* )::malloc( ::strlen( name ) + 1 );
+            ::strcpy( list[count++], name );
+        }
+        
+        fileSystem->FreeFileList( files );
+    }
+    
+    qsort( *names, count, sizeof( UTF8* ), SortNames );
+    
+    // the same demo may be listed for both protocols
+    for ( i = 1, j = 1; i < count; i++ )
+    {
+        if ( !Q_stricmp( ( *names )[i], ( *names )[j - 1] ) )
+        {
+            ::free( ( *names )[i] );
+            continue;
+        }
+        
+        ( *names )[j++] = ( *names )[i];
+    }
+    
+    return count ? j : 0;
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::CountSnapshot
+
+Copies the snapshot just parsed out the way cgame gets it and counts it
+===============
+*/
+void idDemoAnalyzeSystemLocal::CountSnapshot( demoAnalyze_t* demo )
+{
+    snapshot_t* snapshot = &demo->snapshot;
+    demoAnalyzeStats_t* stats = &demo->stats;
+    S32 i, clients;
+    
+    if ( !idSnapshotParseSystemLocal::GetSnapshot( &demo->parse, demo->snap.messageNum, snapshot ) )
+    {
+        return;
+    }
+    
+    for ( i = 0, clients = 0; i < snapshot->numEntities; i++ )
+    {
+        if ( snapshot->entities[i].number < MAX_CLIENTS )
+        {
+            clients++;
+        }
+    }
+    
+    if ( !stats->snapshots )
+    {
+        stats->firstServerTime = snapshot->serverTime;
+    }
+    
+    stats->snapshots++;
+    stats->lastServerTime = snapshot->serverTime;
+    stats->entities += demo->snap.numEntities;
+    stats->maxEntities = Q_max( stats->maxEntities, demo->snap.numEntities );
+    stats->maxClients = Q_max( stats->maxClients, clients );
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::ParseMessage
+
+Parses a server message like the client's ParseServerMessage
+===============
+*/
+void idDemoAnalyzeSystemLocal::ParseMessage( demoAnalyze_t* demo, msg_t* msg )
+{
+    clSnapshot_t newSnap;
+    S32 cmd;
+    UTF8* s;
+    
+    demo->parse.serverMessageSequence = demo->serverMessageSequence;
+    
+    MSG_Bitstream( msg );
+    
+    // reliable sequence acknowledge
+    MSG_ReadLong( msg );
+    
+    while ( 1 )
+    {
+        cmd = idSnapshotParseSystemLocal::ReadCommand( msg, demo->parse.showNet );
+        
+        if ( cmd == svc_EOF )
+        {
+            break;
+        }
+        
+        switch ( cmd )
+        {
+            case svc_nop:
+                break;
+            case svc_serverCommand:
+                if ( idSnapshotParseSystemLocal::ParseCommandString( &demo->parse, msg, &s ) )
+                {
+                    demo->stats.serverCommands++;
+                }
+                break;
+            case svc_gamestate:
+                // a gamestate wipes the client state
+                ::memset( &demo->gameState, 0, sizeof( demo->gameState ) );
+                ::memset( demo->baselines, 0, sizeof( demo->baselines ) );
+                ::memset( &demo->snap, 0, sizeof( demo->snap ) );
+                ::memset( demo->snapshots, 0, sizeof( demo->snapshots ) );
+                demo->parseEntitiesNum = 0;
+                
+                idSnapshotParseSystemLocal::ParseGamestate( &demo->parse, msg );
+                
+                // client number and checksum feed
+                MSG_ReadLong( msg );
+                MSG_ReadLong( msg );
+                break;
+            case svc_snapshot:
+                if ( !idSnapshotParseSystemLocal::ParseSnapshot( &demo->parse, msg, &newSnap ) )
+                {
+                    demo->stats.droppedSnapshots++;
+                    break;
+                }
+                
+                idSnapshotParseSystemLocal::StoreSnapshot( &demo->parse, &newSnap );
+                CountSnapshot( demo );
+                break;
+            default:
+                Com_Error( ERR_DROP, "idDemoAnalyzeSystemLocal::ParseMessage: Illegible server message %d\n", cmd );
+                break;
+        }
+    }
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::AnalyzeDemo
+
+Reads a whole demo like ReadDemoMessage does during playback. An error
+the reader raises ends this demo only.
+===============
+*/
+bool idDemoAnalyzeSystemLocal::AnalyzeDemo( demoAnalyze_t* demo, StringEntry name )
+{
+    U8 bufData[MAX_MSGLEN];
+    jmp_buf recover;
+    msg_t buf;
+    
+    ::memset( demo, 0, sizeof( *demo ) );
+    
+    fileSystem->FOpenFileRead( name, &demo->file, true );
+    if ( !demo->file )
+    {
+        Com_Printf( "%s: couldn't open\n", name );
+        return false;
+    }
+    
+    demo->parse.gameState = &demo->gameState;
+    demo->parse.baselines = demo->baselines;
+    demo->parse.snap = &demo->snap;
+    demo->parse.snapshots = demo->snapshots;
+    demo->parse.parseEntities = demo->parseEntities;
+    demo->parse.maxParseEntities = DEMOANALYZE_PARSE_ENTITIES;
+    demo->parse.parseEntitiesNum = &demo->parseEntitiesNum;
+    demo->parse.serverCommandSequence = &demo->serverCommandSequence;
+    
+    if ( setjmp( recover ) )
+    {
+        com_errorRecover = nullptr;
+        
+        Com_Printf( "%s: %s after %i messages\n", name, com_errorMessage, demo->stats.messages );
+        fileSystem->FCloseFile( demo->file );
+        return false;
+    }
+    
+    com_errorRecover = &recover;
+    
+    while ( 1 )
+    {
+        MSG_Init( &buf, bufData, sizeof( bufData ) );
+        
+        if ( !idSnapshotParseSystemLocal::ReadDemoMessage( demo->file, &buf, &demo->serverMessageSequence ) )
+        {
+            break;
+        }
+        
+        demo->stats.messages++;
+        demo->stats.bytes += buf.cursize;
+        
+        ParseMessage( demo, &buf );
+    }
+    
+    com_errorRecover = nullptr;
+    
+    fileSystem->FCloseFile( demo->file );
+    
+    return true;
+}
+
+/*
+===============
+idDemoAnalyzeSystemLocal::Analyze_f
+
+demoAnalyze <demo|pattern> [<slice> <slices>]
+===============
+*/
+void idDemoAnalyzeSystemLocal::Analyze_f( void )
+{
+    S32 i, count, slice = 0, slices = 1, analyzed = 0, failed = 0, seconds;
+    S64 snapshots = 0, messages = 0, demoMsec = 0;
+    demoAnalyzeStats_t* stats;
+    demoAnalyze_t* demo;
+    U64 start;
+    F64 elapsed;
+    UTF8** names;
+    StringEntry info;
+    
+    if ( cmdSystem->Argc() != 2 && cmdSystem->Argc() != 4 )
+    {
+        Com_Printf( "usage: demoAnalyze <demo|pattern> [<slice> <slices>]\n" );
+        return;
+    }
+    
+    if ( cmdSystem->Argc() == 4 )
+    {
+        slice = ::atoi( cmdSystem->Argv( 2 ) );
+        slices = ::atoi( cmdSystem->Argv( 3 ) );
+        
+        if ( slices < 1 || slice < 0 || slice >= slices )
+        {
+            Com_Printf( "demoAnalyze: slice must be from 0 to slices - 1\n" );
+            return;
+        }
+    }
+    
+    count = ListDemos( cmdSystem->Argv( 1 ), &names );
+    demo = ( demoAnalyze_t* )::malloc( sizeof( *demo ) );
+    
+    if ( !count || !demo )
+    {
+        Com_Printf( count ? "demoAnalyze: out of memory\n" : "No demos match %s\n", cmdSystem->Argv( 1 ) );
+        
+        for ( i = 0; i < count; i++ )
+        {
+            ::free( names[i] );
+        }
+        ::free( names );
+        ::free( demo );
+        return;
+    }
+    
+    stats = &demo->stats;
+    start = idsystem->Nanoseconds();
+    
+    for ( i = 0; i < count; i++ )
+    {
+        if ( i % slices != slice )
+        {
+            continue;
+        }
+        
+        if ( !AnalyzeDemo( demo, names[i] ) )
+        {
+            failed++;
+            continue;
+        }
+        
+        analyzed++;
+        snapshots += stats->snapshots;
+        messages += stats->messages;
+        demoMsec += stats->lastServerTime - stats->firstServerTime;
+        
+        seconds = ( stats->lastServerTime - stats->firstServerTime ) / 1000;
+        info = demo->gameState.stringOffsets[CS_SERVERINFO] ? demo->gameState.stringData + demo->gameState.stringOffsets[CS_SERVERINFO] : "";
+        
+        Com_Printf( "%s: %s, %i:%02i, %i snapshots (%i dropped), %i server commands, %i entities and %i clients at most\n",
+                    names[i], Info_ValueForKey( info, "mapname" ), seconds / 60, seconds % 60, stats->snapshots,
+                    stats->droppedSnapshots, stats->serverCommands, stats->maxEntities, stats->maxClients );
+    }
+    
+    elapsed = ( idsystem->Nanoseconds() - start ) / 1e9;
+    
+    for ( i = 0; i < count; i++ )
+    {
+        ::free( names[i] );
+    }
+    ::free( names );
+    ::free( demo );
+    
+    if ( elapsed <= 0 )
+    {
+        elapsed = 0.001;
+    }
+    
+    seconds = ( S32 )( demoMsec / 1000 );
+    
+    Com_Printf( "%i demos analyzed, %i failed, %i:%02i:%02i of demo time in %.1f seconds\n", analyzed, failed,
+                seconds / 3600, ( seconds / 60 ) % 60, seconds % 60, elapsed );
+    Com_Printf( "%.0f demos/hour, %.0f snapshots/sec, %.0f messages/sec, %.0fx realtime\n", ( analyzed + failed ) * 3600.0 / elapsed,
+                snapshots / elapsed, messages / elapsed, demoMsec / 1000.0 / elapsed );
+}
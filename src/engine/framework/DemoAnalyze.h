@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   DemoAnalyze.h
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: headless batch analysis of client demos
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DEMOANALYZE_H__
+#define __DEMOANALYZE_H__
+
+/*
+==============================================================================
+DEMO ANALYSIS
+
+demoAnalyze reads client demos through the same parse code as demo
+playback, gamestate, server commands and delta compressed snapshots, into
+its own state instead of cl and clc, so it runs in the dedicated server
+without cgame, renderer or sound. Every valid snapshot is copied out with
+GetSnapshot the way cgame gets it and counted. A demo the message reader
+drops with an error is counted as failed and the batch goes on. The reader
+keeps global state, so demos are analyzed one after the other on the main
+thread; several processes can split a batch between them with the slice
+arguments.
+==============================================================================
+*/
+
+#define DEMOANALYZE_PARSE_ENTITIES ( MAX_GENTITIES * 4 )	// must be a power of two
+
+typedef struct
+{
+    S32 messages;
+    S32 snapshots;
+    S32 droppedSnapshots;		// delta from a frame we don't have
+    S32 serverCommands;
+    S32 firstServerTime;
+    S32 lastServerTime;
+    S32 maxEntities;
+    S32 maxClients;				// clients in one snapshot
+    S64 entities;
+    S64 bytes;
+} demoAnalyzeStats_t;
+
+typedef struct
+{
+    fileHandle_t file;
+    
+    gameState_t gameState;
+    entityState_t baselines[MAX_GENTITIES];
+    
+    S32 serverMessageSequence;
+    S32 serverCommandSequence;
+    
+    clSnapshot_t snap;
+    clSnapshot_t snapshots[PACKET_BACKUP];
+    
+    S32 parseEntitiesNum;
+    entityState_t parseEntities[DEMOANALYZE_PARSE_ENTITIES];
+    
+    snapshotParse_t parse;
+    
+    // the last snapshot as cgame would get it
+    snapshot_t snapshot;
+    
+    demoAnalyzeStats_t stats;
+} demoAnalyze_t;
+
+//
+// idDemoAnalyzeSystemLocal
+//
+class idDemoAnalyzeSystemLocal
+{
+public:
+    idDemoAnalyzeSystemLocal( void );
+    ~idDemoAnalyzeSystemLocal( void );
+    
+    static void Analyze_f( void );
+    static S32 ListDemos( StringEntry pattern, UTF8*** names );
+    static S32 SortNames( const void* a, const void* b );
+    static bool AnalyzeDemo( demoAnalyze_t* demo, StringEntry name );
+    static void ParseMessage( demoAnalyze_t* demo, msg_t* msg );
+    static void CountSnapshot( demoAnalyze_t* demo );
+};
+
+extern idDemoAnalyzeSystemLocal demoAnalyzeSystemLocal;
+
+#endif //!__DEMOANALYZE_H__
@@ -230,7 +230,7 @@ static convar_t* fs_missing;
 static convar_t* fs_restrict;
 static searchpath_t* fs_searchpaths;
 
-static S32 fs_readCount; // total bytes read
+static SDL_atomic_t fs_readCount; // total bytes read, streams read from a worker
 static S32 fs_loadCount; // total files read
 static S32 fs_loadStack; // total files in memory
 static S32 fs_packFiles; // total number of files in packs
@@ -868,6 +868,11 @@ void idFileSystemLocal::FCloseFile( fileHandle_t f )
     {
         unzCloseCurrentFile( fsh[f].handleFiles.file.z );
         
+        if ( fsh[f].zipWindow )
+        {
+            memorySystem->Free( fsh[f].zipWindow );
+        }
+        
         if ( fsh[f].handleFiles.unique )
         {
             unzClose( fsh[f].handleFiles.file.z );
@@ -1840,7 +1845,7 @@ S32 idFileSystemLocal::Read( void* buffer, S32 len, fileHandle_t f )
     }
     
     buf = ( U8* )buffer;
-    fs_readCount += len;
+    SDL_AtomicAdd( &fs_readCount, len );
     
     if ( fsh[f].zipFile == false )
     {
@@ -1878,12 +1883,71 @@ S32 idFileSystemLocal::Read( void* buffer, S32 len, fileHandle_t f )
         }
         return len;
     }
+    else if ( fsh[f].zipWindow )
+    {
+        return ReadZipWindow( f, buffer, len );
+    }
     else
     {
         return unzReadCurrentFile( fsh[f].handleFiles.file.z, buffer, len );
     }
 }
 
+/*
+================
+idFileSystemLocal::ReadZipWindow
+
+Reads a pk3 entry that has been seeked in. What a backwards seek left in the
+window is handed out first, then the entry is inflated further and the tail
+of what comes out is kept in the window.
+================
+*/
+S32 idFileSystemLocal::ReadZipWindow( fileHandle_t f, void* buffer, S32 len )
+{
+    fileHandleData_t* fh = &fsh[f];
+    U8* buf = ( U8* )buffer;
+    S32 copied, offset, chunk, read, keep;
+    
+    for ( copied = 0; fh->zipWindowReplay > 0 && copied < len; copied += chunk )
+    {
+        offset = ( S32 )( ( fh->zipWindowEnd - fh->zipWindowReplay ) & ( PK3_SEEK_WINDOW_SIZE - 1 ) );
+        chunk = Q_min( fh->zipWindowReplay, len - copied );
+        chunk = Q_min( chunk, PK3_SEEK_WINDOW_SIZE - offset );
+        
+        ::memcpy( buf + copied, fh->zipWindow + offset, chunk );
+        fh->zipWindowReplay -= chunk;
+    }
+    
+    if ( copied == len )
+    {
+        return copied;
+    }
+    
+    read = unzReadCurrentFile( fh->handleFiles.file.z, buf + copied, len - copied );
+    if ( read <= 0 )
+    {
+        return copied ? copied : read;
+    }
+    
+    // only the last window's worth of a long read is kept
+    keep = Q_min( read, PK3_SEEK_WINDOW_SIZE );
+    fh->zipWindowEnd += read - keep;
+    buf += copied + read - keep;
+    
+    for ( ; keep > 0; keep -= chunk, buf += chunk )
+    {
+        offset = ( S32 )( fh->zipWindowEnd & ( PK3_SEEK_WINDOW_SIZE - 1 ) );
+        chunk = Q_min( keep, PK3_SEEK_WINDOW_SIZE - offset );
+        
+        ::memcpy( fh->zipWindow + offset, buf, chunk );
+        fh->zipWindowEnd += chunk;
+    }
+    
+    fh->zipWindowFilled = Q_min( fh->zipWindowFilled + read, PK3_SEEK_WINDOW_SIZE );
+    
+    return copied + read;
+}
+
 /*
 =================
 idFileSystemLocal::Write
@@ -1989,42 +2053,79 @@ S32 idFileSystemLocal::Seek( fileHandle_t f, S64 offset, S32 origin )
     
     if ( fsh[f].zipFile == true )
     {
-        //FIXME: this is incomplete and really, really
-        //crappy (but better than what was here before)
+        // deflated data can only be read forwards. Once an entry has been
+        // seeked in, the last bytes inflated are kept, so seeking back into
+        // them is a copy; further back inflates again from the start of the
+        // entry, and forwards just skips
         U8 buffer[PK3_SEEK_BUFFER_SIZE];
-        S32 remainder = offset;
+        unz_file_info info;
+        S64 position, target, remainder;
+        S32 chunk;
         
-        if ( offset < 0 || origin == FS_SEEK_END )
+        if ( !fsh[f].zipWindow )
         {
-            Com_Error( ERR_FATAL, "Negative offsets and FS_SEEK_END not implemented "
-                       "for idFileSystemLocal::Seek on pk3 file contents\n" );
-            return -1;
+            fsh[f].zipWindow = ( U8* )memorySystem->Malloc( PK3_SEEK_WINDOW_SIZE );
+            fsh[f].zipWindowEnd = unztell( fsh[f].handleFiles.file.z );
+            fsh[f].zipWindowFilled = 0;
+            fsh[f].zipWindowReplay = 0;
         }
         
+        position = fsh[f].zipWindowEnd - fsh[f].zipWindowReplay;
+        
         switch ( origin )
         {
             case FS_SEEK_SET:
-                unzSetOffset( fsh[f].handleFiles.file.z, fsh[f].zipFilePos );
-                unzOpenCurrentFile( fsh[f].handleFiles.file.z );
-                //fallthrough
-                
+                target = offset;
+                break;
+            
             case FS_SEEK_CUR:
-                while ( remainder > PK3_SEEK_BUFFER_SIZE )
-                {
-                    Read( buffer, PK3_SEEK_BUFFER_SIZE, f );
-                    remainder -= PK3_SEEK_BUFFER_SIZE;
-                }
-                
-                Read( buffer, remainder, f );
-                
-                return offset;
+                target = position + offset;
                 break;
-                
+            
+            case FS_SEEK_END:
+                unzGetCurrentFileInfo( fsh[f].handleFiles.file.z, &info, nullptr, 0, nullptr, 0, nullptr, 0 );
+                target = ( S64 )info.uncompressed_size + offset;
+                break;
+            
             default:
                 Com_Error( ERR_FATAL, "Bad origin in idFileSystemLocal::Seek\n" );
                 return -1;
-                break;
         }
+        
+        if ( target < 0 )
+        {
+            return -1;
+        }
+        
+        if ( target <= fsh[f].zipWindowEnd && target >= fsh[f].zipWindowEnd - fsh[f].zipWindowFilled )
+        {
+            fsh[f].zipWindowReplay = ( S32 )( fsh[f].zipWindowEnd - target );
+            return 0;
+        }
+        
+        if ( target < fsh[f].zipWindowEnd )
+        {
+            unzSetOffset( fsh[f].handleFiles.file.z, fsh[f].zipFilePos );
+            unzOpenCurrentFile( fsh[f].handleFiles.file.z );
+            fsh[f].zipWindowEnd = 0;
+            fsh[f].zipWindowFilled = 0;
+        }
+        
+        fsh[f].zipWindowReplay = 0;
+        position = fsh[f].zipWindowEnd;
+        
+        for ( remainder = target - position; remainder > 0; remainder -= chunk )
+        {
+            chunk = ( S32 )( remainder < PK3_SEEK_BUFFER_SIZE ? remainder : PK3_SEEK_BUFFER_SIZE );
+            
+            if ( Read( buffer, chunk, f ) != chunk )
+            {
+                // past the end of the file
+                return -1;
+            }
+        }
+        
+        return 0;
     }
     else
     {
@@ -4693,7 +4794,8 @@ S32 idFileSystemLocal::FTell( fileHandle_t f )
     S32 pos;
     if ( fsh[f].zipFile == true )
     {
-        pos = unztell( fsh[f].handleFiles.file.z );
+        // less what a backwards seek has left to read again from the window
+        pos = unztell( fsh[f].handleFiles.file.z ) - fsh[f].zipWindowReplay;
     }
     else
     {
@@ -90,6 +90,10 @@ typedef struct
     S32 zipFilePos;
     bool zipFile;
     bool streamed;
+    U8* zipWindow;			// the last bytes inflated, seeking back into them needs no inflate
+    S64 zipWindowEnd;		// bytes inflated since the entry was opened
+    S32 zipWindowFilled;
+    S32 zipWindowReplay;	// bytes of the window a backwards seek has to hand out again
     UTF8 name[MAX_ZPATH];
 } fileHandleData_t;
 
@@ -139,6 +143,9 @@ static S32 fs_filter_flag = 0;
 
 #define PK3_SEEK_BUFFER_SIZE 65536
 
+// must be a power of two
+#define PK3_SEEK_WINDOW_SIZE ( 256 * 1024 )
+
 typedef struct
 {
     UTF8 pakname[MAX_QPATH];
@@ -251,6 +258,7 @@ public:
     static void ReorderPurePaks( void );
     static void Startup( StringEntry gameName );
     static bool FileInPathExists( StringEntry testpath );
+    static S32 ReadZipWindow( fileHandle_t f, void* buffer, S32 len );
 };
 
 extern idFileSystemLocal fileSystemLocal;
@@ -65,6 +65,15 @@ idMemorySystemLocal::~idMemorySystemLocal( void )
 
 qmutex_t* zone_mutex = nullptr;
 
+static memsizeclass_t sizeClasses[SLAB_NUM_CLASSES];
+static thread_local memslabcache_t slabCache;
+static SDL_atomic_t s_slabsDisabled;	// ZoneBench_f compares against the plain zone
+
+static memarena_t* frameArenas;	// every thread arena, for meminfo
+static thread_local memthreadarena_t frameArena;
+static SDL_atomic_t s_frameCount;
+static SDL_atomic_t s_frameArenaMegs;
+
 /*
 ========================
 idMemorySystemLocal::ClearZone
@@ -107,7 +116,7 @@ void idMemorySystemLocal::Free( void* ptr )
     }
     
     block = ( memblock_t* )( ( U8* ) ptr - sizeof( memblock_t ) );
-    if ( block->id != ZONEID )
+    if ( block->id != ZONEID && block->id != SLABID )
     {
         Com_Error( ERR_FATAL, "idMemorySystemLocal::Free: freed a pointer without ZONEID" );
     }
@@ -116,14 +125,20 @@ void idMemorySystemLocal::Free( void* ptr )
         Com_Error( ERR_FATAL, "idMemorySystemLocal::Free: freed a freed pointer" );
     }
     
-    threadsSystem->Mutex_Lock( zone_mutex );
-    
     // if static memory
     if ( block->tag == TAG_STATIC )
     {
         return;
     }
     
+    if ( block->id == SLABID )
+    {
+        SlabFree( block );
+        return;
+    }
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
     // check the memory trash tester
     if ( *( S32* )( ( U8* ) block + block->size - 4 ) != ZONEID )
     {
@@ -189,6 +204,12 @@ void idMemorySystemLocal::FreeTags( memtag_t tag )
     S32 count;
     memzone_t* zone;
     
+    // TAG_SMALL never comes from the size classes
+    if ( mainzone && tag != TAG_SMALL )
+    {
+        SlabFreeTags( tag );
+    }
+    
     if ( tag == TAG_SMALL )
     {
         zone = smallzone;
@@ -223,17 +244,21 @@ idMemorySystemLocal::TagMalloc
 */
 void* idMemorySystemLocal::TagMalloc( size_t size, memtag_t tag )
 {
-    S32 extra;
-    memblock_t* start, *rover, *_new, *base;
+    void* buf;
     memzone_t* zone;
     
-    threadsSystem->Mutex_Lock( zone_mutex );
-    
     if ( !tag )
     {
         Com_Error( ERR_FATAL, "idMemorySystemLocal::TagMalloc: tried to use a 0 tag" );
     }
     
+    // small main zone requests are served by the size classes once the
+    // main zone is up, the small zone keeps its own blocks
+    if ( tag != TAG_SMALL && mainzone && size <= SLAB_MAX_SIZE && !SDL_AtomicGet( &s_slabsDisabled ) )
+    {
+        return SlabMalloc( size, tag );
+    }
+    
     if ( tag == TAG_SMALL )
     {
         zone = smallzone;
@@ -243,6 +268,27 @@ void* idMemorySystemLocal::TagMalloc( size_t size, memtag_t tag )
         zone = mainzone;
     }
     
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    buf = ZoneMalloc( zone, size, tag );
+    
+    threadsSystem->Mutex_Unlock( zone_mutex );
+    
+    return buf;
+}
+
+/*
+================
+idMemorySystemLocal::ZoneMalloc
+
+First fit allocation from the zone block list, zone_mutex must be held
+================
+*/
+void* idMemorySystemLocal::ZoneMalloc( memzone_t* zone, size_t size, memtag_t tag )
+{
+    S32 extra;
+    memblock_t* start, *rover, *_new, *base;
+    
     // scan through the block list looking for the first free block
     // of sufficient size
     // account for size of block header
@@ -262,8 +308,8 @@ void* idMemorySystemLocal::TagMalloc( size_t size, memtag_t tag )
         if ( rover == start )
         {
             // scaned all the way around the list
-            Com_Error( ERR_FATAL, "idMemorySystemLocal::Malloc: failed on allocation of %i bytes from the %s zone",
-                       size, zone == smallzone ? "small" : "main" );
+            Com_Error( ERR_FATAL, "idMemorySystemLocal::Malloc: failed on allocation of %lu bytes from the %s zone",
+                       ( U64 )size, zone == smallzone ? "small" : "main" );
             return NULL;
         }
         
@@ -307,9 +353,273 @@ void* idMemorySystemLocal::TagMalloc( size_t size, memtag_t tag )
     // marker for memory trash testing
     *( S32* )( ( U8* ) base + base->size - 4 ) = ZONEID;
     
+    return ( void* )( ( U8* ) base + sizeof( memblock_t ) );
+}
+
+/*
+================
+idMemorySystemLocal::InitSizeClasses
+================
+*/
+void idMemorySystemLocal::InitSizeClasses( void )
+{
+    S32 i;
+    static const S32 sizes[SLAB_NUM_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, SLAB_MAX_SIZE };
+    
+    ::memset( sizeClasses, 0, sizeof( sizeClasses ) );
+    
+    for ( i = 0; i < SLAB_NUM_CLASSES; i++ )
+    {
+        sizeClasses[i].size = sizes[i];
+        
+        // header, space for memory trash tester, aligned like the zone
+        sizeClasses[i].stride = PAD( sizeof( memblock_t ) + sizes[i] + 4, sizeof( intptr_t ) );
+    }
+}
+
+/*
+================
+idMemorySystemLocal::AllocSlab
+
+Carves a new slab of slots from the main zone and puts them on the
+shared free list of the class, zone_mutex must be held
+================
+*/
+memslab_t* idMemorySystemLocal::AllocSlab( S32 sizeClass )
+{
+    S32 i;
+    memslab_t* slab;
+    memblock_t* block;
+    memsizeclass_t* sc = &sizeClasses[sizeClass];
+    
+    slab = ( memslab_t* )ZoneMalloc( mainzone, SLAB_SIZE, TAG_SLAB );
+    slab->sizeClass = sizeClass;
+    slab->slots = ( U8* )( slab + 1 );
+    slab->numSlots = ( SLAB_SIZE - sizeof( memslab_t ) ) / sc->stride;
+    
+    // push in reverse so the lowest addresses are handed out first
+    for ( i = slab->numSlots - 1; i >= 0; i-- )
+    {
+        block = ( memblock_t* )( slab->slots + i * sc->stride );
+        block->size = sc->stride;
+        block->tag = 0;
+        block->id = SLABID;
+        block->prev = NULL;
+        block->next = sc->freeList;
+        sc->freeList = block;
+        
+        // marker for memory trash testing
+        *( S32* )( ( U8* ) block + block->size - 4 ) = ZONEID;
+    }
+    
+    sc->numFree += slab->numSlots;
+    
+    slab->next = sc->slabs;
+    sc->slabs = slab;
+    sc->numSlabs++;
+    
+    return slab;
+}
+
+/*
+================
+idMemorySystemLocal::SlabMalloc
+================
+*/
+void* idMemorySystemLocal::SlabMalloc( size_t size, memtag_t tag )
+{
+    S32 i, sizeClass;
+    memblock_t* block;
+    memsizeclass_t* sc;
+    
+    for ( sizeClass = 0; sizeClasses[sizeClass].size < ( S32 )size; sizeClass++ )
+    {
+    }
+    
+    sc = &sizeClasses[sizeClass];
+    
+    if ( !slabCache.freeList[sizeClass] )
+    {
+        // refill half of the thread cache from the shared list
+        threadsSystem->Mutex_Lock( zone_mutex );
+        
+        for ( i = 0; i < SLAB_CACHE_SIZE / 2; i++ )
+        {
+            if ( !sc->freeList )
+            {
+                AllocSlab( sizeClass );
+            }
+            
+            block = sc->freeList;
+            sc->freeList = block->next;
+            sc->numFree--;
+            
+            block->next = slabCache.freeList[sizeClass];
+            slabCache.freeList[sizeClass] = block;
+            slabCache.numFree[sizeClass]++;
+        }
+        
+        threadsSystem->Mutex_Unlock( zone_mutex );
+    }
+    
+    block = slabCache.freeList[sizeClass];
+    slabCache.freeList[sizeClass] = block->next;
+    slabCache.numFree[sizeClass]--;
+    
+    block->next = NULL;
+    block->tag = tag;
+    
+    return ( void* )( block + 1 );
+}
+
+/*
+================
+idMemorySystemLocal::SlabFree
+================
+*/
+void idMemorySystemLocal::SlabFree( memblock_t* block )
+{
+    S32 i, sizeClass;
+    memblock_t* other;
+    memsizeclass_t* sc;
+    
+    // check the memory trash tester
+    if ( *( S32* )( ( U8* ) block + block->size - 4 ) != ZONEID )
+    {
+        Com_Error( ERR_FATAL, "idMemorySystemLocal:: memory block wrote past end" );
+    }
+    
+    for ( sizeClass = 0; sizeClasses[sizeClass].stride != block->size; sizeClass++ )
+    {
+    }
+
+#ifdef _DEBUG
+    // set the block to something that should cause problems
+    // if it is referenced...
+    ::memset( block + 1, 0xaa, block->size - sizeof( *block ) - 4 );
+#endif
+
+    // mark as free
+    block->tag = 0;
+    
+    block->next = slabCache.freeList[sizeClass];
+    slabCache.freeList[sizeClass] = block;
+    slabCache.numFree[sizeClass]++;
+    
+    if ( slabCache.numFree[sizeClass] <= SLAB_CACHE_SIZE )
+    {
+        return;
+    }
+    
+    // give half of the thread cache back to the shared list
+    sc = &sizeClasses[sizeClass];
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    for ( i = 0; i < SLAB_CACHE_SIZE / 2; i++ )
+    {
+        other = slabCache.freeList[sizeClass];
+        slabCache.freeList[sizeClass] = other->next;
+        slabCache.numFree[sizeClass]--;
+        
+        other->next = sc->freeList;
+        sc->freeList = other;
+        sc->numFree++;
+    }
+    
     threadsSystem->Mutex_Unlock( zone_mutex );
+}
+
+/*
+================
+idMemorySystemLocal::FlushSlabCache
+
+Gives every slot of a thread cache back to the shared lists
+================
+*/
+void idMemorySystemLocal::FlushSlabCache( memslabcache_t* cache )
+{
+    S32 i;
+    memblock_t* block;
+    memsizeclass_t* sc;
     
-    return ( void* )( ( U8* ) base + sizeof( memblock_t ) );
+    // the memory system is already shut down
+    if ( !zone_mutex )
+    {
+        return;
+    }
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    for ( i = 0; i < SLAB_NUM_CLASSES; i++ )
+    {
+        sc = &sizeClasses[i];
+        
+        while ( ( block = cache->freeList[i] ) != NULL )
+        {
+            cache->freeList[i] = block->next;
+            
+            block->next = sc->freeList;
+            sc->freeList = block;
+            sc->numFree++;
+        }
+        
+        cache->numFree[i] = 0;
+    }
+    
+    threadsSystem->Mutex_Unlock( zone_mutex );
+}
+
+/*
+================
+memslabcache_s::~memslabcache_s
+================
+*/
+memslabcache_s::~memslabcache_s( void )
+{
+    idMemorySystemLocal::FlushSlabCache( this );
+}
+
+/*
+================
+idMemorySystemLocal::SlabFreeTags
+================
+*/
+void idMemorySystemLocal::SlabFreeTags( memtag_t tag )
+{
+    S32 i, sizeClass;
+    memslab_t* slab;
+    memblock_t* block;
+    memsizeclass_t* sc;
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    for ( sizeClass = 0; sizeClass < SLAB_NUM_CLASSES; sizeClass++ )
+    {
+        sc = &sizeClasses[sizeClass];
+        
+        for ( slab = sc->slabs; slab; slab = slab->next )
+        {
+            for ( i = 0; i < slab->numSlots; i++ )
+            {
+                block = ( memblock_t* )( slab->slots + i * sc->stride );
+                
+                if ( block->tag != tag )
+                {
+                    continue;
+                }
+                
+                ::memset( block + 1, 0xaa, block->size - sizeof( *block ) - 4 );
+                
+                block->tag = 0;
+                block->next = sc->freeList;
+                sc->freeList = block;
+                sc->numFree++;
+            }
+        }
+    }
+    
+    threadsSystem->Mutex_Unlock( zone_mutex );
 }
 
 /*
@@ -423,6 +733,34 @@ S32 idMemorySystemLocal::AvailableZoneMemory( const memzone_t* zone )
     return zone->size - zone->used;
 }
 
+/*
+========================
+idMemorySystemLocal::ZoneFragmentation
+========================
+*/
+void idMemorySystemLocal::ZoneFragmentation( const memzone_t* zone, S32* freeBytes, S32* freeBlocks, S32* largestFree )
+{
+    const memblock_t* block;
+    
+    *freeBytes = *freeBlocks = *largestFree = 0;
+    
+    for ( block = zone->blocklist.next; block != &zone->blocklist; block = block->next )
+    {
+        if ( block->tag )
+        {
+            continue;
+        }
+        
+        *freeBytes += block->size;
+        ( *freeBlocks )++;
+        
+        if ( block->size > *largestFree )
+        {
+            *largestFree = block->size;
+        }
+    }
+}
+
 /*
 ========================
 idMemorySystemLocal::LogHeap
@@ -452,10 +790,15 @@ idMemorySystemLocal::Meminfo_f
 */
 void idMemorySystemLocal::Meminfo_f( void )
 {
-    S32 zoneBytes, zoneBlocks, smallZoneBytes, smallZoneBlocks, botlibBytes, rendererBytes, otherBytes, staticBytes, generalBytes;
+    S32 i, j, zoneBytes, zoneBlocks, smallZoneBytes, smallZoneBlocks, botlibBytes, rendererBytes, otherBytes, staticBytes, generalBytes, slabBytes;
+    S32 slotsTotal, slotsUsed, freeBytes, freeBlocks, largestFree;
     memblock_t*	block;
+    memslab_t* slab;
+    memsizeclass_t* sc;
+    memarena_t* arena;
     
     zoneBytes = 0;
+    slabBytes = 0;
     botlibBytes = 0;
     rendererBytes = 0;
     otherBytes = 0;
@@ -491,6 +834,10 @@ void idMemorySystemLocal::Meminfo_f( void )
             {
                 generalBytes += block->size;
             }
+            else if ( block->tag == TAG_SLAB )
+            {
+                slabBytes += block->size;
+            }
             else
                 otherBytes += block->size;
         }
@@ -562,6 +909,169 @@ void idMemorySystemLocal::Meminfo_f( void )
     Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
     Com_Printf( "        %8i bytes in static server memory\n", staticBytes );
     Com_Printf( "        %8i bytes in general common memory\n", generalBytes );
+    Com_Printf( "        %8i bytes in size class slabs\n", slabBytes );
+    Com_Printf( "\n" );
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    for ( i = 0; i < SLAB_NUM_CLASSES; i++ )
+    {
+        sc = &sizeClasses[i];
+        slotsTotal = slotsUsed = 0;
+        
+        for ( slab = sc->slabs; slab; slab = slab->next )
+        {
+            for ( j = 0; j < slab->numSlots; j++ )
+            {
+                if ( ( ( memblock_t* )( slab->slots + j * sc->stride ) )->tag )
+                {
+                    slotsUsed++;
+                }
+            }
+            
+            slotsTotal += slab->numSlots;
+        }
+        
+        Com_Printf( "%8i byte class: %7i used %7i free %7i thread cached slots in %i slabs\n", sc->size, slotsUsed, sc->numFree,
+                    slotsTotal - slotsUsed - sc->numFree, sc->numSlabs );
+    }
+    
+    threadsSystem->Mutex_Unlock( zone_mutex );
+    
+    ZoneFragmentation( mainzone, &freeBytes, &freeBlocks, &largestFree );
+    
+    Com_Printf( "\n" );
+    Com_Printf( "%8i K free zone in %i blocks, largest %i K (%.1f%% fragmented)\n", freeBytes / 1024, freeBlocks, largestFree / 1024,
+                freeBytes ? 100.0f * ( 1.0f - ( F32 )largestFree / freeBytes ) : 0.0f );
+    
+    ZoneFragmentation( smallzone, &freeBytes, &freeBlocks, &largestFree );
+    
+    Com_Printf( "%8i K free small zone in %i blocks, largest %i K (%.1f%% fragmented)\n", freeBytes / 1024, freeBlocks, largestFree / 1024,
+                freeBytes ? 100.0f * ( 1.0f - ( F32 )largestFree / freeBytes ) : 0.0f );
+    Com_Printf( "\n" );
+    
+    threadsSystem->Mutex_Lock( zone_mutex );
+    
+    for ( arena = frameArenas, i = 0; arena; arena = arena->next, i++ )
+    {
+        Com_Printf( "%8i K frame arena %i, %i K high water, %i frames overflowed\n", ( S32 )( arena->size / 1024 ), i,
+                    ( S32 )( arena->highWater / 1024 ), arena->numOverflows );
+    }
+    
+    threadsSystem->Mutex_Unlock( zone_mutex );
+}
+
+/*
+=================
+idMemorySystemLocal::ZoneBench_f
+
+Replays the zone traffic of a map change: a level load of strings and small
+structures with a few bigger blocks, cvar and configstring churn while the
+level runs, then the level unload in a different order than the load. Runs
+once through the plain zone and once through the size classes
+=================
+*/
+void idMemorySystemLocal::ZoneBench_f( void )
+{
+    S32 i, j, pass, map, numAllocs, maxAllocs, numMaps, start, msec[2], freeBytes, freeBlocks[2], largestFree[2];
+    U32 seed;
+    size_t size;
+    void** ptrs;
+    
+    numAllocs = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : 50000;
+    numMaps = cmdSystem->Argc() > 2 ? atoi( cmdSystem->Argv( 2 ) ) : 10;
+    
+    numAllocs = ( S32 )Com_Clamp( 1, 200000, numAllocs );
+    numMaps = ( S32 )Com_Clamp( 1, 1000, numMaps );
+    
+    // running out of zone is fatal, so keep every allocation of a level
+    // load at the biggest size below in half of the largest free block
+    ZoneFragmentation( mainzone, &freeBytes, &freeBlocks[0], &largestFree[0] );
+    maxAllocs = largestFree[0] / 2 / ( S32 )PAD( 512 + 4096 + sizeof( memblock_t ) + 4, sizeof( intptr_t ) );
+    
+    if ( numAllocs > maxAllocs )
+    {
+        Com_Printf( "zone bench: the zone only holds %i allocations\n", maxAllocs );
+        numAllocs = maxAllocs;
+    }
+    
+    if ( numAllocs < 1 )
+    {
+        return;
+    }
+    
+    // the unload order below must be a permutation
+    if ( numAllocs % 7919 == 0 )
+    {
+        numAllocs++;
+    }
+    
+    ptrs = ( void** )calloc( numAllocs, sizeof( void* ) );
+    if ( !ptrs )
+    {
+        Com_Printf( "zone bench: couldn't allocate %i pointers\n", numAllocs );
+        return;
+    }
+    
+    for ( pass = 0; pass < 2; pass++ )
+    {
+        SDL_AtomicSet( &s_slabsDisabled, pass == 0 );
+        seed = 0x1d4a11;
+        
+        start = idsystem->Milliseconds();
+        
+        for ( map = 0; map < numMaps; map++ )
+        {
+            // level load
+            for ( i = 0; i < numAllocs; i++ )
+            {
+                seed = seed * 1103515245 + 12345;
+                
+                if ( ( seed >> 16 ) % 100 < 70 )
+                {
+                    size = 1 + ( seed >> 8 ) % 64;
+                }
+                else if ( ( seed >> 16 ) % 100 < 95 )
+                {
+                    size = 64 + ( seed >> 8 ) % 192;
+                }
+                else
+                {
+                    size = 512 + ( seed >> 8 ) % 4096;
+                }
+                
+                ptrs[i] = memorySystemLocal.TagMalloc( size, TAG_GENERAL );
+            }
+            
+            // cvar and configstring churn
+            for ( i = 0; i < numAllocs; i += 4 )
+            {
+                seed = seed * 1103515245 + 12345;
+                
+                memorySystemLocal.Free( ptrs[i] );
+                ptrs[i] = memorySystemLocal.TagMalloc( 1 + ( seed >> 8 ) % 128, TAG_GENERAL );
+            }
+            
+            // level unload
+            for ( i = 0; i < numAllocs; i++ )
+            {
+                j = ( S32 )( ( ( U64 )i * 7919 ) % numAllocs );
+                memorySystemLocal.Free( ptrs[j] );
+            }
+        }
+        
+        msec[pass] = idsystem->Milliseconds() - start;
+        
+        ZoneFragmentation( mainzone, &freeBytes, &freeBlocks[pass], &largestFree[pass] );
+    }
+    
+    SDL_AtomicSet( &s_slabsDisabled, 0 );
+    
+    ::free( ptrs );
+    
+    Com_Printf( "zone bench: %i map changes of %i allocations\n", numMaps, numAllocs );
+    Com_Printf( "%8i msec zone only, %i free zone blocks after\n", msec[0], freeBlocks[0] );
+    Com_Printf( "%8i msec size classes, %i free zone blocks after\n", msec[1], freeBlocks[1] );
 }
 
 /*
@@ -662,6 +1172,7 @@ void idMemorySystemLocal::InitZoneMemory( void )
     
     ClearZone( mainzone, s_zoneTotal );
     
+    InitSizeClasses();
 }
 
 /*
@@ -724,6 +1235,8 @@ void idMemorySystemLocal::InitHunkMemory( void )
     Clear();
     
     cmdSystem->AddCommand( "meminfo", &idMemorySystemLocal::Meminfo_f, "description" );
+    profilerSystem->AddBench( "frame", &idMemorySystemLocal::FrameBench_f, "Benchmarks the frame scratch arenas against the zone and hunk temp memory, args: [frames]" );
+    profilerSystem->AddBench( "zone", &idMemorySystemLocal::ZoneBench_f, "Benchmarks zone allocation churn of a map change, args: [allocations] [map changes]" );
 }
 
 /*
@@ -817,7 +1330,7 @@ void* idMemorySystemLocal::Alloc( size_t size, ha_pref preference )
     
     if ( s_hunk.permTop + s_hunk.tempTop + size > s_hunk.memSize )
     {
-        Com_Error( ERR_DROP, "idMemorySystemLocal::Alloc failed on %i", size );
+        Com_Error( ERR_DROP, "idMemorySystemLocal::Alloc failed on %lu", ( U64 )size );
     }
     
     buf = s_hunk.mem + s_hunk.permTop;
@@ -865,7 +1378,7 @@ void* idMemorySystemLocal::AllocateTempMemory( size_t size )
     
     if ( s_hunk.permTop + s_hunk.tempTop + size > s_hunk.memSize )
     {
-        Com_Error( ERR_DROP, "idMemorySystemLocal::AllocateTempMemory: failed on %i", size );
+        Com_Error( ERR_DROP, "idMemorySystemLocal::AllocateTempMemory: failed on %lu", ( U64 )size );
     }
     
     s_hunk.tempTop += ( U64 )size;
@@ -948,24 +1461,348 @@ void idMemorySystemLocal::ClearTempMemory( void )
 /*
 =================
 idMemorySystemLocal::FrameInit
+
+Starts a new frame for the scratch arenas
 =================
 */
 void idMemorySystemLocal::FrameInit( void )
 {
-    S32 megs = cvarSystem->Get( "com_hunkFrameMegs", "1", CVAR_LATCH | CVAR_ARCHIVE, "description" )->integer;
-    U64 cb;
+    static convar_t* com_hunkFrameMegs;
+    
+    if ( !com_hunkFrameMegs )
+    {
+        com_hunkFrameMegs = cvarSystem->Get( "com_hunkFrameMegs", "1", CVAR_LATCH | CVAR_ARCHIVE, "Initial size of the per-thread frame scratch arenas in megabytes" );
+    }
+    
+    // worker threads read both of these whenever they allocate
+    SDL_AtomicSet( &s_frameArenaMegs, com_hunkFrameMegs->integer < 1 ? 1 : com_hunkFrameMegs->integer );
+    SDL_AtomicIncRef( &s_frameCount );
+}
+
+/*
+=================
+idMemorySystemLocal::FrameArenaSize
+=================
+*/
+size_t idMemorySystemLocal::FrameArenaSize( void )
+{
+    S32 megs = SDL_AtomicGet( &s_frameArenaMegs );
+    
+    return 1024 * 1024 * ( size_t )( megs < 1 ? 1 : megs );
+}
+
+/*
+=================
+idMemorySystemLocal::FrameAlloc
+=================
+*/
+void* idMemorySystemLocal::FrameAlloc( size_t size )
+{
+    memarena_t* arena = frameArena.arena;
+    S32 frame = SDL_AtomicGet( &s_frameCount );
+    
+    if ( !arena )
+    {
+        arena = frameArena.arena = CreateArena( FrameArenaSize() );
+        arena->frame = frame;
+        
+        threadsSystem->Mutex_Lock( zone_mutex );
+        arena->next = frameArenas;
+        frameArenas = arena;
+        threadsSystem->Mutex_Unlock( zone_mutex );
+    }
+    else if ( arena->frame != frame )
+    {
+        // only the owning thread resets its arena, so a worker keeps what it
+        // allocated until it allocates again after the frame has moved on
+        ArenaReset( arena );
+        arena->frame = frame;
+    }
+    
+    return ArenaAlloc( arena, size );
+}
+
+/*
+=================
+idMemorySystemLocal::CreateArena
+=================
+*/
+memarena_t* idMemorySystemLocal::CreateArena( size_t size )
+{
+    memarena_t* arena;
+    
+    arena = ( memarena_t* )calloc( 1, sizeof( memarena_t ) );
+    if ( !arena || ( arena->base = ( U8* )malloc( size ) ) == NULL )
+    {
+        Com_Error( ERR_FATAL, "idMemorySystemLocal::CreateArena: failed on %lu", ( U64 )size );
+    }
+    
+    arena->size = size;
+    
+    return arena;
+}
+
+/*
+=================
+idMemorySystemLocal::ArenaAlloc
+=================
+*/
+void* idMemorySystemLocal::ArenaAlloc( memarena_t* arena, size_t size )
+{
+    U8* buf;
+    size_t blockSize;
+    memarenablock_t* block;
+    
+    size = PAD( size, ARENA_ALIGN );
+    
+    arena->frameBytes += size;
+    if ( arena->frameBytes > arena->highWater )
+    {
+        arena->highWater = arena->frameBytes;
+    }
+    
+    if ( arena->used + size <= arena->size )
+    {
+        buf = arena->base + arena->used;
+        arena->used += size;
+        return buf;
+    }
     
-    if ( megs < 1 )
+    // out of space, chain overflow blocks until the next reset grows the arena
+    block = arena->overflow;
+    if ( !block || block->used + size > block->size )
     {
-        megs = 1;
+        blockSize = size > arena->size ? size : arena->size;
+        
+        block = ( memarenablock_t* )malloc( PAD( sizeof( memarenablock_t ), ARENA_ALIGN ) + blockSize );
+        if ( !block )
+        {
+            Com_Error( ERR_FATAL, "idMemorySystemLocal::ArenaAlloc: failed on %lu", ( U64 )size );
+        }
+        
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->overflow;
+        arena->overflow = block;
+        
+        if ( !arena->overflowed )
+        {
+            arena->overflowed = true;
+            arena->numOverflows++;
+        }
+    }
+    
+    buf = ( U8* )block + PAD( sizeof( memarenablock_t ), ARENA_ALIGN ) + block->used;
+    block->used += size;
+    
+    return buf;
+}
+
+/*
+=================
+idMemorySystemLocal::ArenaReset
+=================
+*/
+void idMemorySystemLocal::ArenaReset( memarena_t* arena )
+{
+    size_t size = arena->size;
+    memarenablock_t* block;
+    
+    while ( ( block = arena->overflow ) != NULL )
+    {
+        arena->overflow = block->next;
+        ::free( block );
+    }
+    
+    // grow to what the earlier frames needed
+    if ( arena->highWater > size )
+    {
+        size = PAD( arena->highWater, 65536 );
+    }
+    
+    if ( FrameArenaSize() > size )
+    {
+        size = FrameArenaSize();
+    }
+    
+    if ( size != arena->size )
+    {
+        ::free( arena->base );
+        
+        arena->base = ( U8* )malloc( size );
+        if ( !arena->base )
+        {
+            Com_Error( ERR_FATAL, "idMemorySystemLocal::ArenaReset: failed on %lu", ( U64 )size );
+        }
+        
+        arena->size = size;
+    }
+    
+    arena->used = 0;
+    arena->frameBytes = 0;
+    arena->overflowed = false;
+}
+
+/*
+=================
+idMemorySystemLocal::ArenaFree
+=================
+*/
+void idMemorySystemLocal::ArenaFree( memarena_t* arena )
+{
+    memarenablock_t* block;
+    
+    while ( ( block = arena->overflow ) != NULL )
+    {
+        arena->overflow = block->next;
+        ::free( block );
+    }
+    
+    ::free( arena->base );
+    ::free( arena );
+}
+
+/*
+=================
+memthreadarena_s::~memthreadarena_s
+
+Frees the frame arena of an exiting thread
+=================
+*/
+memthreadarena_s::~memthreadarena_s( void )
+{
+    memarena_t** link;
+    
+    if ( !arena )
+    {
+        return;
+    }
+    
+    // meminfo walks the list under zone_mutex, which is gone after shutdown
+    if ( zone_mutex )
+    {
+        threadsSystem->Mutex_Lock( zone_mutex );
+        
+        for ( link = &frameArenas; *link; link = &( *link )->next )
+        {
+            if ( *link == arena )
+            {
+                *link = arena->next;
+                break;
+            }
+        }
+        
+        threadsSystem->Mutex_Unlock( zone_mutex );
+    }
+    
+    idMemorySystemLocal::ArenaFree( arena );
+    arena = NULL;
+}
+
+/*
+=================
+idMemorySystemLocal::FrameBench_f
+
+Runs the same frame workload through the zone, the hunk temp allocator and
+a scratch arena: snapshot entity lists, formatted strings and a few big
+temp buffers, all thrown away at the end of the frame
+=================
+*/
+void idMemorySystemLocal::FrameBench_f( void )
+{
+    S32 i, j, frame, numFrames, numAllocs, start, msec[3];
+    static const S32 numStrings = 256, numEntityLists = 64, numBuffers = 4;
+    U32 seed;
+    size_t sizes[numStrings + numEntityLists + numBuffers];
+    void* ptrs[numStrings + numEntityLists + numBuffers];
+    memarena_t* arena;
+    
+    numFrames = cmdSystem->Argc() > 1 ? atoi( cmdSystem->Argv( 1 ) ) : 1000;
+    numFrames = ( S32 )Com_Clamp( 1, 100000, numFrames );
+    
+    // fixed frame layout, the same for every allocator
+    seed = 0x1d4a11;
+    numAllocs = 0;
+    
+    for ( i = 0; i < numStrings; i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        sizes[numAllocs++] = 16 + ( seed >> 8 ) % 112;
+    }
+    
+    for ( i = 0; i < numEntityLists; i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        sizes[numAllocs++] = 256 + ( seed >> 8 ) % 768;
+    }
+    
+    for ( i = 0; i < numBuffers; i++ )
+    {
+        sizes[numAllocs++] = 64 * 1024;
+    }
+    
+    // zone
+    start = idsystem->Milliseconds();
+    
+    for ( frame = 0; frame < numFrames; frame++ )
+    {
+        for ( i = 0; i < numAllocs; i++ )
+        {
+            ptrs[i] = memorySystemLocal.TagMalloc( sizes[i], TAG_GENERAL );
+            *( U8* )ptrs[i] = ( U8 )i;
+        }
+        
+        for ( i = 0; i < numAllocs; i++ )
+        {
+            memorySystemLocal.Free( ptrs[i] );
+        }
+    }
+    
+    msec[0] = idsystem->Milliseconds() - start;
+    
+    // hunk temp memory, freed in stack order
+    start = idsystem->Milliseconds();
+    
+    for ( frame = 0; frame < numFrames; frame++ )
+    {
+        for ( i = 0; i < numAllocs; i++ )
+        {
+            ptrs[i] = memorySystemLocal.AllocateTempMemory( sizes[i] );
+            *( U8* )ptrs[i] = ( U8 )i;
+        }
+        
+        for ( j = numAllocs - 1; j >= 0; j-- )
+        {
+            memorySystemLocal.FreeTempMemory( ptrs[j] );
+        }
+    }
+    
+    msec[1] = idsystem->Milliseconds() - start;
+    
+    // scratch arena
+    arena = CreateArena( FrameArenaSize() );
+    
+    start = idsystem->Milliseconds();
+    
+    for ( frame = 0; frame < numFrames; frame++ )
+    {
+        ArenaReset( arena );
+        
+        for ( i = 0; i < numAllocs; i++ )
+        {
+            ptrs[i] = ArenaAlloc( arena, sizes[i] );
+            *( U8* )ptrs[i] = ( U8 )i;
+        }
     }
     
-    cb = 1024 * 1024 * megs;
+    msec[2] = idsystem->Milliseconds() - start;
     
-    s_frameStackBase = ( U8* )memorySystemLocal.Alloc( cb, h_low );
-    s_frameStackEnd = s_frameStackBase + cb;
+    Com_Printf( "frame bench: %i frames of %i allocations\n", numFrames, numAllocs );
+    Com_Printf( "%8i msec zone\n", msec[0] );
+    Com_Printf( "%8i msec hunk temp memory\n", msec[1] );
+    Com_Printf( "%8i msec frame arena, %i K high water\n", msec[2], ( S32 )( arena->highWater / 1024 ) );
     
-    s_frameStackLoc = s_frameStackBase;
+    ArenaFree( arena );
 }
 
 /*
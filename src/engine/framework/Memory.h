@@ -86,6 +86,55 @@ typedef struct
     memblock_t* rover;
 } memzone_t;
 
+/*
+==============================================================================
+SIZE CLASS ALLOCATION
+
+Small zone allocations are served from fixed size slots instead of the
+first-fit block list. Slabs of slots are carved from the main zone as a
+TAG_SLAB block and never given back, every slot starts with a memblock_t
+(id SLABID, size is the slot stride) so Free and FreeTags can tell them
+apart from zone blocks and memtag_t semantics are unchanged.
+
+Every thread keeps a few free slots per class that it allocates from and
+frees to without locking, only refills and overflows touch the shared
+free list under zone_mutex.
+==============================================================================
+*/
+
+#define SLABID  0x1d4a12
+#define SLAB_SIZE ( 64 * 1024 )
+#define SLAB_NUM_CLASSES 8
+#define SLAB_MAX_SIZE 256
+#define SLAB_CACHE_SIZE 32	// free slots a thread keeps per class
+
+typedef struct memslab_s
+{
+    S32 sizeClass;
+    S32 numSlots;
+    U8* slots;
+    struct memslab_s* next;
+} memslab_t;
+
+typedef struct
+{
+    S32 size;			// largest request served by this class
+    S32 stride;			// slot size, including header and trash tester
+    memblock_t* freeList;	// shared free slots, linked through next
+    S32 numFree;
+    memslab_t* slabs;
+    S32 numSlabs;
+} memsizeclass_t;
+
+// the slots of an exiting thread go back to the shared lists
+typedef struct memslabcache_s
+{
+    memblock_t* freeList[SLAB_NUM_CLASSES];
+    S32 numFree[SLAB_NUM_CLASSES];
+    
+    ~memslabcache_s( void );
+} memslabcache_t;
+
 // main zone for all "dynamic" memory allocation
 static memzone_t* mainzone;
 
@@ -224,9 +273,48 @@ static struct
     U64	mark;
 } s_hunk;
 
-static U8* s_frameStackLoc = 0;
-static U8* s_frameStackBase = 0;
-static U8* s_frameStackEnd = 0;
+/*
+==============================================================================
+FRAME SCRATCH ARENAS
+
+Every thread that calls FrameAlloc gets its own bump arena, allocated from
+the system heap so it survives hunk clears. FrameInit starts a new frame and
+each arena resets itself the next time its thread allocates. An arena that
+runs out during a frame chains overflow blocks and is grown to its high
+water mark on the next reset. The arena is freed when its thread exits.
+==============================================================================
+*/
+
+#define ARENA_ALIGN 16
+
+typedef struct memarenablock_s
+{
+    struct memarenablock_s* next;
+    size_t size;
+    size_t used;
+} memarenablock_t;
+
+typedef struct memarena_s
+{
+    U8* base;
+    size_t size;
+    size_t used;
+    size_t frameBytes;		// requested this frame, overflow blocks included
+    size_t highWater;
+    memarenablock_t* overflow;
+    bool overflowed;
+    S32 numOverflows;		// frames that did not fit
+    S32 frame;				// frame the arena was last reset in
+    struct memarena_s* next;
+} memarena_t;
+
+// the frame arena of a thread, freed when the thread exits
+typedef struct memthreadarena_s
+{
+    memarena_t* arena;
+    
+    ~memthreadarena_s( void );
+} memthreadarena_t;
 
 extern fileHandle_t logfile_;
 
@@ -260,13 +348,29 @@ public:
     virtual UTF8* CopyString( StringEntry in );
     virtual void Shutdown( void );
     virtual void GetHunkInfo( S32* hunkused, S32* hunkexpected );
+    virtual void FrameInit( void );
+    virtual void* FrameAlloc( size_t size );
     
     static void ClearZone( memzone_t* zone, S32 size );
+    static void* ZoneMalloc( memzone_t* zone, size_t size, memtag_t tag );
+    static void InitSizeClasses( void );
+    static memslab_t* AllocSlab( S32 sizeClass );
+    static void* SlabMalloc( size_t size, memtag_t tag );
+    static void SlabFree( memblock_t* block );
+    static void SlabFreeTags( memtag_t tag );
+    static void FlushSlabCache( memslabcache_t* cache );
+    static void ZoneFragmentation( const memzone_t* zone, S32* freeBytes, S32* freeBlocks, S32* largestFree );
     static void LogZoneHeap( memzone_t* zone, UTF8* name );
     static S32 AvailableZoneMemory( const memzone_t* zone );
     static void LogHeap( void );
     static void Meminfo_f( void );
-    static void FrameInit( void );
+    static void ZoneBench_f( void );
+    static size_t FrameArenaSize( void );
+    static memarena_t* CreateArena( size_t size );
+    static void* ArenaAlloc( memarena_t* arena, size_t size );
+    static void ArenaReset( memarena_t* arena );
+    static void ArenaFree( memarena_t* arena );
+    static void FrameBench_f( void );
 };
 
 extern idMemorySystemLocal memorySystemLocal;
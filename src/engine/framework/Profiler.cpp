@@ -0,0 +1,608 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   Profiler.cpp
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: scoped zone frame profiler
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef UPDATE_SERVER
+#include <null/null_autoprecompiled.h>
+#elif DEDICATED
+#include <null/null_serverprecompiled.h>
+#else
+#include <framework/precompiled.h>
+#endif
+
+idProfilerSystemLocal profilerSystemLocal;
+idProfilerSystem* profilerSystem = &profilerSystemLocal;
+
+static convar_t* com_profile;
+static qmutex_t* profile_mutex = nullptr;
+static profileRing_t* profileRings;
+static S32 profileNumRings;
+static U64 profileBaseTime;
+static thread_local profileRing_t* threadRing;
+static thread_local bool mainThread;
+
+// subsystems add their benches before Init as well
+static profileBench_t profileBenches[PROFILE_MAX_BENCHES];
+
+/*
+===============
+idProfilerSystemLocal::idProfilerSystemLocal
+===============
+*/
+idProfilerSystemLocal::idProfilerSystemLocal( void )
+{
+    recording = false;
+}
+
+/*
+===============
+idProfilerSystemLocal::~idProfilerSystemLocal
+===============
+*/
+idProfilerSystemLocal::~idProfilerSystemLocal( void )
+{
+}
+
+/*
+===============
+idProfilerSystemLocal::Init
+===============
+*/
+void idProfilerSystemLocal::Init( void )
+{
+    profile_mutex = threadsSystem->Mutex_Create();
+    profileBaseTime = idsystem->Nanoseconds();
+    mainThread = true;
+    
+    com_profile = cvarSystem->Get( "com_profile", "0", CVAR_TEMP, "Records profiler zones of every thread for profile_dump and profile_report" );
+    
+    cmdSystem->AddCommand( "profile_dump", &idProfilerSystemLocal::Dump_f, "Writes the recorded profiler zones as a Chrome trace, usage: profile_dump [file]" );
+    cmdSystem->AddCommand( "profile_report", &idProfilerSystemLocal::Report_f, "Prints percentiles of the recorded profiler zones" );
+    cmdSystem->AddCommand( "profile_bench", &idProfilerSystemLocal::Bench_f, "Runs one of the engine benchmarks, lists them without a name, usage: profile_bench [name] [args]" );
+
+#ifndef USE_PROFILER
+    Com_DPrintf( "profiler zones are not compiled in, build with USE_PROFILER\n" );
+#endif
+}
+
+/*
+===============
+idProfilerSystemLocal::Shutdown
+
+the rings are left alone, threads that are still running may write to them
+===============
+*/
+void idProfilerSystemLocal::Shutdown( void )
+{
+    recording = false;
+    
+    cmdSystem->RemoveCommand( "profile_dump" );
+    cmdSystem->RemoveCommand( "profile_report" );
+    cmdSystem->RemoveCommand( "profile_bench" );
+}
+
+/*
+===============
+idProfilerSystemLocal::Frame
+
+Called at the start of every Com_Frame, before any zone is open on the
+main thread
+===============
+*/
+void idProfilerSystemLocal::Frame( void )
+{
+    recording = ( com_profile && com_profile->integer );
+    
+    // zones left open by an ERR_DROP longjmp never ran their destructors
+    if ( threadRing )
+    {
+        threadRing->depth = 0;
+    }
+}
+
+/*
+===============
+idProfilerSystemLocal::ThreadRing
+
+allocates the ring of the calling thread the first time it records a zone
+===============
+*/
+profileRing_t* idProfilerSystemLocal::ThreadRing( void )
+{
+    profileRing_t* ring;
+    
+    ring = ( profileRing_t* )::calloc( 1, sizeof( *ring ) );
+    if ( !ring )
+    {
+        return nullptr;
+    }
+    
+    ring->events = ( profileEvent_t* )::calloc( PROFILE_RING_EVENTS, sizeof( *ring->events ) );
+    if ( !ring->events )
+    {
+        ::free( ring );
+        return nullptr;
+    }
+    
+    threadsSystem->Mutex_Lock( profile_mutex );
+    
+    ring->thread = profileNumRings++;
+    ring->main = mainThread;
+    ring->next = profileRings;
+    profileRings = ring;
+    
+    threadsSystem->Mutex_Unlock( profile_mutex );
+    
+    return ring;
+}
+
+/*
+===============
+idProfilerSystemLocal::BeginZone
+===============
+*/
+void idProfilerSystemLocal::BeginZone( StringEntry name )
+{
+    profileRing_t* ring = threadRing;
+    
+    if ( !ring )
+    {
+        ring = threadRing = ThreadRing();
+        
+        if ( !ring )
+        {
+            return;
+        }
+    }
+    
+    if ( ring->depth < PROFILE_MAX_DEPTH )
+    {
+        ring->openNames[ring->depth] = name;
+        ring->openStarts[ring->depth] = idsystem->Nanoseconds();
+    }
+    
+    ring->depth++;
+}
+
+/*
+===============
+idProfilerSystemLocal::EndZone
+===============
+*/
+void idProfilerSystemLocal::EndZone( void )
+{
+    profileRing_t* ring = threadRing;
+    profileEvent_t* event;
+    U32 head;
+    
+    // a zone opened before Frame reset the depth, or the ring couldn't be allocated
+    if ( !ring || ring->depth <= 0 )
+    {
+        return;
+    }
+    
+    ring->depth--;
+    
+    if ( ring->depth >= PROFILE_MAX_DEPTH )
+    {
+        return;
+    }
+    
+    head = ( U32 )SDL_AtomicGet( &ring->head );
+    
+    event = &ring->events[head % PROFILE_RING_EVENTS];
+    event->name = ring->openNames[ring->depth];
+    event->start = ring->openStarts[ring->depth];
+    event->end = idsystem->Nanoseconds();
+    event->depth = ring->depth;
+    
+    // publishes the event to Snapshot
+    SDL_AtomicSet( &ring->head, ( S32 )( head + 1 ) );
+}
+
+/*
+===============
+idProfilerSystemLocal::Snapshot
+
+Copies the events of every ring. The threads don't stop writing, so the
+copy only keeps the events that weren't overwritten while it was taken
+===============
+*/
+S32 idProfilerSystemLocal::Snapshot( profileSnapshot_t** snapshots )
+{
+    S32 i, numRings;
+    U32 k, first, head, after;
+    profileRing_t* ring;
+    profileSnapshot_t* snapshot;
+    
+    threadsSystem->Mutex_Lock( profile_mutex );
+    
+    numRings = profileNumRings;
+    *snapshots = ( profileSnapshot_t* )::calloc( numRings ? numRings : 1, sizeof( profileSnapshot_t ) );
+    
+    if ( !*snapshots )
+    {
+        threadsSystem->Mutex_Unlock( profile_mutex );
+        return 0;
+    }
+    
+    for ( ring = profileRings, i = 0; ring && i < numRings; ring = ring->next, i++ )
+    {
+        snapshot = &( *snapshots )[i];
+        snapshot->thread = ring->thread;
+        snapshot->main = ring->main;
+        
+        head = ( U32 )SDL_AtomicGet( &ring->head );
+        first = head > PROFILE_RING_EVENTS ? head - PROFILE_RING_EVENTS : 0;
+        
+        snapshot->events = ( profileEvent_t* )::malloc( ( head - first ? head - first : 1 ) * sizeof( profileEvent_t ) );
+        if ( !snapshot->events )
+        {
+            continue;
+        }
+        
+        for ( k = first; k < head; k++ )
+        {
+            snapshot->events[k - first] = ring->events[k % PROFILE_RING_EVENTS];
+        }
+        
+        // drop the oldest events if the thread wrapped around onto them,
+        // the slot of event after may be half written as well
+        after = ( U32 )SDL_AtomicGet( &ring->head );
+        if ( after + 1 - first > PROFILE_RING_EVENTS )
+        {
+            k = after + 1 - first - PROFILE_RING_EVENTS;
+            k = k < head - first ? k : head - first;
+            
+            ::memmove( snapshot->events, snapshot->events + k, ( head - first - k ) * sizeof( profileEvent_t ) );
+            first += k;
+        }
+        
+        snapshot->numEvents = ( S32 )( head - first );
+    }
+    
+    threadsSystem->Mutex_Unlock( profile_mutex );
+    
+    return i;
+}
+
+/*
+===============
+idProfilerSystemLocal::FreeSnapshot
+===============
+*/
+void idProfilerSystemLocal::FreeSnapshot( profileSnapshot_t* snapshots, S32 numSnapshots )
+{
+    S32 i;
+    
+    for ( i = 0; i < numSnapshots; i++ )
+    {
+        ::free( snapshots[i].events );
+    }
+    
+    ::free( snapshots );
+}
+
+/*
+===============
+idProfilerSystemLocal::Dump_f
+
+Writes every ring as Chrome trace events, load the file in
+chrome://tracing or ui.perfetto.dev
+===============
+*/
+void idProfilerSystemLocal::Dump_f( void )
+{
+    S32 i, j, numSnapshots, count;
+    fileHandle_t f;
+    profileSnapshot_t* snapshots, *snapshot;
+    profileEvent_t* event;
+    StringEntry filename;
+    
+    filename = cmdSystem->Argc() > 1 ? cmdSystem->Argv( 1 ) : "profile.json";
+    
+    numSnapshots = Snapshot( &snapshots );
+    if ( !snapshots )
+    {
+        Com_Printf( "profile_dump: out of memory\n" );
+        return;
+    }
+    
+    f = fileSystem->FOpenFileWrite( filename );
+    if ( !f )
+    {
+        Com_Printf( "profile_dump: couldn't open %s\n", filename );
+        FreeSnapshot( snapshots, numSnapshots );
+        return;
+    }
+    
+    fileSystem->Printf( f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+    
+    count = 0;
+    
+    for ( i = 0; i < numSnapshots; i++ )
+    {
+        snapshot = &snapshots[i];
+        
+        fileSystem->Printf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}\n",
+                            i ? "," : "", snapshot->thread, snapshot->main ? "main" : va( "thread %i", snapshot->thread ) );
+        
+        for ( j = 0; j < snapshot->numEvents; j++ )
+        {
+            event = &snapshot->events[j];
+            
+            fileSystem->Printf( f, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}\n", event->name, snapshot->thread,
+                                ( event->start - profileBaseTime ) / 1000.0, ( event->end - event->start ) / 1000.0 );
+            count++;
+        }
+    }
+    
+    fileSystem->Printf( f, "]}\n" );
+    
+    fileSystem->FCloseFile( f );
+    
+    FreeSnapshot( snapshots, numSnapshots );
+    
+    Com_Printf( "wrote %i trace events of %i threads to %s\n", count, numSnapshots, filename );
+}
+
+/*
+===============
+idProfilerSystemLocal::SortDurations
+===============
+*/
+S32 idProfilerSystemLocal::SortDurations( const void* a, const void* b )
+{
+    U64 da = *( const U64* )a, db = *( const U64* )b;
+    
+    return da < db ? -1 : ( da > db ? 1 : 0 );
+}
+
+/*
+===============
+idProfilerSystemLocal::Report_f
+
+Prints call counts and duration percentiles of every zone in the rings,
+zones of the same name are merged across threads and modules
+===============
+*/
+void idProfilerSystemLocal::Report_f( void )
+{
+    S32 i, j, k, pass, numZones, numSnapshots;
+    U64 total;
+    profileSnapshot_t* snapshots;
+    profileEvent_t* event;
+    profileZoneStats_t* zone;
+    static profileZoneStats_t zones[PROFILE_MAX_ZONES];
+    
+    numSnapshots = Snapshot( &snapshots );
+    if ( !snapshots )
+    {
+        Com_Printf( "profile_report: out of memory\n" );
+        return;
+    }
+    
+    // count the events of every zone, then gather their durations, the
+    // snapshot doesn't change in between
+    numZones = 0;
+    
+    for ( pass = 0; pass < 2; pass++ )
+    {
+        for ( j = 0; j < numZones; j++ )
+        {
+            if ( pass == 1 && zones[j].count )
+            {
+                zones[j].durations = ( U64* )::malloc( zones[j].count * sizeof( U64 ) );
+            }
+            zones[j].count = 0;
+        }
+        
+        for ( i = 0; i < numSnapshots; i++ )
+        {
+            for ( k = 0; k < snapshots[i].numEvents; k++ )
+            {
+                event = &snapshots[i].events[k];
+                
+                for ( j = 0; j < numZones; j++ )
+                {
+                    if ( zones[j].name == event->name || !::strcmp( zones[j].name, event->name ) )
+                    {
+                        break;
+                    }
+                }
+                
+                if ( j == numZones )
+                {
+                    if ( pass == 1 || numZones == PROFILE_MAX_ZONES )
+                    {
+                        continue;
+                    }
+                    
+                    zones[numZones].name = event->name;
+                    zones[numZones].count = 0;
+                    zones[numZones].durations = nullptr;
+                    numZones++;
+                }
+                
+                if ( pass == 1 )
+                {
+                    if ( !zones[j].durations )
+                    {
+                        continue;
+                    }
+                    
+                    zones[j].durations[zones[j].count] = event->end - event->start;
+                }
+                
+                zones[j].count++;
+            }
+        }
+    }
+    
+    FreeSnapshot( snapshots, numSnapshots );
+    
+    if ( !numZones )
+    {
+        Com_Printf( "no profiler zones recorded, set com_profile 1 first\n" );
+        return;
+    }
+    
+    Com_Printf( "%-28s %8s %10s %9s %9s %9s %9s %9s\n", "zone", "calls", "total ms", "mean us", "p50 us", "p95 us", "p99 us", "max us" );
+    
+    for ( i = 0; i < numZones; i++ )
+    {
+        zone = &zones[i];
+        
+        if ( !zone->durations || !zone->count )
+        {
+            ::free( zone->durations );
+            zone->durations = nullptr;
+            continue;
+        }
+        
+        ::qsort( zone->durations, zone->count, sizeof( U64 ), SortDurations );
+        
+        total = 0;
+        for ( j = 0; j < zone->count; j++ )
+        {
+            total += zone->durations[j];
+        }
+        
+        Com_Printf( "%-28s %8i %10.2f %9.1f %9.1f %9.1f %9.1f %9.1f\n", zone->name, zone->count, total / 1e6, total / 1e3 / zone->count,
+                    zone->durations[zone->count * 50 / 100] / 1e3, zone->durations[zone->count * 95 / 100] / 1e3,
+                    zone->durations[zone->count * 99 / 100] / 1e3, zone->durations[zone->count - 1] / 1e3 );
+        
+        ::free( zone->durations );
+        zone->durations = nullptr;
+    }
+}
+
+/*
+===============
+idProfilerSystemLocal::AddBench
+
+Adding a name again replaces the bench, subsystems that restart add theirs
+again without removing them
+===============
+*/
+void idProfilerSystemLocal::AddBench( StringEntry name, void ( *function )( void ), StringEntry description )
+{
+    S32 i, free = -1;
+    
+    for ( i = 0; i < PROFILE_MAX_BENCHES; i++ )
+    {
+        if ( profileBenches[i].name && !Q_stricmp( profileBenches[i].name, name ) )
+        {
+            break;
+        }
+        
+        if ( !profileBenches[i].name && free < 0 )
+        {
+            free = i;
+        }
+    }
+    
+    if ( i == PROFILE_MAX_BENCHES )
+    {
+        if ( free < 0 )
+        {
+            Com_Printf( S_COLOR_YELLOW "WARNING: more than %i benches, %s dropped\n", PROFILE_MAX_BENCHES, name );
+            return;
+        }
+        
+        i = free;
+    }
+    
+    profileBenches[i].name = name;
+    profileBenches[i].function = function;
+    profileBenches[i].description = description;
+}
+
+/*
+===============
+idProfilerSystemLocal::RemoveBench
+===============
+*/
+void idProfilerSystemLocal::RemoveBench( StringEntry name )
+{
+    S32 i;
+    
+    for ( i = 0; i < PROFILE_MAX_BENCHES; i++ )
+    {
+        if ( profileBenches[i].name && !Q_stricmp( profileBenches[i].name, name ) )
+        {
+            ::memset( &profileBenches[i], 0, sizeof( profileBenches[i] ) );
+        }
+    }
+}
+
+/*
+===============
+idProfilerSystemLocal::Bench_f
+
+Retokenizes the command line without profile_bench, so the bench reads
+its arguments as if it had been run as a command of its own
+===============
+*/
+void idProfilerSystemLocal::Bench_f( void )
+{
+    UTF8 args[MAX_STRING_CHARS];
+    profileBench_t* bench;
+    S32 i;
+    
+    if ( cmdSystem->Argc() < 2 )
+    {
+        Com_Printf( "usage: profile_bench <name> [args]\n" );
+        
+        for ( i = 0; i < PROFILE_MAX_BENCHES; i++ )
+        {
+            if ( profileBenches[i].name )
+            {
+                Com_Printf( "  %-8s %s\n", profileBenches[i].name, profileBenches[i].description );
+            }
+        }
+        return;
+    }
+    
+    bench = nullptr;
+    for ( i = 0; i < PROFILE_MAX_BENCHES; i++ )
+    {
+        if ( profileBenches[i].name && !Q_stricmp( profileBenches[i].name, cmdSystem->Argv( 1 ) ) )
+        {
+            bench = &profileBenches[i];
+            break;
+        }
+    }
+    
+    if ( !bench )
+    {
+        Com_Printf( "profile_bench: no bench named %s\n", cmdSystem->Argv( 1 ) );
+        return;
+    }
+    
+    Q_strncpyz( args, cmdSystem->ArgsFrom( 1 ), sizeof( args ) );
+    cmdSystem->TokenizeString( args );
+    
+    bench->function();
+}
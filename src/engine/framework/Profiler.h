@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   Profiler.h
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: scoped zone frame profiler
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/*
+==============================================================================
+FRAME PROFILER
+
+Every thread that enters a zone while com_profile is set gets a ring of
+the last PROFILE_RING_EVENTS closed zones, written only by that thread.
+Zones are closed in order, so a ring is a flat list of nested intervals
+that profile_dump writes out as Chrome trace events and profile_report
+turns into per zone percentiles. Both work on a copy of the rings, taken
+while the threads go on writing; events overwritten during the copy are
+left out of it.
+==============================================================================
+*/
+
+#define PROFILE_RING_EVENTS ( 64 * 1024 )
+#define PROFILE_MAX_DEPTH 32
+#define PROFILE_MAX_ZONES 256	// distinct zone names in a report
+#define PROFILE_MAX_BENCHES 16
+
+typedef struct
+{
+    StringEntry name;
+    U64 start;		// nanoseconds
+    U64 end;
+    S32 depth;
+} profileEvent_t;
+
+typedef struct profileRing_s
+{
+    S32 thread;		// order in which threads recorded their first zone
+    bool main;		// the thread that ran Init
+    SDL_atomic_t head;	// events ever written, the ring holds the last PROFILE_RING_EVENTS
+    profileEvent_t* events;
+    
+    S32 depth;
+    StringEntry openNames[PROFILE_MAX_DEPTH];
+    U64 openStarts[PROFILE_MAX_DEPTH];
+    
+    struct profileRing_s* next;
+} profileRing_t;
+
+typedef struct
+{
+    S32 thread;
+    bool main;
+    S32 numEvents;
+    profileEvent_t* events;
+} profileSnapshot_t;
+
+typedef struct
+{
+    StringEntry name;
+    S32 count;
+    U64* durations;
+} profileZoneStats_t;
+
+typedef struct
+{
+    StringEntry name;
+    void ( *function )( void );
+    StringEntry description;
+} profileBench_t;
+
+//
+// idProfilerSystemLocal
+//
+class idProfilerSystemLocal : public idProfilerSystem
+{
+public:
+    idProfilerSystemLocal( void );
+    ~idProfilerSystemLocal( void );
+    
+    virtual void Init( void );
+    virtual void Shutdown( void );
+    virtual void Frame( void );
+    virtual void BeginZone( StringEntry name );
+    virtual void EndZone( void );
+    virtual void AddBench( StringEntry name, void ( *function )( void ), StringEntry description );
+    virtual void RemoveBench( StringEntry name );
+    
+    static profileRing_t* ThreadRing( void );
+    static S32 Snapshot( profileSnapshot_t** snapshots );
+    static void FreeSnapshot( profileSnapshot_t* snapshots, S32 numSnapshots );
+    static S32 SortDurations( const void* a, const void* b );
+    static void Dump_f( void );
+    static void Report_f( void );
+    static void Bench_f( void );
+};
+
+extern idProfilerSystemLocal profilerSystemLocal;
+
+#endif //!__PROFILER_H__
@@ -0,0 +1,627 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   SnapshotParse.cpp
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: server message parsing shared by the client and demoAnalyze
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef UPDATE_SERVER
+#include <null/null_autoprecompiled.h>
+#elif DEDICATED
+#include <null/null_serverprecompiled.h>
+#else
+#include <framework/precompiled.h>
+#endif
+
+idSnapshotParseSystemLocal snapshotParseSystemLocal;
+
+/*
+===============
+idSnapshotParseSystemLocal::idSnapshotParseSystemLocal
+===============
+*/
+idSnapshotParseSystemLocal::idSnapshotParseSystemLocal( void )
+{
+}
+
+/*
+===============
+idSnapshotParseSystemLocal::~idSnapshotParseSystemLocal
+===============
+*/
+idSnapshotParseSystemLocal::~idSnapshotParseSystemLocal( void )
+{
+}
+
+/*
+=================
+idSnapshotParseSystemLocal::ReadDemoMessage
+
+Reads the next message of a demo into an initialized msg, returns false at
+the end of the demo
+=================
+*/
+bool idSnapshotParseSystemLocal::ReadDemoMessage( fileHandle_t f, msg_t* msg, S32* serverMessageSequence )
+{
+    S32 r, s;
+    
+    // get the sequence number
+    r = fileSystem->Read( &s, 4, f );
+    if ( r != 4 )
+    {
+        return false;
+    }
+    
+    *serverMessageSequence = LittleLong( s );
+    
+    // get the length
+    r = fileSystem->Read( &msg->cursize, 4, f );
+    
+    if ( r != 4 )
+    {
+        return false;
+    }
+    
+    msg->cursize = LittleLong( msg->cursize );
+    
+    if ( msg->cursize == -1 )
+    {
+        return false;
+    }
+    
+    if ( msg->cursize < 0 || msg->cursize > msg->maxsize )
+    {
+        Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::ReadDemoMessage: demoMsglen > MAX_MSGLEN" );
+    }
+    
+    r = fileSystem->Read( msg->data, msg->cursize, f );
+    
+    if ( r != msg->cursize )
+    {
+        Com_Printf( "Demo file was truncated.\n" );
+        return false;
+    }
+    
+    msg->readcount = 0;
+    
+    return true;
+}
+
+/*
+=================
+idSnapshotParseSystemLocal::ShowNet
+=================
+*/
+void idSnapshotParseSystemLocal::ShowNet( S32 showNet, msg_t* msg, StringEntry s )
+{
+    if ( showNet >= 2 )
+    {
+        Com_Printf( "%3i:%s\n", msg->readcount - 1, s );
+    }
+}
+
+/*
+=================
+idSnapshotParseSystemLocal::ReadCommand
+
+Reads the next command byte of a server message, svc_EOF at its end
+=================
+*/
+S32 idSnapshotParseSystemLocal::ReadCommand( msg_t* msg, S32 showNet )
+{
+    S32 cmd;
+    
+    if ( msg->readcount > msg->cursize )
+    {
+        Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::ReadCommand: read past end of server message" );
+    }
+    
+    cmd = MSG_ReadByte( msg );
+    
+    // See if this is an extension command after the EOF, which means we
+    //  got data that a legacy client should ignore.
+    if ( ( cmd == svc_EOF ) && ( MSG_LookaheadByte( msg ) == svc_extension ) )
+    {
+        ShowNet( showNet, msg, "EXTENSION" );
+        
+        // throw the svc_extension byte away.
+        MSG_ReadByte( msg );
+        
+        // something legacy clients can't do!
+        cmd = MSG_ReadByte( msg );
+        
+        // sometimes you get a svc_extension at end of stream...dangling
+        //  bits in the huffman decoder giving a bogus value?
+        if ( cmd == -1 )
+        {
+            cmd = svc_EOF;
+        }
+    }
+    
+    return cmd;
+}
+
+/*
+=====================
+idSnapshotParseSystemLocal::ParseCommandString
+
+Returns the command if it is one we haven't seen yet
+=====================
+*/
+bool idSnapshotParseSystemLocal::ParseCommandString( snapshotParse_t* parse, msg_t* msg, UTF8** command )
+{
+    S32 seq;
+    
+    seq = MSG_ReadLong( msg );
+    *command = MSG_ReadString( msg );
+    
+    // see if we have already executed stored it off
+    if ( *parse->serverCommandSequence >= seq )
+    {
+        return false;
+    }
+    
+    *parse->serverCommandSequence = seq;
+    
+    return true;
+}
+
+/*
+==================
+idSnapshotParseSystemLocal::ParseGamestate
+
+Reads the configstrings and baselines up to the client number, into state
+the caller has wiped
+==================
+*/
+void idSnapshotParseSystemLocal::ParseGamestate( snapshotParse_t* parse, msg_t* msg )
+{
+    S32 i, len, newnum, cmd;
+    UTF8* s;
+    entityState_t nullstate;
+    gameState_t* gameState = parse->gameState;
+    
+    // a gamestate always marks a server command sequence
+    *parse->serverCommandSequence = MSG_ReadLong( msg );
+    
+    // parse all the configstrings and baselines
+    gameState->dataCount = 1;	// leave a 0 at the beginning for uninitialized configstrings
+    
+    while ( 1 )
+    {
+        cmd = MSG_ReadByte( msg );
+        
+        if ( cmd == svc_EOF )
+        {
+            break;
+        }
+        
+        if ( cmd == svc_configstring )
+        {
+            i = MSG_ReadShort( msg );
+            if ( i < 0 || i >= MAX_CONFIGSTRINGS )
+            {
+                Com_Error( ERR_DROP, "configstring > MAX_CONFIGSTRINGS" );
+            }
+            
+            s = MSG_ReadBigString( msg );
+            len = ( S32 )::strlen( s );
+            
+            if ( len + 1 + gameState->dataCount > MAX_GAMESTATE_CHARS )
+            {
+                Com_Error( ERR_DROP, "MAX_GAMESTATE_CHARS exceeded" );
+            }
+            
+            // append it to the gameState string buffer
+            gameState->stringOffsets[i] = gameState->dataCount;
+            ::memcpy( gameState->stringData + gameState->dataCount, s, len + 1 );
+            gameState->dataCount += len + 1;
+        }
+        else if ( cmd == svc_baseline )
+        {
+            newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+            
+            if ( newnum < 0 || newnum >= MAX_GENTITIES )
+            {
+                Com_Error( ERR_DROP, "Baseline number out of range: %i", newnum );
+            }
+            
+            ::memset( &nullstate, 0, sizeof( nullstate ) );
+            MSG_ReadDeltaEntity( msg, &nullstate, &parse->baselines[newnum], newnum );
+        }
+        else
+        {
+            Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::ParseGamestate: bad command byte" );
+        }
+    }
+}
+
+/*
+==================
+idSnapshotParseSystemLocal::DeltaEntity
+
+Parses deltas from the given base and adds the resulting entity
+to the current frame
+==================
+*/
+void idSnapshotParseSystemLocal::DeltaEntity( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* frame, S32 newnum, entityState_t* old, bool unchanged )
+{
+    entityState_t*  state;
+    
+    // save the parsed entity state into the big circular buffer so
+    // it can be used as the source for a later delta
+    state = &parse->parseEntities[*parse->parseEntitiesNum & ( parse->maxParseEntities - 1 )];
+    
+    if ( unchanged )
+    {
+        *state = *old;
+    }
+    else
+    {
+        MSG_ReadDeltaEntity( msg, old, state, newnum );
+    }
+    
+    if ( state->number == ( MAX_GENTITIES - 1 ) )
+    {
+        return;					// entity was delta removed
+    }
+    
+    if ( parse->addEntity )
+    {
+        parse->addEntity( state, frame );
+    }
+    
+    ( *parse->parseEntitiesNum )++;
+    frame->numEntities++;
+}
+
+/*
+==================
+idSnapshotParseSystemLocal::ParsePacketEntities
+==================
+*/
+void idSnapshotParseSystemLocal::ParsePacketEntities( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* oldframe, clSnapshot_t* newframe )
+{
+    S32 newnum, oldindex, oldnum;
+    entityState_t*	oldstate;
+    
+    newframe->parseEntitiesNum = *parse->parseEntitiesNum;
+    newframe->numEntities = 0;
+    
+    // delta from the entities present in oldframe
+    oldindex = 0;
+    oldstate = nullptr;
+    
+    if ( !oldframe )
+    {
+        oldnum = 99999;
+    }
+    else
+    {
+        if ( oldindex >= oldframe->numEntities )
+        {
+            oldnum = 99999;
+        }
+        else
+        {
+            oldstate = &parse->parseEntities[( oldframe->parseEntitiesNum + oldindex ) & ( parse->maxParseEntities - 1 )];
+            oldnum = oldstate->number;
+        }
+    }
+    
+    while ( 1 )
+    {
+        // read the entity index number
+        newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+        
+        if ( newnum == ( MAX_GENTITIES - 1 ) )
+        {
+            break;
+        }
+        
+        if ( msg->readcount > msg->cursize )
+        {
+            Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::ParsePacketEntities: end of message" );
+        }
+        
+        while ( oldnum < newnum )
+        {
+            // one or more entities from the old packet are unchanged
+            if ( parse->showNet >= 3 )
+            {
+                Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
+            }
+            
+            DeltaEntity( parse, msg, newframe, oldnum, oldstate, true );
+            
+            oldindex++;
+            
+            if ( oldindex >= oldframe->numEntities )
+            {
+                oldnum = 99999;
+            }
+            else
+            {
+                oldstate = &parse->parseEntities[
+                               ( oldframe->parseEntitiesNum + oldindex ) & ( parse->maxParseEntities - 1 )];
+                oldnum = oldstate->number;
+            }
+        }
+        if ( oldnum == newnum )
+        {
+            // delta from previous state
+            if ( parse->showNet >= 3 )
+            {
+                Com_Printf( "%3i:  delta: %i\n", msg->readcount, newnum );
+            }
+            
+            DeltaEntity( parse, msg, newframe, newnum, oldstate, false );
+            
+            oldindex++;
+            
+            if ( oldindex >= oldframe->numEntities )
+            {
+                oldnum = 99999;
+            }
+            else
+            {
+                oldstate = &parse->parseEntities[
+                               ( oldframe->parseEntitiesNum + oldindex ) & ( parse->maxParseEntities - 1 )];
+                oldnum = oldstate->number;
+            }
+            continue;
+        }
+        
+        if ( oldnum > newnum )
+        {
+            // delta from baseline
+            if ( parse->showNet >= 3 )
+            {
+                Com_Printf( "%3i:  baseline: %i\n", msg->readcount, newnum );
+            }
+            
+            DeltaEntity( parse, msg, newframe, newnum, &parse->baselines[newnum], false );
+            
+            continue;
+        }
+        
+    }
+    
+    // any remaining entities in the old frame are copied over
+    while ( oldnum != 99999 )
+    {
+        // one or more entities from the old packet are unchanged
+        if ( parse->showNet >= 3 )
+        {
+            Com_Printf( "%3i:  unchanged: %i\n", msg->readcount, oldnum );
+        }
+        
+        DeltaEntity( parse, msg, newframe, oldnum, oldstate, true );
+        
+        oldindex++;
+        
+        if ( oldindex >= oldframe->numEntities )
+        {
+            oldnum = 99999;
+        }
+        else
+        {
+            oldstate = &parse->parseEntities[
+                           ( oldframe->parseEntitiesNum + oldindex ) & ( parse->maxParseEntities - 1 )];
+            oldnum = oldstate->number;
+        }
+    }
+}
+
+/*
+================
+idSnapshotParseSystemLocal::ParseSnapshot
+
+Reads a snapshot into newSnap and returns whether it is valid. A valid
+snapshot goes to StoreSnapshot, an invalid one has been read in full and
+is dropped without changing any state.
+================
+*/
+bool idSnapshotParseSystemLocal::ParseSnapshot( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* newSnap )
+{
+    S32 len, deltaNum;
+    clSnapshot_t* old;
+    
+    ::memset( newSnap, 0, sizeof( *newSnap ) );
+    
+    // we will have read any new server commands in this
+    // message before we got to svc_snapshot
+    newSnap->serverCommandNum = *parse->serverCommandSequence;
+    
+    newSnap->serverTime = MSG_ReadLong( msg );
+    
+    newSnap->messageNum = parse->serverMessageSequence;
+    
+    deltaNum = MSG_ReadByte( msg );
+    if ( !deltaNum )
+    {
+        newSnap->deltaNum = -1;
+    }
+    else
+    {
+        newSnap->deltaNum = newSnap->messageNum - deltaNum;
+    }
+    
+    newSnap->snapFlags = MSG_ReadByte( msg );
+    
+    // If the frame is delta compressed from data that we
+    // no longer have available, we must suck up the rest of
+    // the frame, but not use it, then ask for a non-compressed
+    // message
+    if ( newSnap->deltaNum <= 0 )
+    {
+        newSnap->valid = true;	// uncompressed frame
+        old = nullptr;
+    }
+    else
+    {
+        old = &parse->snapshots[newSnap->deltaNum & PACKET_MASK];
+        if ( !old->valid )
+        {
+            // should never happen
+            Com_Printf( "Delta from invalid frame (not supposed to happen!).\n" );
+        }
+        else if ( old->messageNum != newSnap->deltaNum )
+        {
+            // The frame that the server did the delta from
+            // is too old, so we can't reconstruct it properly.
+            Com_DPrintf( "Delta frame too old.\n" );
+        }
+        else if ( *parse->parseEntitiesNum - old->parseEntitiesNum > parse->maxParseEntities - 128 )
+        {
+            Com_DPrintf( "Delta parseEntitiesNum too old.\n" );
+        }
+        else
+        {
+            newSnap->valid = true;	// valid delta parse
+        }
+    }
+    
+    // read areamask
+    len = MSG_ReadByte( msg );
+    
+    if ( len < 0 || len > sizeof( newSnap->areamask ) )
+    {
+        Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::ParseSnapshot: Invalid size %d for areamask.", len );
+    }
+    
+    MSG_ReadData( msg, &newSnap->areamask, len );
+    
+    // read playerinfo
+    ShowNet( parse->showNet, msg, "playerstate" );
+    if ( old )
+    {
+        MSG_ReadDeltaPlayerstate( msg, &old->ps, &newSnap->ps );
+    }
+    else
+    {
+        MSG_ReadDeltaPlayerstate( msg, nullptr, &newSnap->ps );
+    }
+    
+    // read packet entities
+    ShowNet( parse->showNet, msg, "packet entities" );
+    
+    ParsePacketEntities( parse, msg, old, newSnap );
+    
+    return newSnap->valid;
+}
+
+/*
+================
+idSnapshotParseSystemLocal::StoreSnapshot
+
+Makes a valid snapshot the current one and saves it off for later deltas
+================
+*/
+void idSnapshotParseSystemLocal::StoreSnapshot( snapshotParse_t* parse, clSnapshot_t* newSnap )
+{
+    S32 oldMessageNum;
+    
+    // clear the valid flags of any snapshots between the last
+    // received and this one, so if there was a dropped packet
+    // it won't look like something valid to delta from next
+    // time we wrap around in the buffer
+    oldMessageNum = parse->snap->messageNum + 1;
+    
+    if ( newSnap->messageNum - oldMessageNum >= PACKET_BACKUP )
+    {
+        oldMessageNum = newSnap->messageNum - ( PACKET_BACKUP - 1 );
+    }
+    for ( ; oldMessageNum < newSnap->messageNum; oldMessageNum++ )
+    {
+        parse->snapshots[oldMessageNum & PACKET_MASK].valid = false;
+    }
+    
+    // copy to the current good spot
+    *parse->snap = *newSnap;
+    
+    // save the frame off in the backup array for later delta comparisons
+    parse->snapshots[newSnap->messageNum & PACKET_MASK] = *newSnap;
+}
+
+/*
+====================
+idSnapshotParseSystemLocal::GetSnapshot
+
+Copies a snapshot out the way cgame gets it
+====================
+*/
+bool idSnapshotParseSystemLocal::GetSnapshot( snapshotParse_t* parse, S32 snapshotNumber, snapshot_t* snapshot )
+{
+    S32 i, count;
+    clSnapshot_t* clSnap;
+    
+    if ( snapshotNumber > parse->snap->messageNum )
+    {
+        Com_Error( ERR_DROP, "idSnapshotParseSystemLocal::GetSnapshot: snapshotNumber > cl.snapshot.messageNum" );
+    }
+    
+    // if the frame has fallen out of the circular buffer, we can't return it
+    if ( parse->snap->messageNum - snapshotNumber >= PACKET_BACKUP )
+    {
+        return false;
+    }
+    
+    // if the frame is not valid, we can't return it
+    clSnap = &parse->snapshots[snapshotNumber & PACKET_MASK];
+    if ( !clSnap->valid )
+    {
+        return false;
+    }
+    
+    // if the entities in the frame have fallen out of their
+    // circular buffer, we can't return it
+    if ( *parse->parseEntitiesNum - clSnap->parseEntitiesNum >= parse->maxParseEntities )
+    {
+        return false;
+    }
+    
+    // write the snapshot
+    snapshot->snapFlags = clSnap->snapFlags;
+    snapshot->serverCommandSequence = clSnap->serverCommandNum;
+    snapshot->ping = clSnap->ping;
+    snapshot->serverTime = clSnap->serverTime;
+    ::memcpy( snapshot->areamask, clSnap->areamask, sizeof( snapshot->areamask ) );
+    snapshot->ps = clSnap->ps;
+    
+    count = clSnap->numEntities;
+    if ( count > MAX_ENTITIES_IN_SNAPSHOT )
+    {
+        Com_DPrintf( "idSnapshotParseSystemLocal::GetSnapshot: truncated %i entities to %i\n", count, MAX_ENTITIES_IN_SNAPSHOT );
+        count = MAX_ENTITIES_IN_SNAPSHOT;
+    }
+    
+    snapshot->numEntities = count;
+    
+    for ( i = 0; i < count; i++ )
+    {
+        snapshot->entities[i] = parse->parseEntities[( clSnap->parseEntitiesNum + i ) & ( parse->maxParseEntities - 1 )];
+    }
+    
+    // FIXME: configstring changes and server commands!!!
+    
+    return true;
+}
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Copyright(C) 2019 - 2020 Dusan Jocic <dusanjocic@msn.com>
+//
+// This file is part of the OpenWolf GPL Source Code.
+// OpenWolf Source Code is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenWolf Source Code is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenWolf Source Code. If not, see <http://www.gnu.org/licenses/>.
+//
+// -------------------------------------------------------------------------------------
+// File name:   SnapshotParse.h
+// Created:
+// Compilers:   Microsoft Visual C++ 2019, gcc (Ubuntu 8.3.0-6ubuntu1) 8.3.0
+// Description: server message parsing shared by the client and demoAnalyze
+// -------------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SNAPSHOTPARSE_H__
+#define __SNAPSHOTPARSE_H__
+
+/*
+==============================================================================
+SNAPSHOT PARSING
+
+The parts of a server message that become client state, the gamestate,
+server commands and delta compressed snapshots, and the framing of demo
+files. The client and demoAnalyze both parse through these, each into the
+storage its snapshotParse_t points at. A message that can't be read is
+dropped with Com_Error like everywhere else in the message reader.
+==============================================================================
+*/
+
+// snapshots are a view of the server at a given time
+typedef struct
+{
+    bool        valid;							// cleared if delta parsing was invalid
+    S32             snapFlags;						// rate delayed and dropped commands
+    S32             serverTime;						// server time the message is valid for (in msec)
+    S32             messageNum;						// copied from netchan->incoming_sequence
+    S32             deltaNum;						// messageNum the delta is from
+    S32             ping;							// time from when cmdNum-1 was sent to time packet was reeceived
+    U8            areamask[MAX_MAP_AREA_BYTES];	// portalarea visibility bits
+    S32             cmdNum;							// the next cmdNum the server is expecting
+    playerState_t   ps;								// complete information about the current player at this time
+    S32             numEntities;					// all of the entities that need to be presented
+    S32             parseEntitiesNum;				// at the time of this snapshot
+    S32             serverCommandNum;				// execute all commands up to this before
+    // making the snapshot current
+} clSnapshot_t;
+
+typedef struct
+{
+    gameState_t* gameState;
+    entityState_t* baselines;			// MAX_GENTITIES
+    clSnapshot_t* snap;					// latest valid snapshot
+    clSnapshot_t* snapshots;			// PACKET_BACKUP, to delta from
+    entityState_t* parseEntities;
+    S32 maxParseEntities;				// a power of two
+    S32* parseEntitiesNum;
+    S32* serverCommandSequence;
+    S32 serverMessageSequence;			// of the message being parsed
+    S32 showNet;						// cl_shownet level, 2 marks the parts of a message, 3 every entity
+    
+    // every entity added to a frame goes through this, if set
+    void ( *addEntity )( entityState_t* state, clSnapshot_t* frame );
+} snapshotParse_t;
+
+//
+// idSnapshotParseSystemLocal
+//
+class idSnapshotParseSystemLocal
+{
+public:
+    idSnapshotParseSystemLocal( void );
+    ~idSnapshotParseSystemLocal( void );
+    
+    static bool ReadDemoMessage( fileHandle_t f, msg_t* msg, S32* serverMessageSequence );
+    static void ShowNet( S32 showNet, msg_t* msg, StringEntry s );
+    static S32 ReadCommand( msg_t* msg, S32 showNet );
+    static bool ParseCommandString( snapshotParse_t* parse, msg_t* msg, UTF8** command );
+    static void ParseGamestate( snapshotParse_t* parse, msg_t* msg );
+    static void DeltaEntity( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* frame, S32 newnum, entityState_t* old, bool unchanged );
+    static void ParsePacketEntities( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* oldframe, clSnapshot_t* newframe );
+    static bool ParseSnapshot( snapshotParse_t* parse, msg_t* msg, clSnapshot_t* newSnap );
+    static void StoreSnapshot( snapshotParse_t* parse, clSnapshot_t* newSnap );
+    static bool GetSnapshot( snapshotParse_t* parse, S32 snapshotNumber, snapshot_t* snapshot );
+};
+
+extern idSnapshotParseSystemLocal snapshotParseSystemLocal;
+
+#endif //!__SNAPSHOTPARSE_H__
@@ -136,6 +136,58 @@ void idThreadsSystemLocal::Thread_Join( qthread_t* thread )
     systemThreadsSystem->Thread_Join( thread );
 }
 
+/*
+* QCondVar_Create
+*/
+qcondvar_t* idThreadsSystemLocal::CondVar_Create( void )
+{
+    S32 ret;
+    qcondvar_t* cond;
+    
+    ret = systemThreadsSystem->CondVar_Create( &cond );
+    if ( ret != 0 )
+    {
+        return nullptr;
+    }
+    return cond;
+}
+
+/*
+* QCondVar_Destroy
+*/
+void idThreadsSystemLocal::CondVar_Destroy( qcondvar_t** pcond )
+{
+    assert( pcond != nullptr );
+    if ( pcond && *pcond )
+    {
+        systemThreadsSystem->CondVar_Destroy( *pcond );
+        *pcond = nullptr;
+    }
+}
+
+/*
+* QCondVar_Wait
+
+The mutex must be held; it is released while waiting. Returns false when
+msec ran out first, callers recheck their condition either way.
+*/
+bool idThreadsSystemLocal::CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec )
+{
+    assert( cond != nullptr && mutex != nullptr );
+    return systemThreadsSystem->CondVar_Wait( cond, mutex, msec );
+}
+
+/*
+* QCondVar_Wake
+
+Wakes every thread waiting on cond.
+*/
+void idThreadsSystemLocal::CondVar_Wake( qcondvar_t* cond )
+{
+    assert( cond != nullptr );
+    systemThreadsSystem->CondVar_Wake( cond );
+}
+
 /*
 * QThreads_Init
 */
@@ -162,4 +214,251 @@ void idThreadsSystemLocal::Threads_Shutdown( void )
         systemThreadsSystem->Mutex_Destroy( global_mutex );
         global_mutex = nullptr;
     }
-}
\ No newline at end of file
+}
+
+static convar_t* com_jobThreads;
+
+static qmutex_t* jobs_mutex;
+static qcondvar_t* jobs_added;		// a job was queued, or the pool is quitting
+static qcondvar_t* jobs_done;		// a job with a group finished
+static qjob_t jobs_queue[MAX_QUEUED_JOBS];
+static S32 jobs_head;			// jobs ever queued
+static S32 jobs_tail;			// jobs ever taken off the queue
+static qthread_t* jobs_threads[MAX_JOB_THREADS];
+static S32 jobs_numThreads;
+static bool jobs_quit;
+
+/*
+===============
+idThreadsSystemLocal::RunJob
+
+Runs a job taken off the queue and retires it from its group. Called
+without the queue mutex held.
+===============
+*/
+void idThreadsSystemLocal::RunJob( qjob_t* job )
+{
+    job->func( job->data );
+    
+    if ( job->group )
+    {
+        threadsSystemLocal.Mutex_Lock( jobs_mutex );
+        job->group->pending--;
+        threadsSystemLocal.CondVar_Wake( jobs_done );
+        threadsSystemLocal.Mutex_Unlock( jobs_mutex );
+    }
+}
+
+/*
+===============
+idThreadsSystemLocal::JobThread
+
+Sleeps until there is a job to run. Jobs still queued when the pool quits
+are run before the thread exits.
+===============
+*/
+void* idThreadsSystemLocal::JobThread( void* param )
+{
+    qjob_t job;
+    
+    threadsSystemLocal.Mutex_Lock( jobs_mutex );
+    
+    while ( 1 )
+    {
+        while ( jobs_tail == jobs_head && !jobs_quit )
+        {
+            threadsSystemLocal.CondVar_Wait( jobs_added, jobs_mutex, COND_WAIT_FOREVER );
+        }
+        
+        if ( jobs_tail == jobs_head )
+        {
+            break;
+        }
+        
+        job = jobs_queue[jobs_tail % MAX_QUEUED_JOBS];
+        jobs_tail++;
+        
+        // Job_Wait ran it already
+        if ( !job.func )
+        {
+            continue;
+        }
+        
+        threadsSystemLocal.Mutex_Unlock( jobs_mutex );
+        RunJob( &job );
+        threadsSystemLocal.Mutex_Lock( jobs_mutex );
+    }
+    
+    threadsSystemLocal.Mutex_Unlock( jobs_mutex );
+    
+    return nullptr;
+}
+
+/*
+===============
+idThreadsSystemLocal::Jobs_Init
+===============
+*/
+void idThreadsSystemLocal::Jobs_Init( void )
+{
+    S32 i, numThreads;
+    
+    com_jobThreads = cvarSystem->Get( "com_jobThreads", "0", CVAR_ARCHIVE | CVAR_LATCH, "Worker threads in the job pool that streams, decodes and encodes in the background, 0 uses one less than the number of cores" );
+    
+    numThreads = com_jobThreads->integer;
+    if ( numThreads <= 0 )
+    {
+        numThreads = SDL_GetCPUCount() - 1;
+    }
+    numThreads = Q_bound( 1, numThreads, MAX_JOB_THREADS );
+    
+    jobs_mutex = Mutex_Create();
+    jobs_added = CondVar_Create();
+    jobs_done = CondVar_Create();
+    if ( !jobs_mutex || !jobs_added || !jobs_done )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't create the job pool, jobs run inline\n" );
+        Jobs_Shutdown();
+        return;
+    }
+    
+    jobs_head = jobs_tail = 0;
+    jobs_quit = false;
+    
+    Mutex_Lock( jobs_mutex );
+    for ( i = 0; i < numThreads; i++ )
+    {
+        jobs_threads[i] = Thread_Create( JobThread, nullptr );
+        if ( !jobs_threads[i] )
+        {
+            break;
+        }
+    }
+    jobs_numThreads = i;
+    Mutex_Unlock( jobs_mutex );
+    
+    Com_DPrintf( "job pool: %i threads\n", jobs_numThreads );
+}
+
+/*
+===============
+idThreadsSystemLocal::Jobs_Shutdown
+
+Every queued job still runs; the subsystems have waited on their groups
+by the time this is called, so normally the queue is empty.
+===============
+*/
+void idThreadsSystemLocal::Jobs_Shutdown( void )
+{
+    S32 i, numThreads;
+    
+    if ( jobs_mutex )
+    {
+        Mutex_Lock( jobs_mutex );
+        jobs_quit = true;
+        numThreads = jobs_numThreads;
+        jobs_numThreads = 0;
+        CondVar_Wake( jobs_added );
+        Mutex_Unlock( jobs_mutex );
+        
+        for ( i = 0; i < numThreads; i++ )
+        {
+            Thread_Join( jobs_threads[i] );
+            jobs_threads[i] = nullptr;
+        }
+    }
+    
+    CondVar_Destroy( &jobs_done );
+    CondVar_Destroy( &jobs_added );
+    Mutex_Destroy( &jobs_mutex );
+}
+
+/*
+===============
+idThreadsSystemLocal::Job_Add
+
+Queues func( data ) for the pool. group may be nullptr for a job nobody
+waits on. When the queue is full or the pool isn't running the job runs
+right here instead.
+===============
+*/
+void idThreadsSystemLocal::Job_Add( qjobGroup_t* group, void ( *func )( void* ), void* data )
+{
+    qjob_t* job;
+    
+    if ( jobs_mutex )
+    {
+        Mutex_Lock( jobs_mutex );
+        
+        if ( jobs_numThreads && jobs_head - jobs_tail < MAX_QUEUED_JOBS )
+        {
+            job = &jobs_queue[jobs_head % MAX_QUEUED_JOBS];
+            job->func = func;
+            job->data = data;
+            job->group = group;
+            jobs_head++;
+            
+            if ( group )
+            {
+                group->pending++;
+            }
+            
+            CondVar_Wake( jobs_added );
+            Mutex_Unlock( jobs_mutex );
+            return;
+        }
+        
+        Mutex_Unlock( jobs_mutex );
+    }
+    
+    func( data );
+}
+
+/*
+===============
+idThreadsSystemLocal::Job_Wait
+
+Returns once every job added with group has finished. Jobs of the group
+that no worker has picked up yet are run by the caller rather than waited
+on.
+===============
+*/
+void idThreadsSystemLocal::Job_Wait( qjobGroup_t* group )
+{
+    S32 i;
+    qjob_t job, *queued;
+    
+    if ( !jobs_mutex )
+    {
+        return;
+    }
+    
+    Mutex_Lock( jobs_mutex );
+    
+    while ( group->pending > 0 )
+    {
+        for ( i = jobs_tail; i < jobs_head; i++ )
+        {
+            queued = &jobs_queue[i % MAX_QUEUED_JOBS];
+            if ( queued->func && queued->group == group )
+            {
+                break;
+            }
+        }
+        
+        if ( i == jobs_head )
+        {
+            CondVar_Wait( jobs_done, jobs_mutex, COND_WAIT_FOREVER );
+            continue;
+        }
+        
+        job = *queued;
+        queued->func = nullptr;
+        
+        Mutex_Unlock( jobs_mutex );
+        RunJob( &job );
+        Mutex_Lock( jobs_mutex );
+    }
+    
+    Mutex_Unlock( jobs_mutex );
+}
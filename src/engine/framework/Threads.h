@@ -37,6 +37,28 @@
 #ifndef __THREADS_H__
 #define __THREADS_H__
 
+/*
+==============================================================================
+JOB POOL
+
+A fixed set of worker threads runs jobs from one queue. Subsystems that
+used to keep a thread of their own add jobs to a group and wait on the
+group, and every wait in between sleeps on a condition variable rather
+than polling. A job runs inline when the queue is full or the pool is
+not running, so Job_Add never blocks and never drops work.
+==============================================================================
+*/
+
+#define MAX_QUEUED_JOBS 1024
+#define MAX_JOB_THREADS 16
+
+typedef struct
+{
+    void ( *func )( void* );	// nullptr once Job_Wait took the job
+    void* data;
+    qjobGroup_t* group;
+} qjob_t;
+
 //
 // idServerBotSystemLocal
 //
@@ -52,8 +74,19 @@ public:
     virtual void Mutex_Unlock( qmutex_t* mutex );
     virtual qthread_t* Thread_Create( void * ( *routine )( void* ), void* param );
     virtual void Thread_Join( qthread_t* thread );
+    virtual qcondvar_t* CondVar_Create( void );
+    virtual void CondVar_Destroy( qcondvar_t** pcond );
+    virtual bool CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec );
+    virtual void CondVar_Wake( qcondvar_t* cond );
     virtual void Threads_Init( void );
     virtual void Threads_Shutdown( void );
+    virtual void Jobs_Init( void );
+    virtual void Jobs_Shutdown( void );
+    virtual void Job_Add( qjobGroup_t* group, void ( *func )( void* ), void* data );
+    virtual void Job_Wait( qjobGroup_t* group );
+    
+    static void RunJob( qjob_t* job );
+    static void* JobThread( void* param );
 };
 
 extern idThreadsSystemLocal threadsSystemLocal;
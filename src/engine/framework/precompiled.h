@@ -139,6 +139,8 @@
 #include <renderSystem/r_types.h>
 #include <API/Memory_api.h>
 #include <framework/Memory.h>
+#include <API/Profiler_api.h>
+#include <framework/Profiler.h>
 #include <API/Parse_api.h>
 #include <framework/Parse.h>
 #include <API/cm_api.h>
@@ -158,6 +160,8 @@
 #include <API/clientGUI_api.h>
 #include <API/clientGame_api.h>
 #include <qcommon/qcommon.h>
+#include <framework/SnapshotParse.h>
+#include <framework/DemoAnalyze.h>
 #include <framework/keycodes.h>
 #include <API/clientKeys_api.h>
 #include <client/clientKeys.h>
@@ -185,6 +189,7 @@
 #include <client/clientNetworkChain.h>
 #include <API/clientParse_api.h>
 #include <client/clientParse.h>
+#include <client/clientDemo.h>
 
 #include <API/download_api.h>
 #include <download/downloadLocal.h>
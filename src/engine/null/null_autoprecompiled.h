@@ -141,6 +141,8 @@
 #include <renderSystem/r_types.h>
 #include <API/Memory_api.h>
 #include <framework/Memory.h>
+#include <API/Profiler_api.h>
+#include <framework/Profiler.h>
 #include <API/Parse_api.h>
 #include <framework/Parse.h>
 #include <API/cm_api.h>
@@ -156,6 +158,9 @@
 #include <API/FileSystem_api.h>
 #include <API/CVarSystem_api.h>
 #include <qcommon/qcommon.h>
+#include <API/clientGame_api.h>
+#include <framework/SnapshotParse.h>
+#include <framework/DemoAnalyze.h>
 #include <framework/keycodes.h>
 #include <API/clientMain_api.h>
 #include <API/clientKeys_api.h>
@@ -135,6 +135,22 @@ S32 idSystemLocal::Milliseconds( void )
     return ( tp.tv_sec - initial_tv_sec ) * 1000 + tp.tv_usec / 1000;
 }
 
+/*
+================
+idSystemLocal::Nanoseconds
+
+monotonic time for profiling, the origin is arbitrary
+================
+*/
+U64 idSystemLocal::Nanoseconds( void )
+{
+    struct timespec ts;
+    
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    
+    return ( U64 )ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /*
 ==================
 idSystemLocal::RandomBytes
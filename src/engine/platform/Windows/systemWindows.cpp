@@ -137,6 +137,30 @@ S32 idSystemLocal::Milliseconds( void )
     return sys_curtime;
 }
 
+/*
+================
+idSystemLocal::Nanoseconds
+
+monotonic time for profiling, the origin is arbitrary
+================
+*/
+U64 idSystemLocal::Nanoseconds( void )
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    
+    if ( !frequency.QuadPart )
+    {
+        QueryPerformanceFrequency( &frequency );
+    }
+    
+    QueryPerformanceCounter( &counter );
+    
+    // split to keep counter * 1e9 from overflowing
+    return ( U64 )( counter.QuadPart / frequency.QuadPart ) * 1000000000 +
+           ( U64 )( counter.QuadPart % frequency.QuadPart ) * 1000000000 / frequency.QuadPart;
+}
+
 /*
 ================
 idSystemLocal::RandomBytes
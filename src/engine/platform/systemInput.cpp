@@ -1143,6 +1143,7 @@ idSystemLocal::Frame
 void idSystemLocal::Frame( void )
 {
     static S32 eventTime;
+    static cvarRef_t r_fullscreen = CVAR_REF( "r_fullscreen" );
     bool loading;
     
     JoyMove( eventTime );
@@ -1151,7 +1152,7 @@ void idSystemLocal::Frame( void )
     loading = ( bool )( cls.state != CA_DISCONNECTED && cls.state != CA_ACTIVE && !( clientGUISystem->GetCatcher() & KEYCATCH_UI ) );
     
     // update isFullscreen since it might of changed since the last vid_restart
-    cls.glconfig.isFullscreen = cvarSystem->VariableIntegerValue( "r_fullscreen" ) != 0;
+    cls.glconfig.isFullscreen = cvarSystem->RefIntegerValue( &r_fullscreen ) != 0;
     
     if ( !cls.glconfig.isFullscreen && ( clientGUISystem->GetCatcher() & KEYCATCH_CONSOLE ) )
     {
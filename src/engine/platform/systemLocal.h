@@ -146,6 +146,7 @@ public:
     
     virtual UTF8* DefaultHomePath( UTF8* buffer, S32 size );
     virtual S32 Milliseconds( void );
+    virtual U64 Nanoseconds( void );
     virtual bool RandomBytes( U8* string, S32 len );
     virtual UTF8* GetCurrentUser( void );
     virtual bool LowPhysicalMemory( void );
@@ -139,7 +139,7 @@ void idSystemThreadsLocal::Thread_Join( qthread_t* thread )
     if ( thread )
     {
         SDL_WaitThread( thread->t, &status );
-        free( thread );
+        memorySystem->Free( thread );
     }
 }
 
@@ -159,3 +159,64 @@ S32 idSystemThreadsLocal::Thread_Cancel( qthread_t* thread )
     assert( false && "NOT IMPLEMENTED" );
     return -1;
 }
+
+/*
+* Sys_CondVar_Create
+*/
+S32 idSystemThreadsLocal::CondVar_Create( qcondvar_t** pcond )
+{
+    qcondvar_t* cond;
+    
+    *pcond = nullptr;
+    
+    cond = ( qcondvar_t* )malloc( sizeof( *cond ) );
+    if ( !cond )
+    {
+        return -1;
+    }
+    
+    cond->c = SDL_CreateCond();
+    if ( !cond->c )
+    {
+        free( cond );
+        return -1;
+    }
+    
+    *pcond = cond;
+    return 0;
+}
+
+/*
+* Sys_CondVar_Destroy
+*/
+void idSystemThreadsLocal::CondVar_Destroy( qcondvar_t* cond )
+{
+    if ( !cond )
+    {
+        return;
+    }
+    
+    SDL_DestroyCond( cond->c );
+    free( cond );
+}
+
+/*
+* Sys_CondVar_Wait
+*/
+bool idSystemThreadsLocal::CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec )
+{
+    if ( msec == COND_WAIT_FOREVER )
+    {
+        return SDL_CondWait( cond->c, mutex->m ) == 0;
+    }
+    
+    return SDL_CondWaitTimeout( cond->c, mutex->m, msec ) == 0;
+}
+
+/*
+* Sys_CondVar_Wake
+*/
+void idSystemThreadsLocal::CondVar_Wake( qcondvar_t* cond )
+{
+    SDL_CondBroadcast( cond->c );
+}
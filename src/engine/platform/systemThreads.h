@@ -54,6 +54,10 @@ public:
     virtual void Thread_Join( qthread_t* thread );
     virtual void Thread_Yield( void );
     virtual S32 Thread_Cancel( qthread_t* thread );
+    virtual S32 CondVar_Create( qcondvar_t** pcond );
+    virtual void CondVar_Destroy( qcondvar_t* cond );
+    virtual bool CondVar_Wait( qcondvar_t* cond, qmutex_t* mutex, U32 msec );
+    virtual void CondVar_Wake( qcondvar_t* cond );
 };
 
 extern idSystemThreadsLocal systemThreadsLocal;
@@ -130,6 +130,7 @@ S32             com_expectedhunkusage;
 S32             com_hunkusedvalue;
 
 bool com_errorEntered = false;
+thread_local jmp_buf* com_errorRecover;	// an ERR_DROP goes back here instead of ending the frame
 bool com_fullyInitialized = false;
 bool com_gameRestarting = false;
 
@@ -365,6 +366,18 @@ void Com_Error( S32 code, StringEntry fmt, ... )
     
     cvarSystem->Set( "com_errorCode", va( "%i", code ) );
     
+    // a command reading data it doesn't trust, like a batch of demos,
+    // takes the drop itself and the server and client go on running
+    if ( code == ERR_DROP && com_errorRecover )
+    {
+        va_start( argptr, fmt );
+        Q_vsnprintf( com_errorMessage, sizeof( com_errorMessage ), fmt, argptr );
+        va_end( argptr );
+        
+        com_errorEntered = false;
+        longjmp( *com_errorRecover, -1 );
+    }
+    
     // when we are running automated scripts, make sure we
     // know if anything failed
     if ( com_buildScript && com_buildScript->integer )
@@ -1286,6 +1299,8 @@ S32 Com_EventLoop( void )
     static U8       bufData[MAX_MSGLEN];
     msg_t           buf;
     
+    PROFILE_ZONE( "Com_EventLoop" );
+    
     MSG_Init( &buf, bufData, sizeof( bufData ) );
     
     while ( 1 )
@@ -1803,6 +1818,7 @@ void Com_Init( UTF8* commandLine )
     
     memorySystem->InitZoneMemory();
     cmdSystem->Init();
+    profilerSystem->Init();
     
     // get the developer cvar set as early as possible
     Com_StartupVariable( "developer" );
@@ -2001,6 +2017,7 @@ void Com_Init( UTF8* commandLine )
     }
     cmdSystem->AddCommand( "quit", Com_Quit_f, "description" );
     cmdSystem->AddCommand( "writeconfig", Com_WriteConfig_f, "Writes current settings to a file in your cfg folder, assumes .cfg as default file extension" );
+    cmdSystem->AddCommand( "demoAnalyze", &idDemoAnalyzeSystemLocal::Analyze_f, "Reads client demos without cgame, renderer or sound and reports their statistics and demos/hour, optionally one slice of them per process" );
     
     s = va( "%s %s %s %s", Q3_VERSION, ARCH_STRING, OS_STRING, __DATE__ );
     com_version = cvarSystem->Get( "version", s, CVAR_ROM | CVAR_SERVERINFO, "description" );
@@ -2029,6 +2046,8 @@ void Com_Init( UTF8* commandLine )
     
     networkChainSystem->Init( Com_Milliseconds() & 0xffff );	// pick a port value that should be nice and random
     
+    threadsSystem->Jobs_Init();
+    
     serverInitSystem->Init();
     
     idConsoleHistorySystemLocal::HistoryLoad();
@@ -2278,6 +2297,13 @@ void Com_Frame( void )
     // old net chan encryption key
     key = 0x87243987;
     
+    // throw away the scratch memory of the last frame
+    memorySystem->FrameInit();
+    
+    profilerSystem->Frame();
+    
+    PROFILE_ZONE( "Com_Frame" );
+    
     // Don't write config on Update Server
 #if !defined (UPDATE_SERVER)
     // write config file if anything changed
@@ -2542,6 +2568,10 @@ void Com_Shutdown( bool badProfile )
         com_journalFile = 0;
     }
     
+    profilerSystem->Shutdown();
+    
+    threadsSystem->Jobs_Shutdown();
+    
     threadsSystem->Mutex_Destroy( &com_print_mutex );
     
     threadsSystem->Threads_Shutdown();
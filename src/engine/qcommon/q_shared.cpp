@@ -1867,10 +1867,11 @@ UTF8* va( StringEntry format, ... )
     S32 len;
     va_list argptr;
 #define MAX_VA_STRING   32000
-    static UTF8 temp_buffer[MAX_VA_STRING];
+    // every thread formats into its own buffers
+    static thread_local UTF8 temp_buffer[MAX_VA_STRING];
     // in case va is called by nested functions
-    static UTF8 string[MAX_VA_STRING];
-    static S32 index = 0;
+    static thread_local UTF8 string[MAX_VA_STRING];
+    static thread_local S32 index = 0;
     UTF8* buf;
     
     va_start( argptr, format );
@@ -481,6 +481,8 @@ extern S32      com_expectedhunkusage;
 extern S32      com_hunkusedvalue;
 
 extern bool com_errorEntered;
+extern thread_local jmp_buf* com_errorRecover;	// per thread, only the thread that set it recovers
+extern UTF8 com_errorMessage[MAXPRINTMSG];
 
 extern fileHandle_t com_journalFile;
 extern fileHandle_t com_journalDataFile;
@@ -38,6 +38,7 @@ idSystem* idsystem;
 idClientAVISystemAPI* clientAVISystem;
 idClientMainSystem* clientMainSystem;
 idMemorySystem* memorySystem;
+idProfilerSystem* profilerSystem;
 
 #ifdef __LINUX__
 extern "C" idRenderSystem* rendererEntry( rendererImports_t* renimports )
@@ -56,6 +57,7 @@ Q_EXPORT idRenderSystem* rendererEntry( rendererImports_t* renimports )
     memorySystem = imports->memorySystem;
     clientAVISystem = imports->clientAVISystem;
     clientMainSystem = imports->clientMainSystem;
+    profilerSystem = imports->profilerSystem;
     
     return renderSystem;
 }
@@ -1589,7 +1589,7 @@ const void* idRenderSystemBackendLocal::SwapBuffers( const void* data )
         S64 sum = 0;
         U8* stencilReadback = nullptr;
         
-        stencilReadback = ( U8* )memorySystem->AllocateTempMemory( glConfig.vidWidth * glConfig.vidHeight );
+        stencilReadback = ( U8* )memorySystem->FrameAlloc( glConfig.vidWidth * glConfig.vidHeight );
         qglReadPixels( 0, 0, glConfig.vidWidth, glConfig.vidHeight, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, stencilReadback );
         
         for ( i = 0; i < glConfig.vidWidth * glConfig.vidHeight; i++ )
@@ -1598,7 +1598,6 @@ const void* idRenderSystemBackendLocal::SwapBuffers( const void* data )
         }
         
         backEnd.pc.c_overDraw += sum;
-        memorySystem->FreeTempMemory( stencilReadback );
     }
     
     if ( glRefConfig.framebufferObject )
@@ -1938,6 +1937,8 @@ void idRenderSystemBackendLocal::ExecuteRenderCommands( const void* data )
 {
     S32		t1, t2;
     
+    PROFILE_ZONE( "RB_ExecuteRenderCommands" );
+    
     t1 = clientMainSystem->ScaledMilliseconds();
     
     while ( 1 )
@@ -718,7 +718,7 @@ void idRenderSystemLocal::EndFrame( S32* frontEndMsec, S32* backEndMsec )
 idRenderSystemLocal::TakeVideoFrame
 =============
 */
-void idRenderSystemLocal::TakeVideoFrame( S32 width, S32 height, U8* captureBuffer, U8* encodeBuffer, bool motionJpeg )
+void idRenderSystemLocal::TakeVideoFrame( S32 width, S32 height, U8* captureBuffer )
 {
     videoFrameCommand_t*	cmd = nullptr;
     
@@ -738,7 +738,58 @@ void idRenderSystemLocal::TakeVideoFrame( S32 width, S32 height, U8* captureBuff
     cmd->width = width;
     cmd->height = height;
     cmd->captureBuffer = captureBuffer;
-    cmd->encodeBuffer = encodeBuffer;
-    cmd->motionJpeg = motionJpeg;
+}
+
+/*
+=============
+idRenderSystemLocal::EncodeVideoFrame
+
+Turns a frame read back by TakeVideoFrame into the contents of an AVI video
+chunk and returns its size. It doesn't touch any GL or renderer state, so the
+client can call it from any thread
+=============
+*/
+S32 idRenderSystemLocal::EncodeVideoFrame( U8* encodeBuffer, S32 encodeSize, const U8* captureBuffer, S32 width, S32 height, S32 padding, bool motionJpeg )
+{
+    S32 linelen, avipadwidth, avipadlen;
+    const U8* lineend, *memend, *srcptr;
+    U8* destptr;
+    
+    linelen = width * 3;
+    
+    if ( motionJpeg )
+    {
+        return ( S32 )idRenderSystemImageJPEGLocal::SaveJPGToBuffer( encodeBuffer, encodeSize, r_aviMotionJpegQuality->integer,
+                width, height, const_cast<U8*>( captureBuffer ), padding );
+    }
+    
+    // AVI line padding
+    avipadwidth = PAD( linelen, AVI_LINE_PADDING );
+    avipadlen = avipadwidth - linelen;
+    
+    srcptr = captureBuffer;
+    destptr = encodeBuffer;
+    memend = srcptr + ( linelen + padding ) * height;
+    
+    // swap R and B and remove line paddings
+    while ( srcptr < memend )
+    {
+        lineend = srcptr + linelen;
+        
+        while ( srcptr < lineend )
+        {
+            *destptr++ = srcptr[2];
+            *destptr++ = srcptr[1];
+            *destptr++ = srcptr[0];
+            srcptr += 3;
+        }
+        
+        ::memset( destptr, '\0', avipadlen );
+        destptr += avipadlen;
+        
+        srcptr += padding;
+    }
+    
+    return avipadwidth * height;
 }
 
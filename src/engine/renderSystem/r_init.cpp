@@ -972,12 +972,14 @@ void idRenderSystemInitLocal::ExportCubemaps_f( void )
 /*
 ==================
 idRenderSystemInitLocal::TakeVideoFrameCmd
+
+Only reads the frame back, the client hands it to EncodeVideoFrame later,
+usually from one of its encoder threads
 ==================
 */
 const void* idRenderSystemInitLocal::TakeVideoFrameCmd( const void* data )
 {
-    S32	padwidth, avipadwidth, padlen, avipadlen, packAlign;
-    size_t memcount;
+    S32	padwidth, padlen, packAlign;
     U64 linelen;
     U8* cBuf;
     const videoFrameCommand_t*	cmd;
@@ -998,51 +1000,11 @@ const void* idRenderSystemInitLocal::TakeVideoFrameCmd( const void* data )
     padwidth = PAD( linelen, packAlign );
     padlen = padwidth - linelen;
     
-    // AVI line padding
-    avipadwidth = PAD( linelen, AVI_LINE_PADDING );
-    avipadlen = avipadwidth - linelen;
-    
     cBuf = ( U8* )PADP( cmd->captureBuffer, packAlign );
     
     qglReadPixels( 0, 0, cmd->width, cmd->height, GL_RGB, GL_UNSIGNED_BYTE, cBuf );
     
-    memcount = padwidth * cmd->height;
-    
-    if ( cmd->motionJpeg )
-    {
-        memcount = idRenderSystemImageJPEGLocal::SaveJPGToBuffer( cmd->encodeBuffer, linelen * cmd->height, r_aviMotionJpegQuality->integer,
-                   cmd->width, cmd->height, cBuf, padlen );
-        clientAVISystem->WriteAVIVideoFrame( cmd->encodeBuffer, ( S32 )memcount );
-    }
-    else
-    {
-        U8* lineend, *memend, * srcptr, *destptr;
-        
-        srcptr = cBuf;
-        destptr = cmd->encodeBuffer;
-        memend = srcptr + memcount;
-        
-        // swap R and B and remove line paddings
-        while ( srcptr < memend )
-        {
-            lineend = srcptr + linelen;
-            
-            while ( srcptr < lineend )
-            {
-                *destptr++ = srcptr[2];
-                *destptr++ = srcptr[1];
-                *destptr++ = srcptr[0];
-                srcptr += 3;
-            }
-            
-            ::memset( destptr, '\0', avipadlen );
-            destptr += avipadlen;
-            
-            srcptr += padlen;
-        }
-        
-        clientAVISystem->WriteAVIVideoFrame( cmd->encodeBuffer, avipadwidth * cmd->height );
-    }
+    clientAVISystem->CaptureAVIVideoFrame( cBuf, padlen );
     
     return ( const void* )( cmd + 1 );
 }
@@ -1957,6 +1957,8 @@ extern	convar_t*	r_printShaders;
 
 extern convar_t*	r_marksOnTriangleMeshes;
 
+extern convar_t* r_aviMotionJpegQuality;
+
 extern convar_t* r_stencilbits;			// number of desired stencil bits
 extern convar_t* r_depthbits;			// number of desired depth bits
 extern convar_t* r_colorbits;			// number of desired color bits, only relevant for fullscreen
@@ -2220,8 +2222,6 @@ typedef struct
     S32						width;
     S32						height;
     U8*					captureBuffer;
-    U8*					encodeBuffer;
-    bool			motionJpeg;
 } videoFrameCommand_t;
 
 typedef struct
@@ -2358,7 +2358,8 @@ public:
     virtual void RemapShader( StringEntry oldShader, StringEntry newShader, StringEntry offsetTime );
     virtual bool GetEntityToken( UTF8* buffer, S32 size );
     virtual bool inPVS( const vec3_t p1, const vec3_t p2 );
-    virtual void TakeVideoFrame( S32 h, S32 w, U8* captureBuffer, U8* encodeBuffer, bool motionJpeg );
+    virtual void TakeVideoFrame( S32 width, S32 height, U8* captureBuffer );
+    virtual S32 EncodeVideoFrame( U8* encodeBuffer, S32 encodeSize, const U8* captureBuffer, S32 width, S32 height, S32 padding, bool motionJpeg );
     virtual void* MainWindow( void );
 };
 
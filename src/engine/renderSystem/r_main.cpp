@@ -1781,6 +1781,8 @@ void idRenderSystemMainLocal::RenderView( viewParms_t* parms )
     S32	firstDrawSurf, numDrawSurfs;
     static int lastTime;
     
+    PROFILE_ZONE( "R_RenderView" );
+    
     if ( parms->viewportWidth <= 0 || parms->viewportHeight <= 0 )
     {
         return;
@@ -161,6 +161,7 @@ extern "C"
 #include <API/threads_api.h>
 #include <framework/Threads.h>
 #include <API/Memory_api.h>
+#include <API/Profiler_api.h>
 #include <API/cm_api.h>
 #include <API/CmdBuffer_api.h>
 #include <API/CmdSystem_api.h>
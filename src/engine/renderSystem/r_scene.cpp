@@ -518,6 +518,8 @@ void idRenderSystemLocal::RenderScene( const refdef_t* fd )
     S32 startTime;
     viewParms_t parms;
     
+    PROFILE_ZONE( "RE_RenderScene" );
+    
     if ( !tr.registered )
     {
         return;
@@ -74,6 +74,8 @@ typedef struct server_s
     struct cmodel_s* models[MAX_MODELS];
     configString_t	configstrings[MAX_CONFIGSTRINGS];
     bool            configstringsmodified[MAX_CONFIGSTRINGS];
+    S32             configstringsDirty[MAX_CONFIGSTRINGS];	// modified indexes, in the order they changed
+    S32             numConfigstringsDirty;
     svEntity_t      svEntities[MAX_GENTITIES];
     
     UTF8*           entityParsePoint;	// used during game VM init
@@ -369,6 +371,8 @@ extern convar_t*  sv_friendlyFire;	// NERVE - SMF
 extern convar_t*  sv_maxlives;	// NERVE - SMF
 extern convar_t*  sv_maxclients;
 extern convar_t* sv_democlients;
+extern convar_t* sv_demoWriteThread;
+extern convar_t* sv_demoKeyFrameInterval;
 extern convar_t*  sv_needpass;
 
 extern convar_t*  sv_privateClients;
@@ -1283,6 +1283,164 @@ void idServerCcmdsSystemLocal::CompleteDemoName( UTF8* args, S32 argNum )
 }
 
 
+/*
+==================
+idServerCcmdsSystemLocal::ConfigstringBenchPass
+
+Runs one pass of the cs bench with the fake clients in the given state and
+returns the time it took. Every frame changes the same set of strings
+several times and then flushes the changes like SendClientMessages does.
+Primed clients get their pending strings once the pass is over, as when
+they enter the game
+==================
+*/
+S32 idServerCcmdsSystemLocal::ConfigstringBenchPass( S32 frames, S32 first, S32 updates, client_t** fake, S32 numFake, clientState_t state, S32* sent )
+{
+    S32 i, j, k, start;
+    
+    for ( i = 0; i < numFake; i++ )
+    {
+        fake[i]->state = state;
+    }
+    
+    *sent = 0;
+    start = idsystem->Milliseconds();
+    
+    for ( i = 0; i < frames; i++ )
+    {
+        for ( j = first; j < MAX_CONFIGSTRINGS; j++ )
+        {
+            for ( k = 0; k < updates; k++ )
+            {
+                serverInitSystem->SetConfigstring( j, va( "n\\bench%i\\t\\%i\\f\\%i", j, k, i ) );
+            }
+        }
+        
+        *sent += sv.numConfigstringsDirty;
+        serverInitSystem->UpdateConfigStrings();
+        
+        // the fake clients acknowledge everything, their
+        // reliable command buffers never overflow
+        for ( j = 0; j < numFake; j++ )
+        {
+            fake[j]->reliableAcknowledge = fake[j]->reliableSequence;
+        }
+    }
+    
+    if ( state == CS_PRIMED )
+    {
+        for ( i = 0; i < numFake; i++ )
+        {
+            fake[i]->state = CS_ACTIVE;
+            serverInitSystemLocal.SendPendingConfigstrings( fake[i] );
+            fake[i]->reliableAcknowledge = fake[i]->reliableSequence;
+        }
+    }
+    
+    return idsystem->Milliseconds() - start;
+}
+
+/*
+==================
+idServerCcmdsSystemLocal::ConfigstringBench_f
+
+Simulates a game that churns configstrings at a high rate: every frame the
+same set of strings is changed several times. The bench is run without any
+clients, and with free slots posing as primed and as active clients
+==================
+*/
+void idServerCcmdsSystemLocal::ConfigstringBench_f( void )
+{
+    S32 i, frames, count, updates, first, want, numFake, msec, sent;
+    S32 savedSequence[MAX_CLIENTS], savedAcknowledge[MAX_CLIENTS];
+    UTF8* saved[MAX_CONFIGSTRINGS];
+    client_t* client, *fake[MAX_CLIENTS];
+    sharedEntity_t* savedEnt[MAX_CLIENTS];
+    static const clientState_t states[] = { CS_FREE, CS_PRIMED, CS_ACTIVE };
+    static StringEntry stateNames[] = { "no clients", "primed", "active" };
+    
+    if ( !com_sv_running->integer || sv.state != SS_GAME )
+    {
+        Com_Printf( "Server is not running.\n" );
+        return;
+    }
+    
+    // the reliable command buffer of any connected client would overflow
+    for ( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
+    {
+        if ( client->state >= CS_PRIMED )
+        {
+            Com_Printf( "The cs bench can only be run on an empty server.\n" );
+            return;
+        }
+    }
+    
+    if ( cmdSystem->Argc() < 2 )
+    {
+        Com_Printf( "usage: profile_bench cs <frames> [strings per frame] [updates per string] [clients]\n" );
+        return;
+    }
+    
+    frames = atoi( cmdSystem->Argv( 1 ) );
+    count = cmdSystem->Argc() > 2 ? atoi( cmdSystem->Argv( 2 ) ) : 64;
+    updates = cmdSystem->Argc() > 3 ? atoi( cmdSystem->Argv( 3 ) ) : 4;
+    want = cmdSystem->Argc() > 4 ? atoi( cmdSystem->Argv( 4 ) ) : 8;
+    
+    // a frame must fit in the reliable command buffer of the fake clients
+    count = ( S32 )Com_Clamp( 1, Q_min( MAX_CONFIGSTRINGS - RESERVED_CONFIGSTRINGS, MAX_RELIABLE_COMMANDS - 1 ), count );
+    frames = ( S32 )Com_Clamp( 1, 100000, frames );
+    updates = ( S32 )Com_Clamp( 1, 64, updates );
+    want = ( S32 )Com_Clamp( 1, MAX_CLIENTS, want );
+    
+    // the fake clients take free slots, a new connection clears the
+    // slot so only the fields touched here have to be put back
+    for ( i = 0, numFake = 0, client = svs.clients; i < sv_maxclients->integer && numFake < want; i++, client++ )
+    {
+        if ( client->state != CS_FREE )
+        {
+            continue;
+        }
+        
+        fake[numFake] = client;
+        savedEnt[numFake] = client->gentity;
+        savedSequence[numFake] = client->reliableSequence;
+        savedAcknowledge[numFake] = client->reliableAcknowledge;
+        client->gentity = nullptr;
+        numFake++;
+    }
+    
+    // use the top of the configstring space and put it back afterwards
+    first = MAX_CONFIGSTRINGS - count;
+    
+    for ( i = first; i < MAX_CONFIGSTRINGS; i++ )
+    {
+        saved[i] = memorySystem->CopyString( sv.configstrings[i].s );
+    }
+    
+    for ( i = 0; i < ( S32 )ARRAY_LEN( states ); i++ )
+    {
+        msec = ConfigstringBenchPass( frames, first, updates, fake, i ? numFake : 0, states[i], &sent );
+        
+        Com_Printf( "cs bench, %s: %i frames, %i changes, %i sent to %i clients in %i msec (%.3f msec/frame)\n", stateNames[i], frames, frames * count * updates, sent, i ? numFake : 0, msec, ( F32 )msec / frames );
+    }
+    
+    for ( i = 0; i < numFake; i++ )
+    {
+        fake[i]->state = CS_FREE;
+        fake[i]->gentity = savedEnt[i];
+        fake[i]->reliableSequence = savedSequence[i];
+        fake[i]->reliableAcknowledge = savedAcknowledge[i];
+        ::memset( fake[i]->csUpdated, 0, sizeof( fake[i]->csUpdated ) );
+    }
+    
+    for ( i = first; i < MAX_CONFIGSTRINGS; i++ )
+    {
+        serverInitSystem->SetConfigstringNoUpdate( i, saved[i] );
+        memorySystem->Free( saved[i] );
+    }
+}
+
+
 /*
 ==================
 idServerCcmdsSystemLocal::AddOperatorCommands
@@ -1326,6 +1484,7 @@ void idServerCcmdsSystemLocal::AddOperatorCommands( void )
     cmdSystem->AddCommand( "demo_play", &idServerCcmdsSystemLocal::Demo_Play_f, "description" );
     cmdSystem->SetCommandCompletionFunc( "demo_play", &idServerCcmdsSystemLocal::CompleteDemoName );
     cmdSystem->AddCommand( "demo_stop", &idServerCcmdsSystemLocal::Demo_Stop_f, "description" );
+    profilerSystem->AddBench( "cs", &idServerCcmdsSystemLocal::ConfigstringBench_f, "Benchmarks configstring propagation, args: <frames> [strings per frame] [updates per string] [clients]" );
     
     cmdSystem->AddCommand( "cheater", &idServerOACSSystemLocal::ExtendedRecordSetCheater_f, "description" );
     
@@ -72,6 +72,8 @@ public:
     static void Demo_Play_f( void );
     static void Demo_Stop_f( void );
     static void CompleteDemoName( UTF8* args, S32 argNum );
+    static void ConfigstringBench_f( void );
+    static S32 ConfigstringBenchPass( S32 frames, S32 first, S32 updates, client_t** fake, S32 numFake, clientState_t state, S32* sent );
 };
 
 extern idServerCcmdsSystemLocal serverCcmdsLocal;
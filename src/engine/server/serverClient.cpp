@@ -784,7 +784,7 @@ void idServerClientSystemLocal::ClientEnterWorld( client_t* client, usercmd_t* c
     
     // resend all configstrings using the cs commands since these are
     // no longer sent when the client is CS_PRIMED
-    serverInitSystem->UpdateConfigStrings();
+    serverInitSystemLocal.SendPendingConfigstrings( client );
     
     // set up the entity for the client
     clientNum = ARRAY_INDEX( svs.clients, client );
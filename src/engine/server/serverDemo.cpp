@@ -46,6 +46,8 @@
 idServerDemoSystemLocal serverDemoSystemLocal;
 idServerDemoSystem* serverDemoSystem = &serverDemoSystemLocal;
 
+static demoWriter_t demoWriter;
+
 /*
 ===============
 idServerDemoSystemLocal::idServerDemoSystemLocal
@@ -74,15 +76,160 @@ Write a message to the demo file
 void idServerDemoSystemLocal::DemoWriteMessage( msg_t* msg )
 {
     S32 len;
+    U8* data;
     
     // Write the entire message to the file, prefixed by the length
     MSG_WriteByte( msg, demo_EOF );
     len = LittleLong( msg->cursize );
-    fileSystem->Write( &len, 4, sv.demoFile );
-    fileSystem->Write( msg->data, msg->cursize, sv.demoFile );
+    
+    if ( !demoWriter.running )
+    {
+        fileSystem->Write( &len, 4, sv.demoFile );
+        fileSystem->Write( msg->data, msg->cursize, sv.demoFile );
+        MSG_Clear( msg );
+        return;
+    }
+    
+    // the writer is a whole buffer behind
+    if ( demoWriter.size[demoWriter.fill] + 4 + msg->cursize > DEMO_WRITE_BUFFER_SIZE )
+    {
+        DemoFlushWriter( true );
+    }
+    
+    data = demoWriter.data[demoWriter.fill] + demoWriter.size[demoWriter.fill];
+    ::memcpy( data, &len, 4 );
+    ::memcpy( data + 4, msg->data, msg->cursize );
+    demoWriter.size[demoWriter.fill] += 4 + msg->cursize;
+    
     MSG_Clear( msg );
 }
 
+/*
+====================
+idServerDemoSystemLocal::DemoStartWriter
+
+Sets up the buffers the write jobs write the demo file from, without
+them the demo is written as it is recorded
+====================
+*/
+bool idServerDemoSystemLocal::DemoStartWriter( void )
+{
+    demoWriter.lastKeyFrame = svs.time;
+    demoWriter.stalls = 0;
+    
+    if ( !sv_demoWriteThread->integer )
+    {
+        return false;
+    }
+    
+    demoWriter.data[0] = ( U8* )::malloc( DEMO_WRITE_BUFFER_SIZE );
+    demoWriter.data[1] = ( U8* )::malloc( DEMO_WRITE_BUFFER_SIZE );
+    demoWriter.size[0] = demoWriter.size[1] = 0;
+    demoWriter.fill = 0;
+    
+    SDL_AtomicSet( &demoWriter.pending, 0 );
+    
+    demoWriter.running = demoWriter.data[0] && demoWriter.data[1];
+    
+    if ( !demoWriter.running )
+    {
+        Com_Printf( S_COLOR_YELLOW "WARNING: couldn't start the demo writer, writing the demo from the server thread\n" );
+        DemoStopWriter();
+        return false;
+    }
+    
+    return true;
+}
+
+/*
+====================
+idServerDemoSystemLocal::DemoStopWriter
+
+Writes out everything recorded so far and stops the writer
+====================
+*/
+void idServerDemoSystemLocal::DemoStopWriter( void )
+{
+    if ( demoWriter.running )
+    {
+        DemoFlushWriter( true );
+        
+        threadsSystem->Job_Wait( &demoWriter.jobs );
+        demoWriter.running = false;
+        
+        if ( demoWriter.stalls )
+        {
+            Com_Printf( "Demo writer fell behind on %i frames.\n", demoWriter.stalls );
+        }
+    }
+    
+    ::free( demoWriter.data[0] );
+    ::free( demoWriter.data[1] );
+    demoWriter.data[0] = demoWriter.data[1] = nullptr;
+}
+
+/*
+====================
+idServerDemoSystemLocal::DemoFlushWriter
+
+Hands the messages gathered so far to the writer. If it is still busy with
+the last ones they stay where they are until the next frame, unless wait
+is set
+====================
+*/
+void idServerDemoSystemLocal::DemoFlushWriter( bool wait )
+{
+    S32 write;
+    
+    if ( SDL_AtomicGet( &demoWriter.pending ) )
+    {
+        if ( !wait )
+        {
+            return;
+        }
+        
+        PROFILE_ZONE( "SV_DemoWriterStall" );
+        
+        threadsSystem->Job_Wait( &demoWriter.jobs );
+        
+        demoWriter.stalls++;
+    }
+    
+    if ( !demoWriter.size[demoWriter.fill] )
+    {
+        return;
+    }
+    
+    // the job gets the index of the buffer to write, fill belongs
+    // to the server thread
+    write = demoWriter.fill;
+    demoWriter.fill ^= 1;
+    SDL_AtomicSet( &demoWriter.pending, 1 );
+    
+    threadsSystem->Job_Add( &demoWriter.jobs, DemoWriteJob, ( void* )( intptr_t )write );
+}
+
+/*
+====================
+idServerDemoSystemLocal::DemoWriteJob
+
+The write jobs own the demo file handle while recording, the server thread
+only closes it once the writer has stopped
+====================
+*/
+void idServerDemoSystemLocal::DemoWriteJob( void* data )
+{
+    S32 write;
+    
+    PROFILE_ZONE( "SV_DemoWrite" );
+    
+    write = ( S32 )( intptr_t )data;
+    fileSystem->Write( demoWriter.data[write], demoWriter.size[write], sv.demoFile );
+    demoWriter.size[write] = 0;
+    
+    SDL_AtomicSet( &demoWriter.pending, 0 );
+}
+
 /*
 ====================
 idServerDemoSystemLocal::DemoWriteServerCommand
@@ -132,8 +279,20 @@ void idServerDemoSystemLocal::DemoWriteFrame( void )
     sharedEntity_t* entity;
     S32 i;
     
+    PROFILE_ZONE( "SV_DemoWriteFrame" );
+    
     MSG_Init( &msg, buf, sizeof( buf ) );
     
+    // Every so often write a whole frame, so the demo can be played from there
+    if ( sv.demoState == DS_RECORDING && sv_demoKeyFrameInterval->integer > 0 &&
+            svs.time - demoWriter.lastKeyFrame >= sv_demoKeyFrameInterval->integer * 1000 )
+    {
+        MSG_WriteByte( &msg, demo_keyFrame );
+        ::memset( sv.demoEntities, 0, sizeof( sv.demoEntities ) );
+        ::memset( sv.demoPlayerStates, 0, sizeof( sv.demoPlayerStates ) );
+        demoWriter.lastKeyFrame = svs.time;
+    }
+    
     // Write entities
     MSG_WriteByte( &msg, demo_entityState );
     for ( i = 0; i < sv.num_entities; i++ )
@@ -177,6 +336,8 @@ void idServerDemoSystemLocal::DemoWriteFrame( void )
     MSG_WriteByte( &msg, demo_endFrame );
     MSG_WriteLong( &msg, svs.time );
     DemoWriteMessage( &msg );
+    
+    DemoFlushWriter( false );
 }
 
 /*
@@ -233,6 +394,25 @@ exit_loop:
                 case demo_endDemo:
                     DemoStopPlayback();
                     return;
+                case demo_keyFrame:
+                    // The frame that follows is delta from nothing, unlink
+                    // everything so only what it links stays linked
+                    for ( i = 0; i < sv.num_entities; i++ )
+                    {
+                        if ( i >= sv_democlients->integer && i < MAX_CLIENTS )
+                        {
+                            continue;
+                        }
+                        
+                        entity = serverGameSystem->GentityNum( i );
+                        if ( entity->r.linked )
+                        {
+                            serverWorldSystem->UnlinkEntity( entity );
+                        }
+                    }
+                    ::memset( sv.demoEntities, 0, sizeof( sv.demoEntities ) );
+                    ::memset( sv.demoPlayerStates, 0, sizeof( sv.demoPlayerStates ) );
+                    break;
                 case demo_endFrame:
                     // Overwrite anything the game may have changed
                     for ( i = 0; i < sv.num_entities; i++ )
@@ -324,6 +504,8 @@ void idServerDemoSystemLocal::DemoStartRecord( void )
 {
     msg_t msg;
     
+    DemoStartWriter();
+    
     MSG_Init( &msg, buf, sizeof( buf ) );
     
     // Write current time
@@ -359,6 +541,8 @@ void idServerDemoSystemLocal::DemoStopRecord( void )
     MSG_WriteByte( &msg, demo_endDemo );
     DemoWriteMessage( &msg );
     
+    DemoStopWriter();
+    
     fileSystem->FCloseFile( sv.demoFile );
     sv.demoState = DS_NONE;
     cvarSystem->SetValue( "sv_demoState", DS_NONE );
@@ -48,7 +48,8 @@ typedef enum
     demo_entityShared,
     demo_playerState,
     demo_endDemo,
-    demo_EOF
+    demo_EOF,
+    demo_keyFrame		// the frame that follows is delta from nothing
 } demo_ops_e;
 
 // Big fat buffer to store all our stuff
@@ -57,6 +58,24 @@ static U8 buf[0x400000];
 // Save maxclients and democlients and restore them after the demo
 static S32 savedMaxClients, savedDemoClients;
 
+// Messages are gathered in one buffer while a job on the job pool writes the
+// other out, a buffer holds at least one message of any size
+#define DEMO_WRITE_BUFFER_SIZE ( sizeof( buf ) + 4 )
+
+typedef struct
+{
+    U8* data[2];
+    S32 size[2];
+    S32 fill;					// the buffer the server thread appends to
+    
+    bool running;
+    qjobGroup_t jobs;
+    SDL_atomic_t pending;		// the write job owns the other buffer
+    
+    S32 lastKeyFrame;			// svs.time
+    S32 stalls;					// frames that waited for the writer
+} demoWriter_t;
+
 //
 // idServerBotSystemLocal
 //
@@ -76,6 +95,10 @@ public:
     virtual void DemoStopPlayback( void );
     
     static void DemoWriteMessage( msg_t* msg );
+    static bool DemoStartWriter( void );
+    static void DemoStopWriter( void );
+    static void DemoFlushWriter( bool wait );
+    static void DemoWriteJob( void* data );
     
 };
 
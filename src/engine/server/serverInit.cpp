@@ -66,22 +66,16 @@ idServerInitSystemLocal::~idServerInitSystemLocal( void )
 
 /*
 ===============
-idServerInitSystemLocal::SendConfigstring
+idServerInitSystemLocal::BuildConfigstringCommands
 
-Creates and sends the server command necessary to update the CS index for the
-given client
+Serializes the CS index into the reliable command(s) the client expects,
+splitting big strings into bcs0/bcs1/bcs2 chunks. Returns the number of
+commands written to cmds
 ===============
 */
-void idServerInitSystemLocal::SendConfigstring( client_t* client, S32 index )
+S32 idServerInitSystemLocal::BuildConfigstringCommands( S32 index, UTF8 cmds[MAX_CONFIGSTRING_CHUNKS][MAX_STRING_CHARS] )
 {
-    S32 maxChunkSize = MAX_STRING_CHARS - 24, len;
-    
-    if ( sv.configstrings[index].restricted && Com_ClientListContains( &sv.configstrings[index].clientList, ( S32 )( client - svs.clients ) ) )
-    {
-        // Send a blank config string for this client if it's listed
-        serverMainSystem->SendServerCommand( client, "cs %i \"\"\n", index );
-        return;
-    }
+    S32 maxChunkSize = MAX_STRING_CHARS - 24, len, numCmds = 0;
     
     len = ( S32 )::strlen( sv.configstrings[index].s );
     
@@ -90,7 +84,7 @@ void idServerInitSystemLocal::SendConfigstring( client_t* client, S32 index )
         S32	sent = 0, remaining = len;
         UTF8* cmd, buf[MAX_STRING_CHARS];
         
-        while ( remaining > 0 )
+        while ( remaining > 0 && numCmds < MAX_CONFIGSTRING_CHUNKS )
         {
             if ( sent == 0 )
             {
@@ -107,7 +101,7 @@ void idServerInitSystemLocal::SendConfigstring( client_t* client, S32 index )
             
             Q_strncpyz( buf, &sv.configstrings[index].s[sent], maxChunkSize );
             
-            serverMainSystem->SendServerCommand( client, "%s %i \"%s\"\n", cmd, index, buf );
+            Q_snprintf( cmds[numCmds++], MAX_STRING_CHARS, "%s %i \"%s\"\n", cmd, index, buf );
             
             sent += ( maxChunkSize - 1 );
             remaining -= ( maxChunkSize - 1 );
@@ -116,67 +110,172 @@ void idServerInitSystemLocal::SendConfigstring( client_t* client, S32 index )
     else
     {
         // standard cs, just send it
-        serverMainSystem->SendServerCommand( client, "cs %i \"%s\"\n", index, sv.configstrings[index].s );
+        Q_snprintf( cmds[numCmds++], MAX_STRING_CHARS, "cs %i \"%s\"\n", index, sv.configstrings[index].s );
     }
+    
+    return numCmds;
 }
 
 /*
 ===============
-idServerInitSystemLocal::UpdateConfigStrings
+idServerInitSystemLocal::SendConfigstring
+
+Creates and sends the server command necessary to update the CS index for the
+given client
 ===============
 */
-void idServerInitSystemLocal::UpdateConfigStrings( void )
+void idServerInitSystemLocal::SendConfigstring( client_t* client, S32 index )
+{
+    S32 i, numCmds;
+    UTF8 cmds[MAX_CONFIGSTRING_CHUNKS][MAX_STRING_CHARS];
+    
+    if ( sv.configstrings[index].restricted && Com_ClientListContains( &sv.configstrings[index].clientList, ( S32 )( client - svs.clients ) ) )
+    {
+        // Send a blank config string for this client if it's listed
+        serverMainSystem->SendServerCommand( client, "cs %i \"\"\n", index );
+        return;
+    }
+    
+    numCmds = BuildConfigstringCommands( index, cmds );
+    
+    for ( i = 0; i < numCmds; i++ )
+    {
+        serverMainSystem->AddServerCommand( client, cmds[i] );
+    }
+}
+
+/*
+===============
+idServerInitSystemLocal::SendConfigstringToClients
+
+Sends the CS index to all relevant clients. The string is serialized once
+and the resulting commands are shared by all recipients
+===============
+*/
+void idServerInitSystemLocal::SendConfigstringToClients( S32 index )
 {
-    S32 len, i, index, maxChunkSize = MAX_STRING_CHARS - 24;
+    S32 i, j, numCmds;
+    UTF8 cmds[MAX_CONFIGSTRING_CHUNKS][MAX_STRING_CHARS];
     client_t* client;
     
-    for ( index = 0; index < MAX_CONFIGSTRINGS; index++ )
+    numCmds = BuildConfigstringCommands( index, cmds );
+    
+    // send the data to all relevent clients
+    for ( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
     {
-        if ( !sv.configstringsmodified[index] )
+        if ( client->state < CS_ACTIVE )
+        {
+            if ( client->state == CS_PRIMED )
+            {
+                client->csUpdated[index] = true;
+            }
+            
+            continue;
+        }
+        
+        // do not always send server info to all clients
+        if ( index == CS_SERVERINFO && client->gentity && ( client->gentity->r.svFlags & SVF_NOSERVERINFO ) )
+        {
+            continue;
+        }
+        
+        if ( sv.configstrings[index].restricted && Com_ClientListContains( &sv.configstrings[index].clientList, i ) )
         {
+            // Send a blank config string for this client if it's listed
+            serverMainSystem->SendServerCommand( client, "cs %i \"\"\n", index );
             continue;
         }
         
+        for ( j = 0; j < numCmds; j++ )
+        {
+            serverMainSystem->AddServerCommand( client, cmds[j] );
+        }
+    }
+}
+
+/*
+===============
+idServerInitSystemLocal::MarkConfigstringModified
+
+Queues the CS index for the next UpdateConfigStrings, every index is
+only queued once no matter how often it changes before the flush
+===============
+*/
+void idServerInitSystemLocal::MarkConfigstringModified( S32 index )
+{
+    if ( sv.configstringsmodified[index] )
+    {
+        return;
+    }
+    
+    sv.configstringsmodified[index] = true;
+    sv.configstringsDirty[sv.numConfigstringsDirty++] = index;
+}
+
+/*
+===============
+idServerInitSystemLocal::UpdateConfigStrings
+
+Sends every configstring changed since the last flush. Runs once per frame
+from SendClientMessages, and from AddServerCommand ahead of any other
+reliable command so clients see the changes in the order they were made.
+The list is taken first, the sends below go through AddServerCommand too
+===============
+*/
+void idServerInitSystemLocal::UpdateConfigStrings( void )
+{
+    S32 n, index, numDirty;
+    
+    numDirty = sv.numConfigstringsDirty;
+    sv.numConfigstringsDirty = 0;
+    
+    for ( n = 0; n < numDirty; n++ )
+    {
+        index = sv.configstringsDirty[n];
         sv.configstringsmodified[index] = false;
         
         // send it to all the clients if we aren't
         // spawning a new server
         if ( sv.state == SS_GAME || sv.restarting )
         {
-            // send the data to all relevent clients
-            for ( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
-            {
-                if ( client->state < CS_ACTIVE )
-                {
-                    if ( client->state == CS_PRIMED )
-                    {
-                        client->csUpdated[index] = true;
-                    }
-                    
-                    continue;
-                }
-                
-                // do not always send server info to all clients
-                if ( index == CS_SERVERINFO && client->gentity && ( client->gentity->r.svFlags & SVF_NOSERVERINFO ) )
-                {
-                    continue;
-                }
-                
-                // RF, don't send to bot/AI
-                // Gordon: Note: might want to re-enable later for bot support
-                // RF, re-enabled
-                // Arnout: removed hardcoded gametype
-                // Arnout: added coop
-                if ( ( serverGameSystem->GameIsSinglePlayer() || serverGameSystem->GameIsCoop() ) && client->gentity && ( client->gentity->r.svFlags & SVF_BOT ) )
-                {
-                    continue;
-                }
-                
-                len = ( S32 )::strlen( sv.configstrings[index].s );
-                
-                SendConfigstring( client, index );
-            }
+            SendConfigstringToClients( index );
+        }
+    }
+}
+
+/*
+===============
+idServerInitSystemLocal::SendPendingConfigstrings
+
+Resends the configstrings that changed while the client was CS_PRIMED
+===============
+*/
+void idServerInitSystemLocal::SendPendingConfigstrings( client_t* client )
+{
+    S32 index;
+    
+    for ( index = 0; index < MAX_CONFIGSTRINGS; index++ )
+    {
+        if ( !client->csUpdated[index] )
+        {
+            continue;
+        }
+        
+        client->csUpdated[index] = false;
+        
+        // do not always send server info to all clients
+        if ( index == CS_SERVERINFO && client->gentity && ( client->gentity->r.svFlags & SVF_NOSERVERINFO ) )
+        {
+            continue;
+        }
+        
+        // RF, don't send to bot/AI
+        if ( ( serverGameSystem->GameIsSinglePlayer() || serverGameSystem->GameIsCoop() ) && client->gentity && ( client->gentity->r.svFlags & SVF_BOT ) )
+        {
+            continue;
         }
+        
+        SendConfigstring( client, index );
     }
 }
 
@@ -220,9 +319,6 @@ idServerInitSystemLocal::SetConfigstring
 */
 void idServerInitSystemLocal::SetConfigstring( S32 index, StringEntry val )
 {
-    S32 i;
-    client_t* client;
-    
     if ( index < 0 || index >= MAX_CONFIGSTRINGS )
     {
         Com_Error( ERR_DROP, "idServerInitSystemLocal::SetConfigstring: bad index %i\n", index );
@@ -243,30 +339,12 @@ void idServerInitSystemLocal::SetConfigstring( S32 index, StringEntry val )
     memorySystem->Free( sv.configstrings[index].s );
     sv.configstrings[index].s = memorySystem->CopyString( val );
     
-    // send it to all the clients if we aren't
-    // spawning a new server
+    // queue it for all the clients if we aren't
+    // spawning a new server, it goes out once however
+    // often it changes before the next flush
     if ( sv.state == SS_GAME || sv.restarting )
     {
-        // send the data to all relevent clients
-        for ( i = 0, client = svs.clients; i < sv_maxclients->integer ; i++, client++ )
-        {
-            if ( client->state < CS_ACTIVE )
-            {
-                if ( client->state == CS_PRIMED )
-                {
-                    client->csUpdated[index] = true;
-                }
-                continue;
-            }
-            
-            // do not always send server info to all clients
-            if ( index == CS_SERVERINFO && client->gentity && ( client->gentity->r.svFlags & SVF_NOSERVERINFO ) )
-            {
-                continue;
-            }
-            
-            SendConfigstring( client, index );
-        }
+        MarkConfigstringModified( index );
     }
 }
 
@@ -720,6 +798,7 @@ void idServerInitSystemLocal::SpawnServer( UTF8* server, bool killBots )
         sv.configstrings[i].s = memorySystem->CopyString( "" );
         sv.configstringsmodified[i] = false;
     }
+    sv.numConfigstringsDirty = 0;
     
     // init client structures and svs.numSnapshotEntities
     if ( !cvarSystem->VariableValue( "sv_running" ) )
@@ -1075,6 +1154,8 @@ void idServerInitSystemLocal::Init( void )
     //
     sv_maxclients = cvarSystem->Get( "sv_maxclients", "20", CVAR_SERVERINFO | CVAR_LATCH, "description" );	// NERVE - SMF - changed to 20 from 8
     sv_democlients = cvarSystem->Get( "sv_democlients", "8", CVAR_SERVERINFO | CVAR_LATCH | CVAR_ARCHIVE, "description" );
+    sv_demoWriteThread = cvarSystem->Get( "sv_demoWriteThread", "1", CVAR_ARCHIVE, "Writes server demos from the job pool so disk stalls don't hold up server frames" );
+    sv_demoKeyFrameInterval = cvarSystem->Get( "sv_demoKeyFrameInterval", "30", CVAR_ARCHIVE, "Seconds between server demo frames recorded in full instead of as deltas, 0 for none" );
     
     sv_maxRate = cvarSystem->Get( "sv_maxRate", "0", CVAR_ARCHIVE | CVAR_SERVERINFO, "description" );
     sv_minPing = cvarSystem->Get( "sv_minPing", "0", CVAR_ARCHIVE | CVAR_SERVERINFO, "description" );
@@ -38,6 +38,9 @@
 #ifndef __SERVERINIT_H__
 #define __SERVERINIT_H__
 
+// a BIG_INFO_STRING configstring is split into this many bcs commands at most
+#define MAX_CONFIGSTRING_CHUNKS ( BIG_INFO_STRING / ( MAX_STRING_CHARS - 25 ) + 1 )
+
 //
 // idServerGameSystemLocal
 //
@@ -59,7 +62,11 @@ public:
     idServerInitSystemLocal();
     ~idServerInitSystemLocal();
     
+    S32 BuildConfigstringCommands( S32 index, UTF8 cmds[MAX_CONFIGSTRING_CHUNKS][MAX_STRING_CHARS] );
     void SendConfigstring( client_t* client, S32 index );
+    void SendConfigstringToClients( S32 index );
+    void MarkConfigstringModified( S32 index );
+    void SendPendingConfigstrings( client_t* client );
     void CreateBaseline( void );
     void BoundMaxClients( S32 minimum );
     void Startup( void );
@@ -60,6 +60,8 @@ convar_t* sv_privatePassword;	// password for the privateClient slots
 convar_t* sv_allowDownload;
 convar_t* sv_maxclients;
 convar_t* sv_democlients;		// number of slots reserved for playing a demo
+convar_t* sv_demoWriteThread;
+convar_t* sv_demoKeyFrameInterval;
 
 convar_t* sv_privateClients;	// number of clients reserved for password
 convar_t* sv_hostname;
@@ -124,6 +126,14 @@ convar_t* sv_wh_bbox_horz;
 convar_t* sv_wh_bbox_vert;
 convar_t* sv_wh_check_fov;
 
+// cvars owned by other modules that are read for every status and info query
+static cvarRef_t fs_restrict = CVAR_REF( "fs_restrict" );
+static cvarRef_t fs_game = CVAR_REF( "fs_game" );
+static cvarRef_t g_gametype = CVAR_REF( "g_gametype" );
+static cvarRef_t g_antilag = CVAR_REF( "g_antilag" );
+static cvarRef_t g_heavyWeaponRestriction = CVAR_REF( "g_heavyWeaponRestriction" );
+static cvarRef_t g_balancedteams = CVAR_REF( "g_balancedteams" );
+
 #define LL( x ) x = LittleLong( x )
 
 /*
@@ -185,6 +195,10 @@ void idServerMainSystemLocal::AddServerCommand( client_t* client, StringEntry cm
 {
     S32 index, i;
     
+    // configstrings changed before this command have to reach the
+    // client ahead of it
+    serverInitSystem->UpdateConfigStrings();
+    
     // do not send commands until the gamestate has been sent
     if ( client->state < CS_PRIMED )
     {
@@ -300,7 +314,9 @@ void idServerMainSystemLocal::MasterHeartbeat( StringEntry hbname )
     return;
 #endif
     
-    netenabled = cvarSystem->VariableIntegerValue( "net_enabled" );
+    static cvarRef_t net_enabled = CVAR_REF( "net_enabled" );
+    
+    netenabled = cvarSystem->RefIntegerValue( &net_enabled );
     
     if ( serverGameSystem->GameIsSinglePlayer() )
     {
@@ -606,7 +622,7 @@ void idServerMainSystemLocal::Status( netadr_t from )
     Info_SetValueForKey( infostring, "challenge", cmdSystem->Argv( 1 ) );
     
     // add "demo" to the sv_keywords if restricted
-    if ( cvarSystem->VariableValue( "fs_restrict" ) )
+    if ( cvarSystem->RefValue( &fs_restrict ) )
     {
         UTF8 keywords[MAX_INFO_STRING];
         
@@ -680,7 +696,7 @@ void idServerMainSystemLocal::GameCompleteStatus( netadr_t from )
     Info_SetValueForKey( infostring, "challenge", cmdSystem->Argv( 1 ) );
     
     // add "demo" to the sv_keywords if restricted
-    if ( cvarSystem->VariableValue( "fs_restrict" ) )
+    if ( cvarSystem->RefValue( &fs_restrict ) )
     {
         UTF8 keywords[MAX_INFO_STRING];
         
@@ -779,7 +795,7 @@ void idServerMainSystemLocal::Info( netadr_t from )
     Info_SetValueForKey( infostring, "clients", va( "%i", count ) );
     Info_SetValueForKey( infostring, "sv_maxclients", va( "%i", sv_maxclients->integer - sv_privateClients->integer ) );
     //Info_SetValueForKey( infostring, "gametype", va("%i", sv_gametype->integer ) );
-    Info_SetValueForKey( infostring, "gametype", cvarSystem->VariableString( "g_gametype" ) );
+    Info_SetValueForKey( infostring, "gametype", cvarSystem->RefString( &g_gametype ) );
     Info_SetValueForKey( infostring, "pure", va( "%i", sv_pure->integer ) );
     
     if ( sv_minPing->integer )
@@ -792,7 +808,7 @@ void idServerMainSystemLocal::Info( netadr_t from )
         Info_SetValueForKey( infostring, "maxPing", va( "%i", sv_maxPing->integer ) );
     }
     
-    gamedir = cvarSystem->VariableString( "fs_game" );
+    gamedir = cvarSystem->RefString( &fs_game );
     if ( *gamedir )
     {
         Info_SetValueForKey( infostring, "game", gamedir );
@@ -810,19 +826,19 @@ void idServerMainSystemLocal::Info( netadr_t from )
     Info_SetValueForKey( infostring, "gamename", GAMENAME_STRING );	// Arnout: to be able to filter out Quake servers
     
     // TTimo
-    antilag = cvarSystem->VariableString( "g_antilag" );
+    antilag = cvarSystem->RefString( &g_antilag );
     if ( antilag )
     {
         Info_SetValueForKey( infostring, "g_antilag", antilag );
     }
     
-    weaprestrict = cvarSystem->VariableString( "g_heavyWeaponRestriction" );
+    weaprestrict = cvarSystem->RefString( &g_heavyWeaponRestriction );
     if ( weaprestrict )
     {
         Info_SetValueForKey( infostring, "weaprestrict", weaprestrict );
     }
     
-    balancedteams = cvarSystem->VariableString( "g_balancedteams" );
+    balancedteams = cvarSystem->RefString( &g_balancedteams );
     if ( balancedteams )
     {
         Info_SetValueForKey( infostring, "balancedteams", balancedteams );
@@ -1517,6 +1533,8 @@ void idServerMainSystemLocal::Frame( S32 msec )
     static S32 start, end;
     UTF8 mapname[MAX_QPATH];
     
+    PROFILE_ZONE( "SV_Frame" );
+    
     start = idsystem->Milliseconds();
     svs.stats.idle += ( F64 )( start - end ) / 1000;
     
@@ -1700,6 +1718,8 @@ void idServerMainSystemLocal::Frame( S32 msec )
     // run the game simulation in c ut  s
     while ( sv.timeResidual >= frameMsec )
     {
+        PROFILE_ZONE( "SV_GameFrame" );
+        
         sv.timeResidual -= frameMsec;
         svs.time += frameMsec;
         sv.time += frameMsec;
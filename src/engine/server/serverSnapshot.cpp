@@ -682,20 +682,25 @@ void idServerSnapshotSystemLocal::BuildClientSnapshot( client_t* client )
     S32 i, clientNum;
     vec3_t org;
     clientSnapshot_t* frame;
-    snapshotEntityNumbers_t entityNumbers;
+    snapshotEntityNumbers_t* entityNumbers;
     sharedEntity_t* ent, *clent;
     entityState_t* state;
     svEntity_t* svEnt;
     playerState_t* ps;
     
+    PROFILE_ZONE( "SV_BuildClientSnapshot" );
+    
     // bump the counter used to prevent double adding
     sv.snapshotCounter++;
     
     // this is the frame we are creating
     frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
     
+    // the entity numbers are only needed until the frame is built
+    entityNumbers = ( snapshotEntityNumbers_t* )memorySystem->FrameAlloc( sizeof( *entityNumbers ) );
+    
     // clear everything in this snapshot
-    entityNumbers.numSnapshotEntities = 0;
+    entityNumbers->numSnapshotEntities = 0;
     ::memset( frame->areabits, 0, sizeof( frame->areabits ) );
     
     // show_bug.cgi?id=62
@@ -752,13 +757,13 @@ void idServerSnapshotSystemLocal::BuildClientSnapshot( client_t* client )
     
     // add all the entities directly visible to the eye, which
     // may include portal entities that merge other viewpoints
-    AddEntitiesVisibleFromPoint( org, frame, &entityNumbers /*, false, client->netchan.remoteAddress.type == NA_LOOPBACK */, false );
+    AddEntitiesVisibleFromPoint( org, frame, entityNumbers /*, false, client->netchan.remoteAddress.type == NA_LOOPBACK */, false );
     
     // if there were portals visible, there may be out of order entities
     // in the list which will need to be resorted for the delta compression
     // to work correctly.  This also catches the error condition
     // of an entity being included twice.
-    qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, sizeof( entityNumbers.snapshotEntities[0] ), QsortEntityNumbers );
+    qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities, sizeof( entityNumbers->snapshotEntities[0] ), QsortEntityNumbers );
     
     // now that all viewpoint's areabits have been OR'd together, invert
     // all of them to make it a mask vector, which is what the renderer wants
@@ -771,17 +776,17 @@ void idServerSnapshotSystemLocal::BuildClientSnapshot( client_t* client )
     frame->num_entities = 0;
     frame->first_entity = svs.nextSnapshotEntities;
     
-    for ( i = 0; i < entityNumbers.numSnapshotEntities; i++ )
+    for ( i = 0; i < entityNumbers->numSnapshotEntities; i++ )
     {
-        ent = serverGameSystem->GentityNum( entityNumbers.snapshotEntities[i] );
+        ent = serverGameSystem->GentityNum( entityNumbers->snapshotEntities[i] );
         state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
         *state = ent->s;
         
-        if ( sv_wh_active->integer && entityNumbers.snapshotEntities[i] < sv_maxclients->integer )
+        if ( sv_wh_active->integer && entityNumbers->snapshotEntities[i] < sv_maxclients->integer )
         {
-            if ( idServerWallhackSystemLocal::PositionChanged( entityNumbers.snapshotEntities[i] ) )
+            if ( idServerWallhackSystemLocal::PositionChanged( entityNumbers->snapshotEntities[i] ) )
             {
-                idServerWallhackSystemLocal::RestorePos( entityNumbers.snapshotEntities[i] );
+                idServerWallhackSystemLocal::RestorePos( entityNumbers->snapshotEntities[i] );
             }
         }
         
@@ -929,10 +934,14 @@ So we send them "idle" packets with the bare minimum required to keep them on th
 */
 void idServerSnapshotSystemLocal::SendClientIdle( client_t* client )
 {
-    U8 msg_buf[MAX_MSGLEN];
+    U8* msg_buf;
     msg_t msg;
     
-    MSG_Init( &msg, msg_buf, sizeof( msg_buf ) );
+    // the netchan copies out whatever it keeps, so the buffer only has to
+    // live for this frame
+    msg_buf = ( U8* )memorySystem->FrameAlloc( MAX_MSGLEN );
+    
+    MSG_Init( &msg, msg_buf, MAX_MSGLEN );
     msg.allowoverflow = true;
     
     // NOTE, MRE: all server->client messages now acknowledge
@@ -979,7 +988,7 @@ Also called by idServerInitSystemLocal::FinalCommand
 */
 void idServerSnapshotSystemLocal::SendClientSnapshot( client_t* client )
 {
-    U8 msg_buf[MAX_MSGLEN];
+    U8* msg_buf;
     msg_t msg;
     
     //bots dont need snapshots
@@ -1010,7 +1019,9 @@ void idServerSnapshotSystemLocal::SendClientSnapshot( client_t* client )
         return;
     }
     
-    MSG_Init( &msg, msg_buf, sizeof( msg_buf ) );
+    msg_buf = ( U8* )memorySystem->FrameAlloc( MAX_MSGLEN );
+    
+    MSG_Init( &msg, msg_buf, MAX_MSGLEN );
     msg.allowoverflow = true;
     
     // NOTE, MRE: all server->client messages now acknowledge
@@ -1053,6 +1064,8 @@ void idServerSnapshotSystemLocal::SendClientMessages( void )
     S32 i, numclients = 0;	// NERVE - SMF - net debugging
     client_t* c;
     
+    PROFILE_ZONE( "SV_SendClientMessages" );
+    
     sv.bpsTotalBytes = 0; // NERVE - SMF - net debugging
     sv.ubpsTotalBytes = 0; // NERVE - SMF - net debugging
     
@@ -709,6 +709,8 @@ void idServerWorldSystemLocal::Trace( trace_t* results, const vec3_t start, cons
     S32 i;
     moveclip_t clip;
     
+    PROFILE_ZONE( "SV_Trace" );
+    
     if ( !mins )
     {
         mins = vec3_origin;
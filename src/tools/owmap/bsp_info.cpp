@@ -53,8 +53,9 @@ int BSPInfoMain( int count, char** fileNames )
         return -1;
     }
     
-    /* enable info mode */
+    /* enable info mode (only lump sizes are needed, so load lazily) */
     infoMode = qtrue;
+    bspLazyLoad = qtrue;
     
     /* walk file list */
     for ( i = 0; i < count; i++ )
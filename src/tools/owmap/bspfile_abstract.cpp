@@ -41,6 +41,12 @@
 #include <cctype>
 #include <sstream>
 
+#ifdef Q_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 
 /* -------------------------------------------------------------------------------
 
@@ -135,6 +141,7 @@ void SetDrawSurfaces( int n )
 
 void BSPFilesCleanup()
 {
+    UnmapBSPFile();
     if ( bspDrawVerts != 0 )
     {
         free( bspDrawVerts );
@@ -394,6 +401,250 @@ void AddLump( FILE* file, bspHeader_t* header, int lumpNum, const void* data, in
 
 
 
+/* -------------------------------------------------------------------------------
+
+   mapped bsp files
+
+   the loaders read the bsp through a private (copy-on-write) mapping of the file
+   instead of a heap copy. in lazy mode (set by the read-only tools such as -info,
+   -minimap and -exportents) lumps whose on-disk layout matches the abstract one
+   are referenced in place, and lumps that need conversion are left for
+   LoadBSPLumps() to decode when a tool actually asks for them
+
+   ------------------------------------------------------------------------------- */
+
+#define MAX_INPLACE_LUMPS   32
+
+static byte*                bspMapBase = NULL;
+static int bspMapLength = 0;
+static qboolean bspMapIsHeap = qfalse;
+
+static int numBSPInPlaceLumps = 0;
+static void**               bspInPlaceLumps[ MAX_INPLACE_LUMPS ];
+static int*                 bspInPlaceAllocated[ MAX_INPLACE_LUMPS ];
+
+static int bspPendingLumps = 0;
+static bspLumpDecoder_t bspLumpDecoder = NULL;
+
+
+
+/*
+   LazyBSPLumps()
+   returns true if the loaders may reference lumps in place and defer conversion
+ */
+
+qboolean LazyBSPLumps( void )
+{
+#if GDEF_ARCH_ENDIAN_BIG
+    /* everything has to be swapped on load anyway */
+    return qfalse;
+#else
+    return bspLazyLoad;
+#endif
+}
+
+
+
+/*
+   MapBSPFile()
+   maps a bsp file into memory, falling back to reading it if mapping fails
+ */
+
+void* MapBSPFile( const char* filename, int* length )
+{
+    void*    base;
+    
+    
+    /* drop the previous file */
+    UnmapBSPFile();
+    base = NULL;
+
+#if GDEF_OS_WINDOWS
+    {
+        HANDLE file, mapping;
+        
+        
+        file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+        if ( file != INVALID_HANDLE_VALUE )
+        {
+            bspMapLength = ( int ) GetFileSize( file, NULL );
+            mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+            if ( mapping != NULL )
+            {
+                /* the view keeps the mapping alive */
+                base = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+                CloseHandle( mapping );
+            }
+            CloseHandle( file );
+        }
+    }
+#elif defined( Q_UNIX )
+    {
+        int fd;
+        struct stat st;
+        
+        
+        fd = open( filename, O_RDONLY );
+        if ( fd >= 0 )
+        {
+            if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+            {
+                bspMapLength = ( int ) st.st_size;
+                base = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+                if ( base == MAP_FAILED )
+                {
+                    base = NULL;
+                }
+            }
+            close( fd );
+        }
+    }
+#endif
+
+    /* fall back to a heap copy (this also reports missing files) */
+    if ( base == NULL )
+    {
+        bspMapLength = LoadFile( filename, &base );
+        bspMapIsHeap = qtrue;
+    }
+    
+    /* return it */
+    bspMapBase = ( byte* ) base;
+    if ( length != NULL )
+    {
+        *length = bspMapLength;
+    }
+    return base;
+}
+
+
+
+/*
+   ReleaseBSPFile()
+   called by the loaders when done; keeps the mapping while lumps still point into it
+ */
+
+void ReleaseBSPFile( void )
+{
+    if ( numBSPInPlaceLumps == 0 && bspPendingLumps == 0 )
+    {
+        UnmapBSPFile();
+    }
+}
+
+
+
+/*
+   UnmapBSPFile()
+   unmaps the current bsp file, dropping any lumps that were referenced in place
+ */
+
+void UnmapBSPFile( void )
+{
+    int i;
+    
+    
+    /* forget in-place lumps */
+    for ( i = 0; i < numBSPInPlaceLumps; i++ )
+    {
+        *bspInPlaceLumps[ i ] = NULL;
+        *bspInPlaceAllocated[ i ] = 0;
+    }
+    numBSPInPlaceLumps = 0;
+    bspPendingLumps = 0;
+    bspLumpDecoder = NULL;
+    
+    /* dummy check */
+    if ( bspMapBase == NULL )
+    {
+        return;
+    }
+    
+    /* release the view */
+    if ( bspMapIsHeap )
+    {
+        free( bspMapBase );
+    }
+    else
+    {
+#if GDEF_OS_WINDOWS
+        UnmapViewOfFile( bspMapBase );
+#elif defined( Q_UNIX )
+        munmap( bspMapBase, bspMapLength );
+#endif
+    }
+    bspMapBase = NULL;
+    bspMapLength = 0;
+    bspMapIsHeap = qfalse;
+}
+
+
+
+/*
+   LoadLump_Allocate()
+   like CopyLump_Allocate(), but references the lump in place when loading lazily
+ */
+
+int LoadLump_Allocate( bspHeader_t* header, int lump, void** dest, int size, int* allocationVariable )
+{
+    int count;
+    
+    
+    /* copy unless the lump can be used as-is */
+    if ( !LazyBSPLumps() || ( byte* ) header != bspMapBase || ( header->lumps[ lump ].offset & 3 ) || numBSPInPlaceLumps >= MAX_INPLACE_LUMPS )
+    {
+        return CopyLump_Allocate( header, lump, dest, size, allocationVariable );
+    }
+    
+    /* point into the mapping */
+    count = GetLumpElements( header, lump, size );
+    free( *dest );
+    *dest = count > 0 ? GetLump( header, lump ) : NULL;
+    *allocationVariable = count;
+    
+    /* remember it so it is dropped with the mapping */
+    bspInPlaceLumps[ numBSPInPlaceLumps ] = dest;
+    bspInPlaceAllocated[ numBSPInPlaceLumps ] = allocationVariable;
+    numBSPInPlaceLumps++;
+    return count;
+}
+
+
+
+/*
+   DeferBSPLumps()
+   leaves lumps in the mapping until LoadBSPLumps() asks for them
+ */
+
+void DeferBSPLumps( bspLumpDecoder_t decoder, int lumps )
+{
+    bspLumpDecoder = decoder;
+    bspPendingLumps = lumps;
+}
+
+
+
+/*
+   LoadBSPLumps()
+   decodes deferred lumps (BSP_LUMP_*) of a lazily loaded bsp
+ */
+
+void LoadBSPLumps( int lumps )
+{
+    /* only decode what is still pending */
+    lumps &= bspPendingLumps;
+    if ( lumps == 0 || bspLumpDecoder == NULL || bspMapBase == NULL )
+    {
+        return;
+    }
+    
+    /* decode */
+    bspLumpDecoder( ( bspHeader_t* ) bspMapBase, bspMapLength, lumps );
+    bspPendingLumps &= ~lumps;
+}
+
+
+
 /*
    LoadBSPFile()
    loads a bsp file into memory
@@ -407,9 +658,12 @@ void LoadBSPFile( const char* filename )
         Error( "LoadBSPFile: unsupported BSP file format" );
     }
     
-    /* load it, then byte swap the in-memory version */
+    /* load it, then byte swap the in-memory version (lazy loads are little-endian already) */
     game->load( filename );
-    SwapBSPFile();
+    if ( !LazyBSPLumps() )
+    {
+        SwapBSPFile();
+    }
 }
 
 
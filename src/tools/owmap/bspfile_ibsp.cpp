@@ -456,6 +456,101 @@ static void AddLightGridLumps( FILE* file, ibspHeader_t* header )
     free( buffer );
 }
 
+/*
+   IBSPHasAdvertisements()
+   quake live appends an advertisement lump after the draw indexes
+ */
+
+static qboolean IBSPHasAdvertisements( ibspHeader_t* header, int bspLength )
+{
+    bspLump_t* preLastLump = &header->lumps[LUMP_DRAWINDEXES];
+    int currentSize = preLastLump->offset + preLastLump->length;
+    
+    return ( currentSize < bspLength && header->version == 47 ) ? qtrue : qfalse;   // quake live's bsp version
+}
+
+
+
+/*
+   CountIBSPLumps()
+   sets the element counts of deferred lumps so they can be reported without decoding them
+ */
+
+static void CountIBSPLumps( ibspHeader_t* header, int bspLength )
+{
+    numBSPLeafs = GetLumpElements( ( bspHeader_t* ) header, LUMP_LEAFS, sizeof( bspLeaf_t ) );
+    numBSPBrushSides = GetLumpElements( ( bspHeader_t* ) header, LUMP_BRUSHSIDES, sizeof( ibspBrushSide_t ) );
+    numBSPDrawVerts = GetLumpElements( ( bspHeader_t* ) header, LUMP_DRAWVERTS, sizeof( ibspDrawVert_t ) );
+    numBSPDrawSurfaces = GetLumpElements( ( bspHeader_t* ) header, LUMP_SURFACES, sizeof( ibspDrawSurface_t ) );
+    numBSPFogs = GetLumpElements( ( bspHeader_t* ) header, LUMP_FOGS, sizeof( bspFog_t ) );
+    numBSPVisBytes = GetLumpElements( ( bspHeader_t* ) header, LUMP_VISIBILITY, 1 );
+    numBSPGridPoints = GetLumpElements( ( bspHeader_t* ) header, LUMP_LIGHTGRID, sizeof( ibspGridPoint_t ) );
+    numBSPAds = IBSPHasAdvertisements( header, bspLength ) ? GetLumpElements( ( bspHeader_t* ) header, LUMP_ADVERTISEMENTS, sizeof( bspAdvertisement_t ) ) : 0;
+}
+
+
+
+/*
+   DecodeIBSPLumps()
+   copies/converts the lumps that can't be used in place (BSP_LUMP_*)
+ */
+
+static void DecodeIBSPLumps( bspHeader_t* bspHeader, int bspLength, int lumps )
+{
+    ibspHeader_t*    header = ( ibspHeader_t* ) bspHeader;
+    
+    
+    if ( lumps & BSP_LUMP_LEAFS )
+    {
+        numBSPLeafs = CopyLump( ( bspHeader_t* ) header, LUMP_LEAFS, bspLeafs, sizeof( bspLeaf_t ) ); // TODO fix overflow
+    }
+    
+    if ( lumps & BSP_LUMP_BRUSHSIDES )
+    {
+        CopyBrushSidesLump( header );
+    }
+    
+    if ( lumps & BSP_LUMP_DRAWVERTS )
+    {
+        CopyDrawVertsLump( header );
+    }
+    
+    if ( lumps & BSP_LUMP_DRAWSURFACES )
+    {
+        CopyDrawSurfacesLump( header );
+    }
+    
+    if ( lumps & BSP_LUMP_FOGS )
+    {
+        numBSPFogs = CopyLump( ( bspHeader_t* ) header, LUMP_FOGS, bspFogs, sizeof( bspFog_t ) ); // TODO fix overflow
+    }
+    
+    if ( lumps & BSP_LUMP_VISIBILITY )
+    {
+        numBSPVisBytes = CopyLump( ( bspHeader_t* ) header, LUMP_VISIBILITY, bspVisBytes, 1 ); // TODO fix overflow
+    }
+    
+    if ( lumps & BSP_LUMP_LIGHTGRID )
+    {
+        CopyLightGridLumps( header );
+    }
+    
+    /* advertisements */
+    if ( lumps & BSP_LUMP_ADVERTISEMENTS )
+    {
+        if ( IBSPHasAdvertisements( header, bspLength ) )
+        {
+            numBSPAds = CopyLump( ( bspHeader_t* ) header, LUMP_ADVERTISEMENTS, bspAds, sizeof( bspAdvertisement_t ) );
+        }
+        else
+        {
+            numBSPAds = 0;
+        }
+    }
+}
+
+
+
 /*
    LoadIBSPFile()
    loads a quake 3 bsp file into memory
@@ -464,10 +559,11 @@ static void AddLightGridLumps( FILE* file, ibspHeader_t* header )
 void LoadIBSPFile( const char* filename )
 {
     ibspHeader_t*    header;
+    int bspLength;
     
     
-    /* load the file header */
-    int bspLength = LoadFile( filename, ( void** ) &header );
+    /* map the file */
+    header = static_cast<ibspHeader_t*>( MapBSPFile( filename, &bspLength ) );
     
     /* swap the header (except the first 4 bytes) */
     SwapBlock( ( int* )( ( byte* ) header + sizeof( int ) ), sizeof( *header ) - sizeof( int ) );
@@ -482,58 +578,41 @@ void LoadIBSPFile( const char* filename )
         Error( "%s is version %d, not %d", filename, header->version, game->bspVersion );
     }
     
-    /* load/convert lumps */
-    numBSPShaders = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_SHADERS, ( void** ) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
-    
-    numBSPModels = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_MODELS, ( void** ) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
-    
-    numBSPPlanes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_PLANES, ( void** ) &bspPlanes, sizeof( bspPlane_t ), &allocatedBSPPlanes );
-    
-    numBSPLeafs = CopyLump( ( bspHeader_t* ) header, LUMP_LEAFS, bspLeafs, sizeof( bspLeaf_t ) ); // TODO fix overflow
+    /* load lumps that share the abstract layout (referenced in place when loading lazily) */
+    numBSPShaders = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_SHADERS, ( void** ) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
     
-    numBSPNodes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_NODES, ( void** ) &bspNodes, sizeof( bspNode_t ), &allocatedBSPNodes );
+    numBSPModels = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_MODELS, ( void** ) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
     
-    numBSPLeafSurfaces = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFSURFACES, ( void** ) &bspLeafSurfaces, sizeof( bspLeafSurfaces[ 0 ] ), &allocatedBSPLeafSurfaces );
+    numBSPPlanes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_PLANES, ( void** ) &bspPlanes, sizeof( bspPlane_t ), &allocatedBSPPlanes );
     
-    numBSPLeafBrushes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFBRUSHES, ( void** ) &bspLeafBrushes, sizeof( bspLeafBrushes[ 0 ] ), &allocatedBSPLeafBrushes );
+    numBSPNodes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_NODES, ( void** ) &bspNodes, sizeof( bspNode_t ), &allocatedBSPNodes );
     
-    numBSPBrushes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHES, ( void** ) &bspBrushes, sizeof( bspBrush_t ), &allocatedBSPLeafBrushes );
+    numBSPLeafSurfaces = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFSURFACES, ( void** ) &bspLeafSurfaces, sizeof( bspLeafSurfaces[ 0 ] ), &allocatedBSPLeafSurfaces );
     
-    CopyBrushSidesLump( header );
+    numBSPLeafBrushes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFBRUSHES, ( void** ) &bspLeafBrushes, sizeof( bspLeafBrushes[ 0 ] ), &allocatedBSPLeafBrushes );
     
-    CopyDrawVertsLump( header );
+    numBSPBrushes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHES, ( void** ) &bspBrushes, sizeof( bspBrush_t ), &allocatedBSPLeafBrushes );
     
-    CopyDrawSurfacesLump( header );
+    numBSPDrawIndexes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_DRAWINDEXES, ( void** ) &bspDrawIndexes, sizeof( bspDrawIndexes[ 0 ] ), &allocatedBSPDrawIndexes );
     
-    numBSPFogs = CopyLump( ( bspHeader_t* ) header, LUMP_FOGS, bspFogs, sizeof( bspFog_t ) ); // TODO fix overflow
-    
-    numBSPDrawIndexes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_DRAWINDEXES, ( void** ) &bspDrawIndexes, sizeof( bspDrawIndexes[ 0 ] ), &allocatedBSPDrawIndexes );
-    
-    numBSPVisBytes = CopyLump( ( bspHeader_t* ) header, LUMP_VISIBILITY, bspVisBytes, 1 ); // TODO fix overflow
-    
-    numBSPLightBytes = GetLumpElements( ( bspHeader_t* ) header, LUMP_LIGHTMAPS, 1 ); // TODO change to CopyLump_Allocate
-    bspLightBytes = static_cast<byte*>( safe_malloc( numBSPLightBytes ) );
-    CopyLump( ( bspHeader_t* ) header, LUMP_LIGHTMAPS, bspLightBytes, 1 );
+    numBSPLightBytes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_LIGHTMAPS, ( void** ) &bspLightBytes, 1, &numBSPLightBytes );
     
+    /* entities are always copied, they get reparsed and rewritten */
     bspEntDataSize = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_ENTITIES, ( void** ) &bspEntData, 1, &allocatedBSPEntData );
     
-    CopyLightGridLumps( header );
-    
-    bspLump_t* preLastLump = &header->lumps[LUMP_DRAWINDEXES];
-    int currentSize = preLastLump->offset + preLastLump->length;
-    
-    /* advertisements */
-    if ( currentSize < bspLength && header->version == 47 )   // quake live's bsp version
+    /* convert the rest now, or when a lazy caller asks for it */
+    if ( LazyBSPLumps() )
     {
-        numBSPAds = CopyLump( ( bspHeader_t* ) header, LUMP_ADVERTISEMENTS, bspAds, sizeof( bspAdvertisement_t ) );
+        CountIBSPLumps( header, bspLength );
+        DeferBSPLumps( DecodeIBSPLumps, BSP_LUMP_ALL );
     }
     else
     {
-        numBSPAds = 0;
+        DecodeIBSPLumps( ( bspHeader_t* ) header, bspLength, BSP_LUMP_ALL );
     }
     
-    /* free the file buffer */
-    free( header );
+    /* release the file buffer */
+    ReleaseBSPFile();
 }
 
 
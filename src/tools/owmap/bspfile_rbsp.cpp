@@ -224,8 +224,8 @@ void LoadRBSPFile( const char* filename )
     rbspHeader_t*    header;
     
     
-    /* load the file header */
-    LoadFile( filename, ( void** ) &header );
+    /* map the file */
+    header = static_cast<rbspHeader_t*>( MapBSPFile( filename, NULL ) );
     
     /* swap the header (except the first 4 bytes) */
     SwapBlock( ( int* )( ( byte* ) header + sizeof( int ) ), sizeof( *header ) - sizeof( int ) );
@@ -241,23 +241,23 @@ void LoadRBSPFile( const char* filename )
     }
     
     /* load/convert lumps */
-    numBSPShaders = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_SHADERS, ( void** ) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
+    numBSPShaders = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_SHADERS, ( void** ) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
     
-    numBSPModels = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_MODELS, ( void** ) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
+    numBSPModels = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_MODELS, ( void** ) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
     
-    numBSPPlanes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_PLANES, ( void** ) &bspPlanes, sizeof( bspPlane_t ), &allocatedBSPPlanes );
+    numBSPPlanes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_PLANES, ( void** ) &bspPlanes, sizeof( bspPlane_t ), &allocatedBSPPlanes );
     
     numBSPLeafs = CopyLump( ( bspHeader_t* ) header, LUMP_LEAFS, bspLeafs, sizeof( bspLeaf_t ) );
     
-    numBSPNodes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_NODES, ( void** ) &bspNodes, sizeof( bspNode_t ), &allocatedBSPNodes );
+    numBSPNodes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_NODES, ( void** ) &bspNodes, sizeof( bspNode_t ), &allocatedBSPNodes );
     
-    numBSPLeafSurfaces = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFSURFACES, ( void** ) &bspLeafSurfaces, sizeof( bspLeafSurfaces[ 0 ] ), &allocatedBSPLeafSurfaces );
+    numBSPLeafSurfaces = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFSURFACES, ( void** ) &bspLeafSurfaces, sizeof( bspLeafSurfaces[ 0 ] ), &allocatedBSPLeafSurfaces );
     
-    numBSPLeafBrushes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFBRUSHES, ( void** ) &bspLeafBrushes, sizeof( bspLeafBrushes[ 0 ] ), &allocatedBSPLeafBrushes );
+    numBSPLeafBrushes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_LEAFBRUSHES, ( void** ) &bspLeafBrushes, sizeof( bspLeafBrushes[ 0 ] ), &allocatedBSPLeafBrushes );
     
-    numBSPBrushes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHES, ( void** ) &bspBrushes, sizeof( bspBrush_t ), &allocatedBSPLeafBrushes );
+    numBSPBrushes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHES, ( void** ) &bspBrushes, sizeof( bspBrush_t ), &allocatedBSPLeafBrushes );
     
-    numBSPBrushSides = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHSIDES, ( void** ) &bspBrushSides, sizeof( bspBrushSide_t ), &allocatedBSPBrushSides );
+    numBSPBrushSides = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_BRUSHSIDES, ( void** ) &bspBrushSides, sizeof( bspBrushSide_t ), &allocatedBSPBrushSides );
     
     numBSPDrawVerts = GetLumpElements( ( bspHeader_t* ) header, LUMP_DRAWVERTS, sizeof( bspDrawVerts[ 0 ] ) );
     SetDrawVerts( numBSPDrawVerts );
@@ -269,7 +269,7 @@ void LoadRBSPFile( const char* filename )
     
     numBSPFogs = CopyLump( ( bspHeader_t* ) header, LUMP_FOGS, bspFogs, sizeof( bspFogs[ 0 ] ) );
     
-    numBSPDrawIndexes = CopyLump_Allocate( ( bspHeader_t* ) header, LUMP_DRAWINDEXES, ( void** ) &bspDrawIndexes, sizeof( bspDrawIndexes[ 0 ] ), &allocatedBSPDrawIndexes );
+    numBSPDrawIndexes = LoadLump_Allocate( ( bspHeader_t* ) header, LUMP_DRAWINDEXES, ( void** ) &bspDrawIndexes, sizeof( bspDrawIndexes[ 0 ] ), &allocatedBSPDrawIndexes );
     
     numBSPVisBytes = CopyLump( ( bspHeader_t* ) header, LUMP_VISIBILITY, bspVisBytes, 1 );
     
@@ -281,8 +281,8 @@ void LoadRBSPFile( const char* filename )
     
     CopyLightGridLumps( header );
     
-    /* free the file buffer */
-    free( header );
+    /* release the file buffer */
+    ReleaseBSPFile();
 }
 
 
@@ -107,6 +107,7 @@ int ExportEntitiesMain( int argc, char** argv )
     
     /* load the bsp */
     Sys_Printf( "Loading %s\n", source );
+    bspLazyLoad = qtrue;
     LoadBSPFile( source );
     
     /* export the lightmaps */
@@ -35,10 +35,53 @@
 
 /* dependencies */
 #include "q3map2.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 
 
 
-int c_faceLeafs;
+std::atomic<int> c_faceLeafs;
+
+
+/* faces as seen by SelectSplitPlaneNum(), with their bounds cached */
+typedef struct
+{
+    face_t*      face;
+    int planenum;
+    vec3_t mins, maxs;
+}
+splitFace_t;
+
+
+/* side counts of one candidate split plane against every face in the node */
+typedef struct
+{
+    int planenum;
+    int splits, facing, front, back;
+}
+splitPlane_t;
+
+
+/* a subtree queued by the serial top of FaceBSP() for the worker threads */
+typedef struct
+{
+    node_t*      node;
+    face_t*      list;
+    int numFaces;
+}
+faceTreeTask_t;
+
+
+/* nodes with more faces than this are split before handing out subtrees */
+#define MIN_FACE_TREE_TASK_FACES    256
+
+static std::vector<faceTreeTask_t>*  faceTreeQueue = NULL;
+static std::vector<node_t*>*         faceTreeTopNodes = NULL;
+static int faceTreeTaskFaces;
+static faceTreeTask_t*               faceTreeTasks = NULL;
+
+void BuildFaceTree_r( node_t* node, face_t* list );
 
 
 /*
@@ -74,6 +117,114 @@ void    FreeBspFace( face_t* f )
 
 
 
+/*
+   BlockSplitAxis()
+   returns the axis of the first block boundary the node crosses (-1 if none)
+ */
+
+static int BlockSplitAxis( node_t* node, float* dist )
+{
+    int i;
+    
+    
+    /* ydnar 2002-06-24: changed this to split on z-axis as well */
+    /* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
+    for ( i = 0; i < 3; i++ )
+    {
+        if ( blockSize[ i ] <= 0 )
+        {
+            continue;
+        }
+        *dist = blockSize[ i ] * ( floor( node->mins[ i ] / blockSize[ i ] ) + 1 );
+        if ( node->maxs[ i ] > *dist )
+        {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+
+
+/*
+   CountPlaneSides()
+   counts how the faces of a node fall on a candidate split plane
+ */
+
+static void CountPlaneSides( splitPlane_t* sp, const std::vector<splitFace_t>& faces )
+{
+    const splitFace_t*   check;
+    plane_t*     plane;
+    int side, axis;
+    size_t i;
+    vec_t lo, hi;
+    
+    
+    /* axial planes are decided by the face bounds alone, as each bound is one of the points */
+    plane = &mapplanes[ sp->planenum ];
+    axis = plane->type;
+    if ( axis < 3 && ( fabs( plane->normal[ axis ] ) != 1 || plane->normal[ ( axis + 1 ) % 3 ] != 0 || plane->normal[ ( axis + 2 ) % 3 ] != 0 ) )
+    {
+        axis = 3;
+    }
+    
+    sp->splits = 0;
+    sp->facing = 0;
+    sp->front = 0;
+    sp->back = 0;
+    for ( i = 0; i < faces.size(); i++ )
+    {
+        check = &faces[ i ];
+        if ( check->planenum == sp->planenum )
+        {
+            sp->facing++;
+            continue;
+        }
+        
+        if ( axis < 3 )
+        {
+            if ( plane->normal[ axis ] > 0 )
+            {
+                lo = check->mins[ axis ] - plane->dist;
+                hi = check->maxs[ axis ] - plane->dist;
+            }
+            else
+            {
+                lo = -check->maxs[ axis ] - plane->dist;
+                hi = -check->mins[ axis ] - plane->dist;
+            }
+            if ( lo < -ON_EPSILON )
+            {
+                side = hi > ON_EPSILON ? SIDE_CROSS : SIDE_BACK;
+            }
+            else
+            {
+                side = hi > ON_EPSILON ? SIDE_FRONT : SIDE_ON;
+            }
+        }
+        else
+        {
+            side = WindingOnPlaneSide( check->face->w, plane->normal, plane->dist );
+        }
+        
+        if ( side == SIDE_CROSS )
+        {
+            sp->splits++;
+        }
+        else if ( side == SIDE_FRONT )
+        {
+            sp->front++;
+        }
+        else if ( side == SIDE_BACK )
+        {
+            sp->back++;
+        }
+    }
+}
+
+
+
 /*
    SelectSplitPlaneNum()
    finds the best split plane for this node
@@ -82,17 +233,20 @@ void    FreeBspFace( face_t* f )
 static void SelectSplitPlaneNum( node_t* node, face_t* list, int* splitPlaneNum, int* compileFlags )
 {
     face_t*      split;
-    face_t*      check;
     face_t*      bestSplit;
     int splits, facing, front, back;
-    int side;
     plane_t*     plane;
     int value, bestValue;
-    int i;
+    int i, j;
     vec3_t normal;
     float dist;
     int planenum;
     float sizeBias;
+    std::vector<splitFace_t> faces;
+    std::vector<splitPlane_t> planes;
+    std::vector<int> planenums;
+    splitFace_t*     sf;
+    splitPlane_t*    sp;
     
     //int frontC,backC,splitsC,facingC;
     
@@ -101,68 +255,62 @@ static void SelectSplitPlaneNum( node_t* node, face_t* list, int* splitPlaneNum,
     *splitPlaneNum = -1; /* leaf */
     *compileFlags = 0;
     
-    /* ydnar 2002-06-24: changed this to split on z-axis as well */
-    /* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
-    
     /* if it is crossing a block boundary, force a split */
-    for ( i = 0; i < 3; i++ )
+    i = BlockSplitAxis( node, &dist );
+    if ( i >= 0 )
     {
-        if ( blockSize[ i ] <= 0 )
-        {
-            continue;
-        }
-        dist = blockSize[ i ] * ( floor( node->mins[ i ] / blockSize[ i ] ) + 1 );
-        if ( node->maxs[ i ] > dist )
-        {
-            VectorClear( normal );
-            normal[ i ] = 1;
-            planenum = FindFloatPlane( normal, dist, 0, NULL );
-            *splitPlaneNum = planenum;
-            return;
-        }
+        VectorClear( normal );
+        normal[ i ] = 1;
+        planenum = FindFloatPlane( normal, dist, 0, NULL );
+        *splitPlaneNum = planenum;
+        return;
     }
     
     /* pick one of the face planes */
     bestValue = -99999;
     bestSplit = list;
     
+    /* cache face bounds */
+    for ( split = list; split; split = split->next )
+    {
+        faces.push_back( splitFace_t() );
+        sf = &faces.back();
+        sf->face = split;
+        sf->planenum = split->planenum;
+        ClearBounds( sf->mins, sf->maxs );
+        for ( j = 0; j < split->w->numpoints; j++ )
+        {
+            AddPointToBounds( split->w->p[ j ], sf->mins, sf->maxs );
+        }
+        planenums.push_back( split->planenum );
+    }
+    
+    /* count sides once per distinct plane, coplanar faces all score the same counts */
+    std::sort( planenums.begin(), planenums.end() );
+    planenums.erase( std::unique( planenums.begin(), planenums.end() ), planenums.end() );
+    planes.resize( planenums.size() );
+    for ( i = 0; i < ( int ) planes.size(); i++ )
+    {
+        planes[ i ].planenum = planenums[ i ];
+        CountPlaneSides( &planes[ i ], faces );
+    }
     
     // div0: this check causes detail/structural mixes
     //for( split = list; split; split = split->next )
     //	split->checked = qfalse;
     
-    for ( split = list; split; split = split->next )
+    for ( i = 0; i < ( int ) faces.size(); i++ )
     {
         //if ( split->checked )
         //	continue;
         
+        split = faces[ i ].face;
         plane = &mapplanes[ split->planenum ];
-        splits = 0;
-        facing = 0;
-        front = 0;
-        back = 0;
-        for ( check = list ; check ; check = check->next )
-        {
-            if ( check->planenum == split->planenum )
-            {
-                facing++;
-                //check->checked = qtrue;	// won't need to test this plane again
-                continue;
-            }
-            side = WindingOnPlaneSide( check->w, plane->normal, plane->dist );
-            if ( side == SIDE_CROSS )
-            {
-                splits++;
-            }
-            else if ( side == SIDE_FRONT )
-            {
-                front++;
-            }
-            else if ( side == SIDE_BACK )
-            {
-                back++;
-            }
-        }
+        sp = &planes[ std::lower_bound( planenums.begin(), planenums.end(), split->planenum ) - planenums.begin() ];
+        splits = sp->splits;
+        facing = sp->facing;
+        front = sp->front;
+        back = sp->back;
         
         if ( bspAlternateSplitWeights )
         {
@@ -227,7 +375,8 @@ static void SelectSplitPlaneNum( node_t* node, face_t* list, int* splitPlaneNum,
     }
 #endif
     
-    if ( *splitPlaneNum > -1 )
+    /* the usage counter only feeds the alternate weights, which always build serially */
+    if ( *splitPlaneNum > -1 && bspAlternateSplitWeights )
     {
         mapplanes[ *splitPlaneNum ].counter++;
     }
@@ -253,6 +402,59 @@ int CountFaceList( face_t* list )
 
 
 
+/*
+   QueueFaceTreeTask()
+   during the serial top pass, hands a subtree to the worker threads once it is small enough
+ */
+
+static qboolean QueueFaceTreeTask( node_t* node, face_t* list )
+{
+    faceTreeTask_t task;
+    float dist;
+    
+    
+    /* not queueing */
+    if ( faceTreeQueue == NULL )
+    {
+        return qfalse;
+    }
+    
+    /* keep splitting big nodes here, as well as nodes crossing block boundaries (they create planes) */
+    task.numFaces = CountFaceList( list );
+    if ( task.numFaces > faceTreeTaskFaces || BlockSplitAxis( node, &dist ) >= 0 )
+    {
+        return qfalse;
+    }
+    
+    /* queue it */
+    task.node = node;
+    task.list = list;
+    faceTreeQueue->push_back( task );
+    return qtrue;
+}
+
+
+
+/*
+   FaceTreeTaskCost()
+   FaceTreeTask()
+   builds one queued subtree
+ */
+
+static int FaceTreeTaskCost( int taskNum )
+{
+    return faceTreeTasks[ taskNum ].numFaces;
+}
+
+static void FaceTreeTask( int taskNum )
+{
+    faceTreeTask_t*  task = &faceTreeTasks[ taskNum ];
+    
+    BuildFaceTree_r( task->node, task->list );
+}
+
+
+
 /*
    BuildFaceTree_r()
    recursively builds the bsp, splitting on face planes
@@ -391,8 +593,18 @@ void BuildFaceTree_r( node_t* node, face_t* list )
     }
 #endif
     
+    /* remember split nodes above queued subtrees, they get their structural flags after the subtrees are built */
+    if ( faceTreeTopNodes != NULL )
+    {
+        faceTreeTopNodes->push_back( node );
+    }
+    
     for ( i = 0 ; i < 2 ; i++ )
     {
+        if ( QueueFaceTreeTask( node->children[i], childLists[i] ) )
+        {
+            continue;
+        }
         BuildFaceTree_r( node->children[i], childLists[i] );
         if ( !node->has_structural_children && node->children[i]->has_structural_children )
         {
@@ -426,6 +638,9 @@ tree_t* FaceBSP( face_t* list )
     face_t*  face;
     int i;
     int count;
+    std::vector<faceTreeTask_t> tasks;
+    std::vector<node_t*> topNodes;
+    std::chrono::steady_clock::time_point start;
     
     Sys_FPrintf( SYS_VRB, "--- FaceBSP ---\n" );
     
@@ -452,9 +667,41 @@ tree_t* FaceBSP( face_t* list )
     VectorCopy( tree->maxs, tree->headnode->maxs );
     c_faceLeafs = 0;
     
-    BuildFaceTree_r( tree->headnode, list );
+    /* build the top of the tree here, queueing subtrees for the threads (the alternate weights depend on build order) */
+    start = std::chrono::steady_clock::now();
+    if ( numthreads > 1 && !bspAlternateSplitWeights )
+    {
+        faceTreeQueue = &tasks;
+        faceTreeTopNodes = &topNodes;
+        faceTreeTaskFaces = std::max( MIN_FACE_TREE_TASK_FACES, count / ( numthreads * 16 ) );
+    }
+    if ( !QueueFaceTreeTask( tree->headnode, list ) )
+    {
+        BuildFaceTree_r( tree->headnode, list );
+    }
+    faceTreeQueue = NULL;
+    faceTreeTopNodes = NULL;
+    
+    /* build the queued subtrees; each only depends on its own faces, so the tree matches a serial build */
+    if ( !tasks.empty() )
+    {
+        faceTreeTasks = tasks.data();
+        RunThreadsOnIndividualByCost( ( int ) tasks.size(), qfalse, FaceTreeTask, FaceTreeTaskCost );
+        
+        /* pull the structural flags up from the subtrees, children before parents */
+        for ( i = ( int ) topNodes.size() - 1; i >= 0; i-- )
+        {
+            if ( topNodes[ i ]->children[ 0 ]->has_structural_children || topNodes[ i ]->children[ 1 ]->has_structural_children )
+            {
+                topNodes[ i ]->has_structural_children = qtrue;
+            }
+        }
+    }
+    faceTreeTasks = NULL;
     
-    Sys_FPrintf( SYS_VRB, "%9d leafs\n", c_faceLeafs );
+    Sys_FPrintf( SYS_VRB, "%9d leafs\n", c_faceLeafs.load() );
+    Sys_FPrintf( SYS_VRB, "%9d subtrees on %d threads in %.2f seconds\n", ( int ) tasks.size(), numthreads,
+                 std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() );
     
     return tree;
 }
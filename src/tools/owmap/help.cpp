@@ -211,6 +211,7 @@ void HelpLight()
         {"-gridambientscale <F>", "Scaling factor for the light grid ambient components only"},
         {"-griddirectionality <F>", "Trade off directional light in favor of ambient light in lightgrid"},
         {"-gridscale <F>", "Scaling factor for the light grid only"},
+        {"-incremental", "Reuse lightmaps and grid points whose inputs are unchanged since the last `-incremental` run (kept in a .lightcache file)"},
         {"-lightanglehl", "Enable Half Lambert lighting attenuation"},
         {"-lightmapdir <path>", "Directory to store external lightmaps (default: same as map name without extension)"},
         {"-lightmapsearchblocksize <N>", "Sets of lightmap search blocksize"},
@@ -220,6 +221,7 @@ void HelpLight()
         {"-lomem", "Low memory but slower lighting mode"},
         {"-lowquality", "Low quality floodlight (currently breaks floodlight, do not use)"},
         {"-minsamplesize <N>", "Sets minimum lightmap resolution in units/px"},
+        {"-nobvh", "Trace through the node tree instead of the bvh (slower, for comparison)"},
         {"-nocollapse", "Do not collapse identical lightmaps"},
         {"-nofastpoint", "Disable automatic fast mode for point lights"},
         {"-nofloodstyles", "Disable floodlighting on styled lightmaps"},
@@ -258,6 +260,7 @@ void HelpLight()
         {"-style, -styles", "Enable support for light styles"},
         {"-sunonly", "Only compute sun light"},
         {"-super <N>, -supersample <N>", "Ordered grid supersampling quality"},
+        {"-tracebench", "Benchmark rays/sec of the node tree and the bvh before lighting"},
         {"-thresh <F>", "Triangle subdivision threshold"},
         {"-trianglecheck", "Nudges luxels to their original triangle"},
         {"-trisoup", "Convert brush faces to triangle soup"},
@@ -847,11 +847,12 @@ float PointToPolygonFormFactor( const vec3_t point, const vec3_t normal, const w
 
 
 /*
-   LightContributionTosample()
-   determines the amount of light reaching a sample (luxel or vertex) from a given light
+   LightContributionToSampleDeferred()
+   determines the amount of light reaching a sample (luxel or vertex) from a given light up to the occlusion trace
+   returns LIGHT_CONTRIBUTION_DEFERRED when the caller has to TraceLine() and FinishLightContribution() the sample
  */
 
-int LightContributionToSample( trace_t* trace )
+int LightContributionToSampleDeferred( trace_t* trace )
 {
     light_t*         light;
     float angle;
@@ -1297,16 +1298,10 @@ int LightContributionToSample( trace_t* trace )
         /* trace to point */
         if ( trace->testOcclusion && !trace->forceSunlight )
         {
-            /* trace */
-            TraceLine( trace );
-            trace->forceSubsampling *= add;
-            if ( !( trace->compileFlags & C_SKY ) || trace->opaque )
-            {
-                VectorClear( trace->color );
-                VectorClear( trace->directionContribution );
-                
-                return -1;
-            }
+            /* sunlight has to reach the sky */
+            trace->deferredSky = qtrue;
+            trace->deferredAdd = add;
+            return LIGHT_CONTRIBUTION_DEFERRED;
         }
         
         /* return to sender */
@@ -1359,9 +1354,36 @@ int LightContributionToSample( trace_t* trace )
     VectorScale( light->color, add, trace->color );
     
     /* raytrace */
-    TraceLine( trace );
-    trace->forceSubsampling *= add;
-    if ( trace->passSolid || trace->opaque )
+    trace->deferredSky = qfalse;
+    trace->deferredAdd = add;
+    return LIGHT_CONTRIBUTION_DEFERRED;
+}
+
+
+
+/*
+   FinishLightContribution()
+   applies the occlusion trace of a deferred LightContributionToSampleDeferred() sample
+ */
+
+int FinishLightContribution( trace_t* trace )
+{
+    qboolean occluded;
+    
+    
+    trace->forceSubsampling *= trace->deferredAdd;
+    
+    /* sunlight must pass through sky, everything else must not hit anything */
+    if ( trace->deferredSky )
+    {
+        occluded = ( !( trace->compileFlags & C_SKY ) || trace->opaque ) ? qtrue : qfalse;
+    }
+    else
+    {
+        occluded = ( trace->passSolid || trace->opaque ) ? qtrue : qfalse;
+    }
+    
+    if ( occluded )
     {
         VectorClear( trace->color );
         VectorClear( trace->directionContribution );
@@ -1375,6 +1397,29 @@ int LightContributionToSample( trace_t* trace )
 
 
 
+/*
+   LightContributionTosample()
+   determines the amount of light reaching a sample (luxel or vertex) from a given light
+ */
+
+int LightContributionToSample( trace_t* trace )
+{
+    int contribution;
+    
+    
+    contribution = LightContributionToSampleDeferred( trace );
+    if ( contribution != LIGHT_CONTRIBUTION_DEFERRED )
+    {
+        return contribution;
+    }
+    
+    /* raytrace */
+    TraceLine( trace );
+    return FinishLightContribution( trace );
+}
+
+
+
 /*
    LightingAtSample()
    determines the amount of light reaching a sample (luxel or vertex)
@@ -1789,6 +1834,12 @@ void TraceGrid( int num )
         }
     }
     
+    /* -incremental: copy the point from the light cache if nothing that reaches it changed */
+    if ( incrementalLight && !bouncing && ReuseGridPoint( num, trace.origin, trace.cluster ) )
+    {
+        return;
+    }
+    
     /* setup trace */
     trace.testOcclusion = !noTrace ? qtrue : qfalse;
     trace.forceSunlight = qfalse;
@@ -2163,13 +2214,17 @@ void LightWorld( const char* BSPFilePath )
     /* ydnar: smooth normals */
     if ( shade )
     {
+        BeginLightStage( "SmoothNormals", 0, numBSPDrawSurfaces, LIGHT_STAGE_ALWAYS );
         Sys_Printf( "--- SmoothNormals ---\n" );
         SmoothNormals();
+        EndLightStage();
     }
     
     /* determine the number of grid points */
+    BeginLightStage( "SetupGrid", 0, 0, LIGHT_STAGE_ALWAYS );
     Sys_Printf( "--- SetupGrid ---\n" );
     SetupGrid();
+    EndLightStage();
     
     /* find the optional minimum lighting values */
     GetVectorForKey( &entities[ 0 ], "_color", color );
@@ -2229,19 +2284,26 @@ void LightWorld( const char* BSPFilePath )
     }
     
     /* create world lights */
+    BeginLightStage( "CreateLights", 0, numEntities, LIGHT_STAGE_ALWAYS );
     Sys_FPrintf( SYS_VRB, "--- CreateLights ---\n" );
     CreateEntityLights();
     CreateSurfaceLights();
+    EndLightStage();
     Sys_Printf( "%9d point lights\n", numPointLights );
     Sys_Printf( "%9d spotlights\n", numSpotLights );
     Sys_Printf( "%9d diffuse (area) lights\n", numDiffuseLights );
     Sys_Printf( "%9d sun/sky lights\n", numSunLights );
     
     /* calculate lightgrid */
-    if ( !noGridLighting )
+    if ( !noGridLighting && BeginLightStage( "TraceGrid", 0, numRawGridPoints, LIGHT_STAGE_CHECKPOINT ) )
     {
         /* ydnar: set up light envelopes */
         SetupEnvelopes( qtrue, fastgrid );
+        if ( incrementalLight )
+        {
+            HashLightsForCache();
+            SetupGridCache();
+        }
         
         Sys_Printf( "--- TraceGrid ---\n" );
         inGrid = qtrue;
@@ -2249,34 +2311,58 @@ void LightWorld( const char* BSPFilePath )
         inGrid = qfalse;
         Sys_Printf( "%d x %d x %d = %d grid\n",
                     gridBounds[ 0 ], gridBounds[ 1 ], gridBounds[ 2 ], numBSPGridPoints );
-                    
+        if ( incrementalLight )
+        {
+            Sys_Printf( "%9d grid points reused\n", NumGridPointsReused() );
+        }
+        
         /* ydnar: emit statistics on light culling */
         Sys_FPrintf( SYS_VRB, "%9d grid points envelope culled\n", gridEnvelopeCulled );
         Sys_FPrintf( SYS_VRB, "%9d grid points bounds culled\n", gridBoundsCulled );
+        EndLightStage();
     }
     
     /* slight optimization to remove a sqrt */
     subdivideThreshold *= subdivideThreshold;
     
     /* map the world luxels */
-    Sys_Printf( "--- MapRawLightmap ---\n" );
-    RunThreadsOnIndividual( numRawLightmaps, qtrue, MapRawLightmap );
-    Sys_Printf( "%9d luxels\n", numLuxels );
-    Sys_Printf( "%9d luxels mapped\n", numLuxelsMapped );
-    Sys_Printf( "%9d luxels occluded\n", numLuxelsOccluded );
+    if ( BeginLightStage( "MapRawLightmap", 0, numRawLightmaps, LIGHT_STAGE_CHECKPOINT ) )
+    {
+        Sys_Printf( "--- MapRawLightmap ---\n" );
+        RunThreadsOnIndividualByCost( numRawLightmaps, qtrue, MapRawLightmap, RawLightmapCost );
+        Sys_Printf( "%9d luxels\n", numLuxels );
+        Sys_Printf( "%9d luxels mapped\n", numLuxelsMapped );
+        Sys_Printf( "%9d luxels occluded\n", numLuxelsOccluded );
+        EndLightStage();
+    }
+    
+    /* ydnar: set up light envelopes */
+    SetupEnvelopes( qfalse, fast );
+    
+    /* -incremental: restore the lightmaps whose inputs didn't change */
+    if ( incrementalLight )
+    {
+        HashLightsForCache();
+        if ( !LightStagesResuming() )
+        {
+            ReuseRawLightmaps();
+        }
+    }
     
     /* dirty them up */
-    if ( dirty )
+    if ( dirty && BeginLightStage( "DirtyRawLightmap", 0, numRawLightmaps, LIGHT_STAGE_CHECKPOINT ) )
     {
         Sys_Printf( "--- DirtyRawLightmap ---\n" );
-        RunThreadsOnIndividual( numRawLightmaps, qtrue, DirtyRawLightmap );
+        RunThreadsOnIndividualByCost( numRawLightmaps, qtrue, DirtyRawLightmap, RawLightmapCost );
+        EndLightStage();
     }
     
     /* floodlight pass */
-    FloodlightRawLightmaps();
-    
-    /* ydnar: set up light envelopes */
-    SetupEnvelopes( qfalse, fast );
+    if ( BeginLightStage( "FloodlightRawLightmap", 0, numRawLightmaps, LIGHT_STAGE_CHECKPOINT ) )
+    {
+        FloodlightRawLightmaps();
+        EndLightStage();
+    }
     
     /* light up my world */
     lightsPlaneCulled = 0;
@@ -2284,15 +2370,33 @@ void LightWorld( const char* BSPFilePath )
     lightsBoundsCulled = 0;
     lightsClusterCulled = 0;
     
-    Sys_Printf( "--- IlluminateRawLightmap ---\n" );
-    RunThreadsOnIndividual( numRawLightmaps, qtrue, IlluminateRawLightmap );
-    Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
+    if ( BeginLightStage( "IlluminateRawLightmap", 0, numRawLightmaps, LIGHT_STAGE_CHECKPOINT ) )
+    {
+        Sys_Printf( "--- IlluminateRawLightmap ---\n" );
+        RunThreadsOnIndividualByCost( numRawLightmaps, qtrue, IlluminateRawLightmap, RawLightmapCost );
+        Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
+        EndLightStage();
+    }
+    
+    /* -incremental: keep the unstitched lightmaps for the next run */
+    if ( incrementalLight && !LightStagesResuming() )
+    {
+        WriteLightCache();
+    }
     
-    StitchSurfaceLightmaps();
+    if ( BeginLightStage( "StitchSurfaceLightmaps", 0, numRawLightmaps, LIGHT_STAGE_SKIP ) )
+    {
+        StitchSurfaceLightmaps();
+        EndLightStage();
+    }
     
-    Sys_Printf( "--- IlluminateVertexes ---\n" );
-    RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
-    Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+    if ( BeginLightStage( "IlluminateVertexes", 0, numBSPDrawSurfaces, LIGHT_STAGE_CHECKPOINT ) )
+    {
+        Sys_Printf( "--- IlluminateVertexes ---\n" );
+        RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
+        Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+        EndLightStage();
+    }
     
     /* ydnar: emit statistics on light culling */
     Sys_FPrintf( SYS_VRB, "%9d lights plane culled\n", lightsPlaneCulled );
@@ -2306,10 +2410,14 @@ void LightWorld( const char* BSPFilePath )
     while ( bounce > 0 )
     {
         /* store off the bsp between bounces */
-        StoreSurfaceLightmaps();
-        UnparseEntities();
-        Sys_Printf( "Writing %s\n", BSPFilePath );
-        WriteBSPFile( BSPFilePath );
+        if ( BeginLightStage( "StoreSurfaceLightmaps", b, numRawLightmaps, LIGHT_STAGE_SKIP ) )
+        {
+            StoreSurfaceLightmaps();
+            UnparseEntities();
+            Sys_Printf( "Writing %s\n", BSPFilePath );
+            WriteBSPFile( BSPFilePath );
+            EndLightStage();
+        }
         
         /* note it */
         Sys_Printf( "\n--- Radiosity (bounce %d of %d) ---\n", b, bt );
@@ -2319,20 +2427,24 @@ void LightWorld( const char* BSPFilePath )
         VectorClear( ambientColor );
         g_floodlight = qfalse;
         
-        /* generate diffuse lights */
-        RadFreeLights();
-        RadCreateDiffuseLights();
-        
-        /* setup light envelopes */
-        SetupEnvelopes( qfalse, fastbounce );
-        if ( numLights == 0 )
+        /* generate diffuse lights, a bounce is resumed as a whole */
+        if ( BeginLightStage( "RadCreateDiffuseLights", b, numBSPDrawSurfaces, LIGHT_STAGE_SKIP ) )
         {
-            Sys_Printf( "No diffuse light to calculate, ending radiosity.\n" );
-            return;
+            RadFreeLights();
+            RadCreateDiffuseLights();
+            EndLightStage();
+            
+            /* setup light envelopes */
+            SetupEnvelopes( qfalse, fastbounce );
+            if ( numLights == 0 )
+            {
+                Sys_Printf( "No diffuse light to calculate, ending radiosity.\n" );
+                return;
+            }
         }
         
         /* add to lightgrid */
-        if ( bouncegrid )
+        if ( bouncegrid && BeginLightStage( "BounceGrid", b, numRawGridPoints, LIGHT_STAGE_SKIP ) )
         {
             gridEnvelopeCulled = 0;
             gridBoundsCulled = 0;
@@ -2343,6 +2455,7 @@ void LightWorld( const char* BSPFilePath )
             inGrid = qfalse;
             Sys_FPrintf( SYS_VRB, "%9d grid points envelope culled\n", gridEnvelopeCulled );
             Sys_FPrintf( SYS_VRB, "%9d grid points bounds culled\n", gridBoundsCulled );
+            EndLightStage();
         }
         
         /* light up my world */
@@ -2351,16 +2464,28 @@ void LightWorld( const char* BSPFilePath )
         lightsBoundsCulled = 0;
         lightsClusterCulled = 0;
         
-        Sys_Printf( "--- IlluminateRawLightmap ---\n" );
-        RunThreadsOnIndividual( numRawLightmaps, qtrue, IlluminateRawLightmap );
-        Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
-        Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+        if ( BeginLightStage( "IlluminateRawLightmap", b, numRawLightmaps, LIGHT_STAGE_SKIP ) )
+        {
+            Sys_Printf( "--- IlluminateRawLightmap ---\n" );
+            RunThreadsOnIndividualByCost( numRawLightmaps, qtrue, IlluminateRawLightmap, RawLightmapCost );
+            Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
+            Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+            EndLightStage();
+        }
         
-        StitchSurfaceLightmaps();
+        if ( BeginLightStage( "StitchSurfaceLightmaps", b, numRawLightmaps, LIGHT_STAGE_SKIP ) )
+        {
+            StitchSurfaceLightmaps();
+            EndLightStage();
+        }
         
-        Sys_Printf( "--- IlluminateVertexes ---\n" );
-        RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
-        Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+        if ( BeginLightStage( "IlluminateVertexes", b, numBSPDrawSurfaces, LIGHT_STAGE_CHECKPOINT ) )
+        {
+            Sys_Printf( "--- IlluminateVertexes ---\n" );
+            RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
+            Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
+            EndLightStage();
+        }
         
         /* ydnar: emit statistics on light culling */
         Sys_FPrintf( SYS_VRB, "%9d lights plane culled\n", lightsPlaneCulled );
@@ -2379,7 +2504,9 @@ void LightWorld( const char* BSPFilePath )
     }
     
     /* ydnar: store off lightmaps */
+    BeginLightStage( "StoreSurfaceLightmaps", 0, numRawLightmaps, LIGHT_STAGE_ALWAYS );
     StoreSurfaceLightmaps();
+    EndLightStage();
 }
 
 /*
@@ -2393,6 +2520,7 @@ int LightMain( int argc, char** argv )
     float f;
     char BSPFilePath[ 1024 ];
     char surfaceFilePath[ 1024 ];
+    char lightCacheFilePath[ 1024 ];
     BSPFilePath[0] = 0;
     surfaceFilePath[0] = 0;
     const char*  value;
@@ -3161,6 +3289,37 @@ int LightMain( int argc, char** argv )
             noSurfaces = qtrue;
             options.push_back( { argv[i], "", "not tracing against surfaces" } );
         }
+        else if ( !Q_stricmp( argv[i], "-nobvh" ) )
+        {
+            noTraceBVH = qtrue;
+            options.push_back( { argv[i], "", "tracing through the node tree instead of the bvh" } );
+        }
+        else if ( !Q_stricmp( argv[i], "-incremental" ) )
+        {
+            incrementalLight = qtrue;
+            options.push_back( { argv[i], "", "reusing unchanged lightmaps and grid points from the light cache" } );
+        }
+        else if ( !Q_stricmp( argv[i], "-checkpoint" ) )
+        {
+            lightCheckpoint = qtrue;
+            options.push_back( { argv[i], "", "writing a light checkpoint after every stage" } );
+        }
+        else if ( !Q_stricmp( argv[i], "-resume" ) )
+        {
+            lightCheckpoint = qtrue;
+            lightResume = qtrue;
+            options.push_back( { argv[i], "", "resuming from the light checkpoint" } );
+        }
+        else if ( !Q_stricmp( argv[i], "-stagereport" ) )
+        {
+            lightStageReport = qtrue;
+            options.push_back( { argv[i], "", "writing stage times to a json report" } );
+        }
+        else if ( !Q_stricmp( argv[i], "-tracebench" ) )
+        {
+            traceBenchmark = qtrue;
+            options.push_back( { argv[i], "", "benchmarking the raytracer before lighting" } );
+        }
         else if ( !Q_stricmp( argv[i], "-dump" ) )
         {
             dump = qtrue;
@@ -3376,6 +3535,11 @@ int LightMain( int argc, char** argv )
         DefaultExtension( surfaceFilePath, ".srf" );
     }
     
+    /* light cache for -incremental lives next to the bsp */
+    strcpy( lightCacheFilePath, BSPFilePath );
+    StripExtension( lightCacheFilePath );
+    DefaultExtension( lightCacheFilePath, ".lightcache" );
+    
     /* ydnar: set default sample size */
     SetDefaultSampleSize( sampleSize );
     
@@ -3429,8 +3593,23 @@ int LightMain( int argc, char** argv )
     SetupFloodLight();
     SetupSurfaceLightmaps();
     
+    /* -checkpoint: find out how far the last run got */
+    SetupLightCheckpoint( BSPFilePath, argc, argv );
+    
     /* initialize the surface facet tracing */
+    BeginLightStage( "SetupTraceNodes", 0, numBSPDrawSurfaces, LIGHT_STAGE_ALWAYS );
     SetupTraceNodes();
+    EndLightStage();
+    if ( traceBenchmark )
+    {
+        TraceBenchmark();
+    }
+    
+    /* -incremental: hash the shared inputs and load the last run's cache */
+    if ( incrementalLight )
+    {
+        SetupLightCache( lightCacheFilePath, argc, argv );
+    }
     
     /* light the world */
     LightWorld( BSPFilePath );
@@ -3439,6 +3618,7 @@ int LightMain( int argc, char** argv )
     UnparseEntities();
     Sys_Printf( "Writing %s\n", BSPFilePath );
     WriteBSPFile( BSPFilePath );
+    FinishLightStages();
     
     /* ydnar: export lightmaps */
     if ( exportLightmaps && !externalLightmaps )
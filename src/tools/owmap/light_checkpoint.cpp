@@ -0,0 +1,620 @@
+/* -------------------------------------------------------------------------------
+   
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+   
+   This file is part of GtkRadiant.
+   
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+   
+   ----------------------------------------------------------------------------------
+   
+   This code has been altered significantly from its original form, to support
+   several games based on the Quake III Arena engine, in the form of "Q3Map2."
+   
+   ------------------------------------------------------------------------------- */
+
+
+
+
+/* marker */
+#define LIGHT_CHECKPOINT_C
+
+
+
+/* dependencies */
+#include "q3map2.h"
+#include <chrono>
+
+
+
+/* -------------------------------------------------------------------------------
+
+   light checkpoints and stage timing
+   
+   the light stages are timed as they run, -stagereport writes the times as json
+   next to the bsp after every stage.
+   
+   with -checkpoint, the lighting state is written to a .lightckpt file after
+   every stage that ends with it complete: the grid points, the super luxels of
+   the raw lightmaps, the bsp luxels the bounces add up in and the vertex
+   luxels. -resume skips the stages the
+   checkpoint covers, restores it where the last of them ended and lights on
+   from there. stages in between that only feed a later checkpoint are skipped
+   too, stages that set up other state always run.
+   
+   a bounce is checkpointed as a whole, its diffuse lights are made from the
+   state at its start and are not kept.
+   
+   ------------------------------------------------------------------------------- */
+
+#define LIGHT_CHECKPOINT_IDENT      ( ( 'K' << 24 ) + ( 'L' << 16 ) + ( 'W' << 8 ) + 'O' )
+#define LIGHT_CHECKPOINT_VERSION    1
+
+#define LIGHT_CHECKPOINT_DELUXELS   ( 1 << MAX_LIGHTMAPS )
+#define LIGHT_CHECKPOINT_BSP_LUXELS ( MAX_LIGHTMAPS + 1 )
+#define LIGHT_CHECKPOINT_BSP_DELUXELS ( 1 << ( 2 * MAX_LIGHTMAPS + 1 ) )
+
+typedef struct
+{
+    int ident, version;
+    uint64_t inputHash;
+    int numStages;
+    int numRawLightmaps, numRawGridPoints, numBSPGridPoints, numBSPDrawVerts;
+}
+lightCheckpointHeader_t;
+
+typedef struct
+{
+    const char*      name;
+    int bounce, items;
+    lightStageMode_t mode;
+    qboolean resumed;
+    double seconds, checkpointSeconds;
+}
+lightStage_t;
+
+static char checkpointPath[ 1024 ], reportPath[ 1024 ], reportBSPPath[ 1024 ];
+static uint64_t inputHash;
+static int stagesDone, resumeStages;
+
+static std::vector< lightStage_t > stages;
+static int currentStage = -1;
+static std::chrono::steady_clock::time_point lightStart, stageStart;
+
+
+
+/*
+   LightmapCheckpointSize()
+   size of the luxels of a raw lightmap in a checkpoint, after its sizes and mask
+ */
+
+static long LightmapCheckpointSize( const int ints[ 5 ] )
+{
+    int i, mask;
+    long luxels, bspLuxels, size;
+    
+    
+    luxels = ( long ) ints[ 0 ] * ints[ 1 ];
+    bspLuxels = ( long ) ints[ 2 ] * ints[ 3 ];
+    mask = ints[ 4 ];
+    size = MAX_LIGHTMAPS;
+    for ( i = 0; i < MAX_LIGHTMAPS; i++ )
+    {
+        if ( mask & ( 1 << i ) )
+        {
+            size += luxels * SUPER_LUXEL_SIZE * sizeof( float );
+        }
+    }
+    size += luxels * ( SUPER_ORIGIN_SIZE + SUPER_NORMAL_SIZE + SUPER_FLOODLIGHT_SIZE ) * sizeof( float );
+    size += luxels * sizeof( int );
+    if ( mask & LIGHT_CHECKPOINT_DELUXELS )
+    {
+        size += luxels * SUPER_DELUXEL_SIZE * sizeof( float );
+    }
+    
+    /* light accumulated over the bounces */
+    for ( i = 0; i < MAX_LIGHTMAPS; i++ )
+    {
+        if ( mask & ( 1 << ( LIGHT_CHECKPOINT_BSP_LUXELS + i ) ) )
+        {
+            size += bspLuxels * BSP_LUXEL_SIZE * sizeof( float );
+        }
+    }
+    if ( mask & LIGHT_CHECKPOINT_BSP_DELUXELS )
+    {
+        size += bspLuxels * BSP_DELUXEL_SIZE * sizeof( float );
+    }
+    
+    return size;
+}
+
+
+
+/*
+   LoadLightCheckpoint()
+   checks that the checkpoint was made from the same inputs and notes how far it got
+ */
+
+static void LoadLightCheckpoint( void )
+{
+    int i, ints[ 5 ];
+    long expected;
+    FILE*                file;
+    lightCheckpointHeader_t header;
+    
+    
+    file = fopen( checkpointPath, "rb" );
+    if ( file == NULL )
+    {
+        Sys_Printf( "No light checkpoint %s, lighting everything\n", checkpointPath );
+        return;
+    }
+    
+    if ( fread( &header, sizeof( header ), 1, file ) != 1 ||
+            header.ident != LIGHT_CHECKPOINT_IDENT || header.version != LIGHT_CHECKPOINT_VERSION )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Light checkpoint %s is not valid, lighting everything\n", checkpointPath );
+        fclose( file );
+        return;
+    }
+    if ( header.inputHash != inputHash || header.numRawLightmaps != numRawLightmaps || header.numBSPDrawVerts != numBSPDrawVerts )
+    {
+        Sys_Printf( "Light checkpoint %s was made with other settings or inputs, lighting everything\n", checkpointPath );
+        fclose( file );
+        return;
+    }
+    
+    /* walk the lightmap records */
+    expected = sizeof( header );
+    for ( i = 0; i < numRawLightmaps; i++ )
+    {
+        if ( fseek( file, expected, SEEK_SET ) != 0 || fread( ints, sizeof( ints ), 1, file ) != 1 ||
+                ints[ 0 ] != rawLightmaps[ i ].sw || ints[ 1 ] != rawLightmaps[ i ].sh ||
+                ints[ 2 ] != rawLightmaps[ i ].w || ints[ 3 ] != rawLightmaps[ i ].h )
+        {
+            break;
+        }
+        expected += sizeof( ints ) + LightmapCheckpointSize( ints );
+    }
+    expected += header.numRawGridPoints * sizeof( rawGridPoint_t ) + header.numBSPGridPoints * sizeof( bspGridPoint_t );
+    expected += 2 * MAX_LIGHTMAPS * numBSPDrawVerts * VERTEX_LUXEL_SIZE * sizeof( float );
+    expected += numBSPDrawSurfaces * MAX_LIGHTMAPS;
+    fseek( file, 0, SEEK_END );
+    if ( i < numRawLightmaps || ftell( file ) != expected )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Light checkpoint %s is truncated, lighting everything\n", checkpointPath );
+        fclose( file );
+        return;
+    }
+    fclose( file );
+    
+    resumeStages = header.numStages;
+    Sys_Printf( "Resuming from light checkpoint %s after %d stages\n", checkpointPath, resumeStages );
+}
+
+
+
+/*
+   SetupLightCheckpoint()
+   sets up the checkpoint and report paths and loads the checkpoint to resume,
+   call after the raw lightmaps are set up
+ */
+
+void SetupLightCheckpoint( const char* bspPath, int argc, char** argv )
+{
+    strcpy( reportBSPPath, bspPath );
+    strcpy( checkpointPath, bspPath );
+    StripExtension( checkpointPath );
+    strcpy( reportPath, checkpointPath );
+    DefaultExtension( checkpointPath, ".lightckpt" );
+    DefaultExtension( reportPath, ".lightstages.json" );
+    
+    if ( !lightCheckpoint )
+    {
+        return;
+    }
+    
+    /* note it */
+    Sys_FPrintf( SYS_VRB, "--- SetupLightCheckpoint ---\n" );
+    
+    inputHash = LightInputHash( argc, argv );
+    if ( lightResume )
+    {
+        LoadLightCheckpoint();
+    }
+}
+
+
+
+/*
+   WriteLightCheckpoint()
+   writes the lighting state after the stages done so far, replacing the last
+   checkpoint only once the new one is complete
+ */
+
+static void WriteLightCheckpoint( void )
+{
+    int i, j, mask, luxels, bspLuxels, ints[ 5 ];
+    char tempPath[ 1024 ];
+    FILE*                file;
+    lightCheckpointHeader_t header;
+    rawLightmap_t*       lm;
+    
+    
+    memset( &header, 0, sizeof( header ) );
+    header.ident = LIGHT_CHECKPOINT_IDENT;
+    header.version = LIGHT_CHECKPOINT_VERSION;
+    header.inputHash = inputHash;
+    header.numStages = stagesDone;
+    header.numRawLightmaps = numRawLightmaps;
+    header.numRawGridPoints = numRawGridPoints;
+    header.numBSPGridPoints = numBSPGridPoints;
+    header.numBSPDrawVerts = numBSPDrawVerts;
+    
+    sprintf( tempPath, "%s.tmp", checkpointPath );
+    file = SafeOpenWrite( tempPath );
+    SafeWrite( file, &header, sizeof( header ) );
+    
+    for ( i = 0; i < numRawLightmaps; i++ )
+    {
+        lm = &rawLightmaps[ i ];
+        luxels = lm->sw * lm->sh;
+        bspLuxels = lm->w * lm->h;
+        
+        mask = 0;
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->superLuxels[ j ] != NULL )
+            {
+                mask |= 1 << j;
+            }
+        }
+        if ( lm->superDeluxels != NULL )
+        {
+            mask |= LIGHT_CHECKPOINT_DELUXELS;
+        }
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->bspLuxels[ j ] != NULL )
+            {
+                mask |= 1 << ( LIGHT_CHECKPOINT_BSP_LUXELS + j );
+            }
+        }
+        if ( lm->bspDeluxels != NULL )
+        {
+            mask |= LIGHT_CHECKPOINT_BSP_DELUXELS;
+        }
+        
+        ints[ 0 ] = lm->sw;
+        ints[ 1 ] = lm->sh;
+        ints[ 2 ] = lm->w;
+        ints[ 3 ] = lm->h;
+        ints[ 4 ] = mask;
+        SafeWrite( file, ints, sizeof( ints ) );
+        SafeWrite( file, lm->styles, MAX_LIGHTMAPS );
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->superLuxels[ j ] != NULL )
+            {
+                SafeWrite( file, lm->superLuxels[ j ], luxels * SUPER_LUXEL_SIZE * sizeof( float ) );
+            }
+        }
+        SafeWrite( file, lm->superOrigins, luxels * SUPER_ORIGIN_SIZE * sizeof( float ) );
+        SafeWrite( file, lm->superNormals, luxels * SUPER_NORMAL_SIZE * sizeof( float ) );
+        SafeWrite( file, lm->superFloodLight, luxels * SUPER_FLOODLIGHT_SIZE * sizeof( float ) );
+        SafeWrite( file, lm->superClusters, luxels * sizeof( int ) );
+        if ( mask & LIGHT_CHECKPOINT_DELUXELS )
+        {
+            SafeWrite( file, lm->superDeluxels, luxels * SUPER_DELUXEL_SIZE * sizeof( float ) );
+        }
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->bspLuxels[ j ] != NULL )
+            {
+                SafeWrite( file, lm->bspLuxels[ j ], bspLuxels * BSP_LUXEL_SIZE * sizeof( float ) );
+            }
+        }
+        if ( mask & LIGHT_CHECKPOINT_BSP_DELUXELS )
+        {
+            SafeWrite( file, lm->bspDeluxels, bspLuxels * BSP_DELUXEL_SIZE * sizeof( float ) );
+        }
+    }
+    
+    SafeWrite( file, rawGridPoints, numRawGridPoints * sizeof( rawGridPoint_t ) );
+    SafeWrite( file, bspGridPoints, numBSPGridPoints * sizeof( bspGridPoint_t ) );
+    for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+    {
+        SafeWrite( file, vertexLuxels[ j ], numBSPDrawVerts * VERTEX_LUXEL_SIZE * sizeof( float ) );
+        SafeWrite( file, radVertexLuxels[ j ], numBSPDrawVerts * VERTEX_LUXEL_SIZE * sizeof( float ) );
+    }
+    for ( i = 0; i < numBSPDrawSurfaces; i++ )
+    {
+        SafeWrite( file, bspDrawSurfaces[ i ].vertexStyles, MAX_LIGHTMAPS );
+    }
+    fclose( file );
+    
+    remove( checkpointPath );
+    if ( rename( tempPath, checkpointPath ) != 0 )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Could not rename %s to %s\n", tempPath, checkpointPath );
+    }
+}
+
+
+
+/*
+   RestoreLightCheckpoint()
+   reads the lighting state back, the stages it covers were skipped
+ */
+
+static void RestoreLightCheckpoint( void )
+{
+    int i, j, luxels, bspLuxels, ints[ 5 ];
+    FILE*                file;
+    lightCheckpointHeader_t header;
+    rawLightmap_t*       lm;
+    
+    
+    Sys_Printf( "Restoring light checkpoint %s\n", checkpointPath );
+    
+    file = SafeOpenRead( checkpointPath );
+    SafeRead( file, &header, sizeof( header ) );
+    if ( header.ident != LIGHT_CHECKPOINT_IDENT || header.inputHash != inputHash || header.numStages != resumeStages ||
+            header.numRawGridPoints != numRawGridPoints || header.numBSPGridPoints != numBSPGridPoints )
+    {
+        Error( "Light checkpoint %s changed while it was resumed", checkpointPath );
+    }
+    
+    for ( i = 0; i < numRawLightmaps; i++ )
+    {
+        lm = &rawLightmaps[ i ];
+        luxels = lm->sw * lm->sh;
+        bspLuxels = lm->w * lm->h;
+        
+        SafeRead( file, ints, sizeof( ints ) );
+        SafeRead( file, lm->styles, MAX_LIGHTMAPS );
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( ints[ 4 ] & ( 1 << j ) )
+            {
+                if ( lm->superLuxels[ j ] == NULL )
+                {
+                    lm->superLuxels[ j ] = static_cast<float*>( safe_malloc( luxels * SUPER_LUXEL_SIZE * sizeof( float ) ) );
+                }
+                SafeRead( file, lm->superLuxels[ j ], luxels * SUPER_LUXEL_SIZE * sizeof( float ) );
+            }
+            else if ( lm->superLuxels[ j ] != NULL )
+            {
+                free( lm->superLuxels[ j ] );
+                lm->superLuxels[ j ] = NULL;
+            }
+        }
+        SafeRead( file, lm->superOrigins, luxels * SUPER_ORIGIN_SIZE * sizeof( float ) );
+        SafeRead( file, lm->superNormals, luxels * SUPER_NORMAL_SIZE * sizeof( float ) );
+        SafeRead( file, lm->superFloodLight, luxels * SUPER_FLOODLIGHT_SIZE * sizeof( float ) );
+        SafeRead( file, lm->superClusters, luxels * sizeof( int ) );
+        if ( ints[ 4 ] & LIGHT_CHECKPOINT_DELUXELS )
+        {
+            if ( lm->superDeluxels == NULL )
+            {
+                lm->superDeluxels = static_cast<float*>( safe_malloc( luxels * SUPER_DELUXEL_SIZE * sizeof( float ) ) );
+            }
+            SafeRead( file, lm->superDeluxels, luxels * SUPER_DELUXEL_SIZE * sizeof( float ) );
+        }
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( ints[ 4 ] & ( 1 << ( LIGHT_CHECKPOINT_BSP_LUXELS + j ) ) )
+            {
+                if ( lm->bspLuxels[ j ] == NULL )
+                {
+                    lm->bspLuxels[ j ] = static_cast<float*>( safe_malloc( bspLuxels * BSP_LUXEL_SIZE * sizeof( float ) ) );
+                }
+                SafeRead( file, lm->bspLuxels[ j ], bspLuxels * BSP_LUXEL_SIZE * sizeof( float ) );
+            }
+        }
+        if ( ints[ 4 ] & LIGHT_CHECKPOINT_BSP_DELUXELS )
+        {
+            if ( lm->bspDeluxels == NULL )
+            {
+                lm->bspDeluxels = static_cast<float*>( safe_malloc( bspLuxels * BSP_DELUXEL_SIZE * sizeof( float ) ) );
+            }
+            SafeRead( file, lm->bspDeluxels, bspLuxels * BSP_DELUXEL_SIZE * sizeof( float ) );
+        }
+    }
+    
+    SafeRead( file, rawGridPoints, numRawGridPoints * sizeof( rawGridPoint_t ) );
+    SafeRead( file, bspGridPoints, numBSPGridPoints * sizeof( bspGridPoint_t ) );
+    for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+    {
+        SafeRead( file, vertexLuxels[ j ], numBSPDrawVerts * VERTEX_LUXEL_SIZE * sizeof( float ) );
+        SafeRead( file, radVertexLuxels[ j ], numBSPDrawVerts * VERTEX_LUXEL_SIZE * sizeof( float ) );
+    }
+    for ( i = 0; i < numBSPDrawSurfaces; i++ )
+    {
+        SafeRead( file, bspDrawSurfaces[ i ].vertexStyles, MAX_LIGHTMAPS );
+    }
+    fclose( file );
+}
+
+
+
+/*
+   WriteLightStageReport()
+   writes the stage times so far as json
+ */
+
+static void WriteJSONString( FILE* file, const char* string )
+{
+    fputc( '"', file );
+    for ( ; *string; string++ )
+    {
+        if ( *string == '"' || *string == '\\' )
+        {
+            fputc( '\\', file );
+        }
+        fputc( *string, file );
+    }
+    fputc( '"', file );
+}
+
+static void WriteLightStageReport( void )
+{
+    size_t i;
+    FILE*                file;
+    const lightStage_t*  stage;
+    
+    
+    file = fopen( reportPath, "w" );
+    if ( file == NULL )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Could not write %s\n", reportPath );
+        return;
+    }
+    
+    fprintf( file, "{\n    \"bsp\": " );
+    WriteJSONString( file, reportBSPPath );
+    fprintf( file, ",\n    \"threads\": %d,\n", numthreads );
+    fprintf( file, "    \"resumedStages\": %d,\n", resumeStages );
+    fprintf( file, "    \"seconds\": %.3f,\n", std::chrono::duration<double>( std::chrono::steady_clock::now() - lightStart ).count() );
+    fprintf( file, "    \"stages\": [\n" );
+    for ( i = 0; i < stages.size(); i++ )
+    {
+        stage = &stages[ i ];
+        fprintf( file, "        { \"name\": " );
+        WriteJSONString( file, stage->name );
+        fprintf( file, ", \"bounce\": %d, \"items\": %d, \"seconds\": %.3f, \"itemsPerSecond\": %.1f, \"checkpointSeconds\": %.3f, \"resumed\": %s }%s\n",
+                 stage->bounce, stage->items, stage->seconds, stage->seconds >= 0.001 ? stage->items / stage->seconds : 0.0,
+                 stage->checkpointSeconds, stage->resumed ? "true" : "false", i + 1 < stages.size() ? "," : "" );
+    }
+    fprintf( file, "    ]\n}\n" );
+    fclose( file );
+}
+
+
+
+/*
+   BeginLightStage()
+   starts timing a stage, returns qfalse if the stage is skipped because the
+   checkpoint being resumed covers it
+ */
+
+qboolean BeginLightStage( const char* name, int bounce, int items, lightStageMode_t mode )
+{
+    lightStage_t stage;
+    
+    
+    if ( stages.empty() )
+    {
+        lightStart = std::chrono::steady_clock::now();
+    }
+    
+    stage.name = name;
+    stage.bounce = bounce;
+    stage.items = items;
+    stage.mode = mode;
+    stage.resumed = qfalse;
+    stage.seconds = 0;
+    stage.checkpointSeconds = 0;
+    
+    /* resuming */
+    if ( mode != LIGHT_STAGE_ALWAYS && stagesDone < resumeStages )
+    {
+        stage.resumed = qtrue;
+        stages.push_back( stage );
+        if ( mode == LIGHT_STAGE_CHECKPOINT && ++stagesDone == resumeStages )
+        {
+            RestoreLightCheckpoint();
+        }
+        return qfalse;
+    }
+    
+    stages.push_back( stage );
+    currentStage = stages.size() - 1;
+    stageStart = std::chrono::steady_clock::now();
+    return qtrue;
+}
+
+
+
+/*
+   EndLightStage()
+   stops timing the current stage and writes the checkpoint and report
+ */
+
+void EndLightStage( void )
+{
+    lightStage_t*        stage;
+    std::chrono::steady_clock::time_point start;
+    
+    
+    if ( currentStage < 0 )
+    {
+        return;
+    }
+    stage = &stages[ currentStage ];
+    currentStage = -1;
+    stage->seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - stageStart ).count();
+    
+    if ( stage->mode == LIGHT_STAGE_CHECKPOINT )
+    {
+        stagesDone++;
+        if ( lightCheckpoint )
+        {
+            start = std::chrono::steady_clock::now();
+            WriteLightCheckpoint();
+            stage->checkpointSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            Sys_FPrintf( SYS_VRB, "Wrote light checkpoint %s after %d stages (%.2f seconds)\n", checkpointPath, stagesDone, stage->checkpointSeconds );
+        }
+    }
+    
+    if ( lightStageReport )
+    {
+        WriteLightStageReport();
+    }
+}
+
+
+
+/*
+   LightStagesResuming()
+   qtrue while stages are still skipped to reach the checkpoint being resumed
+ */
+
+qboolean LightStagesResuming( void )
+{
+    return ( stagesDone < resumeStages ) ? qtrue : qfalse;
+}
+
+
+
+/*
+   FinishLightStages()
+   removes the checkpoint of a finished run and writes the final report
+ */
+
+void FinishLightStages( void )
+{
+    if ( lightCheckpoint )
+    {
+        remove( checkpointPath );
+    }
+    
+    if ( lightStageReport )
+    {
+        WriteLightStageReport();
+        Sys_Printf( "Wrote light stage report %s\n", reportPath );
+    }
+}
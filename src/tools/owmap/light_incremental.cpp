@@ -0,0 +1,1477 @@
+/* -------------------------------------------------------------------------------
+   
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+   
+   This file is part of GtkRadiant.
+   
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+   
+   ----------------------------------------------------------------------------------
+   
+   This code has been altered significantly from its original form, to support
+   several games based on the Quake III Arena engine, in the form of "Q3Map2."
+   
+   ------------------------------------------------------------------------------- */
+
+
+
+/* marker */
+#define LIGHT_INCREMENTAL_C
+
+
+
+/* dependencies */
+#include "q3map2.h"
+#include <algorithm>
+
+
+
+/* -------------------------------------------------------------------------------
+   
+   incremental lighting
+   
+   a -incremental light run keeps the lit super luxels of every raw lightmap and
+   the values of every grid point in a .lightcache file next to the bsp, keyed
+   by a hash of everything that went into them: the surfaces, their shaders, the
+   lights that reach them and the occluders in the box their rays can cross.
+   the next -incremental run hashes the same inputs and copies back the records
+   that still match instead of lighting them again.
+   
+   occluders are summed into a coarse cell grid over the world, 3d prefix sums
+   over the cells give the hash of the occluders in any box with 8 lookups.
+   
+   ------------------------------------------------------------------------------- */
+
+#define LIGHT_CACHE_IDENT           ( ( 'C' << 24 ) + ( 'L' << 16 ) + ( 'W' << 8 ) + 'O' )
+#define LIGHT_CACHE_VERSION         1
+
+#define LIGHT_CACHE_CELLS           32          /* occluder grid cells per axis */
+#define LIGHT_CACHE_PAD             16.0f       /* slack around samples and light origins */
+
+#define LIGHT_CACHE_DELUXELS        ( 1 << MAX_LIGHTMAPS )
+#define LIGHT_CACHE_DIRT            ( 2 << MAX_LIGHTMAPS )
+
+#define HASH_INIT                   14695981039346656037ULL
+
+typedef struct
+{
+    int ident, version;
+    uint64_t globalHash;
+    int numLightmaps, numGridPoints;
+}
+lightCacheHeader_t;
+
+typedef struct
+{
+    uint64_t hash;
+    int offset;
+}
+lightCacheRecord_t;
+
+static char lightCachePath[ 1024 ];
+static qboolean reuseLightmaps, reuseGrid;
+static uint64_t globalHash;
+
+static byte* cacheBuffer;
+static std::vector< lightCacheRecord_t > cacheLightmaps, cacheGridPoints;
+
+static uint64_t* shaderDigests;
+static int numShaderDigests;
+static uint64_t* surfaceHashes;
+
+static uint64_t* occluderSums;
+static vec3_t occluderMins, occluderCell;
+
+static uint64_t* lightmapHashes;
+static byte* lightmapReused;
+static uint64_t* gridHashes;
+static byte* gridReused;
+
+
+
+/*
+   HashBytes()
+   fnv-1a over a block of memory
+ */
+
+static uint64_t HashBytes( uint64_t hash, const void* data, size_t size )
+{
+    size_t i;
+    const byte*      b;
+    
+    
+    b = ( const byte* ) data;
+    for ( i = 0; i < size; i++ )
+    {
+        hash = ( hash ^ b[ i ] ) * 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+
+
+static uint64_t HashInt( uint64_t hash, int value )
+{
+    return HashBytes( hash, &value, sizeof( value ) );
+}
+
+
+
+static uint64_t HashString( uint64_t hash, const char* string )
+{
+    if ( string == NULL )
+    {
+        return HashInt( hash, 0 );
+    }
+    
+    return HashBytes( hash, string, strlen( string ) + 1 );
+}
+
+
+
+/*
+   MixHash()
+   scrambles a hash so sums of them don't cancel out
+ */
+
+static uint64_t MixHash( uint64_t x )
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    
+    return x;
+}
+
+
+
+static uint64_t HashImage( uint64_t hash, const image_t* image )
+{
+    if ( image == NULL || image->pixels == NULL )
+    {
+        return HashInt( hash, 0 );
+    }
+    
+    hash = HashInt( hash, image->width );
+    hash = HashInt( hash, image->height );
+    return HashBytes( hash, image->pixels, image->width * image->height * 4 );
+}
+
+
+
+/*
+   ShaderDigest()
+   hashes a shader by its text and images, everything else is derived from them
+ */
+
+static uint64_t DigestShader( const shaderInfo_t* si )
+{
+    uint64_t hash;
+    
+    
+    hash = HashString( HASH_INIT, si->shader );
+    hash = HashString( hash, si->shaderText );
+    hash = HashImage( hash, si->shaderImage );
+    hash = HashImage( hash, si->lightImage );
+    hash = HashImage( hash, si->normalImage );
+    
+    return hash;
+}
+
+
+
+static uint64_t ShaderDigest( const shaderInfo_t* si )
+{
+    int num;
+    
+    
+    if ( si == NULL )
+    {
+        return 0;
+    }
+    
+    num = si - shaderInfo;
+    if ( num >= 0 && num < numShaderDigests )
+    {
+        return shaderDigests[ num ];
+    }
+    
+    return DigestShader( si );
+}
+
+
+
+/*
+   UpdateShaderDigests()
+   digests shaders loaded since the last call, must not run on worker threads
+ */
+
+static void UpdateShaderDigests( void )
+{
+    if ( shaderDigests == NULL )
+    {
+        shaderDigests = static_cast<uint64_t*>( safe_malloc( MAX_SHADER_INFO * sizeof( *shaderDigests ) ) );
+    }
+    
+    for ( ; numShaderDigests < numShaderInfo; numShaderDigests++ )
+    {
+        shaderDigests[ numShaderDigests ] = DigestShader( &shaderInfo[ numShaderDigests ] );
+    }
+}
+
+
+
+/*
+   HashSurface()
+   hashes the inputs of a draw surface, by content and not by index
+ */
+
+static uint64_t HashSurface( int num )
+{
+    int i;
+    uint64_t hash, digest;
+    bspDrawSurface_t*    ds;
+    surfaceInfo_t*       info;
+    bspDrawVert_t*       dv;
+    bspShader_t*         shader;
+    
+    
+    ds = &bspDrawSurfaces[ num ];
+    info = &surfaceInfos[ num ];
+    shader = &bspShaders[ ds->shaderNum ];
+    
+    hash = HashString( HASH_INIT, shader->shader );
+    hash = HashInt( hash, shader->surfaceFlags );
+    hash = HashInt( hash, shader->contentFlags );
+    hash = HashInt( hash, ds->surfaceType );
+    hash = HashInt( hash, ds->patchWidth );
+    hash = HashInt( hash, ds->patchHeight );
+    
+    digest = ShaderDigest( info->si );
+    hash = HashBytes( hash, &digest, sizeof( digest ) );
+    hash = HashInt( hash, info->castShadows );
+    hash = HashInt( hash, info->recvShadows );
+    hash = HashInt( hash, info->sampleSize );
+    hash = HashInt( hash, info->patchIterations );
+    hash = HashBytes( hash, &info->longestCurve, sizeof( info->longestCurve ) );
+    hash = HashBytes( hash, info->axis, sizeof( info->axis ) );
+    hash = HashInt( hash, info->hasLightmap );
+    
+    /* lightmap coords and colors are light output, only the vertex alpha is input */
+    for ( i = 0; i < ds->numVerts; i++ )
+    {
+        dv = &yDrawVerts[ ds->firstVert + i ];
+        hash = HashBytes( hash, dv->xyz, sizeof( dv->xyz ) );
+        hash = HashBytes( hash, dv->st, sizeof( dv->st ) );
+        hash = HashBytes( hash, dv->normal, sizeof( dv->normal ) );
+        hash = HashBytes( hash, &dv->color[ 0 ][ 3 ], 1 );
+    }
+    
+    return HashBytes( hash, &bspDrawIndexes[ ds->firstIndex ], ds->numIndexes * sizeof( int ) );
+}
+
+
+
+/*
+   HashPicoModel()
+   hashes the triangles of an external model the light tracer loads itself
+ */
+
+static uint64_t HashPicoModel( uint64_t hash, const char* name, int frame )
+{
+    int i, j, numVerts;
+    uint64_t digest;
+    picoModel_t*     model;
+    picoSurface_t*   surface;
+    picoShader_t*    shader;
+    
+    
+    hash = HashString( hash, name );
+    hash = HashInt( hash, frame );
+    
+    model = LoadModel( name, frame );
+    if ( model == NULL )
+    {
+        return hash;
+    }
+    
+    for ( i = 0; i < PicoGetModelNumSurfaces( model ); i++ )
+    {
+        surface = PicoGetModelSurface( model, i );
+        if ( surface == NULL )
+        {
+            continue;
+        }
+        
+        shader = PicoGetSurfaceShader( surface );
+        if ( shader != NULL )
+        {
+            digest = ShaderDigest( ShaderInfoForShaderNull( PicoGetShaderName( shader ) ) );
+            hash = HashString( hash, PicoGetShaderName( shader ) );
+            hash = HashBytes( hash, &digest, sizeof( digest ) );
+        }
+        
+        numVerts = PicoGetSurfaceNumVertexes( surface );
+        for ( j = 0; j < numVerts; j++ )
+        {
+            hash = HashBytes( hash, PicoGetSurfaceXYZ( surface, j ), sizeof( picoVec3_t ) );
+            hash = HashBytes( hash, PicoGetSurfaceST( surface, 0, j ), sizeof( picoVec2_t ) );
+        }
+        hash = HashBytes( hash, PicoGetSurfaceIndexes( surface, 0 ), PicoGetSurfaceNumIndexes( surface ) * sizeof( picoIndex_t ) );
+    }
+    
+    return hash;
+}
+
+
+
+/*
+   HashEpairs()
+   hashes the keys of an entity regardless of their order, which flips every time
+   the entities are written out again
+ */
+
+static uint64_t HashEpairs( uint64_t hash, const entity_t* e )
+{
+    uint64_t sum;
+    epair_t*         ep;
+    
+    
+    sum = 0;
+    for ( ep = e->epairs; ep != NULL; ep = ep->next )
+    {
+        /* every compile appends to the command line key */
+        if ( !Q_strncasecmp( ep->key, "_q3map2_", 8 ) )
+        {
+            continue;
+        }
+        sum += MixHash( HashString( HashString( HASH_INIT, ep->key ), ep->value ) );
+    }
+    
+    return HashBytes( hash, &sum, sizeof( sum ) );
+}
+
+
+
+/*
+   HashGlobals()
+   hashes the inputs that every lightmap and grid point depends on
+ */
+
+static uint64_t HashGlobals( int argc, char** argv )
+{
+    int i, m;
+    uint64_t hash;
+    entity_t*        e;
+    const char*      value;
+    
+    
+    hash = HashInt( HASH_INIT, LIGHT_CACHE_VERSION );
+    hash = HashInt( hash, sizeof( rawGridPoint_t ) );
+    hash = HashInt( hash, sizeof( bspGridPoint_t ) );
+    
+    /* command line, minus the map and the switches that don't change the light */
+    for ( i = 1; i < ( argc - 1 ); i++ )
+    {
+        if ( !Q_stricmp( argv[ i ], "-incremental" ) || !Q_stricmp( argv[ i ], "-checkpoint" ) ||
+                !Q_stricmp( argv[ i ], "-resume" ) || !Q_stricmp( argv[ i ], "-stagereport" ) )
+        {
+            continue;
+        }
+        hash = HashString( hash, argv[ i ] );
+    }
+    
+    /* every entity that isn't a light, with the external models the tracer loads for them */
+    for ( i = 0; i < numEntities; i++ )
+    {
+        e = &entities[ i ];
+        if ( !Q_strncasecmp( ValueForKey( e, "classname" ), "light", 5 ) )
+        {
+            continue;
+        }
+        
+        hash = HashEpairs( hash, e );
+        
+        value = ValueForKey( e, "model" );
+        if ( i > 0 && value[ 0 ] != '\0' && value[ 0 ] != '*' )
+        {
+            hash = HashPicoModel( hash, value, IntForKey( e, ValueForKey( e, "_frame" )[ 0 ] != '\0' ? "_frame" : "frame" ) );
+        }
+        value = ValueForKey( e, "model2" );
+        if ( i > 0 && value[ 0 ] != '\0' && value[ 0 ] != '*' )
+        {
+            hash = HashPicoModel( hash, value, IntForKey( e, "_frame2" ) );
+        }
+    }
+    
+    /* brush entity surfaces are moved by their entity, so they count everywhere */
+    for ( m = 1; m < numBSPModels; m++ )
+    {
+        for ( i = 0; i < bspModels[ m ].numBSPSurfaces; i++ )
+        {
+            hash = HashBytes( hash, &surfaceHashes[ bspModels[ m ].firstBSPSurface + i ], sizeof( uint64_t ) );
+        }
+    }
+    
+    return hash;
+}
+
+
+
+/*
+   AddOccluder()
+   sums an occluder hash into every cell its bounds touch
+ */
+
+static void OccluderCells( const vec3_t mins, const vec3_t maxs, int lo[ 3 ], int hi[ 3 ] )
+{
+    int i;
+    
+    
+    for ( i = 0; i < 3; i++ )
+    {
+        lo[ i ] = ( int ) floor( ( mins[ i ] - occluderMins[ i ] ) / occluderCell[ i ] );
+        hi[ i ] = ( int ) floor( ( maxs[ i ] - occluderMins[ i ] ) / occluderCell[ i ] );
+        lo[ i ] = lo[ i ] < 0 ? 0 : ( lo[ i ] >= LIGHT_CACHE_CELLS ? LIGHT_CACHE_CELLS - 1 : lo[ i ] );
+        hi[ i ] = hi[ i ] < 0 ? 0 : ( hi[ i ] >= LIGHT_CACHE_CELLS ? LIGHT_CACHE_CELLS - 1 : hi[ i ] );
+    }
+}
+
+
+
+#define OCCLUDER_SUM( x, y, z ) occluderSums[ ( ( ( z ) * ( LIGHT_CACHE_CELLS + 1 ) ) + ( y ) ) * ( LIGHT_CACHE_CELLS + 1 ) + ( x ) ]
+
+static void AddOccluder( uint64_t hash, const vec3_t mins, const vec3_t maxs )
+{
+    int x, y, z, lo[ 3 ], hi[ 3 ];
+    
+    
+    OccluderCells( mins, maxs, lo, hi );
+    for ( z = lo[ 2 ]; z <= hi[ 2 ]; z++ )
+    {
+        for ( y = lo[ 1 ]; y <= hi[ 1 ]; y++ )
+        {
+            for ( x = lo[ 0 ]; x <= hi[ 0 ]; x++ )
+            {
+                /* salt with the cell so moving an occluder between cells changes the sum */
+                OCCLUDER_SUM( x + 1, y + 1, z + 1 ) += MixHash( hash ^ ( ( uint64_t )( ( z * LIGHT_CACHE_CELLS + y ) * LIGHT_CACHE_CELLS + x ) * 0x9E3779B97F4A7C15ULL ) );
+            }
+        }
+    }
+}
+
+
+
+/*
+   OccluderHash()
+   hashes every occluder touching a box
+ */
+
+static uint64_t OccluderHash( const vec3_t mins, const vec3_t maxs )
+{
+    int lo[ 3 ], hi[ 3 ];
+    
+    
+    OccluderCells( mins, maxs, lo, hi );
+    hi[ 0 ]++;
+    hi[ 1 ]++;
+    hi[ 2 ]++;
+    
+    return OCCLUDER_SUM( hi[ 0 ], hi[ 1 ], hi[ 2 ] )
+           - OCCLUDER_SUM( lo[ 0 ], hi[ 1 ], hi[ 2 ] ) - OCCLUDER_SUM( hi[ 0 ], lo[ 1 ], hi[ 2 ] ) - OCCLUDER_SUM( hi[ 0 ], hi[ 1 ], lo[ 2 ] )
+           + OCCLUDER_SUM( lo[ 0 ], lo[ 1 ], hi[ 2 ] ) + OCCLUDER_SUM( lo[ 0 ], hi[ 1 ], lo[ 2 ] ) + OCCLUDER_SUM( hi[ 0 ], lo[ 1 ], lo[ 2 ] )
+           - OCCLUDER_SUM( lo[ 0 ], lo[ 1 ], lo[ 2 ] );
+}
+
+
+
+/*
+   AddSolidLeafs_r()
+   solid leafs stop light rays, a leaf is hashed by its bounds and the node
+   planes that cut them, so it keeps its hash when the tree around it changes
+ */
+
+static void AddSolidLeafs_r( int nodeNum, std::vector< int >& path )
+{
+    int i;
+    uint64_t hash, planes;
+    bspLeaf_t*       leaf;
+    bspPlane_t*      plane;
+    vec3_t mins, maxs, center, extents;
+    float d, r;
+    
+    
+    /* node */
+    if ( nodeNum >= 0 )
+    {
+        for ( i = 0; i < 2; i++ )
+        {
+            path.push_back( ( bspNodes[ nodeNum ].planeNum << 1 ) | i );
+            AddSolidLeafs_r( bspNodes[ nodeNum ].children[ i ], path );
+            path.pop_back();
+        }
+        return;
+    }
+    
+    /* only opaque leafs occlude */
+    leaf = &bspLeafs[ -nodeNum - 1 ];
+    if ( leaf->cluster != -1 )
+    {
+        return;
+    }
+    
+    for ( i = 0; i < 3; i++ )
+    {
+        mins[ i ] = leaf->mins[ i ] - 1.0f;
+        maxs[ i ] = leaf->maxs[ i ] + 1.0f;
+        center[ i ] = ( mins[ i ] + maxs[ i ] ) * 0.5f;
+        extents[ i ] = ( maxs[ i ] - mins[ i ] ) * 0.5f;
+    }
+    
+    /* planes the bounds lie wholly on one side of add nothing to the leaf shape */
+    planes = 0;
+    for ( i = 0; i < ( int ) path.size(); i++ )
+    {
+        plane = &bspPlanes[ path[ i ] >> 1 ];
+        d = DotProduct( plane->normal, center ) - plane->dist;
+        r = fabs( plane->normal[ 0 ] * extents[ 0 ] ) + fabs( plane->normal[ 1 ] * extents[ 1 ] ) + fabs( plane->normal[ 2 ] * extents[ 2 ] );
+        if ( d - r >= 0.0f || d + r <= 0.0f )
+        {
+            continue;
+        }
+        
+        hash = HashInt( HASH_INIT, path[ i ] & 1 );
+        planes += MixHash( HashBytes( hash, plane, sizeof( *plane ) ) );
+    }
+    
+    hash = HashBytes( HASH_INIT, leaf->mins, sizeof( leaf->mins ) );
+    hash = HashBytes( hash, leaf->maxs, sizeof( leaf->maxs ) );
+    AddOccluder( HashBytes( hash, &planes, sizeof( planes ) ), mins, maxs );
+}
+
+
+
+/*
+   SetupOccluders()
+   builds the prefix summed occluder grid from the world surfaces and solid leafs
+ */
+
+static void SetupOccluders( void )
+{
+    int i, x, y, z, num, size;
+    bspDrawSurface_t*    ds;
+    vec3_t mins, maxs;
+    std::vector< int > path;
+    
+    
+    /* cells cover the world model */
+    for ( i = 0; i < 3; i++ )
+    {
+        occluderMins[ i ] = bspModels[ 0 ].mins[ i ] - LIGHT_CACHE_PAD;
+        occluderCell[ i ] = ( bspModels[ 0 ].maxs[ i ] - bspModels[ 0 ].mins[ i ] + 2.0f * LIGHT_CACHE_PAD ) / LIGHT_CACHE_CELLS;
+        if ( occluderCell[ i ] < 1.0f )
+        {
+            occluderCell[ i ] = 1.0f;
+        }
+    }
+    
+    size = ( LIGHT_CACHE_CELLS + 1 ) * ( LIGHT_CACHE_CELLS + 1 ) * ( LIGHT_CACHE_CELLS + 1 );
+    occluderSums = static_cast<uint64_t*>( safe_malloc( size * sizeof( *occluderSums ) ) );
+    memset( occluderSums, 0, size * sizeof( *occluderSums ) );
+    
+    /* world surfaces */
+    for ( i = 0; i < bspModels[ 0 ].numBSPSurfaces; i++ )
+    {
+        num = bspModels[ 0 ].firstBSPSurface + i;
+        ds = &bspDrawSurfaces[ num ];
+        if ( ds->numVerts <= 0 )
+        {
+            continue;
+        }
+        
+        ClearBounds( mins, maxs );
+        for ( x = 0; x < ds->numVerts; x++ )
+        {
+            AddPointToBounds( yDrawVerts[ ds->firstVert + x ].xyz, mins, maxs );
+        }
+        AddOccluder( surfaceHashes[ num ], mins, maxs );
+    }
+    
+    /* solid leafs */
+    if ( numBSPNodes > 0 )
+    {
+        AddSolidLeafs_r( 0, path );
+    }
+    
+    /* prefix sums along each axis */
+    for ( z = 1; z <= LIGHT_CACHE_CELLS; z++ )
+        for ( y = 1; y <= LIGHT_CACHE_CELLS; y++ )
+            for ( x = 1; x <= LIGHT_CACHE_CELLS; x++ )
+                OCCLUDER_SUM( x, y, z ) += OCCLUDER_SUM( x - 1, y, z );
+    for ( z = 1; z <= LIGHT_CACHE_CELLS; z++ )
+        for ( y = 1; y <= LIGHT_CACHE_CELLS; y++ )
+            for ( x = 1; x <= LIGHT_CACHE_CELLS; x++ )
+                OCCLUDER_SUM( x, y, z ) += OCCLUDER_SUM( x, y - 1, z );
+    for ( z = 1; z <= LIGHT_CACHE_CELLS; z++ )
+        for ( y = 1; y <= LIGHT_CACHE_CELLS; y++ )
+            for ( x = 1; x <= LIGHT_CACHE_CELLS; x++ )
+                OCCLUDER_SUM( x, y, z ) += OCCLUDER_SUM( x, y, z - 1 );
+}
+
+
+
+/*
+   CompareCacheRecords()
+   sorts cache records by hash for binary searching
+ */
+
+static bool CompareCacheRecords( const lightCacheRecord_t& a, const lightCacheRecord_t& b )
+{
+    return a.hash < b.hash;
+}
+
+
+
+static const byte* FindCacheRecord( const std::vector< lightCacheRecord_t >& records, uint64_t hash )
+{
+    lightCacheRecord_t key;
+    std::vector< lightCacheRecord_t >::const_iterator it;
+    
+    
+    key.hash = hash;
+    key.offset = 0;
+    it = std::lower_bound( records.begin(), records.end(), key, CompareCacheRecords );
+    if ( it == records.end() || it->hash != hash )
+    {
+        return NULL;
+    }
+    
+    return cacheBuffer + it->offset;
+}
+
+
+
+/*
+   LightmapRecordSize()
+   size of a lightmap record after its hash, given the sizes and mask it starts with
+ */
+
+static int LightmapRecordSize( int sw, int sh, int mask )
+{
+    int i, size, luxels;
+    
+    
+    luxels = sw * sh;
+    size = 3 * sizeof( int ) + MAX_LIGHTMAPS;
+    for ( i = 0; i < MAX_LIGHTMAPS; i++ )
+    {
+        if ( mask & ( 1 << i ) )
+        {
+            size += luxels * SUPER_LUXEL_SIZE * sizeof( float );
+        }
+    }
+    size += luxels * sizeof( int );
+    if ( mask & LIGHT_CACHE_DELUXELS )
+    {
+        size += luxels * SUPER_DELUXEL_SIZE * sizeof( float );
+    }
+    if ( mask & LIGHT_CACHE_DIRT )
+    {
+        size += luxels * sizeof( float );
+    }
+    
+    return size;
+}
+
+
+
+/*
+   LoadLightCache()
+   reads the cache of the last -incremental run and indexes its records
+ */
+
+static void LoadLightCache( void )
+{
+    int i, length, offset, ints[ 3 ];
+    lightCacheHeader_t header;
+    lightCacheRecord_t record;
+    
+    
+    length = TryLoadFile( lightCachePath, ( void** ) &cacheBuffer );
+    if ( length < 0 )
+    {
+        Sys_Printf( "No light cache %s, lighting everything\n", lightCachePath );
+        return;
+    }
+    
+    if ( length < ( int ) sizeof( header ) )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Light cache %s is truncated, lighting everything\n", lightCachePath );
+        return;
+    }
+    memcpy( &header, cacheBuffer, sizeof( header ) );
+    if ( header.ident != LIGHT_CACHE_IDENT || header.version != LIGHT_CACHE_VERSION || header.globalHash != globalHash )
+    {
+        Sys_Printf( "Light cache %s was made with other settings or entities, lighting everything\n", lightCachePath );
+        return;
+    }
+    
+    /* lightmap records */
+    offset = sizeof( header );
+    for ( i = 0; i < header.numLightmaps; i++ )
+    {
+        if ( offset + ( int ) sizeof( uint64_t ) + ( int ) sizeof( ints ) > length )
+        {
+            break;
+        }
+        memcpy( &record.hash, cacheBuffer + offset, sizeof( uint64_t ) );
+        record.offset = offset + sizeof( uint64_t );
+        memcpy( ints, cacheBuffer + record.offset, sizeof( ints ) );
+        offset = record.offset + LightmapRecordSize( ints[ 0 ], ints[ 1 ], ints[ 2 ] );
+        if ( offset > length )
+        {
+            break;
+        }
+        cacheLightmaps.push_back( record );
+    }
+    
+    /* grid records */
+    for ( i = 0; i < header.numGridPoints && ( int ) cacheLightmaps.size() == header.numLightmaps; i++ )
+    {
+        if ( offset + ( int )( sizeof( uint64_t ) + sizeof( rawGridPoint_t ) + sizeof( bspGridPoint_t ) ) > length )
+        {
+            break;
+        }
+        memcpy( &record.hash, cacheBuffer + offset, sizeof( uint64_t ) );
+        record.offset = offset + sizeof( uint64_t );
+        offset = record.offset + sizeof( rawGridPoint_t ) + sizeof( bspGridPoint_t );
+        cacheGridPoints.push_back( record );
+    }
+    
+    if ( ( int ) cacheLightmaps.size() != header.numLightmaps || ( int ) cacheGridPoints.size() != header.numGridPoints )
+    {
+        Sys_FPrintf( SYS_WRN, "WARNING: Light cache %s is truncated, lighting everything\n", lightCachePath );
+        cacheLightmaps.clear();
+        cacheGridPoints.clear();
+        return;
+    }
+    
+    std::sort( cacheLightmaps.begin(), cacheLightmaps.end(), CompareCacheRecords );
+    std::sort( cacheGridPoints.begin(), cacheGridPoints.end(), CompareCacheRecords );
+    
+    Sys_Printf( "Loaded light cache %s (%d lightmaps, %d grid points)\n", lightCachePath, header.numLightmaps, header.numGridPoints );
+}
+
+
+
+/*
+   HashLightInputs()
+   hashes the surfaces by content and the shared light inputs, once
+ */
+
+static void HashLightInputs( int argc, char** argv )
+{
+    int i;
+    
+    
+    if ( surfaceHashes != NULL )
+    {
+        return;
+    }
+    
+    UpdateShaderDigests();
+    surfaceHashes = static_cast<uint64_t*>( safe_malloc( ( numBSPDrawSurfaces + 1 ) * sizeof( *surfaceHashes ) ) );
+    for ( i = 0; i < numBSPDrawSurfaces; i++ )
+    {
+        surfaceHashes[ i ] = HashSurface( i );
+    }
+    
+    globalHash = HashGlobals( argc, argv );
+}
+
+
+
+/*
+   LightInputHash()
+   hashes everything a whole light run depends on, for checkpoints
+ */
+
+uint64_t LightInputHash( int argc, char** argv )
+{
+    int i;
+    uint64_t hash;
+    
+    
+    HashLightInputs( argc, argv );
+    hash = globalHash;
+    
+    /* the lights left out of the global hash */
+    for ( i = 0; i < numEntities; i++ )
+    {
+        if ( Q_strncasecmp( ValueForKey( &entities[ i ], "classname" ), "light", 5 ) )
+        {
+            continue;
+        }
+        hash = HashEpairs( hash, &entities[ i ] );
+    }
+    
+    /* every surface and what the tracer and vis culling read */
+    hash = HashBytes( hash, surfaceHashes, numBSPDrawSurfaces * sizeof( *surfaceHashes ) );
+    hash = HashBytes( hash, bspPlanes, numBSPPlanes * sizeof( *bspPlanes ) );
+    hash = HashBytes( hash, bspNodes, numBSPNodes * sizeof( *bspNodes ) );
+    hash = HashBytes( hash, bspLeafs, numBSPLeafs * sizeof( *bspLeafs ) );
+    hash = HashBytes( hash, bspBrushes, numBSPBrushes * sizeof( *bspBrushes ) );
+    hash = HashBytes( hash, bspBrushSides, numBSPBrushSides * sizeof( *bspBrushSides ) );
+    hash = HashBytes( hash, bspVisBytes, numBSPVisBytes );
+    
+    return hash;
+}
+
+
+
+/*
+   SetupLightCache()
+   hashes the shared light inputs and loads the cache of the previous run
+ */
+
+void SetupLightCache( const char* path, int argc, char** argv )
+{
+    /* note it */
+    Sys_FPrintf( SYS_VRB, "--- SetupLightCache ---\n" );
+    
+    strcpy( lightCachePath, path );
+    
+    /* anything that draws random numbers makes a lightmap depend on those lit before it */
+    reuseLightmaps = qtrue;
+    reuseGrid = qtrue;
+    if ( lightRandomSamples || ( dirty && dirtMode == 1 ) )
+    {
+        Sys_Printf( "Random sampling is enabled, lightmaps will not be reused\n" );
+        reuseLightmaps = qfalse;
+    }
+    if ( g_floodlight && floodlight_lowquality )
+    {
+        Sys_Printf( "Low quality floodlight is enabled, nothing will be reused\n" );
+        reuseLightmaps = qfalse;
+        reuseGrid = qfalse;
+    }
+    
+    HashLightInputs( argc, argv );
+    SetupOccluders();
+    
+    /* per lightmap and grid point state */
+    lightmapHashes = static_cast<uint64_t*>( safe_malloc( ( numRawLightmaps + 1 ) * sizeof( *lightmapHashes ) ) );
+    memset( lightmapHashes, 0, ( numRawLightmaps + 1 ) * sizeof( *lightmapHashes ) );
+    lightmapReused = static_cast<byte*>( safe_malloc( numRawLightmaps + 1 ) );
+    memset( lightmapReused, 0, numRawLightmaps + 1 );
+    
+    LoadLightCache();
+}
+
+
+
+/*
+   HashLightsForCache()
+   hashes every light and the box its rays can end in, call after SetupEnvelopes()
+ */
+
+void HashLightsForCache( void )
+{
+    int i;
+    uint64_t hash, digest;
+    light_t*     light;
+    vec3_t point;
+    
+    
+    UpdateShaderDigests();
+    
+    for ( light = lights; light != NULL; light = light->next )
+    {
+        /* the cluster number is left out, what it can see is hashed where it is tested */
+        hash = HashInt( HASH_INIT, light->type );
+        hash = HashInt( hash, light->flags );
+        hash = HashBytes( hash, light->origin, ( byte* ) &light->cluster - ( byte* ) light->origin );
+        hash = HashBytes( hash, light->emitColor, ( byte* )( &light->filterRadius + 1 ) - ( byte* ) light->emitColor );
+        digest = ShaderDigest( light->si );
+        hash = HashBytes( hash, &digest, sizeof( digest ) );
+        
+        VectorSet( point, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD );
+        VectorSubtract( light->origin, point, light->cacheMins );
+        VectorAdd( light->origin, point, light->cacheMaxs );
+        
+        if ( light->w != NULL )
+        {
+            hash = HashInt( hash, light->w->numpoints );
+            for ( i = 0; i < light->w->numpoints; i++ )
+            {
+                hash = HashBytes( hash, light->w->p[ i ], sizeof( vec3_t ) );
+                AddPointToBounds( light->w->p[ i ], light->cacheMins, light->cacheMaxs );
+            }
+        }
+        
+        light->cacheHash = hash;
+    }
+}
+
+
+
+/*
+   AddLightToRegion()
+   grows a box by where the rays from the sample box to a light can go
+ */
+
+static void AddLightToRegion( light_t* light, const vec3_t sampleMins, const vec3_t sampleMaxs, vec3_t mins, vec3_t maxs )
+{
+    vec3_t point;
+    
+    
+    /* sun rays go a fixed offset from each sample */
+    if ( light->type == EMIT_SUN )
+    {
+        VectorAdd( sampleMins, light->origin, point );
+        AddPointToBounds( point, mins, maxs );
+        VectorAdd( sampleMaxs, light->origin, point );
+        AddPointToBounds( point, mins, maxs );
+        return;
+    }
+    
+    AddPointToBounds( light->cacheMins, mins, maxs );
+    AddPointToBounds( light->cacheMaxs, mins, maxs );
+}
+
+
+
+/*
+   ReuseGridPoint()
+   hashes a grid point and copies it from the cache when it is unchanged,
+   lights are culled like LightContributionToPoint() but a little looser
+ */
+
+qboolean ReuseGridPoint( int num, vec3_t origin, int cluster )
+{
+    uint64_t hash;
+    light_t*     light;
+    vec3_t sampleMins, sampleMaxs, mins, maxs, end, delta;
+    const byte*      record;
+    float pad;
+    
+    
+    /* SetupGridCache() wasn't called */
+    if ( gridHashes == NULL )
+    {
+        return qfalse;
+    }
+    
+    hash = globalHash;
+    hash = HashBytes( hash, origin, sizeof( vec3_t ) );
+    
+    VectorSet( delta, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD );
+    VectorSubtract( origin, delta, sampleMins );
+    VectorAdd( origin, delta, sampleMaxs );
+    
+    /* floodlight rays */
+    pad = g_floodlight ? floodlightDistance : 0.0f;
+    VectorSet( delta, pad, pad, pad );
+    VectorSubtract( sampleMins, delta, mins );
+    VectorAdd( sampleMaxs, delta, maxs );
+    
+    for ( light = lights; light != NULL; light = light->next )
+    {
+        if ( !( light->flags & LIGHT_GRID ) || light->envelope <= 0.0f )
+        {
+            continue;
+        }
+        
+        if ( light->type != EMIT_SUN )
+        {
+            if ( sunOnly || !ClusterVisible( cluster, light->cluster ) )
+            {
+                continue;
+            }
+        }
+        
+        if ( origin[ 0 ] > light->maxs[ 0 ] || origin[ 0 ] < light->mins[ 0 ] ||
+                origin[ 1 ] > light->maxs[ 1 ] || origin[ 1 ] < light->mins[ 1 ] ||
+                origin[ 2 ] > light->maxs[ 2 ] || origin[ 2 ] < light->mins[ 2 ] )
+        {
+            continue;
+        }
+        
+        if ( light->type == EMIT_SUN )
+        {
+            VectorAdd( origin, light->origin, end );
+        }
+        else
+        {
+            VectorCopy( light->origin, end );
+        }
+        VectorSubtract( end, origin, delta );
+        if ( VectorLength( delta ) > light->envelope + 1.0f )
+        {
+            continue;
+        }
+        
+        hash = HashBytes( hash, &light->cacheHash, sizeof( light->cacheHash ) );
+        AddLightToRegion( light, sampleMins, sampleMaxs, mins, maxs );
+    }
+    
+    hash = MixHash( hash ) ^ OccluderHash( mins, maxs );
+    if ( hash == 0 )
+    {
+        hash = 1;
+    }
+    gridHashes[ num ] = hash;
+    
+    /* restore */
+    if ( !reuseGrid )
+    {
+        return qfalse;
+    }
+    record = FindCacheRecord( cacheGridPoints, hash );
+    if ( record == NULL )
+    {
+        return qfalse;
+    }
+    
+    memcpy( &rawGridPoints[ num ], record, sizeof( rawGridPoint_t ) );
+    memcpy( &bspGridPoints[ num ], record + sizeof( rawGridPoint_t ), sizeof( bspGridPoint_t ) );
+    gridReused[ num ] = 1;
+    
+    return qtrue;
+}
+
+
+
+/*
+   SetupGridCache()
+   allocates the grid point hashes, call before TraceGrid()
+ */
+
+void SetupGridCache( void )
+{
+    gridHashes = static_cast<uint64_t*>( safe_malloc( ( numRawGridPoints + 1 ) * sizeof( *gridHashes ) ) );
+    memset( gridHashes, 0, ( numRawGridPoints + 1 ) * sizeof( *gridHashes ) );
+    gridReused = static_cast<byte*>( safe_malloc( numRawGridPoints + 1 ) );
+    memset( gridReused, 0, numRawGridPoints + 1 );
+}
+
+
+
+int NumGridPointsReused( void )
+{
+    int i, count;
+    
+    
+    count = 0;
+    for ( i = 0; gridReused != NULL && i < numRawGridPoints; i++ )
+    {
+        count += gridReused[ i ];
+    }
+    
+    return count;
+}
+
+
+
+/*
+   VisibleLightsHash()
+   hashes which lights of a list a cluster can see, remembering the clusters it has seen
+ */
+
+static uint64_t VisibleLightsHash( const trace_t* trace, int cluster, std::vector< int >& clusters, std::vector< uint64_t >& hashes )
+{
+    int i;
+    uint64_t hash;
+    
+    
+    for ( i = 0; i < ( int ) clusters.size(); i++ )
+    {
+        if ( clusters[ i ] == cluster )
+        {
+            return hashes[ i ];
+        }
+    }
+    
+    hash = HASH_INIT;
+    for ( i = 0; i < trace->numLights; i++ )
+    {
+        hash = HashInt( hash, trace->lights[ i ]->type == EMIT_SUN || ClusterVisible( cluster, trace->lights[ i ]->cluster ) );
+    }
+    clusters.push_back( cluster );
+    hashes.push_back( hash );
+    
+    return hash;
+}
+
+
+
+/*
+   HashRawLightmap()
+   hashes everything IlluminateRawLightmap(), DirtyRawLightmap() and
+   FloodLightRawLightmap() read for a lightmap mapped by MapRawLightmap()
+ */
+
+static void HashRawLightmap( int rawLightmapNum )
+{
+    int i, x, y, *cluster;
+    uint64_t hash, visHash;
+    float*               origin, *normal, pad;
+    rawLightmap_t*       lm;
+    trace_t trace;
+    vec3_t sampleMins, sampleMaxs, mins, maxs, delta;
+    std::vector< int > visClusters;
+    std::vector< uint64_t > visHashes;
+    
+    
+    /* bail if this number exceeds the number of raw lightmaps */
+    if ( rawLightmapNum >= numRawLightmaps )
+    {
+        return;
+    }
+    
+    /* get lightmap */
+    lm = &rawLightmaps[ rawLightmapNum ];
+    
+    /* lightmap setup */
+    hash = globalHash;
+    hash = HashInt( hash, lm->splotchFix );
+    hash = HashBytes( hash, lm->wrap, sizeof( lm->wrap ) );
+    hash = HashInt( hash, lm->customWidth );
+    hash = HashInt( hash, lm->customHeight );
+    hash = HashBytes( hash, &lm->brightness, sizeof( lm->brightness ) );
+    hash = HashBytes( hash, &lm->filterRadius, sizeof( lm->filterRadius ) );
+    hash = HashInt( hash, lm->sampleSize );
+    hash = HashInt( hash, lm->actualSampleSize );
+    hash = HashInt( hash, lm->axisNum );
+    hash = HashBytes( hash, &lm->floodlightDirectionScale, sizeof( lm->floodlightDirectionScale ) );
+    hash = HashBytes( hash, lm->floodlightRGB, sizeof( lm->floodlightRGB ) );
+    hash = HashBytes( hash, &lm->floodlightIntensity, sizeof( lm->floodlightIntensity ) );
+    hash = HashBytes( hash, &lm->floodlightDistance, sizeof( lm->floodlightDistance ) );
+    hash = HashInt( hash, lm->recvShadows );
+    hash = HashBytes( hash, lm->mins, sizeof( lm->mins ) );
+    hash = HashBytes( hash, lm->maxs, sizeof( lm->maxs ) );
+    hash = HashBytes( hash, lm->axis, sizeof( lm->axis ) );
+    if ( lm->plane != NULL )
+    {
+        hash = HashBytes( hash, lm->plane, 4 * sizeof( float ) );
+    }
+    hash = HashInt( hash, lm->sw );
+    hash = HashInt( hash, lm->sh );
+    
+    for ( i = 0; i < lm->numLightSurfaces; i++ )
+    {
+        hash = HashBytes( hash, &surfaceHashes[ lightSurfaces[ lm->firstLightSurface + i ] ], sizeof( uint64_t ) );
+    }
+    
+    /* the same light list IlluminateRawLightmap() will build */
+    trace.numLights = 0;
+    trace.lights = NULL;
+    CreateTraceLightsForBounds( lm->mins, lm->maxs, lm->plane, lm->numLightClusters, lm->lightClusters, LIGHT_SURFACES, &trace );
+    for ( i = 0; i < trace.numLights; i++ )
+    {
+        hash = HashBytes( hash, &trace.lights[ i ]->cacheHash, sizeof( uint64_t ) );
+    }
+    
+    /* mapped luxels, clusters are hashed by which of the lights they can see */
+    VectorCopy( lm->mins, sampleMins );
+    VectorCopy( lm->maxs, sampleMaxs );
+    for ( y = 0; y < lm->sh; y++ )
+    {
+        for ( x = 0; x < lm->sw; x++ )
+        {
+            cluster = SUPER_CLUSTER( x, y );
+            origin = SUPER_ORIGIN( x, y );
+            normal = SUPER_NORMAL( x, y );
+            
+            if ( *cluster < 0 )
+            {
+                hash = HashInt( hash, *cluster );
+            }
+            else
+            {
+                visHash = VisibleLightsHash( &trace, *cluster, visClusters, visHashes );
+                hash = HashBytes( hash, &visHash, sizeof( visHash ) );
+                AddPointToBounds( origin, sampleMins, sampleMaxs );
+            }
+            
+            hash = HashBytes( hash, origin, SUPER_ORIGIN_SIZE * sizeof( float ) );
+            hash = HashBytes( hash, normal, 3 * sizeof( float ) );
+        }
+    }
+    
+    /* box the rays can cross, dirt and floodlight rays leave every sample */
+    VectorSet( delta, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD, LIGHT_CACHE_PAD );
+    VectorSubtract( sampleMins, delta, sampleMins );
+    VectorAdd( sampleMaxs, delta, sampleMaxs );
+    
+    pad = 0.0f;
+    if ( dirty )
+    {
+        pad = dirtDepth;
+    }
+    if ( g_floodlight && floodlightIntensity && floodlightDistance > pad )
+    {
+        pad = floodlightDistance;
+    }
+    if ( lm->floodlightIntensity && lm->floodlightDistance > pad )
+    {
+        pad = lm->floodlightDistance;
+    }
+    VectorSet( delta, pad, pad, pad );
+    VectorSubtract( sampleMins, delta, mins );
+    VectorAdd( sampleMaxs, delta, maxs );
+    
+    for ( i = 0; i < trace.numLights; i++ )
+    {
+        AddLightToRegion( trace.lights[ i ], sampleMins, sampleMaxs, mins, maxs );
+    }
+    FreeTraceLights( &trace );
+    
+    hash = MixHash( hash ) ^ OccluderHash( mins, maxs );
+    lightmapHashes[ rawLightmapNum ] = hash ? hash : 1;
+}
+
+
+
+/*
+   RestoreRawLightmap()
+   copies a cached lightmap record back into the super luxels
+ */
+
+static qboolean RestoreRawLightmap( rawLightmap_t* lm, const byte* record )
+{
+    int i, ints[ 3 ], luxels, size;
+    byte styles[ MAX_LIGHTMAPS ];
+    float*               dirt;
+    
+    
+    memcpy( ints, record, sizeof( ints ) );
+    record += sizeof( ints );
+    if ( ints[ 0 ] != lm->sw || ints[ 1 ] != lm->sh ||
+            ( ( ints[ 2 ] & LIGHT_CACHE_DELUXELS ) != 0 ) != ( lm->superDeluxels != NULL ) ||
+            ( ( ints[ 2 ] & LIGHT_CACHE_DIRT ) != 0 ) != ( dirty != qfalse ) )
+    {
+        return qfalse;
+    }
+    
+    luxels = lm->sw * lm->sh;
+    memcpy( styles, record, MAX_LIGHTMAPS );
+    memcpy( lm->styles, styles, MAX_LIGHTMAPS );
+    record += MAX_LIGHTMAPS;
+    
+    size = luxels * SUPER_LUXEL_SIZE * sizeof( float );
+    for ( i = 0; i < MAX_LIGHTMAPS; i++ )
+    {
+        if ( ints[ 2 ] & ( 1 << i ) )
+        {
+            if ( lm->superLuxels[ i ] == NULL )
+            {
+                lm->superLuxels[ i ] = static_cast<float*>( safe_malloc( size ) );
+            }
+            memcpy( lm->superLuxels[ i ], record, size );
+            record += size;
+        }
+        else if ( lm->superLuxels[ i ] != NULL )
+        {
+            memset( lm->superLuxels[ i ], 0, size );
+        }
+    }
+    
+    memcpy( lm->superClusters, record, luxels * sizeof( int ) );
+    record += luxels * sizeof( int );
+    
+    if ( ints[ 2 ] & LIGHT_CACHE_DELUXELS )
+    {
+        memcpy( lm->superDeluxels, record, luxels * SUPER_DELUXEL_SIZE * sizeof( float ) );
+        record += luxels * SUPER_DELUXEL_SIZE * sizeof( float );
+    }
+    
+    /* dirt is kept in the normals, bounces apply it again */
+    if ( ints[ 2 ] & LIGHT_CACHE_DIRT )
+    {
+        dirt = lm->superNormals + 3;
+        for ( i = 0; i < luxels; i++, dirt += SUPER_NORMAL_SIZE, record += sizeof( float ) )
+        {
+            memcpy( dirt, record, sizeof( float ) );
+        }
+    }
+    
+    return qtrue;
+}
+
+
+
+/*
+   ReuseRawLightmaps()
+   hashes every raw lightmap and restores the ones the cache has, call after
+   MapRawLightmap() and SetupEnvelopes()
+ */
+
+void ReuseRawLightmaps( void )
+{
+    int i, reused, luxels;
+    const byte*      record;
+    
+    
+    if ( lightmapHashes == NULL )
+    {
+        return;
+    }
+    
+    UpdateShaderDigests();
+    RunThreadsOnIndividual( numRawLightmaps, qfalse, HashRawLightmap );
+    
+    reused = 0;
+    luxels = 0;
+    for ( i = 0; reuseLightmaps && i < numRawLightmaps; i++ )
+    {
+        record = FindCacheRecord( cacheLightmaps, lightmapHashes[ i ] );
+        if ( record != NULL && RestoreRawLightmap( &rawLightmaps[ i ], record ) )
+        {
+            lightmapReused[ i ] = 1;
+            reused++;
+            luxels += rawLightmaps[ i ].sw * rawLightmaps[ i ].sh;
+        }
+    }
+    
+    Sys_Printf( "%9d of %d lightmaps reused (%d luxels)\n", reused, numRawLightmaps, luxels );
+}
+
+
+
+qboolean RawLightmapReused( int num )
+{
+    return ( lightmapReused != NULL && lightmapReused[ num ] ) ? qtrue : qfalse;
+}
+
+
+
+/*
+   WriteLightCache()
+   writes the lit lightmaps and grid for the next -incremental run, call after
+   the first IlluminateRawLightmap() pass and before they are stitched
+ */
+
+void WriteLightCache( void )
+{
+    int i, j, mask, luxels, ints[ 3 ];
+    FILE*                file;
+    lightCacheHeader_t header;
+    rawLightmap_t*       lm;
+    
+    
+    if ( lightmapHashes == NULL )
+    {
+        return;
+    }
+    
+    /* note it */
+    Sys_FPrintf( SYS_VRB, "--- WriteLightCache ---\n" );
+    
+    memset( &header, 0, sizeof( header ) );
+    header.ident = LIGHT_CACHE_IDENT;
+    header.version = LIGHT_CACHE_VERSION;
+    header.globalHash = globalHash;
+    for ( i = 0; i < numRawLightmaps; i++ )
+    {
+        header.numLightmaps += lightmapHashes[ i ] != 0;
+    }
+    for ( i = 0; gridHashes != NULL && i < numRawGridPoints; i++ )
+    {
+        header.numGridPoints += gridHashes[ i ] != 0;
+    }
+    
+    file = SafeOpenWrite( lightCachePath );
+    SafeWrite( file, &header, sizeof( header ) );
+    
+    for ( i = 0; i < numRawLightmaps; i++ )
+    {
+        if ( lightmapHashes[ i ] == 0 )
+        {
+            continue;
+        }
+        
+        lm = &rawLightmaps[ i ];
+        luxels = lm->sw * lm->sh;
+        
+        mask = 0;
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->superLuxels[ j ] != NULL )
+            {
+                mask |= 1 << j;
+            }
+        }
+        if ( lm->superDeluxels != NULL )
+        {
+            mask |= LIGHT_CACHE_DELUXELS;
+        }
+        if ( dirty )
+        {
+            mask |= LIGHT_CACHE_DIRT;
+        }
+        
+        ints[ 0 ] = lm->sw;
+        ints[ 1 ] = lm->sh;
+        ints[ 2 ] = mask;
+        SafeWrite( file, &lightmapHashes[ i ], sizeof( uint64_t ) );
+        SafeWrite( file, ints, sizeof( ints ) );
+        SafeWrite( file, lm->styles, MAX_LIGHTMAPS );
+        for ( j = 0; j < MAX_LIGHTMAPS; j++ )
+        {
+            if ( lm->superLuxels[ j ] != NULL )
+            {
+                SafeWrite( file, lm->superLuxels[ j ], luxels * SUPER_LUXEL_SIZE * sizeof( float ) );
+            }
+        }
+        SafeWrite( file, lm->superClusters, luxels * sizeof( int ) );
+        if ( mask & LIGHT_CACHE_DELUXELS )
+        {
+            SafeWrite( file, lm->superDeluxels, luxels * SUPER_DELUXEL_SIZE * sizeof( float ) );
+        }
+        if ( mask & LIGHT_CACHE_DIRT )
+        {
+            for ( j = 0; j < luxels; j++ )
+            {
+                SafeWrite( file, lm->superNormals + j * SUPER_NORMAL_SIZE + 3, sizeof( float ) );
+            }
+        }
+    }
+    
+    for ( i = 0; gridHashes != NULL && i < numRawGridPoints; i++ )
+    {
+        if ( gridHashes[ i ] == 0 )
+        {
+            continue;
+        }
+        SafeWrite( file, &gridHashes[ i ], sizeof( uint64_t ) );
+        SafeWrite( file, &rawGridPoints[ i ], sizeof( rawGridPoint_t ) );
+        SafeWrite( file, &bspGridPoints[ i ], sizeof( bspGridPoint_t ) );
+    }
+    
+    fclose( file );
+    Sys_Printf( "Wrote light cache %s (%d lightmaps, %d grid points)\n", lightCachePath, header.numLightmaps, header.numGridPoints );
+    
+    /* the old records are no longer needed, bounces light everything */
+    free( cacheBuffer );
+    cacheBuffer = NULL;
+    cacheLightmaps.clear();
+    cacheGridPoints.clear();
+    memset( lightmapReused, 0, numRawLightmaps );
+}
@@ -39,6 +39,16 @@
 
 /* dependencies */
 #include "q3map2.h"
+#include <algorithm>
+#include <chrono>
+
+/* 4-wide bvh tests, the scalar path covers everything else */
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define TRACE_SSE               1
+#include <emmintrin.h>
+#else
+#define TRACE_SSE               0
+#endif
 
 
 
@@ -60,9 +70,27 @@
 
 #define TRACE_ON_EPSILON        0.1f
 
+#define BARY_EPSILON            0.01f
+#define ASLF_EPSILON            0.0001f /* so to not get double shadows */
+#define COPLANAR_EPSILON        0.25f   //%	0.000001f
+#define NEAR_SHADOW_EPSILON     1.5f    //%	1.25f
+#define SELF_SHADOW_EPSILON     0.5f
+
 #define TRACE_LEAF              -1
 #define TRACE_LEAF_SOLID        -2
 
+#define BVH_WIDTH               4           /* children per node and triangles per leaf */
+#define BVH_BINS                16
+#define BVH_MAX_SAH_DEPTH       48          /* deeper nodes are split at the median */
+#define BVH_STACK_SIZE          256
+#define BVH_EMPTY_CHILD         ( -0x7FFFFFFF - 1 )
+#define BVH_EMPTY_BOUNDS        1.0e30f
+#define BVH_INFINITE_DISTANCE   1.0e30f
+
+#define MAX_BVH_HITS            32          /* pending sky and filter hits per ray before they spill to the heap */
+#define BVH_PACKET_COHERENCE    0.9f        /* packets are traced together when every ray is this close to their mean direction */
+#define TRACE_BENCH_RAYS        ( 1 << 17 )
+
 typedef struct traceVert_s
 {
     vec3_t xyz;
@@ -104,6 +132,35 @@ typedef struct traceNode_s
 }
 traceNode_t;
 
+/* bsp nodes that lead to solid leafs, all a trace walks once the surfaces are in the bvh */
+typedef struct traceSolidNode_s
+{
+    int type;
+    vec4_t plane;
+    int children[ 2 ];
+    int numItems;
+}
+traceSolidNode_t;
+
+/* children are bvh node numbers, -( leaf number + 1 ) or BVH_EMPTY_CHILD */
+typedef struct traceBVHNode_s
+{
+    float mins[ 3 ][ BVH_WIDTH ];
+    float maxs[ 3 ][ BVH_WIDTH ];
+    int children[ BVH_WIDTH ];
+}
+traceBVHNode_t;
+
+/* triangle lanes are -1 past the last triangle, their edges are zero so they never pass the determinant test */
+typedef struct traceBVHLeaf_s
+{
+    float origin[ 3 ][ BVH_WIDTH ];
+    float edge1[ 3 ][ BVH_WIDTH ];
+    float edge2[ 3 ][ BVH_WIDTH ];
+    int triangles[ BVH_WIDTH ];
+}
+traceBVHLeaf_t;
+
 
 int noDrawContentFlags, noDrawSurfaceFlags, noDrawCompileFlags;
 
@@ -120,6 +177,13 @@ int headNodeNum = 0, skyboxNodeNum = 0, maxTraceDepth = 0, numTraceLeafNodes = 0
 int numTraceNodes = 0, maxTraceNodes = 0;
 traceNode_t*                     traceNodes = NULL;
 
+int numTraceSolidNodes = 0, solidHeadNodeNum = TRACE_LEAF;
+traceSolidNode_t*                traceSolidNodes = NULL;
+
+int numTraceBVHNodes = 0, numTraceBVHLeaves = 0, numTraceBVHTriangles = 0;
+traceBVHNode_t*                  traceBVHNodes = NULL;
+traceBVHLeaf_t*                  traceBVHLeaves = NULL;
+
 
 
 /* -------------------------------------------------------------------------------
@@ -1399,6 +1463,483 @@ static void PopulateTraceNodes( void )
 
 /* -------------------------------------------------------------------------------
 
+   bvh construction
+   
+   ------------------------------------------------------------------------------- */
+
+typedef struct bvhRef_s
+{
+    vec3_t mins, maxs, center;
+    int triangleNum;
+}
+bvhRef_t;
+
+typedef struct bvhBuildNode_s
+{
+    vec3_t mins, maxs;
+    int children[ 2 ];                  /* -1 for leafs */
+    int firstRef, numRefs;
+}
+bvhBuildNode_t;
+
+struct bvhCenterLess
+{
+    int axis;
+    
+    bool operator()( const bvhRef_t& a, const bvhRef_t& b ) const
+    {
+        return a.center[ axis ] < b.center[ axis ];
+    }
+};
+
+
+
+/*
+   SetupTraceSolidNodes_r()
+   copies the parts of the trace tree that lead to solid leafs, returns TRACE_LEAF for subtrees without any
+ */
+
+static int SetupTraceSolidNodes_r( int nodeNum, std::vector<traceSolidNode_t>& solidNodes )
+{
+    int i, children[ 2 ];
+    traceNode_t*         node;
+    traceSolidNode_t solid;
+    
+    
+    /* get node */
+    node = &traceNodes[ nodeNum ];
+    if ( node->type == TRACE_LEAF_SOLID )
+    {
+        return TRACE_LEAF_SOLID;
+    }
+    if ( node->type < 0 )
+    {
+        return TRACE_LEAF;
+    }
+    
+    /* walk children */
+    for ( i = 0; i < 2; i++ )
+    {
+        children[ i ] = SetupTraceSolidNodes_r( traceNodes[ nodeNum ].children[ i ], solidNodes );
+    }
+    
+    /* nothing solid below */
+    if ( children[ 0 ] == TRACE_LEAF && children[ 1 ] == TRACE_LEAF )
+    {
+        return TRACE_LEAF;
+    }
+    
+    /* copy the split, numItems keeps the testall pruning of TraceLine_r */
+    node = &traceNodes[ nodeNum ];
+    solid.type = node->type;
+    Vector4Copy( node->plane, solid.plane );
+    solid.children[ 0 ] = children[ 0 ];
+    solid.children[ 1 ] = children[ 1 ];
+    solid.numItems = node->numItems;
+    solidNodes.push_back( solid );
+    
+    return ( int )solidNodes.size() - 1;
+}
+
+
+
+/*
+   CollectTraceBVHRefs_r()
+   gathers the triangles of all non-solid leafs, solid leaf triangles are never reached by a trace
+ */
+
+static void CollectTraceBVHRefs_r( int nodeNum, std::vector<bvhRef_t>& refs )
+{
+    int i, j;
+    float pad, planePad;
+    vec3_t normal;
+    traceNode_t*     node;
+    traceTriangle_t* tt;
+    bvhRef_t ref;
+    
+    
+    /* get node */
+    node = &traceNodes[ nodeNum ];
+    if ( node->type == TRACE_LEAF_SOLID )
+    {
+        return;
+    }
+    
+    /* decision node */
+    if ( node->type >= 0 )
+    {
+        CollectTraceBVHRefs_r( node->children[ 0 ], refs );
+        CollectTraceBVHRefs_r( traceNodes[ nodeNum ].children[ 1 ], refs );
+        return;
+    }
+    
+    /* leaf */
+    for ( i = 0; i < node->numItems; i++ )
+    {
+        tt = &traceTriangles[ node->items[ i ] ];
+        
+        ClearBounds( ref.mins, ref.maxs );
+        for ( j = 0; j < 3; j++ )
+        {
+            AddPointToBounds( tt->v[ j ].xyz, ref.mins, ref.maxs );
+        }
+        
+        /* TraceTriangle accepts hits BARY_EPSILON outside the edges, which only grows the box within the triangle plane */
+        pad = BARY_EPSILON * ( VectorLength( tt->edge1 ) + VectorLength( tt->edge2 ) );
+        CrossProduct( tt->edge1, tt->edge2, normal );
+        VectorNormalize( normal, normal );
+        for ( j = 0; j < 3; j++ )
+        {
+            planePad = pad * sqrt( std::max( 0.0f, 1.0f - normal[ j ] * normal[ j ] ) ) + 0.0625f;
+            ref.mins[ j ] -= planePad;
+            ref.maxs[ j ] += planePad;
+            ref.center[ j ] = 0.5f * ( ref.mins[ j ] + ref.maxs[ j ] );
+        }
+        ref.triangleNum = node->items[ i ];
+        refs.push_back( ref );
+    }
+}
+
+
+
+/*
+   BVHSurfaceArea()
+   half the surface area of a box, all the sah cost needs
+ */
+
+static inline float BVHSurfaceArea( const vec3_t mins, const vec3_t maxs )
+{
+    vec3_t size;
+    
+    
+    VectorSubtract( maxs, mins, size );
+    if ( size[ 0 ] < 0.0f )
+    {
+        return 0.0f;
+    }
+    return size[ 0 ] * size[ 1 ] + size[ 1 ] * size[ 2 ] + size[ 2 ] * size[ 0 ];
+}
+
+
+
+/*
+   BuildTraceBVH_r()
+   builds a binary bvh over refs with binned sah splits, leafs hold up to BVH_WIDTH triangles
+ */
+
+static int BuildTraceBVH_r( std::vector<bvhBuildNode_t>& nodes, bvhRef_t* refs, int firstRef, int numRefs, int depth )
+{
+    int i, j, axis, bin, bestAxis, bestSplit, numLeft, nodeNum, child;
+    int binCounts[ BVH_BINS ];
+    vec3_t binMins[ BVH_BINS ], binMaxs[ BVH_BINS ];
+    vec3_t centerMins, centerMaxs, mins, maxs;
+    float areas[ BVH_BINS ], scale, cost, bestCost;
+    bvhBuildNode_t node;
+    bvhRef_t*        ref;
+    bvhCenterLess median;
+    
+    
+    /* bound the refs and their centers */
+    ClearBounds( node.mins, node.maxs );
+    ClearBounds( centerMins, centerMaxs );
+    for ( i = 0; i < numRefs; i++ )
+    {
+        ref = &refs[ firstRef + i ];
+        AddPointToBounds( ref->mins, node.mins, node.maxs );
+        AddPointToBounds( ref->maxs, node.mins, node.maxs );
+        AddPointToBounds( ref->center, centerMins, centerMaxs );
+    }
+    node.children[ 0 ] = node.children[ 1 ] = -1;
+    node.firstRef = firstRef;
+    node.numRefs = numRefs;
+    
+    nodeNum = ( int )nodes.size();
+    nodes.push_back( node );
+    
+    /* small enough for a leaf */
+    if ( numRefs <= BVH_WIDTH )
+    {
+        return nodeNum;
+    }
+    
+    /* find the cheapest binned split */
+    bestAxis = -1;
+    bestSplit = 0;
+    bestCost = 1.0e30f;
+    if ( depth < BVH_MAX_SAH_DEPTH )
+    {
+        for ( axis = 0; axis < 3; axis++ )
+        {
+            if ( centerMaxs[ axis ] - centerMins[ axis ] <= 0.0f )
+            {
+                continue;
+            }
+            scale = BVH_BINS / ( centerMaxs[ axis ] - centerMins[ axis ] );
+            
+            /* fill the bins */
+            for ( bin = 0; bin < BVH_BINS; bin++ )
+            {
+                binCounts[ bin ] = 0;
+                ClearBounds( binMins[ bin ], binMaxs[ bin ] );
+            }
+            for ( i = 0; i < numRefs; i++ )
+            {
+                ref = &refs[ firstRef + i ];
+                bin = ( int )( ( ref->center[ axis ] - centerMins[ axis ] ) * scale );
+                bin = bin < BVH_BINS ? bin : BVH_BINS - 1;
+                binCounts[ bin ]++;
+                AddPointToBounds( ref->mins, binMins[ bin ], binMaxs[ bin ] );
+                AddPointToBounds( ref->maxs, binMins[ bin ], binMaxs[ bin ] );
+            }
+            
+            /* sweep from the right, then price every split from the left */
+            ClearBounds( mins, maxs );
+            for ( bin = BVH_BINS - 1; bin > 0; bin-- )
+            {
+                AddPointToBounds( binMins[ bin ], mins, maxs );
+                AddPointToBounds( binMaxs[ bin ], mins, maxs );
+                areas[ bin ] = BVHSurfaceArea( mins, maxs );
+            }
+            ClearBounds( mins, maxs );
+            numLeft = 0;
+            for ( bin = 0; bin < BVH_BINS - 1; bin++ )
+            {
+                AddPointToBounds( binMins[ bin ], mins, maxs );
+                AddPointToBounds( binMaxs[ bin ], mins, maxs );
+                numLeft += binCounts[ bin ];
+                if ( numLeft == 0 || numLeft == numRefs )
+                {
+                    continue;
+                }
+                
+                cost = BVHSurfaceArea( mins, maxs ) * numLeft + areas[ bin + 1 ] * ( numRefs - numLeft );
+                if ( cost < bestCost )
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = bin;
+                }
+            }
+        }
+    }
+    
+    /* partition the refs */
+    if ( bestAxis >= 0 )
+    {
+        scale = BVH_BINS / ( centerMaxs[ bestAxis ] - centerMins[ bestAxis ] );
+        numLeft = 0;
+        for ( i = 0; i < numRefs; i++ )
+        {
+            ref = &refs[ firstRef + i ];
+            bin = ( int )( ( ref->center[ bestAxis ] - centerMins[ bestAxis ] ) * scale );
+            bin = bin < BVH_BINS ? bin : BVH_BINS - 1;
+            if ( bin <= bestSplit )
+            {
+                std::swap( *ref, refs[ firstRef + numLeft ] );
+                numLeft++;
+            }
+        }
+    }
+    
+    /* too deep or all centers in one spot, split at the median of the widest axis */
+    else
+    {
+        VectorSubtract( centerMaxs, centerMins, mins );
+        median.axis = ( mins[ 0 ] >= mins[ 1 ] && mins[ 0 ] >= mins[ 2 ] ) ? 0 : ( mins[ 1 ] >= mins[ 2 ] ? 1 : 2 );
+        numLeft = numRefs / 2;
+        std::nth_element( refs + firstRef, refs + firstRef + numLeft, refs + firstRef + numRefs, median );
+    }
+    
+    /* build the children, nodes may move while they are added */
+    for ( j = 0; j < 2; j++ )
+    {
+        child = j == 0
+                ? BuildTraceBVH_r( nodes, refs, firstRef, numLeft, depth + 1 )
+                : BuildTraceBVH_r( nodes, refs, firstRef + numLeft, numRefs - numLeft, depth + 1 );
+        nodes[ nodeNum ].children[ j ] = child;
+    }
+    nodes[ nodeNum ].numRefs = 0;
+    
+    return nodeNum;
+}
+
+
+
+/*
+   CollapseTraceBVH_r()
+   pulls grandchildren of a binary node up until it has BVH_WIDTH children and emits it as a 4-wide node
+ */
+
+static int CollapseTraceBVH_r( const std::vector<bvhBuildNode_t>& nodes, const bvhRef_t* refs, int buildNum,
+                               std::vector<traceBVHNode_t>& bvhNodes, std::vector<traceBVHLeaf_t>& bvhLeaves )
+{
+    int i, j, k, best, numChildren, children[ BVH_WIDTH ], nodeNum, code;
+    float area, bestArea;
+    const bvhBuildNode_t*    build;
+    traceBVHNode_t bvhNode;
+    traceBVHLeaf_t leaf;
+    traceTriangle_t* tt;
+    
+    
+    /* start with the children of the build node, a leaf root becomes a node with one child */
+    build = &nodes[ buildNum ];
+    numChildren = 0;
+    if ( build->children[ 0 ] < 0 )
+    {
+        children[ numChildren++ ] = buildNum;
+    }
+    else
+    {
+        children[ numChildren++ ] = build->children[ 0 ];
+        children[ numChildren++ ] = build->children[ 1 ];
+    }
+    
+    /* open the largest inner child until the node is full */
+    while ( numChildren < BVH_WIDTH )
+    {
+        best = -1;
+        bestArea = -1.0f;
+        for ( i = 0; i < numChildren; i++ )
+        {
+            build = &nodes[ children[ i ] ];
+            if ( build->children[ 0 ] < 0 )
+            {
+                continue;
+            }
+            area = BVHSurfaceArea( build->mins, build->maxs );
+            if ( area > bestArea )
+            {
+                bestArea = area;
+                best = i;
+            }
+        }
+        if ( best < 0 )
+        {
+            break;
+        }
+        
+        build = &nodes[ children[ best ] ];
+        children[ best ] = build->children[ 0 ];
+        children[ numChildren++ ] = build->children[ 1 ];
+    }
+    
+    /* reserve the node before the children are emitted */
+    nodeNum = ( int )bvhNodes.size();
+    bvhNodes.push_back( bvhNode );
+    
+    for ( i = 0; i < BVH_WIDTH; i++ )
+    {
+        /* unused slot, a point box far outside the world */
+        if ( i >= numChildren )
+        {
+            for ( j = 0; j < 3; j++ )
+            {
+                bvhNode.mins[ j ][ i ] = BVH_EMPTY_BOUNDS;
+                bvhNode.maxs[ j ][ i ] = BVH_EMPTY_BOUNDS;
+            }
+            bvhNode.children[ i ] = BVH_EMPTY_CHILD;
+            continue;
+        }
+        
+        build = &nodes[ children[ i ] ];
+        for ( j = 0; j < 3; j++ )
+        {
+            bvhNode.mins[ j ][ i ] = build->mins[ j ];
+            bvhNode.maxs[ j ][ i ] = build->maxs[ j ];
+        }
+        
+        /* inner child */
+        if ( build->children[ 0 ] >= 0 )
+        {
+            bvhNode.children[ i ] = CollapseTraceBVH_r( nodes, refs, children[ i ], bvhNodes, bvhLeaves );
+            continue;
+        }
+        
+        /* leaf child, store its triangles in structure of arrays order */
+        memset( &leaf, 0, sizeof( leaf ) );
+        for ( k = 0; k < BVH_WIDTH; k++ )
+        {
+            if ( k >= build->numRefs )
+            {
+                leaf.triangles[ k ] = -1;
+                continue;
+            }
+            
+            leaf.triangles[ k ] = refs[ build->firstRef + k ].triangleNum;
+            tt = &traceTriangles[ leaf.triangles[ k ] ];
+            for ( j = 0; j < 3; j++ )
+            {
+                leaf.origin[ j ][ k ] = tt->v[ 0 ].xyz[ j ];
+                leaf.edge1[ j ][ k ] = tt->edge1[ j ];
+                leaf.edge2[ j ][ k ] = tt->edge2[ j ];
+            }
+        }
+        code = -( int )bvhLeaves.size() - 1;
+        bvhLeaves.push_back( leaf );
+        bvhNode.children[ i ] = code;
+    }
+    
+    bvhNodes[ nodeNum ] = bvhNode;
+    return nodeNum;
+}
+
+
+
+/*
+   SetupTraceBVH()
+   builds the 4-wide bvh over the trace triangles and the solid node tree TraceLine walks alongside it
+ */
+
+static void SetupTraceBVH( void )
+{
+    std::vector<traceSolidNode_t> solidNodes;
+    std::vector<bvhRef_t> refs;
+    std::vector<bvhBuildNode_t> buildNodes;
+    std::vector<traceBVHNode_t> bvhNodes;
+    std::vector<traceBVHLeaf_t> bvhLeaves;
+    
+    
+    /* note it */
+    Sys_FPrintf( SYS_VRB, "--- SetupTraceBVH ---\n" );
+    
+    /* the node tree only has to answer for solid leafs now */
+    solidHeadNodeNum = SetupTraceSolidNodes_r( headNodeNum, solidNodes );
+    numTraceSolidNodes = ( int )solidNodes.size();
+    traceSolidNodes = static_cast<traceSolidNode_t*>( safe_malloc( ( numTraceSolidNodes + 1 ) * sizeof( *traceSolidNodes ) ) );
+    if ( numTraceSolidNodes > 0 )
+    {
+        memcpy( traceSolidNodes, solidNodes.data(), numTraceSolidNodes * sizeof( *traceSolidNodes ) );
+    }
+    
+    /* build the bvh */
+    CollectTraceBVHRefs_r( headNodeNum, refs );
+    numTraceBVHTriangles = ( int )refs.size();
+    if ( numTraceBVHTriangles == 0 )
+    {
+        return;
+    }
+    BuildTraceBVH_r( buildNodes, refs.data(), 0, numTraceBVHTriangles, 0 );
+    CollapseTraceBVH_r( buildNodes, refs.data(), 0, bvhNodes, bvhLeaves );
+    
+    /* copy it out */
+    numTraceBVHNodes = ( int )bvhNodes.size();
+    numTraceBVHLeaves = ( int )bvhLeaves.size();
+    traceBVHNodes = static_cast<traceBVHNode_t*>( safe_malloc( numTraceBVHNodes * sizeof( *traceBVHNodes ) ) );
+    traceBVHLeaves = static_cast<traceBVHLeaf_t*>( safe_malloc( numTraceBVHLeaves * sizeof( *traceBVHLeaves ) ) );
+    memcpy( traceBVHNodes, bvhNodes.data(), numTraceBVHNodes * sizeof( *traceBVHNodes ) );
+    memcpy( traceBVHLeaves, bvhLeaves.data(), numTraceBVHLeaves * sizeof( *traceBVHLeaves ) );
+    
+    /* emit some stats */
+    Sys_FPrintf( SYS_VRB, "%9d solid trace nodes\n", numTraceSolidNodes );
+    Sys_FPrintf( SYS_VRB, "%9d bvh triangles\n", numTraceBVHTriangles );
+    Sys_FPrintf( SYS_VRB, "%9d bvh nodes (%.2fMB)\n", numTraceBVHNodes, ( float )( numTraceBVHNodes * sizeof( *traceBVHNodes ) ) / ( 1024.0f * 1024.0f ) );
+    Sys_FPrintf( SYS_VRB, "%9d bvh leafs (%.2fMB)\n", numTraceBVHLeaves, ( float )( numTraceBVHLeaves * sizeof( *traceBVHLeaves ) ) / ( 1024.0f * 1024.0f ) );
+}
+
+
+
+/* -------------------------------------------------------------------------------
+   
    trace initialization
 
    ------------------------------------------------------------------------------- */
@@ -1437,6 +1978,12 @@ void SetupTraceNodes( void )
     TriangulateTraceNode_r( headNodeNum );
     TriangulateTraceNode_r( skyboxNodeNum );
     
+    /* sort the triangles into the bvh */
+    if ( !noTraceBVH )
+    {
+        SetupTraceBVH();
+    }
+    
     /* emit some stats */
     //%	Sys_FPrintf( SYS_VRB, "%9d original triangles\n", numOriginalTriangles );
     Sys_FPrintf( SYS_VRB, "%9d trace windings (%.2fMB)\n", numTraceWindings, ( float )( numTraceWindings * sizeof( *traceWindings ) ) / ( 1024.0f * 1024.0f ) );
@@ -1497,36 +2044,12 @@ void SetupTraceNodes( void )
    ------------------------------------------------------------------------------- */
 
 /*
-   TraceTriangle()
-   based on code written by william 'spog' joseph
-   based on code originally written by tomas moller and ben trumbore, journal of graphics tools, 2(1):21-28, 1997
+   TraceInfoShadows()
+   returns qtrue if surfaces of this trace info may shadow the trace, shared by the node tree and the bvh
  */
 
-#define BARY_EPSILON            0.01f
-#define ASLF_EPSILON            0.0001f /* so to not get double shadows */
-#define COPLANAR_EPSILON        0.25f   //%	0.000001f
-#define NEAR_SHADOW_EPSILON     1.5f    //%	1.25f
-#define SELF_SHADOW_EPSILON     0.5f
-
-qboolean TraceTriangle( traceInfo_t* ti, traceTriangle_t* tt, trace_t* trace )
+static inline qboolean TraceInfoShadows( traceInfo_t* ti, trace_t* trace )
 {
-    int i;
-    float tvec[ 3 ], pvec[ 3 ], qvec[ 3 ];
-    float det, invDet, depth;
-    float u, v, w, s, t;
-    int is, it;
-    byte*            pixel;
-    float shadow;
-    shaderInfo_t*    si;
-    
-    
-    /* don't double-trace against sky */
-    si = ti->si;
-    if ( trace->compileFlags & si->compileFlags & C_SKY )
-    {
-        return qfalse;
-    }
-    
     /* receive shadows from worldspawn group only */
     if ( trace->recvShadows == 1 )
     {
@@ -1564,45 +2087,20 @@ qboolean TraceTriangle( traceInfo_t* ti, traceTriangle_t* tt, trace_t* trace )
         }
     }
     
-    /* begin calculating determinant - also used to calculate u parameter */
-    CrossProduct( trace->direction, tt->edge2, pvec );
-    
-    /* if determinant is near zero, trace lies in plane of triangle */
-    det = DotProduct( tt->edge1, pvec );
-    
-    /* the non-culling branch */
-    if ( fabs( det ) < COPLANAR_EPSILON )
-    {
-        return qfalse;
-    }
-    invDet = 1.0f / det;
+    return qtrue;
+}
     
-    /* calculate distance from first vertex to ray origin */
-    VectorSubtract( trace->origin, tt->v[ 0 ].xyz, tvec );
     
-    /* calculate u parameter and test bounds */
-    u = DotProduct( tvec, pvec ) * invDet;
-    if ( u < -BARY_EPSILON || u > ( 1.0f + BARY_EPSILON ) )
-    {
-        return qfalse;
-    }
     
-    /* prepare to test v parameter */
-    CrossProduct( tvec, tt->edge1, qvec );
+/*
+   TraceSelfShadows()
+   returns qfalse if a hit this close to the trace origin is on one of the sample's own surfaces
+ */
     
-    /* calculate v parameter and test bounds */
-    v = DotProduct( trace->direction, qvec ) * invDet;
-    if ( v < -BARY_EPSILON || ( u + v ) > ( 1.0f + BARY_EPSILON ) )
-    {
-        return qfalse;
-    }
+static inline qboolean TraceSelfShadows( traceInfo_t* ti, float depth, trace_t* trace )
+{
+    int i;
     
-    /* calculate t (depth) */
-    depth = DotProduct( tt->edge2, qvec ) * invDet;
-    if ( depth <= trace->inhibitRadius || depth >= trace->distance )
-    {
-        return qfalse;
-    }
     
     /* if hitpoint is really close to trace origin (sample point), then check for self-shadowing */
     if ( depth <= SELF_SHADOW_EPSILON )
@@ -1617,24 +2115,24 @@ qboolean TraceTriangle( traceInfo_t* ti, traceTriangle_t* tt, trace_t* trace )
         }
     }
     
-    /* stack compile flags */
-    trace->compileFlags |= si->compileFlags;
+    return qtrue;
+}
     
-    /* don't trace against sky */
-    if ( si->compileFlags & C_SKY )
-    {
-        return qfalse;
-    }
     
-    /* most surfaces are completely opaque */
-    if ( !( si->compileFlags & ( C_ALPHASHADOW | C_LIGHTFILTER ) ) ||
-            si->lightImage == NULL || si->lightImage->pixels == NULL )
-    {
-        VectorMA( trace->origin, depth, trace->direction, trace->hit );
-        VectorClear( trace->color );
-        trace->opaque = qtrue;
-        return qtrue;
-    }
+
+/*
+   TraceTriangleFilter()
+   filters the trace color through an alphashadow or lightfilter hit at barycentric u, v
+   returns qtrue if the trace became opaque
+ */
+
+static qboolean TraceTriangleFilter( shaderInfo_t* si, traceTriangle_t* tt, float u, float v, float depth, trace_t* trace )
+{
+    float w, s, t;
+    int is, it;
+    byte*            pixel;
+    float shadow;
+    
     
     /* force subsampling because the lighting is texture dependent */
     trace->forceSubsampling = 1.0;
@@ -1710,6 +2208,116 @@ qboolean TraceTriangle( traceInfo_t* ti, traceTriangle_t* tt, trace_t* trace )
 
 
 
+/*
+   TraceTriangleOpaque()
+   returns qtrue if hits on this shader stop the trace without sampling its light image
+ */
+
+static inline qboolean TraceTriangleOpaque( shaderInfo_t* si )
+{
+    return ( !( si->compileFlags & ( C_ALPHASHADOW | C_LIGHTFILTER ) ) ||
+             si->lightImage == NULL || si->lightImage->pixels == NULL ) ? qtrue : qfalse;
+}
+
+
+
+/*
+   TraceTriangle()
+   based on code written by william 'spog' joseph
+   based on code originally written by tomas moller and ben trumbore, journal of graphics tools, 2(1):21-28, 1997
+ */
+
+qboolean TraceTriangle( traceInfo_t* ti, traceTriangle_t* tt, trace_t* trace )
+{
+    float tvec[ 3 ], pvec[ 3 ], qvec[ 3 ];
+    float det, invDet, depth;
+    float u, v;
+    shaderInfo_t*    si;
+    
+    
+    /* don't double-trace against sky */
+    si = ti->si;
+    if ( trace->compileFlags & si->compileFlags & C_SKY )
+    {
+        return qfalse;
+    }
+    
+    /* shadow groups and grid patches */
+    if ( !TraceInfoShadows( ti, trace ) )
+    {
+        return qfalse;
+    }
+    
+    /* begin calculating determinant - also used to calculate u parameter */
+    CrossProduct( trace->direction, tt->edge2, pvec );
+    
+    /* if determinant is near zero, trace lies in plane of triangle */
+    det = DotProduct( tt->edge1, pvec );
+    
+    /* the non-culling branch */
+    if ( fabs( det ) < COPLANAR_EPSILON )
+    {
+        return qfalse;
+    }
+    invDet = 1.0f / det;
+    
+    /* calculate distance from first vertex to ray origin */
+    VectorSubtract( trace->origin, tt->v[ 0 ].xyz, tvec );
+    
+    /* calculate u parameter and test bounds */
+    u = DotProduct( tvec, pvec ) * invDet;
+    if ( u < -BARY_EPSILON || u > ( 1.0f + BARY_EPSILON ) )
+    {
+        return qfalse;
+    }
+    
+    /* prepare to test v parameter */
+    CrossProduct( tvec, tt->edge1, qvec );
+    
+    /* calculate v parameter and test bounds */
+    v = DotProduct( trace->direction, qvec ) * invDet;
+    if ( v < -BARY_EPSILON || ( u + v ) > ( 1.0f + BARY_EPSILON ) )
+    {
+        return qfalse;
+    }
+    
+    /* calculate t (depth) */
+    depth = DotProduct( tt->edge2, qvec ) * invDet;
+    if ( depth <= trace->inhibitRadius || depth >= trace->distance )
+    {
+        return qfalse;
+    }
+    
+    /* don't self-shadow */
+    if ( !TraceSelfShadows( ti, depth, trace ) )
+    {
+        return qfalse;
+    }
+    
+    /* stack compile flags */
+    trace->compileFlags |= si->compileFlags;
+    
+    /* don't trace against sky */
+    if ( si->compileFlags & C_SKY )
+    {
+        return qfalse;
+    }
+    
+    /* most surfaces are completely opaque */
+    if ( TraceTriangleOpaque( si ) )
+    {
+        VectorMA( trace->origin, depth, trace->direction, trace->hit );
+        VectorClear( trace->color );
+        trace->opaque = qtrue;
+        return qtrue;
+    }
+    
+    /* filter the light through the texture */
+    return TraceTriangleFilter( si, tt, u, v, depth, trace );
+}
+
+
+
 /*
    TraceWinding() - ydnar
    temporary hack
@@ -1893,11 +2501,12 @@ static qboolean TraceLine_r( int nodeNum, const vec3_t origin, const vec3_t end,
 }
 
 /*
-   TraceLine() - ydnar
+   TraceLineNodes() - ydnar
    rewrote this function a bit :)
+   traces through the node tree, used when the bvh is disabled with -nobvh
  */
 
-void TraceLine( trace_t* trace )
+static void TraceLineNodes( trace_t* trace )
 {
     int i, j;
     traceNode_t*     node;
@@ -1963,11 +2572,1004 @@ void TraceLine( trace_t* trace )
 
 
 
+/* -------------------------------------------------------------------------------
+   
+   bvh raytracer
+   
+   ------------------------------------------------------------------------------- */
+
+typedef struct traceBVHHit_s
+{
+    float depth, u, v;
+    int triangleNum;
+}
+traceBVHHit_t;
+
+typedef struct traceBVHRay_s
+{
+    trace_t*             trace;
+    float origin[ 3 ], direction[ 3 ], invDirection[ 3 ];
+    float minDepth, maxDepth;           /* maxDepth shrinks to the nearest opaque hit */
+    int opaqueTriangle;
+    
+    /* sky and filter hits in front of maxDepth, resolved front to back after the traversal */
+    int numHits, maxHits;
+    traceBVHHit_t*   hits;              /* localHits until a ray collects more than MAX_BVH_HITS */
+    traceBVHHit_t localHits[ MAX_BVH_HITS ];
+}
+traceBVHRay_t;
+
+
+
 /*
-   SetupTrace() - ydnar
-   sets up certain trace values
+   TraceSolid_r()
+   walks the solid node tree like TraceLine_r, returns qtrue and sets trace->hit at the first solid leaf
  */
 
+static qboolean TraceSolid_r( int nodeNum, const vec3_t start, const vec3_t end, trace_t* trace )
+{
+    traceSolidNode_t*    node;
+    int side;
+    float front, back, frac;
+    vec3_t origin, mid;
+    
+    
+    VectorCopy( start, origin );
+    
+    while ( 1 )
+    {
+        /* solid leaf */
+        if ( nodeNum == TRACE_LEAF_SOLID )
+        {
+            VectorCopy( origin, trace->hit );
+            trace->passSolid = qtrue;
+            return qtrue;
+        }
+        
+        /* nothing solid down here */
+        if ( nodeNum < 0 )
+        {
+            return qfalse;
+        }
+        
+        /* get node */
+        node = &traceSolidNodes[ nodeNum ];
+        
+        /* don't test branches of the bsp with nothing in them when testall is enabled */
+        if ( trace->testAll && node->numItems == 0 )
+        {
+            return qfalse;
+        }
+        
+        /* classify beginning and end points */
+        switch ( node->type )
+        {
+            case PLANE_X:
+                front = origin[ 0 ] - node->plane[ 3 ];
+                back = end[ 0 ] - node->plane[ 3 ];
+                break;
+            
+            case PLANE_Y:
+                front = origin[ 1 ] - node->plane[ 3 ];
+                back = end[ 1 ] - node->plane[ 3 ];
+                break;
+            
+            case PLANE_Z:
+                front = origin[ 2 ] - node->plane[ 3 ];
+                back = end[ 2 ] - node->plane[ 3 ];
+                break;
+            
+            default:
+                front = DotProduct( origin, node->plane ) - node->plane[ 3 ];
+                back = DotProduct( end, node->plane ) - node->plane[ 3 ];
+                break;
+        }
+        
+        /* entirely in front side? */
+        if ( front >= -TRACE_ON_EPSILON && back >= -TRACE_ON_EPSILON )
+        {
+            nodeNum = node->children[ 0 ];
+            continue;
+        }
+        
+        /* entirely on back side? */
+        if ( front < TRACE_ON_EPSILON && back < TRACE_ON_EPSILON )
+        {
+            nodeNum = node->children[ 1 ];
+            continue;
+        }
+        
+        /* select side */
+        side = front < 0;
+        
+        /* calculate intercept point */
+        frac = front / ( front - back );
+        mid[ 0 ] = origin[ 0 ] + ( end[ 0 ] - origin[ 0 ] ) * frac;
+        mid[ 1 ] = origin[ 1 ] + ( end[ 1 ] - origin[ 1 ] ) * frac;
+        mid[ 2 ] = origin[ 2 ] + ( end[ 2 ] - origin[ 2 ] ) * frac;
+        
+        /* trace first side */
+        if ( TraceSolid_r( node->children[ side ], origin, mid, trace ) )
+        {
+            return qtrue;
+        }
+        
+        /* trace other side */
+        nodeNum = node->children[ !side ];
+        VectorCopy( mid, origin );
+    }
+}
+
+
+
+/*
+   TraceBVHHit()
+   applies the per surface rules of TraceTriangle to a hit, opaque hits shorten the ray
+ */
+
+static void TraceBVHHit( traceBVHRay_t* ray, int triangleNum, float depth, float u, float v )
+{
+    traceTriangle_t* tt;
+    traceInfo_t*     ti;
+    shaderInfo_t*    si;
+    traceBVHHit_t*   hit;
+    void*            temp;
+    
+    
+    /* an earlier lane of the same leaf may have moved the end */
+    if ( depth >= ray->maxDepth )
+    {
+        return;
+    }
+    
+    /* get triangle */
+    tt = &traceTriangles[ triangleNum ];
+    ti = &traceInfos[ tt->infoNum ];
+    si = ti->si;
+    
+    /* shadow groups, grid patches and self shadowing */
+    if ( !TraceInfoShadows( ti, ray->trace ) || !TraceSelfShadows( ti, depth, ray->trace ) )
+    {
+        return;
+    }
+    
+    /* most surfaces are completely opaque */
+    if ( !( si->compileFlags & C_SKY ) && TraceTriangleOpaque( si ) )
+    {
+        ray->maxDepth = depth;
+        ray->opaqueTriangle = triangleNum;
+        return;
+    }
+    
+    /* keep the hit for later, every one of them may be needed to filter the light */
+    if ( ray->numHits >= ray->maxHits )
+    {
+        ray->maxHits *= 2;
+        temp = safe_malloc( ray->maxHits * sizeof( *ray->hits ) );
+        memcpy( temp, ray->hits, ray->numHits * sizeof( *ray->hits ) );
+        if ( ray->hits != ray->localHits )
+        {
+            free( ray->hits );
+        }
+        ray->hits = ( traceBVHHit_t* ) temp;
+    }
+    hit = &ray->hits[ ray->numHits++ ];
+    hit->depth = depth;
+    hit->u = u;
+    hit->v = v;
+    hit->triangleNum = triangleNum;
+}
+
+
+
+/*
+   TraceBVHBounds()
+   slab tests a ray against the 4 child boxes of a node, returns a mask of the hit children
+ */
+
+static inline int TraceBVHBounds( const traceBVHNode_t* node, const traceBVHRay_t* ray, float* nears )
+{
+#if TRACE_SSE
+    __m128 t0, t1, tNear, tFar;
+    
+    
+    t0 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->mins[ 0 ] ), _mm_set1_ps( ray->origin[ 0 ] ) ), _mm_set1_ps( ray->invDirection[ 0 ] ) );
+    t1 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->maxs[ 0 ] ), _mm_set1_ps( ray->origin[ 0 ] ) ), _mm_set1_ps( ray->invDirection[ 0 ] ) );
+    tNear = _mm_max_ps( _mm_min_ps( t0, t1 ), _mm_setzero_ps() );
+    tFar = _mm_min_ps( _mm_max_ps( t0, t1 ), _mm_set1_ps( ray->maxDepth ) );
+    
+    t0 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->mins[ 1 ] ), _mm_set1_ps( ray->origin[ 1 ] ) ), _mm_set1_ps( ray->invDirection[ 1 ] ) );
+    t1 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->maxs[ 1 ] ), _mm_set1_ps( ray->origin[ 1 ] ) ), _mm_set1_ps( ray->invDirection[ 1 ] ) );
+    tNear = _mm_max_ps( _mm_min_ps( t0, t1 ), tNear );
+    tFar = _mm_min_ps( _mm_max_ps( t0, t1 ), tFar );
+    
+    t0 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->mins[ 2 ] ), _mm_set1_ps( ray->origin[ 2 ] ) ), _mm_set1_ps( ray->invDirection[ 2 ] ) );
+    t1 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node->maxs[ 2 ] ), _mm_set1_ps( ray->origin[ 2 ] ) ), _mm_set1_ps( ray->invDirection[ 2 ] ) );
+    tNear = _mm_max_ps( _mm_min_ps( t0, t1 ), tNear );
+    tFar = _mm_min_ps( _mm_max_ps( t0, t1 ), tFar );
+    
+    _mm_storeu_ps( nears, tNear );
+    return _mm_movemask_ps( _mm_cmple_ps( tNear, tFar ) );
+#else
+    int i, j, mask;
+    float t0, t1, tNear, tFar;
+    
+    
+    mask = 0;
+    for ( i = 0; i < BVH_WIDTH; i++ )
+    {
+        tNear = 0.0f;
+        tFar = ray->maxDepth;
+        for ( j = 0; j < 3; j++ )
+        {
+            t0 = ( node->mins[ j ][ i ] - ray->origin[ j ] ) * ray->invDirection[ j ];
+            t1 = ( node->maxs[ j ][ i ] - ray->origin[ j ] ) * ray->invDirection[ j ];
+            tNear = std::max( std::min( t0, t1 ), tNear );
+            tFar = std::min( std::max( t0, t1 ), tFar );
+        }
+        nears[ i ] = tNear;
+        if ( tNear <= tFar )
+        {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+
+
+/*
+   TraceBVHLeaf()
+   moller-trumbore against the 4 triangles of a leaf with the epsilons of TraceTriangle
+ */
+
+static inline void TraceBVHLeaf( const traceBVHLeaf_t* leaf, traceBVHRay_t* ray )
+{
+    int i, mask;
+    float depths[ BVH_WIDTH ], us[ BVH_WIDTH ], vs[ BVH_WIDTH ];
+#if TRACE_SSE
+    __m128 dx, dy, dz, e1x, e1y, e1z, e2x, e2y, e2z, tx, ty, tz;
+    __m128 px, py, pz, qx, qy, qz, det, invDet, u, v, depth, valid;
+    
+    
+    /* begin calculating determinant - also used to calculate u parameter */
+    dx = _mm_set1_ps( ray->direction[ 0 ] );
+    dy = _mm_set1_ps( ray->direction[ 1 ] );
+    dz = _mm_set1_ps( ray->direction[ 2 ] );
+    e1x = _mm_loadu_ps( leaf->edge1[ 0 ] );
+    e1y = _mm_loadu_ps( leaf->edge1[ 1 ] );
+    e1z = _mm_loadu_ps( leaf->edge1[ 2 ] );
+    e2x = _mm_loadu_ps( leaf->edge2[ 0 ] );
+    e2y = _mm_loadu_ps( leaf->edge2[ 1 ] );
+    e2z = _mm_loadu_ps( leaf->edge2[ 2 ] );
+    px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+    py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+    pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+    
+    /* if determinant is near zero, trace lies in plane of triangle */
+    det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+    valid = _mm_cmpge_ps( _mm_andnot_ps( _mm_set1_ps( -0.0f ), det ), _mm_set1_ps( COPLANAR_EPSILON ) );
+    if ( !_mm_movemask_ps( valid ) )
+    {
+        return;
+    }
+    invDet = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_or_ps( _mm_and_ps( valid, det ), _mm_andnot_ps( valid, _mm_set1_ps( 1.0f ) ) ) );
+    
+    /* calculate u parameter and test bounds */
+    tx = _mm_sub_ps( _mm_set1_ps( ray->origin[ 0 ] ), _mm_loadu_ps( leaf->origin[ 0 ] ) );
+    ty = _mm_sub_ps( _mm_set1_ps( ray->origin[ 1 ] ), _mm_loadu_ps( leaf->origin[ 1 ] ) );
+    tz = _mm_sub_ps( _mm_set1_ps( ray->origin[ 2 ] ), _mm_loadu_ps( leaf->origin[ 2 ] ) );
+    u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, px ), _mm_mul_ps( ty, py ) ), _mm_mul_ps( tz, pz ) ), invDet );
+    valid = _mm_and_ps( valid, _mm_cmpge_ps( u, _mm_set1_ps( -BARY_EPSILON ) ) );
+    valid = _mm_and_ps( valid, _mm_cmple_ps( u, _mm_set1_ps( 1.0f + BARY_EPSILON ) ) );
+    
+    /* calculate v parameter and test bounds */
+    qx = _mm_sub_ps( _mm_mul_ps( ty, e1z ), _mm_mul_ps( tz, e1y ) );
+    qy = _mm_sub_ps( _mm_mul_ps( tz, e1x ), _mm_mul_ps( tx, e1z ) );
+    qz = _mm_sub_ps( _mm_mul_ps( tx, e1y ), _mm_mul_ps( ty, e1x ) );
+    v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) ), invDet );
+    valid = _mm_and_ps( valid, _mm_cmpge_ps( v, _mm_set1_ps( -BARY_EPSILON ) ) );
+    valid = _mm_and_ps( valid, _mm_cmple_ps( _mm_add_ps( u, v ), _mm_set1_ps( 1.0f + BARY_EPSILON ) ) );
+    
+    /* calculate t (depth) */
+    depth = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ), invDet );
+    valid = _mm_and_ps( valid, _mm_cmpgt_ps( depth, _mm_set1_ps( ray->minDepth ) ) );
+    valid = _mm_and_ps( valid, _mm_cmplt_ps( depth, _mm_set1_ps( ray->maxDepth ) ) );
+    
+    mask = _mm_movemask_ps( valid );
+    if ( !mask )
+    {
+        return;
+    }
+    _mm_storeu_ps( depths, depth );
+    _mm_storeu_ps( us, u );
+    _mm_storeu_ps( vs, v );
+#else
+    int j;
+    float tvec[ 3 ], pvec[ 3 ], qvec[ 3 ], edge1[ 3 ], edge2[ 3 ];
+    float det, invDet;
+    
+    
+    mask = 0;
+    for ( i = 0; i < BVH_WIDTH; i++ )
+    {
+        for ( j = 0; j < 3; j++ )
+        {
+            edge1[ j ] = leaf->edge1[ j ][ i ];
+            edge2[ j ] = leaf->edge2[ j ][ i ];
+            tvec[ j ] = ray->origin[ j ] - leaf->origin[ j ][ i ];
+        }
+        
+        CrossProduct( ray->direction, edge2, pvec );
+        det = DotProduct( edge1, pvec );
+        if ( fabs( det ) < COPLANAR_EPSILON )
+        {
+            continue;
+        }
+        invDet = 1.0f / det;
+        
+        us[ i ] = DotProduct( tvec, pvec ) * invDet;
+        if ( us[ i ] < -BARY_EPSILON || us[ i ] > ( 1.0f + BARY_EPSILON ) )
+        {
+            continue;
+        }
+        
+        CrossProduct( tvec, edge1, qvec );
+        vs[ i ] = DotProduct( ray->direction, qvec ) * invDet;
+        if ( vs[ i ] < -BARY_EPSILON || ( us[ i ] + vs[ i ] ) > ( 1.0f + BARY_EPSILON ) )
+        {
+            continue;
+        }
+        
+        depths[ i ] = DotProduct( edge2, qvec ) * invDet;
+        if ( depths[ i ] <= ray->minDepth || depths[ i ] >= ray->maxDepth )
+        {
+            continue;
+        }
+        mask |= 1 << i;
+    }
+#endif
+    
+    /* padding lanes have zero edges and never get here */
+    for ( i = 0; i < BVH_WIDTH; i++ )
+    {
+        if ( mask & ( 1 << i ) )
+        {
+            TraceBVHHit( ray, leaf->triangles[ i ], depths[ i ], us[ i ], vs[ i ] );
+        }
+    }
+}
+
+
+
+/*
+   TraceBVHRay()
+   traces a single ray through the bvh nearest child first, skipping pushed children the ray has since fallen short of
+ */
+
+static void TraceBVHRay( traceBVHRay_t* ray )
+{
+    int i, j, sp, nodeNum, hitMask, numChildren, children[ BVH_WIDTH ];
+    int stack[ BVH_STACK_SIZE ];
+    float nears[ BVH_WIDTH ], childNears[ BVH_WIDTH ], stackNears[ BVH_STACK_SIZE ];
+    const traceBVHNode_t*    node;
+    
+    
+    /* start at the root */
+    stack[ 0 ] = 0;
+    stackNears[ 0 ] = 0.0f;
+    sp = 1;
+    
+    while ( sp > 0 )
+    {
+        sp--;
+        if ( stackNears[ sp ] > ray->maxDepth )
+        {
+            continue;
+        }
+        nodeNum = stack[ sp ];
+        
+        /* descend into the nearest child, pushing the others */
+        while ( nodeNum >= 0 )
+        {
+            node = &traceBVHNodes[ nodeNum ];
+            hitMask = TraceBVHBounds( node, ray, nears );
+            
+            /* sort the hit children nearest first */
+            numChildren = 0;
+            for ( i = 0; i < BVH_WIDTH; i++ )
+            {
+                if ( !( hitMask & ( 1 << i ) ) || node->children[ i ] == BVH_EMPTY_CHILD )
+                {
+                    continue;
+                }
+                for ( j = numChildren; j > 0 && childNears[ j - 1 ] > nears[ i ]; j-- )
+                {
+                    children[ j ] = children[ j - 1 ];
+                    childNears[ j ] = childNears[ j - 1 ];
+                }
+                children[ j ] = node->children[ i ];
+                childNears[ j ] = nears[ i ];
+                numChildren++;
+            }
+            
+            if ( numChildren == 0 )
+            {
+                nodeNum = BVH_EMPTY_CHILD;
+                break;
+            }
+            
+            /* push the farther children, farthest first */
+            if ( sp + numChildren > BVH_STACK_SIZE )
+            {
+                Error( "TraceBVHRay: BVH_STACK_SIZE (%d) exceeded", BVH_STACK_SIZE );
+            }
+            for ( i = numChildren - 1; i > 0; i-- )
+            {
+                stack[ sp ] = children[ i ];
+                stackNears[ sp ] = childNears[ i ];
+                sp++;
+            }
+            nodeNum = children[ 0 ];
+        }
+        
+        /* leaf */
+        if ( nodeNum != BVH_EMPTY_CHILD )
+        {
+            TraceBVHLeaf( &traceBVHLeaves[ -nodeNum - 1 ], ray );
+        }
+    }
+}
+
+
+
+/*
+   TraceBVHPacket()
+   traces a packet of rays through the bvh together, a child is entered with the mask of the rays that hit its box
+ */
+
+static void TraceBVHPacket( traceBVHRay_t* rays, int numRays )
+{
+    int i, j, r, sp, nodeNum, hitMask, order[ BVH_WIDTH ];
+    int stack[ BVH_STACK_SIZE ];
+    unsigned int masks[ BVH_STACK_SIZE ], mask, childMasks[ BVH_WIDTH ];
+    float nears[ BVH_WIDTH ], childNears[ BVH_WIDTH ];
+    const traceBVHNode_t*    node;
+    const traceBVHLeaf_t*    leaf;
+    
+    
+    /* start at the root with every ray */
+    stack[ 0 ] = 0;
+    masks[ 0 ] = numRays >= 32 ? 0xFFFFFFFFu : ( 1u << numRays ) - 1;
+    sp = 1;
+    
+    while ( sp > 0 )
+    {
+        sp--;
+        nodeNum = stack[ sp ];
+        mask = masks[ sp ];
+        
+        /* leaf */
+        if ( nodeNum < 0 )
+        {
+            leaf = &traceBVHLeaves[ -nodeNum - 1 ];
+            for ( r = 0; r < numRays; r++ )
+            {
+                if ( mask & ( 1u << r ) )
+                {
+                    TraceBVHLeaf( leaf, &rays[ r ] );
+                }
+            }
+            continue;
+        }
+        
+        /* test the child boxes against every ray that got here */
+        node = &traceBVHNodes[ nodeNum ];
+        for ( i = 0; i < BVH_WIDTH; i++ )
+        {
+            childMasks[ i ] = 0;
+            childNears[ i ] = BVH_INFINITE_DISTANCE;
+        }
+        for ( r = 0; r < numRays; r++ )
+        {
+            if ( !( mask & ( 1u << r ) ) )
+            {
+                continue;
+            }
+            hitMask = TraceBVHBounds( node, &rays[ r ], nears );
+            for ( i = 0; i < BVH_WIDTH; i++ )
+            {
+                if ( hitMask & ( 1 << i ) )
+                {
+                    childMasks[ i ] |= 1u << r;
+                    childNears[ i ] = std::min( childNears[ i ], nears[ i ] );
+                }
+            }
+        }
+        
+        /* push the farthest child first so the nearest is popped first and shortens the rays early */
+        for ( i = 0; i < BVH_WIDTH; i++ )
+        {
+            for ( j = i; j > 0 && childNears[ order[ j - 1 ] ] < childNears[ i ]; j-- )
+            {
+                order[ j ] = order[ j - 1 ];
+            }
+            order[ j ] = i;
+        }
+        for ( i = 0; i < BVH_WIDTH; i++ )
+        {
+            j = order[ i ];
+            if ( childMasks[ j ] == 0 || node->children[ j ] == BVH_EMPTY_CHILD )
+            {
+                continue;
+            }
+            if ( sp >= BVH_STACK_SIZE )
+            {
+                Error( "TraceBVHPacket: BVH_STACK_SIZE (%d) exceeded", BVH_STACK_SIZE );
+            }
+            stack[ sp ] = node->children[ j ];
+            masks[ sp ] = childMasks[ j ];
+            sp++;
+        }
+    }
+}
+
+
+
+/*
+   TraceBVHCoherent()
+   returns qtrue if the rays point roughly the same way, spread out rays are cheaper traced one by one
+ */
+
+static qboolean TraceBVHCoherent( const traceBVHRay_t* rays, int numRays )
+{
+    int i;
+    vec3_t mean;
+    
+    
+    VectorClear( mean );
+    for ( i = 0; i < numRays; i++ )
+    {
+        VectorAdd( mean, rays[ i ].direction, mean );
+    }
+    VectorNormalize( mean, mean );
+    
+    for ( i = 0; i < numRays; i++ )
+    {
+        if ( DotProduct( mean, rays[ i ].direction ) < BVH_PACKET_COHERENCE )
+        {
+            return qfalse;
+        }
+    }
+    return qtrue;
+}
+
+
+
+/*
+   TraceBVHResolve()
+   applies the sky and filter hits in front of the nearest opaque hit in depth order
+ */
+
+static void TraceBVHResolve( traceBVHRay_t* ray )
+{
+    int i, j;
+    trace_t*         trace;
+    traceTriangle_t* tt;
+    shaderInfo_t*    si;
+    traceBVHHit_t hit;
+    
+    
+    /* sort the pending hits */
+    for ( i = 1; i < ray->numHits; i++ )
+    {
+        hit = ray->hits[ i ];
+        for ( j = i; j > 0 && ray->hits[ j - 1 ].depth > hit.depth; j-- )
+        {
+            ray->hits[ j ] = ray->hits[ j - 1 ];
+        }
+        ray->hits[ j ] = hit;
+    }
+    
+    /* walk them front to back */
+    trace = ray->trace;
+    for ( i = 0; i < ray->numHits && ray->hits[ i ].depth < ray->maxDepth; i++ )
+    {
+        tt = &traceTriangles[ ray->hits[ i ].triangleNum ];
+        si = traceInfos[ tt->infoNum ].si;
+        
+        /* stack compile flags */
+        trace->compileFlags |= si->compileFlags;
+        
+        /* don't trace against sky */
+        if ( si->compileFlags & C_SKY )
+        {
+            continue;
+        }
+        
+        /* filter the light through the texture */
+        if ( TraceTriangleFilter( si, tt, ray->hits[ i ].u, ray->hits[ i ].v, ray->hits[ i ].depth, trace ) )
+        {
+            return;
+        }
+    }
+    
+    /* nearest opaque hit */
+    if ( ray->opaqueTriangle >= 0 )
+    {
+        trace->compileFlags |= traceInfos[ traceTriangles[ ray->opaqueTriangle ].infoNum ].si->compileFlags;
+        VectorMA( trace->origin, ray->maxDepth, trace->direction, trace->hit );
+        VectorClear( trace->color );
+        trace->opaque = qtrue;
+    }
+}
+
+
+
+/*
+   TraceBVHSetupRay()
+   clears the trace output and traces it through the solid nodes
+   returns qfalse if that settled the trace, otherwise sets up a ray for the surfaces in front of the solid
+ */
+
+static qboolean TraceBVHSetupRay( trace_t* trace, traceBVHRay_t* ray )
+{
+    float solidDepth;
+    vec3_t displacement;
+    
+    
+    /* setup output (note: this code assumes the input data is completely filled out) */
+    trace->passSolid = qfalse;
+    trace->opaque = qfalse;
+    trace->compileFlags = 0;
+    trace->numTestNodes = 0;
+    
+    /* early outs */
+    if ( !trace->recvShadows || !trace->testOcclusion || trace->distance <= 0.00001f )
+    {
+        return qfalse;
+    }
+    
+    /* trace through solid nodes */
+    solidDepth = trace->distance;
+    if ( TraceSolid_r( solidHeadNodeNum, trace->origin, trace->end, trace ) )
+    {
+        if ( !trace->testAll )
+        {
+            trace->opaque = qtrue;
+            return qfalse;
+        }
+        
+        /* testall only sees surfaces in front of the solid */
+        VectorSubtract( trace->hit, trace->origin, displacement );
+        solidDepth = std::min( solidDepth, ( float )VectorLength( displacement ) );
+    }
+    
+    /* skip surfaces? */
+    if ( noSurfaces || numTraceBVHNodes == 0 )
+    {
+        return qfalse;
+    }
+    
+    /* setup ray */
+    ray->trace = trace;
+    VectorCopy( trace->origin, ray->origin );
+    VectorCopy( trace->direction, ray->direction );
+    ray->invDirection[ 0 ] = fabs( trace->direction[ 0 ] ) > 1.0e-12f ? 1.0f / trace->direction[ 0 ] : BVH_INFINITE_DISTANCE;
+    ray->invDirection[ 1 ] = fabs( trace->direction[ 1 ] ) > 1.0e-12f ? 1.0f / trace->direction[ 1 ] : BVH_INFINITE_DISTANCE;
+    ray->invDirection[ 2 ] = fabs( trace->direction[ 2 ] ) > 1.0e-12f ? 1.0f / trace->direction[ 2 ] : BVH_INFINITE_DISTANCE;
+    ray->minDepth = trace->inhibitRadius;
+    ray->maxDepth = solidDepth;
+    ray->opaqueTriangle = -1;
+    ray->numHits = 0;
+    ray->maxHits = MAX_BVH_HITS;
+    ray->hits = ray->localHits;
+    return qtrue;
+}
+
+
+
+/*
+   TraceBVHFinishRay()
+   resolves the hits of a traced ray and frees them
+ */
+
+static void TraceBVHFinishRay( traceBVHRay_t* ray )
+{
+    TraceBVHResolve( ray );
+    if ( ray->hits != ray->localHits )
+    {
+        free( ray->hits );
+    }
+}
+
+
+
+/*
+   TraceLinePacket()
+   traces a bundle of traces, ideally sharing an origin or a target, through the bvh together
+   every trace must be filled out as for TraceLine
+ */
+
+void TraceLinePacket( trace_t* traces, int numTraces )
+{
+    int i, j, numRays;
+    traceBVHRay_t rays[ TRACE_PACKET_SIZE ];
+    
+    
+    /* no bvh, trace them one by one */
+    if ( noTraceBVH )
+    {
+        for ( i = 0; i < numTraces; i++ )
+        {
+            TraceLineNodes( &traces[ i ] );
+        }
+        return;
+    }
+    
+    for ( i = 0; i < numTraces; i += TRACE_PACKET_SIZE )
+    {
+        numRays = 0;
+        for ( j = i; j < numTraces && j < i + TRACE_PACKET_SIZE; j++ )
+        {
+            if ( TraceBVHSetupRay( &traces[ j ], &rays[ numRays ] ) )
+            {
+                numRays++;
+            }
+        }
+        
+        /* trace the packet */
+        if ( numRays > 1 && TraceBVHCoherent( rays, numRays ) )
+        {
+            TraceBVHPacket( rays, numRays );
+        }
+        else
+        {
+            for ( j = 0; j < numRays; j++ )
+            {
+                TraceBVHRay( &rays[ j ] );
+            }
+        }
+        for ( j = 0; j < numRays; j++ )
+        {
+            TraceBVHFinishRay( &rays[ j ] );
+        }
+    }
+}
+
+
+
+/*
+   TraceLine() - ydnar
+   traces a single line through the bvh, or the node tree with -nobvh
+ */
+
+void TraceLine( trace_t* trace )
+{
+    if ( noTraceBVH )
+    {
+        TraceLineNodes( trace );
+        return;
+    }
+    TraceLinePacket( trace, 1 );
+}
+
+
+
+/*
+   TraceBenchmark()
+   times the node tree against the bvh on random bundles of rays and checks both against every triangle
+ */
+
+static inline float TraceBenchRandom( unsigned int* seed )
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return ( *seed >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+static void TraceBenchPoint( unsigned int* seed, float* out )
+{
+    int i, attempt;
+    float a, b, side;
+    vec3_t point, normal;
+    traceTriangle_t* tt;
+    
+    
+    /* pick a point just off the open side of a triangle */
+    for ( attempt = 0; attempt < 64; attempt++ )
+    {
+        tt = &traceTriangles[ ( int )( TraceBenchRandom( seed ) * numTraceTriangles ) % numTraceTriangles ];
+        a = TraceBenchRandom( seed );
+        b = TraceBenchRandom( seed );
+        if ( a + b > 1.0f )
+        {
+            a = 1.0f - a;
+            b = 1.0f - b;
+        }
+        for ( i = 0; i < 3; i++ )
+        {
+            point[ i ] = tt->v[ 0 ].xyz[ i ] + a * tt->edge1[ i ] + b * tt->edge2[ i ];
+        }
+        CrossProduct( tt->edge1, tt->edge2, normal );
+        VectorNormalize( normal, normal );
+        
+        for ( side = 1.0f; side >= -1.0f; side -= 2.0f )
+        {
+            VectorMA( point, side, normal, out );
+            if ( ClusterForPoint( out ) >= 0 )
+            {
+                return;
+            }
+        }
+    }
+}
+
+/*
+   TraceLineEveryTriangle()
+   the reference for TraceBenchmark, tests the ray against every bvh leaf instead of walking the bvh
+ */
+
+static void TraceLineEveryTriangle( trace_t* trace )
+{
+    int i;
+    traceBVHRay_t ray;
+    
+    
+    if ( !TraceBVHSetupRay( trace, &ray ) )
+    {
+        return;
+    }
+    for ( i = 0; i < numTraceBVHLeaves; i++ )
+    {
+        TraceBVHLeaf( &traceBVHLeaves[ i ], &ray );
+    }
+    TraceBVHFinishRay( &ray );
+}
+
+void TraceBenchmark( void )
+{
+    int i, j, k, set, pass, numRays, numMismatches, numBothOpaque;
+    unsigned int seed;
+    float error, depthError, maxDepthError;
+    double seconds;
+    vec3_t displacement;
+    std::vector<float> points;
+    std::vector<float> depths[ 4 ];
+    trace_t*         trace;
+    trace_t packet[ TRACE_PACKET_SIZE ];
+    std::chrono::steady_clock::time_point start;
+    static const char* setNames[ 2 ] = { "bundles from one point (dirt, floodlight)", "bundles to one point (luxels to a light)" };
+    static const char* passNames[ 4 ] = { "node tree", "bvh", "bvh packets", "every triangle" };
+    
+    
+    /* note it */
+    Sys_Printf( "--- TraceBenchmark ---\n" );
+    if ( numTraceTriangles == 0 || noTraceBVH )
+    {
+        Sys_Printf( "no trace triangles or bvh to benchmark\n" );
+        return;
+    }
+    
+    /* setup the traces */
+    memset( packet, 0, sizeof( packet ) );
+    for ( i = 0; i < TRACE_PACKET_SIZE; i++ )
+    {
+        packet[ i ].testOcclusion = qtrue;
+        packet[ i ].recvShadows = 1;
+    }
+    
+    numRays = TRACE_BENCH_RAYS;
+    points.resize( numRays * 6 );
+    Sys_Printf( "%9d rays in bundles of %d\n", numRays, TRACE_PACKET_SIZE );
+    
+    for ( set = 0; set < 2; set++ )
+    {
+        /* one shared point and one random point per ray, luxel origins are jittered around theirs */
+        seed = 1;
+        for ( i = 0; i < numRays; i++ )
+        {
+            if ( ( i % TRACE_PACKET_SIZE ) == 0 )
+            {
+                TraceBenchPoint( &seed, &points[ i * 6 + set * 3 ] );
+            }
+            else
+            {
+                VectorCopy( &points[ ( i - 1 ) * 6 + set * 3 ], &points[ i * 6 + set * 3 ] );
+            }
+            
+            if ( set == 0 )
+            {
+                TraceBenchPoint( &seed, &points[ i * 6 + 3 ] );
+            }
+            else
+            {
+                TraceBenchPoint( &seed, &points[ i * 6 ] );
+                if ( ( i % TRACE_PACKET_SIZE ) != 0 )
+                {
+                    for ( j = 0; j < 3; j++ )
+                    {
+                        points[ i * 6 + j ] = points[ ( i - ( i % TRACE_PACKET_SIZE ) ) * 6 + j ] + ( TraceBenchRandom( &seed ) - 0.5f ) * 8.0f;
+                    }
+                }
+            }
+        }
+        
+        /* node tree, bvh one ray at a time, bvh packets, then the reference */
+        Sys_Printf( "%s\n", setNames[ set ] );
+        for ( pass = 0; pass < 4; pass++ )
+        {
+            depths[ pass ].resize( numRays );
+            start = std::chrono::steady_clock::now();
+            for ( i = 0; i < numRays; i += TRACE_PACKET_SIZE )
+            {
+                for ( j = 0; j < TRACE_PACKET_SIZE && i + j < numRays; j++ )
+                {
+                    trace = &packet[ j ];
+                    VectorCopy( &points[ ( i + j ) * 6 ], trace->origin );
+                    VectorCopy( &points[ ( i + j ) * 6 + 3 ], trace->end );
+                    SetupTrace( trace );
+                    VectorSet( trace->color, 1.0f, 1.0f, 1.0f );
+                    
+                    if ( pass == 0 )
+                    {
+                        TraceLineNodes( trace );
+                    }
+                    else if ( pass == 1 )
+                    {
+                        TraceLinePacket( trace, 1 );
+                    }
+                    else if ( pass == 3 )
+                    {
+                        TraceLineEveryTriangle( trace );
+                    }
+                }
+                if ( pass == 2 )
+                {
+                    TraceLinePacket( packet, j );
+                }
+                
+                /* record the hit depth, negative for clear */
+                for ( k = 0; k < j; k++ )
+                {
+                    VectorSubtract( packet[ k ].hit, packet[ k ].origin, displacement );
+                    depths[ pass ][ i + k ] = packet[ k ].opaque ? ( float )VectorLength( displacement ) : -1.0f;
+                }
+            }
+            seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            Sys_Printf( "%9.0f rays/sec %s\n", numRays / std::max( seconds, 1.0e-9 ), passNames[ pass ] );
+        }
+        
+        /* compare each pass with the reference, the node tree only tests the triangles
+           clipped into the leafs its plane walk visits so it misses a few the ray crosses */
+        for ( pass = 0; pass < 3; pass++ )
+        {
+            numMismatches = 0;
+            numBothOpaque = 0;
+            depthError = 0.0f;
+            maxDepthError = 0.0f;
+            for ( i = 0; i < numRays; i++ )
+            {
+                if ( ( depths[ pass ][ i ] < 0.0f ) != ( depths[ 3 ][ i ] < 0.0f ) )
+                {
+                    numMismatches++;
+                }
+                else if ( depths[ 3 ][ i ] >= 0.0f )
+                {
+                    numBothOpaque++;
+                    error = fabs( depths[ pass ][ i ] - depths[ 3 ][ i ] );
+                    depthError += error;
+                    maxDepthError = std::max( maxDepthError, error );
+                }
+            }
+            Sys_Printf( "%9d occlusion mismatches (%.3f%%), %.3f mean and %.3f max hit distance error, %s\n", numMismatches, 100.0f * numMismatches / numRays,
+                        numBothOpaque ? depthError / numBothOpaque : 0.0f, maxDepthError, passNames[ pass ] );
+        }
+    }
+}
+
+
+
 float SetupTrace( trace_t* trace )
 {
     VectorSubtract( trace->end, trace->origin, trace->displacement );
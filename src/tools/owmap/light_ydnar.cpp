@@ -1556,9 +1556,10 @@ void SetupDirt( void )
 
 float DirtForSample( trace_t* trace )
 {
-    int i;
+    int i, j, numPacket;
     float gatherDirt, outDirt, angle, elevation, ooDepth;
     vec3_t normal, worldUp, myUp, myRt, temp, direction, displacement;
+    trace_t packet[ TRACE_PACKET_SIZE ];
     
     
     /* dummy check */
@@ -1599,76 +1600,67 @@ float DirtForSample( trace_t* trace )
         VectorNormalize( myUp, myUp );
     }
     
-    /* 1 = random mode, 0 (well everything else) = non-random mode */
-    if ( dirtMode == 1 )
+    /* 1 = random mode, 0 (well everything else) = non-random mode, the last ray is the direct one */
+    for ( i = 0; i <= numDirtVectors; i += numPacket )
     {
-        /* iterate */
-        for ( i = 0; i < numDirtVectors; i++ )
+        numPacket = numDirtVectors + 1 - i;
+        if ( numPacket > TRACE_PACKET_SIZE )
         {
-            /* get random vector */
-            angle = Random() * DEG2RAD( 360.0f );
-            elevation = Random() * DEG2RAD( DIRT_CONE_ANGLE );
-            temp[ 0 ] = cos( angle ) * sin( elevation );
-            temp[ 1 ] = sin( angle ) * sin( elevation );
-            temp[ 2 ] = cos( elevation );
-            
-            /* transform into tangent space */
-            direction[ 0 ] = myRt[ 0 ] * temp[ 0 ] + myUp[ 0 ] * temp[ 1 ] + normal[ 0 ] * temp[ 2 ];
-            direction[ 1 ] = myRt[ 1 ] * temp[ 0 ] + myUp[ 1 ] * temp[ 1 ] + normal[ 1 ] * temp[ 2 ];
-            direction[ 2 ] = myRt[ 2 ] * temp[ 0 ] + myUp[ 2 ] * temp[ 1 ] + normal[ 2 ] * temp[ 2 ];
+            numPacket = TRACE_PACKET_SIZE;
+        }
+        
+        for ( j = 0; j < numPacket; j++ )
+        {
+            /* direct ray */
+            if ( i + j == numDirtVectors )
+            {
+                VectorCopy( normal, direction );
+            }
             
-            /* set endpoint */
-            VectorMA( trace->origin, dirtDepth, direction, trace->end );
-            SetupTrace( trace );
-            VectorSet( trace->color, 1.0f, 1.0f, 1.0f );
+            /* get random vector */
+            else if ( dirtMode == 1 )
+            {
+                angle = Random() * DEG2RAD( 360.0f );
+                elevation = Random() * DEG2RAD( DIRT_CONE_ANGLE );
+                temp[ 0 ] = cos( angle ) * sin( elevation );
+                temp[ 1 ] = sin( angle ) * sin( elevation );
+                temp[ 2 ] = cos( elevation );
+                
+                /* transform into tangent space */
+                direction[ 0 ] = myRt[ 0 ] * temp[ 0 ] + myUp[ 0 ] * temp[ 1 ] + normal[ 0 ] * temp[ 2 ];
+                direction[ 1 ] = myRt[ 1 ] * temp[ 0 ] + myUp[ 1 ] * temp[ 1 ] + normal[ 1 ] * temp[ 2 ];
+                direction[ 2 ] = myRt[ 2 ] * temp[ 0 ] + myUp[ 2 ] * temp[ 1 ] + normal[ 2 ] * temp[ 2 ];
+            }
             
-            /* trace */
-            TraceLine( trace );
-            if ( trace->opaque && !( trace->compileFlags & C_SKY ) )
+            /* transform ordered vector into tangent space */
+            else
             {
-                VectorSubtract( trace->hit, trace->origin, displacement );
-                gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
+                direction[ 0 ] = myRt[ 0 ] * dirtVectors[ i + j ][ 0 ] + myUp[ 0 ] * dirtVectors[ i + j ][ 1 ] + normal[ 0 ] * dirtVectors[ i + j ][ 2 ];
+                direction[ 1 ] = myRt[ 1 ] * dirtVectors[ i + j ][ 0 ] + myUp[ 1 ] * dirtVectors[ i + j ][ 1 ] + normal[ 1 ] * dirtVectors[ i + j ][ 2 ];
+                direction[ 2 ] = myRt[ 2 ] * dirtVectors[ i + j ][ 0 ] + myUp[ 2 ] * dirtVectors[ i + j ][ 1 ] + normal[ 2 ] * dirtVectors[ i + j ][ 2 ];
             }
-        }
-    }
-    else
-    {
-        /* iterate through ordered vectors */
-        for ( i = 0; i < numDirtVectors; i++ )
-        {
-            /* transform vector into tangent space */
-            direction[ 0 ] = myRt[ 0 ] * dirtVectors[ i ][ 0 ] + myUp[ 0 ] * dirtVectors[ i ][ 1 ] + normal[ 0 ] * dirtVectors[ i ][ 2 ];
-            direction[ 1 ] = myRt[ 1 ] * dirtVectors[ i ][ 0 ] + myUp[ 1 ] * dirtVectors[ i ][ 1 ] + normal[ 1 ] * dirtVectors[ i ][ 2 ];
-            direction[ 2 ] = myRt[ 2 ] * dirtVectors[ i ][ 0 ] + myUp[ 2 ] * dirtVectors[ i ][ 1 ] + normal[ 2 ] * dirtVectors[ i ][ 2 ];
             
             /* set endpoint */
-            VectorMA( trace->origin, dirtDepth, direction, trace->end );
-            SetupTrace( trace );
-            VectorSet( trace->color, 1.0f, 1.0f, 1.0f );
-            
-            /* trace */
-            TraceLine( trace );
-            if ( trace->opaque )
+            packet[ j ] = *trace;
+            VectorMA( trace->origin, dirtDepth, direction, packet[ j ].end );
+            SetupTrace( &packet[ j ] );
+            VectorSet( packet[ j ].color, 1.0f, 1.0f, 1.0f );
+        }
+        
+        /* trace the whole bundle at once, it shares one origin */
+        TraceLinePacket( packet, numPacket );
+        
+        for ( j = 0; j < numPacket; j++ )
+        {
+            /* random rays that reach the sky aren't dirt */
+            if ( packet[ j ].opaque && ( dirtMode != 1 || i + j == numDirtVectors || !( packet[ j ].compileFlags & C_SKY ) ) )
             {
-                VectorSubtract( trace->hit, trace->origin, displacement );
+                VectorSubtract( packet[ j ].hit, packet[ j ].origin, displacement );
                 gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
             }
         }
     }
     
-    /* direct ray */
-    VectorMA( trace->origin, dirtDepth, normal, trace->end );
-    SetupTrace( trace );
-    VectorSet( trace->color, 1.0f, 1.0f, 1.0f );
-    
-    /* trace */
-    TraceLine( trace );
-    if ( trace->opaque )
-    {
-        VectorSubtract( trace->hit, trace->origin, displacement );
-        gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
-    }
-    
     /* early out */
     if ( gatherDirt <= 0.0f )
     {
@@ -1716,6 +1708,12 @@ void DirtyRawLightmap( int rawLightmapNum )
         return;
     }
     
+    /* -incremental: restored from the light cache */
+    if ( RawLightmapReused( rawLightmapNum ) )
+    {
+        return;
+    }
+    
     /* get lightmap */
     lm = &rawLightmaps[ rawLightmapNum ];
     
@@ -2151,6 +2149,66 @@ static void RandomSubsampleRawLuxel( rawLightmap_t* lm, trace_t* trace, vec3_t s
 
 
 
+/*
+   StoreLightContribution()
+   copies a finished light contribution into the per-light luxel, returns qtrue if it lit the luxel
+ */
+
+static qboolean StoreLightContribution( trace_t* trace, float* lightLuxel, float* lightDeluxel, unsigned char* flag )
+{
+    VectorCopy( trace->color, lightLuxel );
+    
+    /* add the contribution to the deluxemap */
+    if ( deluxemap )
+    {
+        VectorCopy( trace->directionContribution, lightDeluxel );
+    }
+    
+    /* check for evilness */
+    if ( trace->forceSubsampling > 1.0f && ( lightSamples > 1 || lightRandomSamples ) )
+    {
+        *flag |= FLAG_FORCE_SUBSAMPLING; /* force */
+        return qtrue;
+    }
+    
+    /* add to count */
+    return ( trace->color[ 0 ] || trace->color[ 1 ] || trace->color[ 2 ] ) ? qtrue : qfalse;
+}
+
+
+
+/*
+   FlushLightPacket()
+   traces the deferred samples of a luxel packet together and stores them, returns the number of lit luxels
+ */
+
+static int FlushLightPacket( trace_t* packet, int numPacket, float** lightLuxels, float** lightDeluxels, unsigned char** flags )
+{
+    int i, lighted;
+    
+    
+    if ( numPacket <= 0 )
+    {
+        return 0;
+    }
+    
+    TraceLinePacket( packet, numPacket );
+    
+    lighted = 0;
+    for ( i = 0; i < numPacket; i++ )
+    {
+        FinishLightContribution( &packet[ i ] );
+        if ( StoreLightContribution( &packet[ i ], lightLuxels[ i ], lightDeluxels[ i ], flags[ i ] ) )
+        {
+            lighted++;
+        }
+    }
+    
+    return lighted;
+}
+
+
+
 /*
    IlluminateRawLightmap()
    illuminates the luxels
@@ -2176,6 +2234,10 @@ void IlluminateRawLightmap( int rawLightmapNum )
     float tests[ 4 ][ 2 ] = { { 0.0f, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
     trace_t trace;
     float stackLightLuxels[ STACK_LL_SIZE ];
+    int numPacket;
+    trace_t packet[ TRACE_PACKET_SIZE ];
+    float*               packetLuxels[ TRACE_PACKET_SIZE ], *packetDeluxels[ TRACE_PACKET_SIZE ];
+    unsigned char*           packetFlags[ TRACE_PACKET_SIZE ];
     
     
     /* bail if this number exceeds the number of raw lightmaps */
@@ -2184,6 +2246,12 @@ void IlluminateRawLightmap( int rawLightmapNum )
         return;
     }
     
+    /* -incremental: restored from the light cache */
+    if ( RawLightmapReused( rawLightmapNum ) )
+    {
+        return;
+    }
+    
     /* get lightmap */
     lm = &rawLightmaps[ rawLightmapNum ];
     
@@ -2427,6 +2495,13 @@ void IlluminateRawLightmap( int rawLightmapNum )
                 memset( ( void* ) lm->superFlags, 0, size );
             }
             
+            /* every packet slot starts out as a copy of the light's trace */
+            for ( numPacket = 0; numPacket < TRACE_PACKET_SIZE; numPacket++ )
+            {
+                packet[ numPacket ] = trace;
+            }
+            numPacket = 0;
+            
             /* initial pass, one sample per luxel */
             for ( y = 0; y < lm->sh; y++ )
             {
@@ -2461,35 +2536,37 @@ void IlluminateRawLightmap( int rawLightmapNum )
                         lightLuxel[ 3 ] = 1.0f;
                         
                         /* setup trace */
-                        trace.cluster = *cluster;
-                        VectorCopy( origin, trace.origin );
-                        VectorCopy( normal, trace.normal );
-                        
-                        /* get light for this sample */
-                        LightContributionToSample( &trace );
-                        VectorCopy( trace.color, lightLuxel );
+                        packet[ numPacket ].cluster = *cluster;
+                        VectorCopy( origin, packet[ numPacket ].origin );
+                        VectorCopy( normal, packet[ numPacket ].normal );
                         
-                        /* add the contribution to the deluxemap */
-                        if ( deluxemap )
+                        /* get light for this sample, occlusion tests are traced a packet at a time */
+                        if ( LightContributionToSampleDeferred( &packet[ numPacket ] ) != LIGHT_CONTRIBUTION_DEFERRED )
                         {
-                            VectorCopy( trace.directionContribution, lightDeluxel );
+                            if ( StoreLightContribution( &packet[ numPacket ], lightLuxel, lightDeluxel, flag ) )
+                            {
+                                totalLighted++;
+                            }
+                            continue;
                         }
                         
-                        /* check for evilness */
-                        if ( trace.forceSubsampling > 1.0f && ( lightSamples > 1 || lightRandomSamples ) )
-                        {
-                            totalLighted++;
-                            *flag |= FLAG_FORCE_SUBSAMPLING; /* force */
-                        }
-                        /* add to count */
-                        else if ( trace.color[ 0 ] || trace.color[ 1 ] || trace.color[ 2 ] )
+                        packetLuxels[ numPacket ] = lightLuxel;
+                        packetDeluxels[ numPacket ] = lightDeluxel;
+                        packetFlags[ numPacket ] = flag;
+                        numPacket++;
+                        
+                        if ( numPacket == TRACE_PACKET_SIZE )
                         {
-                            totalLighted++;
+                            totalLighted += FlushLightPacket( packet, numPacket, packetLuxels, packetDeluxels, packetFlags );
+                            numPacket = 0;
                         }
                     }
                 }
             }
             
+            /* trace what is left of the last packet */
+            totalLighted += FlushLightPacket( packet, numPacket, packetLuxels, packetDeluxels, packetFlags );
+            
             /* don't even bother with everything else if nothing was lit */
             if ( totalLighted == 0 )
             {
@@ -4571,7 +4648,7 @@ void SetupFloodLight( void )
 
 float FloodLightForSample( trace_t* trace, float floodLightDistance, qboolean floodLightLowQuality )
 {
-    int i;
+    int i, j, numPacket;
     float d;
     float contribution;
     int sub = 0;
@@ -4579,6 +4656,7 @@ float FloodLightForSample( trace_t* trace, float floodLightDistance, qboolean fl
     vec3_t normal, worldUp, myUp, myRt, direction, displacement;
     float dd;
     int vecs = 0;
+    trace_t packet[ TRACE_PACKET_SIZE ];
     
     gatherLight = 0;
     /* dummy check */
@@ -4629,48 +4707,63 @@ float FloodLightForSample( trace_t* trace, float floodLightDistance, qboolean fl
     }
     else
     {
-        /* iterate through ordered vectors */
-        for ( i = 0; i < numFloodVectors; i++ )
+        /* iterate through ordered vectors, a packet at a time */
+        for ( i = 0; i < numFloodVectors; i += numPacket )
         {
-            vecs++;
-            
-            /* transform vector into tangent space */
-            direction[ 0 ] = myRt[ 0 ] * floodVectors[ i ][ 0 ] + myUp[ 0 ] * floodVectors[ i ][ 1 ] + normal[ 0 ] * floodVectors[ i ][ 2 ];
-            direction[ 1 ] = myRt[ 1 ] * floodVectors[ i ][ 0 ] + myUp[ 1 ] * floodVectors[ i ][ 1 ] + normal[ 1 ] * floodVectors[ i ][ 2 ];
-            direction[ 2 ] = myRt[ 2 ] * floodVectors[ i ][ 0 ] + myUp[ 2 ] * floodVectors[ i ][ 1 ] + normal[ 2 ] * floodVectors[ i ][ 2 ];
-            
-            /* set endpoint */
-            VectorMA( trace->origin, dd, direction, trace->end );
+            numPacket = numFloodVectors - i;
+            if ( numPacket > TRACE_PACKET_SIZE )
+            {
+                numPacket = TRACE_PACKET_SIZE;
+            }
             
-            //VectorMA( trace->origin, 1, direction, trace->origin );
+            for ( j = 0; j < numPacket; j++ )
+            {
+                vecs++;
+                
+                /* transform vector into tangent space */
+                direction[ 0 ] = myRt[ 0 ] * floodVectors[ i + j ][ 0 ] + myUp[ 0 ] * floodVectors[ i + j ][ 1 ] + normal[ 0 ] * floodVectors[ i + j ][ 2 ];
+                direction[ 1 ] = myRt[ 1 ] * floodVectors[ i + j ][ 0 ] + myUp[ 1 ] * floodVectors[ i + j ][ 1 ] + normal[ 1 ] * floodVectors[ i + j ][ 2 ];
+                direction[ 2 ] = myRt[ 2 ] * floodVectors[ i + j ][ 0 ] + myUp[ 2 ] * floodVectors[ i + j ][ 1 ] + normal[ 2 ] * floodVectors[ i + j ][ 2 ];
+                
+                /* set endpoint */
+                packet[ j ] = *trace;
+                VectorMA( trace->origin, dd, direction, packet[ j ].end );
+                
+                //VectorMA( trace->origin, 1, direction, trace->origin );
+                
+                SetupTrace( &packet[ j ] );
+                VectorSet( packet[ j ].color, 1.0f, 1.0f, 1.0f );
+            }
             
-            SetupTrace( trace );
-            VectorSet( trace->color, 1.0f, 1.0f, 1.0f );
             /* trace */
-            TraceLine( trace );
-            contribution = 1;
+            TraceLinePacket( packet, numPacket );
             
-            if ( trace->compileFlags & C_SKY || trace->compileFlags & C_TRANSLUCENT )
+            for ( j = 0; j < numPacket; j++ )
             {
-                contribution = 1.0f;
-            }
-            else if ( trace->opaque )
-            {
-                VectorSubtract( trace->hit, trace->origin, displacement );
-                d = VectorLength( displacement );
+                contribution = 1;
                 
-                // d=trace->distance;
-                //if (d>256) gatherDirt+=1;
-                contribution = d / dd;
-                if ( contribution > 1 )
+                if ( packet[ j ].compileFlags & C_SKY || packet[ j ].compileFlags & C_TRANSLUCENT )
                 {
                     contribution = 1.0f;
                 }
+                else if ( packet[ j ].opaque )
+                {
+                    VectorSubtract( packet[ j ].hit, packet[ j ].origin, displacement );
+                    d = VectorLength( displacement );
+                    
+                    // d=trace->distance;
+                    //if (d>256) gatherDirt+=1;
+                    contribution = d / dd;
+                    if ( contribution > 1 )
+                    {
+                        contribution = 1.0f;
+                    }
+                    
+                    //gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
+                }
                 
-                //gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
+                gatherLight += contribution;
             }
-            
-            gatherLight += contribution;
         }
     }
     
@@ -4853,6 +4946,13 @@ void FloodLightRawLightmap( int rawLightmapNum )
     {
         return;
     }
+    
+    /* -incremental: restored from the light cache */
+    if ( RawLightmapReused( rawLightmapNum ) )
+    {
+        return;
+    }
+    
     /* get lightmap */
     lm = &rawLightmaps[ rawLightmapNum ];
     
@@ -4879,7 +4979,7 @@ void FloodlightRawLightmaps()
     
     Sys_Printf( "--- FloodlightRawLightmap ---\n" );
     numSurfacesFloodlighten = 0;
-    RunThreadsOnIndividual( numRawLightmaps, qtrue, FloodLightRawLightmap );
+    RunThreadsOnIndividualByCost( numRawLightmaps, qtrue, FloodLightRawLightmap, RawLightmapCost );
     Sys_Printf( "%9d custom lightmaps floodlighted\n", numSurfacesFloodlighten );
 }
 
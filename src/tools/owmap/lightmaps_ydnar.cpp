@@ -1037,6 +1037,18 @@ static int CompareSurfaceInfo( const void* a, const void* b )
 
 
 
+/*
+   RawLightmapCost()
+   luxel count of a raw lightmap, the per-lightmap passes are started biggest first
+ */
+
+int RawLightmapCost( int num )
+{
+    return rawLightmaps[ num ].sw * rawLightmaps[ num ].sh;
+}
+
+
+
 /*
    SetupSurfaceLightmaps()
    allocates lightmaps for every surface in the bsp that needs one
@@ -2045,34 +2057,71 @@ static qboolean ApproximateLightmap( rawLightmap_t* lm )
 
 
 /*
-   TestOutLightmapStamp()
-   tests a stamp on a given lightmap for validity
+   lightmap stamps
+   the used luxels of a surface lightmap as offsets from its corner. placements
+   are tested STAMP_SPAN origins along a row at once: every luxel is a single
+   unaligned read of lightBits covering that luxel for all the origins, and the
+   test stops as soon as all of them are blocked
+ */
+
+#define STAMP_SPAN              32
+
+typedef struct lightmapStamp_s
+{
+    int w, h;
+    std::vector<int> luxelX, luxelY;    /* used luxels in row order */
+    std::vector<int> rowLuxels;         /* [h] */
+}
+lightmapStamp_t;
+
+
+
+/*
+   LightBitsAt()
+   reads the 57 or more lightBits starting at a bit offset
  */
 
-static qboolean TestOutLightmapStamp( rawLightmap_t* lm, int lightmapNum, outLightmap_t* olm, int x, int y )
+static inline uint64_t LightBitsAt( const byte* lightBits, int offset )
 {
-    int sx, sy, ox, oy, offset;
+    const byte* b = lightBits + ( offset >> 3 );
+    uint64_t bits;
+    
+    
+    bits = ( uint64_t ) b[ 0 ] | ( ( uint64_t ) b[ 1 ] << 8 ) | ( ( uint64_t ) b[ 2 ] << 16 ) | ( ( uint64_t ) b[ 3 ] << 24 ) |
+           ( ( uint64_t ) b[ 4 ] << 32 ) | ( ( uint64_t ) b[ 5 ] << 40 ) | ( ( uint64_t ) b[ 6 ] << 48 ) | ( ( uint64_t ) b[ 7 ] << 56 );
+    return bits >> ( offset & 7 );
+}
+
+
+
+/*
+   SetupLightmapStamp()
+   collects the used luxels of a surface lightmap
+ */
+
+static void SetupLightmapStamp( rawLightmap_t* lm, int lightmapNum, lightmapStamp_t* stamp )
+{
+    int sx, sy;
     float*       luxel;
     
     
-    /* bounds check */
-    if ( x < 0 || y < 0 || ( x + lm->w ) > olm->customWidth || ( y + lm->h ) > olm->customHeight )
-    {
-        return qfalse;
-    }
+    stamp->luxelX.clear();
+    stamp->luxelY.clear();
     
-    /* solid lightmaps test a 1x1 stamp */
+    /* solid lightmaps use a 1x1 stamp */
     if ( lm->solid[ lightmapNum ] )
     {
-        offset = ( y * olm->customWidth ) + x;
-        if ( olm->lightBits[ offset >> 3 ] & ( 1 << ( offset & 7 ) ) )
-        {
-            return qfalse;
-        }
-        return qtrue;
+        stamp->w = 1;
+        stamp->h = 1;
+        stamp->luxelX.push_back( 0 );
+        stamp->luxelY.push_back( 0 );
+        stamp->rowLuxels.assign( 1, 1 );
+        return;
     }
     
-    /* test the stamp */
+    stamp->w = lm->w;
+    stamp->h = lm->h;
+    stamp->rowLuxels.assign( lm->h, 0 );
     for ( sy = 0; sy < lm->h; sy++ )
     {
         for ( sx = 0; sx < lm->w; sx++ )
@@ -2084,23 +2133,86 @@ static qboolean TestOutLightmapStamp( rawLightmap_t* lm, int lightmapNum, outLig
                 continue;
             }
             
-            /* get bsp lightmap coords and test */
-            ox = x + sx;
-            oy = y + sy;
-            offset = ( oy * olm->customWidth ) + ox;
-            if ( olm->lightBits[ offset >> 3 ] & ( 1 << ( offset & 7 ) ) )
-            {
-                return qfalse;
-            }
+            stamp->luxelX.push_back( sx );
+            stamp->luxelY.push_back( sy );
+            stamp->rowLuxels[ sy ]++;
+        }
+    }
+}
+
+
+
+/*
+   TestOutLightmapRows()
+   quick reject for a row of origins, every stamp row needs at least as many free luxels in the row it lands on
+ */
+
+static qboolean TestOutLightmapRows( const lightmapStamp_t* stamp, outLightmap_t* olm, int y )
+{
+    int sy;
+    
+    
+    for ( sy = 0; sy < stamp->h && y + sy < olm->customHeight; sy++ )
+    {
+        if ( olm->rowFreeLuxels[ y + sy ] < stamp->rowLuxels[ sy ] )
+        {
+            return qfalse;
         }
     }
     
-    /* stamp is empty */
     return qtrue;
 }
 
 
 
+/*
+   TestOutLightmapSpan()
+   tests the stamp at count ( up to STAMP_SPAN ) origins starting at x, y, which
+   must all be in bounds. returns a mask of the origins where the stamp is empty
+ */
+
+static uint32_t TestOutLightmapSpan( const lightmapStamp_t* stamp, outLightmap_t* olm, int x, int y, int count )
+{
+    int i, numLuxels;
+    uint32_t all, blocked;
+    
+    
+    all = count >= STAMP_SPAN ? 0xFFFFFFFFu : ( 1u << count ) - 1;
+    blocked = 0;
+    numLuxels = stamp->luxelX.size();
+    for ( i = 0; i < numLuxels; i++ )
+    {
+        blocked |= ( uint32_t ) LightBitsAt( olm->lightBits, ( ( y + stamp->luxelY[ i ] ) * olm->customWidth ) + x + stamp->luxelX[ i ] );
+        if ( ( blocked & all ) == all )
+        {
+            return 0;
+        }
+    }
+    
+    return ~blocked & all;
+}
+
+
+
+/*
+   TestOutLightmapStamp()
+   tests a stamp on a given lightmap for validity
+ */
+
+static qboolean TestOutLightmapStamp( rawLightmap_t* lm, const lightmapStamp_t* stamp, outLightmap_t* olm, int x, int y )
+{
+    /* bounds check */
+    if ( x < 0 || y < 0 || ( x + lm->w ) > olm->customWidth || ( y + lm->h ) > olm->customHeight )
+    {
+        return qfalse;
+    }
+    
+    /* test the stamp */
+    return TestOutLightmapSpan( stamp, olm, x, y, 1 ) ? qtrue : qfalse;
+}
+
+
+
 /*
    SetupOutLightmap()
    sets up an output lightmap
@@ -2108,6 +2220,9 @@ static qboolean TestOutLightmapStamp( rawLightmap_t* lm, int lightmapNum, outLig
 
 static void SetupOutLightmap( rawLightmap_t* lm, outLightmap_t* olm )
 {
+    int i;
+    
+    
     /* dummy check */
     if ( lm == NULL || olm == NULL )
     {
@@ -2139,6 +2254,11 @@ static void SetupOutLightmap( rawLightmap_t* lm, outLightmap_t* olm )
     olm->customWidth = lm->customWidth;
     olm->customHeight = lm->customHeight;
     olm->freeLuxels = olm->customWidth * olm->customHeight;
+    olm->rowFreeLuxels = static_cast<int*>( safe_malloc( olm->customHeight * sizeof( int ) ) );
+    for ( i = 0; i < olm->customHeight; i++ )
+    {
+        olm->rowFreeLuxels[ i ] = olm->customWidth;
+    }
     olm->numShaders = 0;
     
     /* allocate buffers */
@@ -2180,6 +2300,8 @@ static void FindOutLightmaps( rawLightmap_t* lm )
     float* HDRpixel;
     qboolean ok;
     int xIncrement, yIncrement;
+    uint32_t span;
+    static lightmapStamp_t stamp;
     
     
     /* set default lightmap number (-3 = LIGHTMAP_BY_VERTEX) */
@@ -2207,6 +2329,8 @@ static void FindOutLightmaps( rawLightmap_t* lm )
             continue;
         }
         
+        SetupLightmapStamp( lm, lightmapNum, &stamp );
+        
         /* if this is a styled lightmap, try some normalized locations first */
         ok = qfalse;
         if ( lightmapNum > 0 && outLightmaps != NULL )
@@ -2238,7 +2362,7 @@ static void FindOutLightmaps( rawLightmap_t* lm )
                     {
                         x = lm->lightmapX[ 0 ];
                         y = lm->lightmapY[ 0 ];
-                        ok = TestOutLightmapStamp( lm, lightmapNum, olm, x, y );
+                        ok = TestOutLightmapStamp( lm, &stamp, olm, x, y );
                     }
                     
                     /* try shifting */
@@ -2250,7 +2374,7 @@ static void FindOutLightmaps( rawLightmap_t* lm )
                             {
                                 x = lm->lightmapX[ 0 ] + sx * ( olm->customWidth >> 1 );  //%	lm->w;
                                 y = lm->lightmapY[ 0 ] + sy * ( olm->customHeight >> 1 ); //%	lm->h;
-                                ok = TestOutLightmapStamp( lm, lightmapNum, olm, x, y );
+                                ok = TestOutLightmapStamp( lm, &stamp, olm, x, y );
                                 
                                 if ( ok )
                                 {
@@ -2348,14 +2472,41 @@ static void FindOutLightmaps( rawLightmap_t* lm )
                 /* walk the origin around the lightmap */
                 for ( y = 0; y < yMax; y += yIncrement )
                 {
-                    for ( x = 0; x < xMax; x += xIncrement )
+                    /* skip rows too full for the stamp */
+                    if ( !TestOutLightmapRows( &stamp, olm, y ) )
                     {
-                        /* find a fine tract of lauhnd */
-                        ok = TestOutLightmapStamp( lm, lightmapNum, olm, x, y );
-                        
-                        if ( ok )
+                        continue;
+                    }
+                    
+                    /* test a span of origins at once, the lowest empty one is the first fit */
+                    if ( xIncrement == 1 && !lm->solid[ lightmapNum ] )
+                    {
+                        for ( x = 0; x < xMax; x += STAMP_SPAN )
                         {
-                            break;
+                            span = TestOutLightmapSpan( &stamp, olm, x, y, Q_min( STAMP_SPAN, xMax - x ) );
+                            if ( span )
+                            {
+                                while ( !( span & 1 ) )
+                                {
+                                    span >>= 1;
+                                    x++;
+                                }
+                                ok = qtrue;
+                                break;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for ( x = 0; x < xMax; x += xIncrement )
+                        {
+                            /* find a fine tract of lauhnd */
+                            ok = TestOutLightmapStamp( lm, &stamp, olm, x, y );
+                            
+                            if ( ok )
+                            {
+                                break;
+                            }
                         }
                     }
                     
@@ -2503,6 +2654,7 @@ static void FindOutLightmaps( rawLightmap_t* lm )
                 /* flag pixel as used */
                 olm->lightBits[ offset >> 3 ] |= ( 1 << ( offset & 7 ) );
                 olm->freeLuxels--;
+                olm->rowFreeLuxels[ oy ]--;
                 
                 /* store color */
                 pixel = olm->bspLightBytes + ( ( ( oy * olm->customWidth ) + ox ) * 3 );
@@ -2730,8 +2882,8 @@ void StoreSurfaceLightmaps( void )
     vec3_t sample, occludedSample, dirSample, colorMins, colorMaxs;
     float*               deluxel, *bspDeluxel, *bspDeluxel2;
     byte*                lb;
-    int numUsed, numTwins, numTwinLuxels, numStored;
-    float lmx, lmy, efficiency;
+    int numUsed, numTwins, numTwinLuxels, numStored, numPacked, numPageLuxels;
+    float lmx, lmy, efficiency, utilization;
     vec3_t color;
     bspDrawSurface_t*    ds, *parent, dsTemp;
     surfaceInfo_t*       info;
@@ -3382,6 +3534,7 @@ void StoreSurfaceLightmaps( void )
         for ( i = 0; i < numOutLightmaps; i++ )
         {
             free( outLightmaps[ i ].lightBits );
+            free( outLightmaps[ i ].rowFreeLuxels );
             free( outLightmaps[ i ].bspLightBytes );
         }
         free( outLightmaps );
@@ -3878,6 +4031,18 @@ void StoreSurfaceLightmaps( void )
                  ? 0
                  : ( float ) numUsed / ( float ) numStored;
                  
+    /* calc page utilization, which also covers external lightmaps */
+    numPacked = 0;
+    numPageLuxels = 0;
+    for ( i = 0; i < numOutLightmaps; i++ )
+    {
+        numPageLuxels += outLightmaps[ i ].customWidth * outLightmaps[ i ].customHeight;
+        numPacked += outLightmaps[ i ].customWidth * outLightmaps[ i ].customHeight - outLightmaps[ i ].freeLuxels;
+    }
+    utilization = ( numPageLuxels <= 0 )
+                  ? 0
+                  : ( float ) numPacked / ( float ) numPageLuxels;
+                  
     /* print stats */
     Sys_Printf( "%9d luxels used\n", numUsed );
     Sys_Printf( "%9d luxels stored (%3.2f percent efficiency)\n", numStored, efficiency * 100.0f );
@@ -3887,6 +4052,7 @@ void StoreSurfaceLightmaps( void )
     Sys_Printf( "%9d vertex approximated surfaces\n", numSurfsVertexApproximated );
     Sys_Printf( "%9d BSP lightmaps\n", numBSPLightmaps );
     Sys_Printf( "%9d total lightmaps\n", numOutLightmaps );
+    Sys_Printf( "%9d luxels packed (%3.2f percent page utilization)\n", numPacked, utilization * 100.0f );
     Sys_Printf( "%9d unique lightmap/shader combinations\n", numLightmapShaders );
     
     /* write map shader file */
@@ -30,9 +30,30 @@
 
 /* dependencies */
 #include "q3map2.h"
+#include <algorithm>
+#include <chrono>
+
+/* four adjacent pixels are ray cast at once where sse2 is available */
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define MINIMAP_SSE             1
+#include <emmintrin.h>
+#else
+#define MINIMAP_SSE             0
+#endif
 
 /* minimap stuff */
 
+#define MINIMAP_TILE_ROWS       32      /* image rows sampled, filtered and written at a time */
+#define MINIMAP_CELL_PIXELS     16      /* image columns sharing a brush list, a multiple of 4 */
+
+typedef struct miniMapBrush_s
+{
+    float mins[ 2 ], maxs[ 2 ];                         /* from the first four (axial) sides */
+    int firstPlane, numPlanes;                          /* into minimap.planes, four floats each */
+    qboolean in, out;                                   /* has sides facing down/up */
+}
+miniMapBrush_t;
+
 typedef struct minimap_s
 {
     bspModel_t* model;
@@ -40,12 +61,34 @@ typedef struct minimap_s
     int height;
     int samples;
     float* sample_offsets;
+    qboolean sharpen;
     float sharpen_boxmult;
     float sharpen_centermult;
     float boost, brightness, contrast;
-    float* data1f;
-    float* sharpendata1f;
     vec3_t mins, size;
+    miniMapMode_t mode;
+    
+    /* opaque brushes packed for vertical rays */
+    std::vector<miniMapBrush_t> brushes;
+    std::vector<float> planes;
+    
+    /* per column cell, the brushes that may be hit by the samples of the current tile */
+    std::vector< std::vector<int> > cells;
+    
+    /* rows tileFirst to tileEnd - 1 are buffered, tileSampled onward are sampled for the current tile */
+    int tileFirst, tileSampled, tileEnd;
+    int tileY, tileRows;
+    float* data1f;
+    byte* data4b;
+    int bytesPerPixel;
+    float* randomCoords;
+    
+    /* autolevel pass */
+    qboolean levelPass;
+    float* rowMins, *rowMaxs;
+    float levelMin, levelMax;
+    
+    int pacifier;
 }
 minimap_t;
 
@@ -103,62 +146,156 @@ qboolean BrushIntersectionWithLine( bspBrush_t* brush, vec3_t start, vec3_t dir,
     return ( in && out ) ? qtrue : qfalse;
 }
 
-static float MiniMapSample( float x, float y )
+/*
+   MiniMapTileRow()
+   returns the buffered samples of image row y
+ */
+
+static inline float* MiniMapTileRow( int y )
 {
-    vec3_t org, dir;
-    int i, bi;
-    float t0, t1;
-    float samp;
-    bspBrush_t* b;
-    bspBrushSide_t* s;
-    int cnt;
+    return &minimap.data1f[ ( y - minimap.tileFirst ) * minimap.width ];
+}
+
+#if MINIMAP_SSE
+
+/*
+   MiniMapSample4()
+   sums the opaque thickness along vertical rays through four points
+ */
+
+static void MiniMapSample4( const float* xs, const float* ys, const std::vector<int>& cell, float* samp )
+{
+    size_t i;
+    int j;
+    const __m128 x = _mm_loadu_ps( xs );
+    const __m128 y = _mm_loadu_ps( ys );
+    __m128 sum = _mm_setzero_ps();
+    
+    for ( i = 0; i < cell.size(); ++i )
+    {
+        const miniMapBrush_t* b = &minimap.brushes[ cell[ i ] ];
+        const float* p;
+        __m128 hit, tin, tout;
+        
+        /* sort out mins/maxs of the brush */
+        hit = _mm_and_ps( _mm_and_ps( _mm_cmpnlt_ps( x, _mm_set1_ps( b->mins[ 0 ] ) ), _mm_cmpngt_ps( x, _mm_set1_ps( b->maxs[ 0 ] ) ) ),
+                          _mm_and_ps( _mm_cmpnlt_ps( y, _mm_set1_ps( b->mins[ 1 ] ) ), _mm_cmpngt_ps( y, _mm_set1_ps( b->maxs[ 1 ] ) ) ) );
+        if ( !b->in || !b->out || !_mm_movemask_ps( hit ) )
+        {
+            continue;
+        }
+        
+        /* same as BrushIntersectionWithLine() with dir ( 0, 0, 1 ) */
+        tin = _mm_set1_ps( -FLT_MAX );
+        tout = _mm_set1_ps( FLT_MAX );
+        p = &minimap.planes[ b->firstPlane * 4 ];
+        for ( j = 0; j < b->numPlanes; ++j, p += 4 )
+        {
+            __m128 sn = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( p[ 0 ] ) ), _mm_mul_ps( y, _mm_set1_ps( p[ 1 ] ) ) );
+            if ( p[ 2 ] == 0 )
+            {
+                hit = _mm_andnot_ps( _mm_cmpgt_ps( sn, _mm_set1_ps( p[ 3 ] ) ), hit );
+                if ( !_mm_movemask_ps( hit ) )
+                {
+                    break;
+                }
+            }
+            else
+            {
+                __m128 t = _mm_div_ps( _mm_sub_ps( _mm_set1_ps( p[ 3 ] ), sn ), _mm_set1_ps( p[ 2 ] ) );
+                if ( p[ 2 ] < 0 )
+                {
+                    tin = _mm_max_ps( t, tin );
+                }
+                else
+                {
+                    tout = _mm_min_ps( t, tout );
+                }
+            }
+        }
+        hit = _mm_and_ps( hit, _mm_cmplt_ps( tin, tout ) );
+        sum = _mm_add_ps( sum, _mm_and_ps( hit, _mm_sub_ps( tout, tin ) ) );
+    }
     
-    org[0] = x;
-    org[1] = y;
-    org[2] = 0;
-    dir[0] = 0;
-    dir[1] = 0;
-    dir[2] = 1;
+    _mm_storeu_ps( samp, sum );
+}
+
+#else
+
+static qboolean MiniMapBrushIntersection( const miniMapBrush_t* b, float x, float y, float* t_in, float* t_out )
+{
+    int i;
+    qboolean in = qfalse, out = qfalse;
+    const float* p = &minimap.planes[ b->firstPlane * 4 ];
     
-    cnt = 0;
-    samp = 0;
-    for ( i = 0; i < minimap.model->numBSPBrushes; ++i )
+    for ( i = 0; i < b->numPlanes; ++i, p += 4 )
     {
-        bi = minimap.model->firstBSPBrush + i;
-        if ( opaqueBrushes[bi >> 3] & ( 1 << ( bi & 7 ) ) )
+        float sn = x * p[ 0 ] + y * p[ 1 ];
+        if ( p[ 2 ] == 0 )
         {
-            b = &bspBrushes[bi];
-            
-            // sort out mins/maxs of the brush
-            s = &bspBrushSides[b->firstSide];
-            if ( x < -bspPlanes[s[0].planeNum].dist )
+            if ( sn > p[ 3 ] )
             {
-                continue;
+                return qfalse; // outside!
             }
-            if ( x > +bspPlanes[s[1].planeNum].dist )
+        }
+        else
+        {
+            float t = ( p[ 3 ] - sn ) / p[ 2 ];
+            if ( p[ 2 ] < 0 )
             {
-                continue;
+                if ( !in || t > *t_in )
+                {
+                    *t_in = t;
+                    in = qtrue;
+                    if ( out && *t_in >= *t_out )
+                    {
+                        return qfalse;
+                    }
+                }
             }
-            if ( y < -bspPlanes[s[2].planeNum].dist )
+            else
             {
-                continue;
+                if ( !out || t < *t_out )
+                {
+                    *t_out = t;
+                    out = qtrue;
+                    if ( in && *t_in >= *t_out )
+                    {
+                        return qfalse;
+                    }
+                }
             }
-            if ( y > +bspPlanes[s[3].planeNum].dist )
+        }
+    }
+    return ( in && out ) ? qtrue : qfalse;
+}
+
+static void MiniMapSample4( const float* xs, const float* ys, const std::vector<int>& cell, float* samp )
+{
+    size_t i;
+    int j;
+    float t0, t1;
+    
+    for ( j = 0; j < 4; ++j )
+    {
+        samp[ j ] = 0;
+        for ( i = 0; i < cell.size(); ++i )
+        {
+            const miniMapBrush_t* b = &minimap.brushes[ cell[ i ] ];
+            if ( xs[ j ] < b->mins[ 0 ] || xs[ j ] > b->maxs[ 0 ] || ys[ j ] < b->mins[ 1 ] || ys[ j ] > b->maxs[ 1 ] )
             {
                 continue;
             }
-            
-            if ( BrushIntersectionWithLine( b, org, dir, &t0, &t1 ) )
+            if ( MiniMapBrushIntersection( b, xs[ j ], ys[ j ], &t0, &t1 ) )
             {
-                samp += t1 - t0;
-                ++cnt;
+                samp[ j ] += t1 - t0;
             }
         }
     }
-    
-    return samp;
 }
 
+#endif
+
 void RandomVector2f( float v[2] )
 {
     do
@@ -169,147 +306,511 @@ void RandomVector2f( float v[2] )
     while ( v[0] * v[0] + v[1] * v[1] > 1 );
 }
 
-static void MiniMapRandomlySupersampled( int y )
+/*
+   MiniMapRandomCoords()
+   draws the random sample positions of a run of rows up front, so the
+   pattern does not depend on which thread samples which row
+ */
+
+static void MiniMapRandomCoords( int first, int count )
 {
-    int x, i;
-    float* p = &minimap.data1f[y * minimap.width];
-    float ymin = minimap.mins[1] + minimap.size[1] * ( y / ( float ) minimap.height );
+    int x, y, i;
+    float* c = minimap.randomCoords;
     float dx   =                   minimap.size[0]      / ( float ) minimap.width;
     float dy   =                   minimap.size[1]      / ( float ) minimap.height;
     float uv[2];
-    float thisval;
     
-    for ( x = 0; x < minimap.width; ++x )
+    for ( y = first; y < first + count; ++y )
     {
-        float xmin = minimap.mins[0] + minimap.size[0] * ( x / ( float ) minimap.width );
-        float val = 0;
+        float ymin = minimap.mins[1] + minimap.size[1] * ( y / ( float ) minimap.height );
+        for ( x = 0; x < minimap.width; ++x )
+        {
+            float xmin = minimap.mins[0] + minimap.size[0] * ( x / ( float ) minimap.width );
+            for ( i = 0; i < minimap.samples; ++i )
+            {
+                RandomVector2f( uv );
+                *c++ = xmin + ( uv[0] + 0.5 ) * dx; /* exaggerated random pattern for better results */
+                *c++ = ymin + ( uv[1] + 0.5 ) * dy; /* exaggerated random pattern for better results */
+            }
+        }
+    }
+}
+
+static void MiniMapRandomlySupersampled( int y )
+{
+    int x, i, j;
+    float* p = MiniMapTileRow( y );
+    const float* c = &minimap.randomCoords[ ( y - minimap.tileSampled ) * minimap.width * minimap.samples * 2 ];
+    float xs[4], ys[4], samp[4], val[4];
+    
+    for ( x = 0; x < minimap.width; x += 4 )
+    {
+        const std::vector<int>& cell = minimap.cells[ x / MINIMAP_CELL_PIXELS ];
         
+        for ( j = 0; j < 4; ++j )
+        {
+            val[ j ] = 0;
+        }
         for ( i = 0; i < minimap.samples; ++i )
         {
-            RandomVector2f( uv );
-            thisval = MiniMapSample(
-                          xmin + ( uv[0] + 0.5 ) * dx, /* exaggerated random pattern for better results */
-                          ymin + ( uv[1] + 0.5 ) * dy  /* exaggerated random pattern for better results */
-                      );
-            val += thisval;
+            for ( j = 0; j < 4; ++j )
+            {
+                const float* uv = &c[ ( std::min( x + j, minimap.width - 1 ) * minimap.samples + i ) * 2 ];
+                xs[ j ] = uv[ 0 ];
+                ys[ j ] = uv[ 1 ];
+            }
+            MiniMapSample4( xs, ys, cell, samp );
+            for ( j = 0; j < 4; ++j )
+            {
+                val[ j ] += samp[ j ];
+            }
+        }
+        for ( j = 0; j < 4 && x + j < minimap.width; ++j )
+        {
+            p[ x + j ] = val[ j ] / ( minimap.samples * minimap.size[2] );
         }
-        val /= minimap.samples * minimap.size[2];
-        *p++ = val;
     }
 }
 
 static void MiniMapSupersampled( int y )
 {
-    int x, i;
-    float* p = &minimap.data1f[y * minimap.width];
+    int x, i, j;
+    float* p = MiniMapTileRow( y );
     float ymin = minimap.mins[1] + minimap.size[1] * ( y / ( float ) minimap.height );
     float dx   =                   minimap.size[0]      / ( float ) minimap.width;
     float dy   =                   minimap.size[1]      / ( float ) minimap.height;
+    float xmin[4], xs[4], ys[4], samp[4], val[4];
     
-    for ( x = 0; x < minimap.width; ++x )
+    for ( x = 0; x < minimap.width; x += 4 )
     {
-        float xmin = minimap.mins[0] + minimap.size[0] * ( x / ( float ) minimap.width );
-        float val = 0;
+        const std::vector<int>& cell = minimap.cells[ x / MINIMAP_CELL_PIXELS ];
         
+        for ( j = 0; j < 4; ++j )
+        {
+            xmin[ j ] = minimap.mins[0] + minimap.size[0] * ( std::min( x + j, minimap.width - 1 ) / ( float ) minimap.width );
+            val[ j ] = 0;
+        }
         for ( i = 0; i < minimap.samples; ++i )
         {
-            float thisval = MiniMapSample(
-                                xmin + minimap.sample_offsets[2 * i + 0] * dx,
-                                ymin + minimap.sample_offsets[2 * i + 1] * dy
-                            );
-            val += thisval;
+            for ( j = 0; j < 4; ++j )
+            {
+                xs[ j ] = xmin[ j ] + minimap.sample_offsets[2 * i + 0] * dx;
+                ys[ j ] = ymin + minimap.sample_offsets[2 * i + 1] * dy;
+            }
+            MiniMapSample4( xs, ys, cell, samp );
+            for ( j = 0; j < 4; ++j )
+            {
+                val[ j ] += samp[ j ];
+            }
+        }
+        for ( j = 0; j < 4 && x + j < minimap.width; ++j )
+        {
+            p[ x + j ] = val[ j ] / ( minimap.samples * minimap.size[2] );
         }
-        val /= minimap.samples * minimap.size[2];
-        *p++ = val;
     }
 }
 
 static void MiniMapNoSupersampling( int y )
 {
-    int x;
-    float* p = &minimap.data1f[y * minimap.width];
+    int x, j;
+    float* p = MiniMapTileRow( y );
     float ymin = minimap.mins[1] + minimap.size[1] * ( ( y + 0.5 ) / ( float ) minimap.height );
+    float xs[4], ys[4], samp[4];
     
-    for ( x = 0; x < minimap.width; ++x )
+    for ( j = 0; j < 4; ++j )
     {
-        float xmin = minimap.mins[0] + minimap.size[0] * ( ( x + 0.5 ) / ( float ) minimap.width );
-        *p++ = MiniMapSample( xmin, ymin ) / minimap.size[2];
+        ys[ j ] = ymin;
     }
-}
-
-static void MiniMapSharpen( int y )
-{
-    int x;
-    qboolean up = ( y > 0 ) ? qtrue : qfalse;
-    qboolean down = ( y < minimap.height - 1 ) ? qtrue : qfalse;
-    float* p = &minimap.data1f[y * minimap.width];
-    float* q = &minimap.sharpendata1f[y * minimap.width];
-    
-    for ( x = 0; x < minimap.width; ++x )
+    for ( x = 0; x < minimap.width; x += 4 )
     {
-        qboolean left = ( x > 0 ) ? qtrue : qfalse;
-        qboolean right = ( x < minimap.width - 1 ) ? qtrue : qfalse;
-        float val = p[0] * minimap.sharpen_centermult;
-        
-        if ( left && up )
+        for ( j = 0; j < 4; ++j )
         {
-            val += p[-1 - minimap.width] * minimap.sharpen_boxmult;
+            xs[ j ] = minimap.mins[0] + minimap.size[0] * ( ( std::min( x + j, minimap.width - 1 ) + 0.5 ) / ( float ) minimap.width );
         }
-        if ( left && down )
+        MiniMapSample4( xs, ys, minimap.cells[ x / MINIMAP_CELL_PIXELS ], samp );
+        for ( j = 0; j < 4 && x + j < minimap.width; ++j )
         {
-            val += p[-1 + minimap.width] * minimap.sharpen_boxmult;
+            p[ x + j ] = samp[ j ] / minimap.size[2];
         }
-        if ( right && up )
+    }
+}
+
+static void MiniMapContrastBoost( float* q )
+{
+    int x = 0;
+
+#if MINIMAP_SSE
+    const __m128 boost = _mm_set1_ps( minimap.boost ), boost1 = _mm_set1_ps( minimap.boost - 1 ), one = _mm_set1_ps( 1 );
+    for ( ; x + 4 <= minimap.width; x += 4 )
+    {
+        __m128 v = _mm_loadu_ps( q + x );
+        _mm_storeu_ps( q + x, _mm_div_ps( _mm_mul_ps( v, boost ), _mm_add_ps( _mm_mul_ps( boost1, v ), one ) ) );
+    }
+#endif
+    for ( ; x < minimap.width; ++x )
+    {
+        q[ x ] = q[ x ] * minimap.boost / ( ( minimap.boost - 1 ) * q[ x ] + 1 );
+    }
+}
+
+static void MiniMapBrightnessContrast( float* q )
+{
+    int x = 0;
+
+#if MINIMAP_SSE
+    const __m128 contrast = _mm_set1_ps( minimap.contrast ), brightness = _mm_set1_ps( minimap.brightness );
+    for ( ; x + 4 <= minimap.width; x += 4 )
+    {
+        _mm_storeu_ps( q + x, _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( q + x ), contrast ), brightness ) );
+    }
+#endif
+    for ( ; x < minimap.width; ++x )
+    {
+        q[ x ] = q[ x ] * minimap.contrast + minimap.brightness;
+    }
+}
+
+/*
+   MiniMapSampleRow()
+   samples a new row of the current tile and applies the per pixel filters
+ */
+
+static void MiniMapSampleRow( int i )
+{
+    int x, y = minimap.tileSampled + i;
+    float* q = MiniMapTileRow( y );
+    
+    if ( minimap.samples <= 1 )
+    {
+        MiniMapNoSupersampling( y );
+    }
+    else if ( minimap.sample_offsets )
+    {
+        MiniMapSupersampled( y );
+    }
+    else
+    {
+        MiniMapRandomlySupersampled( y );
+    }
+    
+    if ( minimap.boost != 1.0 )
+    {
+        MiniMapContrastBoost( q );
+    }
+    
+    if ( minimap.levelPass )
+    {
+        float mi = 1, ma = 0;
+        for ( x = 0; x < minimap.width; ++x )
         {
-            val += p[+1 - minimap.width] * minimap.sharpen_boxmult;
+            mi = std::min( mi, q[ x ] );
+            ma = std::max( ma, q[ x ] );
         }
-        if ( right && down )
+        minimap.rowMins[ i ] = mi;
+        minimap.rowMaxs[ i ] = ma;
+    }
+    else if ( minimap.brightness != 0 || minimap.contrast != 1 )
+    {
+        MiniMapBrightnessContrast( q );
+    }
+}
+
+/*
+   MiniMapStorePixel()
+   clamps a filtered value and stores it in the output row
+ */
+
+static inline void MiniMapStorePixel( byte* out, int x, float v )
+{
+    byte b;
+    
+    if ( v < 0 )
+    {
+        v = 0;
+    }
+    if ( v > 255.0 / 256.0 )
+    {
+        v = 255.0 / 256.0;
+    }
+    b = v * 256;
+    
+    switch ( minimap.mode )
+    {
+        case MINIMAP_MODE_GRAY:
+            out[ x ] = b;
+            break;
+        case MINIMAP_MODE_BLACK:
+            out[ x * 4 + 0 ] = 0;
+            out[ x * 4 + 1 ] = 0;
+            out[ x * 4 + 2 ] = 0;
+            out[ x * 4 + 3 ] = b;
+            break;
+        case MINIMAP_MODE_WHITE:
+            out[ x * 4 + 0 ] = 255;
+            out[ x * 4 + 1 ] = 255;
+            out[ x * 4 + 2 ] = 255;
+            out[ x * 4 + 3 ] = b;
+            break;
+    }
+}
+
+#if MINIMAP_SSE
+static inline void MiniMapStorePixels( byte* out, int x, __m128 v )
+{
+    int j;
+    int b[4];
+    
+    v = _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 255.0f / 256.0f ) );
+    _mm_storeu_si128( ( __m128i* ) b, _mm_cvttps_epi32( _mm_mul_ps( v, _mm_set1_ps( 256 ) ) ) );
+    
+    for ( j = 0; j < 4; ++j )
+    {
+        switch ( minimap.mode )
         {
-            val += p[+1 + minimap.width] * minimap.sharpen_boxmult;
+            case MINIMAP_MODE_GRAY:
+                out[ x + j ] = b[ j ];
+                break;
+            case MINIMAP_MODE_BLACK:
+                out[ ( x + j ) * 4 + 0 ] = 0;
+                out[ ( x + j ) * 4 + 1 ] = 0;
+                out[ ( x + j ) * 4 + 2 ] = 0;
+                out[ ( x + j ) * 4 + 3 ] = b[ j ];
+                break;
+            case MINIMAP_MODE_WHITE:
+                out[ ( x + j ) * 4 + 0 ] = 255;
+                out[ ( x + j ) * 4 + 1 ] = 255;
+                out[ ( x + j ) * 4 + 2 ] = 255;
+                out[ ( x + j ) * 4 + 3 ] = b[ j ];
+                break;
         }
+    }
+}
+#endif
+
+static float MiniMapSharpen( const float* p, int x, qboolean up, qboolean down )
+{
+    qboolean left = ( x > 0 ) ? qtrue : qfalse;
+    qboolean right = ( x < minimap.width - 1 ) ? qtrue : qfalse;
+    float val;
+    
+    p += x;
+    val = p[0] * minimap.sharpen_centermult;
+    
+    if ( left && up )
+    {
+        val += p[-1 - minimap.width] * minimap.sharpen_boxmult;
+    }
+    if ( left && down )
+    {
+        val += p[-1 + minimap.width] * minimap.sharpen_boxmult;
+    }
+    if ( right && up )
+    {
+        val += p[+1 - minimap.width] * minimap.sharpen_boxmult;
+    }
+    if ( right && down )
+    {
+        val += p[+1 + minimap.width] * minimap.sharpen_boxmult;
+    }
+    
+    if ( left )
+    {
+        val += p[-1] * minimap.sharpen_boxmult;
+    }
+    if ( right )
+    {
+        val += p[+1] * minimap.sharpen_boxmult;
+    }
+    if ( up )
+    {
+        val += p[-minimap.width] * minimap.sharpen_boxmult;
+    }
+    if ( down )
+    {
+        val += p[+minimap.width] * minimap.sharpen_boxmult;
+    }
+    
+    return val;
+}
+
+/*
+   MiniMapFilterRow()
+   sharpens an image row of the current tile and converts it to the output format
+ */
+
+static void MiniMapFilterRow( int i )
+{
+    int x = 0, y = minimap.tileY + i;
+    const float* p = MiniMapTileRow( y );
+    byte* out = &minimap.data4b[ i * minimap.width * minimap.bytesPerPixel ];
+    
+    if ( minimap.sharpen )
+    {
+        qboolean up = ( y > 0 ) ? qtrue : qfalse;
+        qboolean down = ( y < minimap.height - 1 ) ? qtrue : qfalse;
         
-        if ( left )
+        MiniMapStorePixel( out, x, MiniMapSharpen( p, x, up, down ) );
+        x = 1;
+
+#if MINIMAP_SSE
+        /* interior pixels, adding up the neighbours in the same order as MiniMapSharpen() */
+        if ( up && down )
         {
-            val += p[-1] * minimap.sharpen_boxmult;
+            const __m128 cm = _mm_set1_ps( minimap.sharpen_centermult ), bm = _mm_set1_ps( minimap.sharpen_boxmult );
+            const float* u = p - minimap.width;
+            const float* d = p + minimap.width;
+            
+            for ( ; x + 4 < minimap.width; x += 4 )
+            {
+                __m128 val = _mm_mul_ps( _mm_loadu_ps( p + x ), cm );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( u + x - 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( d + x - 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( u + x + 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( d + x + 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( p + x - 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( p + x + 1 ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( u + x ), bm ) );
+                val = _mm_add_ps( val, _mm_mul_ps( _mm_loadu_ps( d + x ), bm ) );
+                MiniMapStorePixels( out, x, val );
+            }
         }
-        if ( right )
+#endif
+        for ( ; x < minimap.width; ++x )
         {
-            val += p[+1] * minimap.sharpen_boxmult;
+            MiniMapStorePixel( out, x, MiniMapSharpen( p, x, up, down ) );
         }
-        if ( up )
+    }
+    else
+    {
+#if MINIMAP_SSE
+        for ( ; x + 4 <= minimap.width; x += 4 )
         {
-            val += p[-minimap.width] * minimap.sharpen_boxmult;
+            MiniMapStorePixels( out, x, _mm_loadu_ps( p + x ) );
         }
-        if ( down )
+#endif
+        for ( ; x < minimap.width; ++x )
         {
-            val += p[+minimap.width] * minimap.sharpen_boxmult;
+            MiniMapStorePixel( out, x, p[ x ] );
         }
-        
-        ++p;
-        *q++ = val;
     }
 }
 
-static void MiniMapContrastBoost( int y )
+/*
+   MiniMapBinBrushes()
+   sorts the brushes that may be hit by the samples of image rows first to
+   end - 1 into column cells, keeping them in brush order so the sums do not
+   change
+ */
+
+static void MiniMapBinBrushes( int first, int end )
 {
-    int x;
-    float* q = &minimap.data1f[y * minimap.width];
-    for ( x = 0; x < minimap.width; ++x )
+    size_t i;
+    int c, c0, c1;
+    double dx = minimap.size[0] / ( double ) minimap.width;
+    double dy = minimap.size[1] / ( double ) minimap.height;
+    double cellSize = dx * MINIMAP_CELL_PIXELS;
+    double ymin = minimap.mins[1] + ( first - 2 ) * dy;
+    double ymax = minimap.mins[1] + ( end + 2 ) * dy;
+    int numCells = minimap.cells.size();
+    
+    /* samples stay within 2 pixels of their pixel, random ones included */
+    for ( c = 0; c < numCells; ++c )
     {
-        *q = *q * minimap.boost / ( ( minimap.boost - 1 ) * *q + 1 );
-        ++q;
+        minimap.cells[ c ].clear();
+    }
+    for ( i = 0; i < minimap.brushes.size(); ++i )
+    {
+        const miniMapBrush_t* b = &minimap.brushes[ i ];
+        if ( b->maxs[ 1 ] < ymin || b->mins[ 1 ] > ymax )
+        {
+            continue;
+        }
+        c0 = std::max( ( int ) floor( ( b->mins[ 0 ] - minimap.mins[0] - 2 * dx ) / cellSize ), 0 );
+        c1 = std::min( ( int ) floor( ( b->maxs[ 0 ] - minimap.mins[0] + 2 * dx ) / cellSize ), numCells - 1 );
+        for ( c = c0; c <= c1; ++c )
+        {
+            minimap.cells[ c ].push_back( i );
+        }
     }
 }
 
-static void MiniMapBrightnessContrast( int y )
+/*
+   MiniMapPass()
+   generates the image a tile of rows at a time, writing the rows to f if
+   given; the samples of the rows around each tile are kept for sharpening
+ */
+
+static void MiniMapPass( FILE* f, const char* name )
 {
-    int x;
-    float* q = &minimap.data1f[y * minimap.width];
-    for ( x = 0; x < minimap.width; ++x )
+    int y, r, first, end, f40;
+    std::chrono::steady_clock::time_point start;
+    
+    Sys_Printf( "\n--- %s (%d) ---\n", name, minimap.height );
+    start = std::chrono::steady_clock::now();
+    minimap.pacifier = -1;
+    minimap.tileFirst = minimap.tileEnd = 0;
+    
+    for ( y = 0; y < minimap.height; y += MINIMAP_TILE_ROWS )
     {
-        *q = *q * minimap.contrast + minimap.brightness;
-        ++q;
+        first = std::max( y - 1, 0 );
+        end = std::min( y + MINIMAP_TILE_ROWS + 1, minimap.height );
+        
+        /* keep the rows the previous tile already sampled */
+        if ( minimap.tileEnd > first )
+        {
+            memmove( minimap.data1f, MiniMapTileRow( first ), ( minimap.tileEnd - first ) * minimap.width * sizeof( *minimap.data1f ) );
+            minimap.tileSampled = minimap.tileEnd;
+        }
+        else
+        {
+            minimap.tileSampled = first;
+        }
+        minimap.tileFirst = first;
+        minimap.tileEnd = end;
+        
+        if ( minimap.tileSampled < end )
+        {
+            MiniMapBinBrushes( minimap.tileSampled, end );
+            if ( minimap.randomCoords )
+            {
+                MiniMapRandomCoords( minimap.tileSampled, end - minimap.tileSampled );
+            }
+            RunThreadsOnIndividual( end - minimap.tileSampled, qfalse, MiniMapSampleRow );
+            if ( minimap.levelPass )
+            {
+                for ( r = 0; r < end - minimap.tileSampled; ++r )
+                {
+                    minimap.levelMin = std::min( minimap.levelMin, minimap.rowMins[ r ] );
+                    minimap.levelMax = std::max( minimap.levelMax, minimap.rowMaxs[ r ] );
+                }
+            }
+        }
+        
+        if ( f )
+        {
+            minimap.tileY = y;
+            minimap.tileRows = std::min( MINIMAP_TILE_ROWS, minimap.height - y );
+            RunThreadsOnIndividual( minimap.tileRows, qfalse, MiniMapFilterRow );
+            SafeWrite( f, minimap.data4b, minimap.tileRows * minimap.width * minimap.bytesPerPixel );
+        }
+        
+        /* pacifier */
+        f40 = 40 * std::min( y + MINIMAP_TILE_ROWS, minimap.height ) / minimap.height;
+        while ( minimap.pacifier < f40 )
+        {
+            ++minimap.pacifier;
+            if ( minimap.pacifier % 4 == 0 )
+            {
+                Sys_Printf( "%i", minimap.pacifier / 4 );
+            }
+            else
+            {
+                Sys_Printf( "." );
+            }
+        }
     }
+    
+    Sys_Printf( " (%i)\n", ( int ) std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() );
 }
 
 void MiniMapMakeMinsMaxs( vec3_t mins_in, vec3_t maxs_in, float border, qboolean keepaspect )
@@ -354,15 +855,61 @@ void MiniMapMakeMinsMaxs( vec3_t mins_in, vec3_t maxs_in, float border, qboolean
 
 /*
    MiniMapSetupBrushes()
-   determines solid non-sky brushes in the world
+   determines solid non-sky brushes in the world and packs them for vertical rays
  */
 
 void MiniMapSetupBrushes( void )
 {
+    int i, j, bi;
+    bspBrush_t* b;
+    bspBrushSide_t* s;
+    bspPlane_t* plane;
+    miniMapBrush_t brush;
+    
     SetupBrushesFlags( C_SOLID | C_SKY, C_SOLID, 0, 0 );
     // at least one must be solid
     // none may be sky
     // not all may be nodraw
+    
+    minimap.brushes.clear();
+    minimap.planes.clear();
+    for ( i = 0; i < minimap.model->numBSPBrushes; ++i )
+    {
+        bi = minimap.model->firstBSPBrush + i;
+        if ( !( opaqueBrushes[bi >> 3] & ( 1 << ( bi & 7 ) ) ) )
+        {
+            continue;
+        }
+        b = &bspBrushes[bi];
+        s = &bspBrushSides[b->firstSide];
+        
+        brush.mins[ 0 ] = -bspPlanes[s[0].planeNum].dist;
+        brush.maxs[ 0 ] = +bspPlanes[s[1].planeNum].dist;
+        brush.mins[ 1 ] = -bspPlanes[s[2].planeNum].dist;
+        brush.maxs[ 1 ] = +bspPlanes[s[3].planeNum].dist;
+        brush.firstPlane = minimap.planes.size() / 4;
+        brush.numPlanes = b->numSides;
+        brush.in = brush.out = qfalse;
+        for ( j = 0; j < b->numSides; ++j )
+        {
+            plane = &bspPlanes[s[j].planeNum];
+            minimap.planes.push_back( plane->normal[ 0 ] );
+            minimap.planes.push_back( plane->normal[ 1 ] );
+            minimap.planes.push_back( plane->normal[ 2 ] );
+            minimap.planes.push_back( plane->dist );
+            if ( plane->normal[ 2 ] < 0 )
+            {
+                brush.in = qtrue;
+            }
+            else if ( plane->normal[ 2 ] > 0 )
+            {
+                brush.out = qtrue;
+            }
+        }
+        minimap.brushes.push_back( brush );
+    }
+    
+    Sys_FPrintf( SYS_VRB, "%9d opaque brushes\n", ( int ) minimap.brushes.size() );
 }
 
 qboolean MiniMapEvaluateSampleOffsets( int* bestj, int* bestk, float* bestval )
@@ -515,13 +1062,15 @@ int MiniMapBSPMain( int argc, char** argv )
     qboolean autolevel;
     float minimapSharpen;
     float border;
-    byte* data4b, *p;
-    float* q;
-    int x, y;
+    const char* name;
+    byte header[18];
+    FILE* f;
     int i;
     miniMapMode_t mode;
     vec3_t mins, maxs;
     qboolean keepaspect;
+    std::chrono::steady_clock::time_point start;
+    double seconds;
     
     /* arg checking */
     if ( argc < 2 )
@@ -536,7 +1085,9 @@ int MiniMapBSPMain( int argc, char** argv )
     DefaultExtension( source, ".world" );
     Sys_Printf( "Loading %s\n", source );
     LoadShaderInfo();
+    bspLazyLoad = qtrue;
     LoadBSPFile( source );
+    LoadBSPLumps( BSP_LUMP_BRUSHSIDES );
     
     minimap.model = &bspModels[0];
     VectorCopy( minimap.model->mins, mins );
@@ -685,67 +1236,53 @@ int MiniMapBSPMain( int argc, char** argv )
     ExtractFilePath( minimapFilename, path );
     Q_mkdir( path );
     
-    if ( minimapSharpen >= 0 )
+    minimap.sharpen = ( minimapSharpen >= 0 ) ? qtrue : qfalse;
+    if ( minimap.sharpen )
     {
         minimap.sharpen_centermult = 8 * minimapSharpen + 1;
         minimap.sharpen_boxmult    =    -minimapSharpen;
     }
-    
-    minimap.data1f = static_cast<float*>( safe_malloc( minimap.width * minimap.height * sizeof( *minimap.data1f ) ) );
-    data4b = static_cast<byte*>( safe_malloc( minimap.width * minimap.height * 4 ) );
-    if ( minimapSharpen >= 0 )
-    {
-        minimap.sharpendata1f = static_cast<float*>( safe_malloc( minimap.width * minimap.height * sizeof( *minimap.data1f ) ) );
-    }
+    minimap.mode = mode;
     
     MiniMapSetupBrushes();
     
+    /* only a tile of rows is kept in memory at a time */
+    minimap.cells.resize( ( minimap.width + MINIMAP_CELL_PIXELS - 1 ) / MINIMAP_CELL_PIXELS );
+    minimap.data1f = static_cast<float*>( safe_malloc( ( MINIMAP_TILE_ROWS + 2 ) * minimap.width * sizeof( *minimap.data1f ) ) );
+    minimap.bytesPerPixel = ( mode == MINIMAP_MODE_GRAY ) ? 1 : 4;
+    minimap.data4b = static_cast<byte*>( safe_malloc( MINIMAP_TILE_ROWS * minimap.width * minimap.bytesPerPixel ) );
+    minimap.rowMins = static_cast<float*>( safe_malloc( ( MINIMAP_TILE_ROWS + 2 ) * sizeof( *minimap.rowMins ) ) );
+    minimap.rowMaxs = static_cast<float*>( safe_malloc( ( MINIMAP_TILE_ROWS + 2 ) * sizeof( *minimap.rowMaxs ) ) );
+    minimap.randomCoords = NULL;
+    
     if ( minimap.samples <= 1 )
     {
-        Sys_Printf( "\n--- MiniMapNoSupersampling (%d) ---\n", minimap.height );
-        RunThreadsOnIndividual( minimap.height, qtrue, MiniMapNoSupersampling );
+        name = "MiniMapNoSupersampling";
     }
-    else
+    else if ( minimap.sample_offsets )
     {
-        if ( minimap.sample_offsets )
-        {
-            Sys_Printf( "\n--- MiniMapSupersampled (%d) ---\n", minimap.height );
-            RunThreadsOnIndividual( minimap.height, qtrue, MiniMapSupersampled );
-        }
-        else
-        {
-            Sys_Printf( "\n--- MiniMapRandomlySupersampled (%d) ---\n", minimap.height );
-            RunThreadsOnIndividual( minimap.height, qtrue, MiniMapRandomlySupersampled );
-        }
+        name = "MiniMapSupersampled";
     }
-    
-    if ( minimap.boost != 1.0 )
+    else
     {
-        Sys_Printf( "\n--- MiniMapContrastBoost (%d) ---\n", minimap.height );
-        RunThreadsOnIndividual( minimap.height, qtrue, MiniMapContrastBoost );
+        name = "MiniMapRandomlySupersampled";
+        minimap.randomCoords = static_cast<float*>( safe_malloc( ( MINIMAP_TILE_ROWS + 2 ) * minimap.width * minimap.samples * 2 * sizeof( *minimap.randomCoords ) ) );
     }
     
+    start = std::chrono::steady_clock::now();
+    
     if ( autolevel )
     {
-        Sys_Printf( "\n--- MiniMapAutoLevel (%d) ---\n", minimap.height );
-        float mi = 1, ma = 0;
+        /* the levels depend on the whole image, so it is sampled once to find them before it is written */
+        minimap.levelPass = qtrue;
+        minimap.levelMin = 1;
+        minimap.levelMax = 0;
+        MiniMapPass( NULL, "MiniMapAutoLevel" );
+        minimap.levelPass = qfalse;
+        
+        float mi = minimap.levelMin, ma = minimap.levelMax;
         float s, o;
         
-        // TODO threads!
-        q = minimap.data1f;
-        for ( y = 0; y < minimap.height; ++y )
-            for ( x = 0; x < minimap.width; ++x )
-            {
-                float v = *q++;
-                if ( v < mi )
-                {
-                    mi = v;
-                }
-                if ( v > ma )
-                {
-                    ma = v;
-                }
-            }
         if ( ma > mi )
         {
             s = 1 / ( ma - mi );
@@ -769,99 +1306,29 @@ int MiniMapBSPMain( int argc, char** argv )
         }
     }
     
-    if ( minimap.brightness != 0 || minimap.contrast != 1 )
-    {
-        Sys_Printf( "\n--- MiniMapBrightnessContrast (%d) ---\n", minimap.height );
-        RunThreadsOnIndividual( minimap.height, qtrue, MiniMapBrightnessContrast );
-    }
+    /* same header as WriteTGA() and WriteTGAGray(), followed by the rows as they are generated */
+    Sys_Printf( "Writing to %s\n", minimapFilename );
+    memset( header, 0, sizeof( header ) );
+    header[2] = ( mode == MINIMAP_MODE_GRAY ) ? 3 : 2;
+    header[12] = minimap.width & 255;
+    header[13] = minimap.width >> 8;
+    header[14] = minimap.height & 255;
+    header[15] = minimap.height >> 8;
+    header[16] = minimap.bytesPerPixel * 8;
+    f = SafeOpenWrite( minimapFilename );
+    SafeWrite( f, header, sizeof( header ) );
+    MiniMapPass( f, name );
+    fclose( f );
     
-    if ( minimap.sharpendata1f )
-    {
-        Sys_Printf( "\n--- MiniMapSharpen (%d) ---\n", minimap.height );
-        RunThreadsOnIndividual( minimap.height, qtrue, MiniMapSharpen );
-        q = minimap.sharpendata1f;
-    }
-    else
-    {
-        q = minimap.data1f;
-    }
-    
-    Sys_Printf( "\nConverting..." );
-    
-    switch ( mode )
-    {
-        case MINIMAP_MODE_GRAY:
-            p = data4b;
-            for ( y = 0; y < minimap.height; ++y )
-                for ( x = 0; x < minimap.width; ++x )
-                {
-                    byte b;
-                    float v = *q++;
-                    if ( v < 0 )
-                    {
-                        v = 0;
-                    }
-                    if ( v > 255.0 / 256.0 )
-                    {
-                        v = 255.0 / 256.0;
-                    }
-                    b = v * 256;
-                    *p++ = b;
-                }
-            Sys_Printf( " writing to %s...", minimapFilename );
-            WriteTGAGray( minimapFilename, data4b, minimap.width, minimap.height );
-            break;
-        case MINIMAP_MODE_BLACK:
-            p = data4b;
-            for ( y = 0; y < minimap.height; ++y )
-                for ( x = 0; x < minimap.width; ++x )
-                {
-                    byte b;
-                    float v = *q++;
-                    if ( v < 0 )
-                    {
-                        v = 0;
-                    }
-                    if ( v > 255.0 / 256.0 )
-                    {
-                        v = 255.0 / 256.0;
-                    }
-                    b = v * 256;
-                    *p++ = 0;
-                    *p++ = 0;
-                    *p++ = 0;
-                    *p++ = b;
-                }
-            Sys_Printf( " writing to %s...", minimapFilename );
-            WriteTGA( minimapFilename, data4b, minimap.width, minimap.height );
-            break;
-        case MINIMAP_MODE_WHITE:
-            p = data4b;
-            for ( y = 0; y < minimap.height; ++y )
-                for ( x = 0; x < minimap.width; ++x )
-                {
-                    byte b;
-                    float v = *q++;
-                    if ( v < 0 )
-                    {
-                        v = 0;
-                    }
-                    if ( v > 255.0 / 256.0 )
-                    {
-                        v = 255.0 / 256.0;
-                    }
-                    b = v * 256;
-                    *p++ = 255;
-                    *p++ = 255;
-                    *p++ = 255;
-                    *p++ = b;
-                }
-            Sys_Printf( " writing to %s...", minimapFilename );
-            WriteTGA( minimapFilename, data4b, minimap.width, minimap.height );
-            break;
-    }
+    seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    Sys_Printf( "%9.2f megapixels/sec (%d x %d, %d samples per pixel)\n",
+                minimap.width * ( double ) minimap.height / 1000000.0 / std::max( seconds, 0.001 ), minimap.width, minimap.height, minimap.samples );
     
-    Sys_Printf( " done.\n" );
+    free( minimap.data1f );
+    free( minimap.data4b );
+    free( minimap.rowMins );
+    free( minimap.rowMaxs );
+    free( minimap.randomCoords );
     
     /* return to sender */
     return 0;
@@ -69,6 +69,7 @@
 #include "inout.h"
 #include "md4.h"
 #include <stdlib.h>
+#include <stdint.h>
 #include "assets_loader.hpp"
 #include <vector>
 #include <string>
@@ -303,6 +304,8 @@
 #define MAX_SEPERATORS          MAX_POINTS_ON_WINDING
 #define MAX_POINTS_ON_FIXED_WINDING 24  /* ydnar: increased this from 12 at the expense of more memory */
 #define MAX_PORTALS_ON_LEAF     4096 //Dushan - increased 4 times
+#define STACK_FRAMES_PER_CHUNK  64      /* pooled recursion frames per allocation */
+#define MAX_STACK_FRAME_CHUNKS  256     /* caps the flow recursion at 16384 leafs deep */
 
 
 /* light */
@@ -330,6 +333,8 @@
 #define LIGHT_WOLF_DEFAULT      ( LIGHT_ATTEN_LINEAR | LIGHT_ATTEN_DISTANCE | LIGHT_GRID | LIGHT_SURFACES | LIGHT_FAST )
 
 #define MAX_TRACE_TEST_NODES    256
+#define TRACE_PACKET_SIZE       16      /* traces TraceLinePacket walks through the bvh together */
+#define LIGHT_CONTRIBUTION_DEFERRED 2   /* LightContributionToSampleDeferred left the occlusion trace to the caller */
 #define DEFAULT_INHIBIT_RADIUS  1.5f
 
 #define LUXEL_EPSILON           0.125f
@@ -376,6 +381,17 @@
 // moved this to a external header so the physics engine can use it.
 #include "bspfile_abstract.h"
 
+/* abstract lumps a lazy load can leave undecoded until LoadBSPLumps() */
+#define BSP_LUMP_LEAFS          ( 1 << 0 )
+#define BSP_LUMP_BRUSHSIDES     ( 1 << 1 )
+#define BSP_LUMP_DRAWVERTS      ( 1 << 2 )
+#define BSP_LUMP_DRAWSURFACES   ( 1 << 3 )
+#define BSP_LUMP_FOGS           ( 1 << 4 )
+#define BSP_LUMP_VISIBILITY     ( 1 << 5 )
+#define BSP_LUMP_LIGHTGRID      ( 1 << 6 )
+#define BSP_LUMP_ADVERTISEMENTS ( 1 << 7 )
+#define BSP_LUMP_ALL            ( ( 1 << 8 ) - 1 )
+
 /* -------------------------------------------------------------------------------
 
    general types
@@ -390,6 +406,10 @@ typedef unsigned char qb_t;
 typedef float tcMod_t[ 3 ][ 3 ];
 
 
+/* decodes the BSP_LUMP_* lumps of a mapped bsp file */
+typedef void ( *bspLumpDecoder_t )( bspHeader_t* header, int length, int lumps );
+
+
 /* ydnar: for multiple game support */
 typedef struct surfaceParm_s
 {
@@ -1109,14 +1129,14 @@ leaf_t;
 
 typedef struct pstack_s
 {
-    byte mightsee[ MAX_PORTALS / 8 ];
+    byte*                mightsee;      /* [portals], pooled per depth */
     struct pstack_s*     next;
     leaf_t*              leaf;
     vportal_t*           portal;        /* portal exiting */
     fixedWinding_t*      source;
     fixedWinding_t*      pass;
     
-    fixedWinding_t windings[ 3 ];       /* source, pass, temp in any order */
+    fixedWinding_t*      windings;      /* [3] pooled per depth, source, pass, temp in any order */
     int freewindings[ 3 ];
     
     visPlane_t portalplane;
@@ -1134,6 +1154,9 @@ typedef struct
     vportal_t*           base;
     int c_chains;
     pstack_t pstack_head;
+    
+    int numframechunks;
+    byte*                framechunks[ MAX_STACK_FRAME_CHUNKS ];
 }
 threaddata_t;
 
@@ -1177,6 +1200,9 @@ typedef struct light_s
     
     float falloffTolerance;                 /* ydnar: minimum attenuation threshold */
     float filterRadius;                 /* ydnar: lightmap filter radius in world units, 0 == default */
+    
+    uint64_t cacheHash;                 /* hash of the fields above for -incremental */
+    vec3_t cacheMins, cacheMaxs;        /* where rays to the light can end */
 }
 light_t;
 
@@ -1220,6 +1246,10 @@ typedef struct
     qboolean opaque;
     vec_t forceSubsampling;           /* needs subsampling (alphashadow), value = max color contribution possible from it */
     
+    /* deferred occlusion, see FinishLightContribution() */
+    qboolean deferredSky;
+    vec_t deferredAdd;
+    
     /* working data */
     int numTestNodes;
     int testNodes[ MAX_TRACE_TEST_NODES ];
@@ -1264,6 +1294,7 @@ typedef struct outLightmap_s
     int customWidth, customHeight;
     int numLightmaps;
     int freeLuxels;
+    int*                 rowFreeLuxels; /* [customHeight], placements skip rows that can't hold the stamp */
     int numShaders;
     shaderInfo_t*        shaders[ MAX_LIGHTMAP_SHADERS ];
     byte*                lightBits;
@@ -1334,6 +1365,15 @@ typedef struct rawGridPoint_s
 rawGridPoint_t;
 
 
+typedef enum
+{
+    LIGHT_STAGE_ALWAYS,                                 /* always runs */
+    LIGHT_STAGE_SKIP,                                   /* skipped while resuming, a later checkpoint holds its output */
+    LIGHT_STAGE_CHECKPOINT                              /* skipped while resuming, checkpointed when it ends */
+}
+lightStageMode_t;
+
+
 typedef struct surfaceInfo_s
 {
     int modelindex;
@@ -1632,6 +1672,8 @@ void                        PassagePortalFlow( int portalnum );
 
 /* light.c  */
 float                       PointToPolygonFormFactor( const vec3_t point, const vec3_t normal, const winding_t* w );
+int                         LightContributionToSampleDeferred( trace_t* trace );
+int                         FinishLightContribution( trace_t* trace );
 int                         LightContributionToSample( trace_t* trace );
 void LightingAtSample( trace_t* trace, byte styles[ MAX_LIGHTMAPS ], vec3_t colors[ MAX_LIGHTMAPS ] );
 int                         LightContributionToPoint( trace_t* trace );
@@ -1641,7 +1683,29 @@ int                         LightMain( int argc, char** argv );
 /* light_trace.c */
 void                        SetupTraceNodes( void );
 void                        TraceLine( trace_t* trace );
+void                        TraceLinePacket( trace_t* traces, int numTraces );
 float                       SetupTrace( trace_t* trace );
+void                        TraceBenchmark( void );
+
+
+/* light_incremental.c */
+void                        SetupLightCache( const char* path, int argc, char** argv );
+void                        HashLightsForCache( void );
+void                        SetupGridCache( void );
+qboolean                    ReuseGridPoint( int num, vec3_t origin, int cluster );
+int                         NumGridPointsReused( void );
+void                        ReuseRawLightmaps( void );
+qboolean                    RawLightmapReused( int num );
+void                        WriteLightCache( void );
+uint64_t                    LightInputHash( int argc, char** argv );
+
+
+/* light_checkpoint.c */
+void                        SetupLightCheckpoint( const char* bspPath, int argc, char** argv );
+qboolean                    BeginLightStage( const char* name, int bounce, int items, lightStageMode_t mode );
+void                        EndLightStage( void );
+qboolean                    LightStagesResuming( void );
+void                        FinishLightStages( void );
 
 
 /* light_bounce.c */
@@ -1694,6 +1758,7 @@ int                         ExportLightmapsMain( int argc, char** argv );
 int                         ImportLightmapsMain( int argc, char** argv );
 
 void                        SetupSurfaceLightmaps( void );
+int                         RawLightmapCost( int num );
 void                        StitchSurfaceLightmaps( void );
 void                        StoreSurfaceLightmaps();
 
@@ -1747,6 +1812,14 @@ int                         CopyLump( bspHeader_t* header, int lump, void* dest,
 int                         CopyLump_Allocate( bspHeader_t* header, int lump, void** dest, int size, int* allocationVariable );
 void                        AddLump( FILE* file, bspHeader_t* header, int lumpNum, const void* data, int length );
 
+qboolean                    LazyBSPLumps( void );
+void*                        MapBSPFile( const char* filename, int* length );
+void                        ReleaseBSPFile( void );
+void                        UnmapBSPFile( void );
+int                         LoadLump_Allocate( bspHeader_t* header, int lump, void** dest, int size, int* allocationVariable );
+void                        DeferBSPLumps( bspLumpDecoder_t decoder, int lumps );
+void                        LoadBSPLumps( int lumps );
+
 void                        LoadBSPFile( const char* filename );
 void                        WriteBSPFile( const char* filename );
 void                        PrintBSPFileSizes( void );
@@ -1864,6 +1937,7 @@ Q_EXTERN qboolean verbose;
 Q_EXTERN qboolean verboseEntities Q_ASSIGN( qfalse );
 Q_EXTERN qboolean force Q_ASSIGN( qfalse );
 Q_EXTERN qboolean infoMode Q_ASSIGN( qfalse );
+Q_EXTERN qboolean bspLazyLoad Q_ASSIGN( qfalse );
 Q_EXTERN qboolean useCustomInfoParms Q_ASSIGN( qfalse );
 Q_EXTERN qboolean noprune Q_ASSIGN( qfalse );
 Q_EXTERN qboolean leaktest Q_ASSIGN( qfalse );
@@ -2060,7 +2134,8 @@ Q_EXTERN int testlevel;
 Q_EXTERN byte*               uncompressed;
 
 Q_EXTERN int leafbytes, leaflongs;
-Q_EXTERN int portalbytes, portallongs;
+Q_EXTERN int portalbytes, portallongs;          /* longs are 64 bit words */
+Q_EXTERN int stackframebytes;
 
 Q_EXTERN vportal_t*          sorted_portals[ MAX_MAP_PORTALS * 2 ];
 
@@ -2085,6 +2160,12 @@ Q_EXTERN qboolean noGridLighting Q_ASSIGN( qfalse );
 
 Q_EXTERN qboolean noTrace Q_ASSIGN( qfalse );
 Q_EXTERN qboolean noSurfaces Q_ASSIGN( qfalse );
+Q_EXTERN qboolean noTraceBVH Q_ASSIGN( qfalse );
+Q_EXTERN qboolean traceBenchmark Q_ASSIGN( qfalse );
+Q_EXTERN qboolean incrementalLight Q_ASSIGN( qfalse );
+Q_EXTERN qboolean lightCheckpoint Q_ASSIGN( qfalse );
+Q_EXTERN qboolean lightResume Q_ASSIGN( qfalse );
+Q_EXTERN qboolean lightStageReport Q_ASSIGN( qfalse );
 Q_EXTERN qboolean patchShadows Q_ASSIGN( qfalse );
 Q_EXTERN qboolean g_forceVertex Q_ASSIGN( qfalse );
 
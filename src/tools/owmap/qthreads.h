@@ -27,6 +27,8 @@ extern int numthreads;
 void ThreadSetDefault( void );
 int GetThreadWork( void );
 void RunThreadsOnIndividual( int workcnt, qboolean showpacifier, void ( *func )( int ) );
+void RunThreadsOnIndividualInOrder( int workcnt, qboolean showpacifier, void ( *func )( int ) );
+void RunThreadsOnIndividualByCost( int workcnt, qboolean showpacifier, void ( *func )( int ), int ( *cost )( int ) );
 void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) );
 void ThreadLock( void );
 void ThreadUnlock( void );
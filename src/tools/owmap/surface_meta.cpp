@@ -48,6 +48,7 @@
 
 #define GROW_META_VERTS     1024
 #define GROW_META_TRIANGLES 1024
+#define META_VERT_HASH_SIZE 65536   /* power of two */
 
 static int numMetaSurfaces, numPatchMetaSurfaces;
 
@@ -56,6 +57,10 @@ static int numMetaVerts = 0;
 static int firstSearchMetaVert = 0;
 static bspDrawVert_t*        metaVerts = NULL;
 
+/* hash chains of identical meta verts, each chain runs from the newest vert to the oldest */
+static int metaVertHash[ META_VERT_HASH_SIZE ];
+static int*                  metaVertHashNext = NULL;
+
 static int maxMetaTriangles = 0;
 static int numMetaTriangles = 0;
 static metaTriangle_t*       metaTriangles = NULL;
@@ -71,6 +76,32 @@ void ClearMetaTriangles( void )
 {
     numMetaVerts = 0;
     numMetaTriangles = 0;
+    memset( metaVertHash, -1, sizeof( metaVertHash ) );
+}
+
+
+
+/*
+   HashMetaVertex()
+   hashes every byte FindMetaVertex compares
+ */
+
+static unsigned int HashMetaVertex( const bspDrawVert_t* v )
+{
+    int i;
+    unsigned int hash;
+    const byte*      b;
+    
+    
+    /* fnv-1a */
+    hash = 2166136261u;
+    b = ( const byte* ) v;
+    for ( i = 0; i < ( int ) sizeof( *v ); i++ )
+    {
+        hash = ( hash ^ b[ i ] ) * 16777619u;
+    }
+    
+    return hash & ( META_VERT_HASH_SIZE - 1 );
 }
 
 
@@ -82,14 +113,21 @@ void ClearMetaTriangles( void )
 
 static int FindMetaVertex( bspDrawVert_t* src )
 {
-    int i;
-    bspDrawVert_t*   v, *temp;
+    int i, hash, *tempNext;
+    bspDrawVert_t*   temp;
+    
     
+    /* nothing was ever added, the hash may not have been cleared yet */
+    if ( maxMetaVerts == 0 )
+    {
+        memset( metaVertHash, -1, sizeof( metaVertHash ) );
+    }
     
-    /* try to find an existing drawvert */
-    for ( i = firstSearchMetaVert, v = &metaVerts[ i ]; i < numMetaVerts; i++, v++ )
+    /* try to find an existing drawvert, verts before firstSearchMetaVert end the chain */
+    hash = HashMetaVertex( src );
+    for ( i = metaVertHash[ hash ]; i >= firstSearchMetaVert; i = metaVertHashNext[ i ] )
     {
-        if ( memcmp( src, v, sizeof( bspDrawVert_t ) ) == 0 )
+        if ( memcmp( src, &metaVerts[ i ], sizeof( bspDrawVert_t ) ) == 0 )
         {
             return i;
         }
@@ -101,16 +139,22 @@ static int FindMetaVertex( bspDrawVert_t* src )
         /* reallocate more room */
         maxMetaVerts += GROW_META_VERTS;
         temp = static_cast<bspDrawVert_t*>( safe_malloc( maxMetaVerts * sizeof( bspDrawVert_t ) ) );
+        tempNext = static_cast<int*>( safe_malloc( maxMetaVerts * sizeof( int ) ) );
         if ( metaVerts != NULL )
         {
             memcpy( temp, metaVerts, numMetaVerts * sizeof( bspDrawVert_t ) );
+            memcpy( tempNext, metaVertHashNext, numMetaVerts * sizeof( int ) );
             free( metaVerts );
+            free( metaVertHashNext );
         }
         metaVerts = temp;
+        metaVertHashNext = tempNext;
     }
     
     /* add the triangle */
     memcpy( &metaVerts[ numMetaVerts ], src, sizeof( bspDrawVert_t ) );
+    metaVertHashNext[ numMetaVerts ] = metaVertHash[ hash ];
+    metaVertHash[ hash ] = numMetaVerts;
     numMetaVerts++;
     
     /* return the count */
@@ -31,8 +31,10 @@
 #include "mathlib.h"
 #include "inout.h"
 #include "qthreads.h"
+#include <atomic>
+#include <chrono>
 
-#define MAX_THREADS 64
+#define MAX_THREADS 64	/* only the OSF1 and IRIX paths still use fixed arrays */
 
 int dispatch;
 int workcount;
@@ -91,32 +93,324 @@ int GetThreadWork( void )
 }
 
 
-void ( *workfunction )( int );
+/*
+   ===================================================================
 
-void ThreadWorkerFunction( int threadnum )
+   WORK STEALING POOL
+
+   RunThreadsOnIndividual splits the work items into one range per
+   thread. A thread takes chunks from the front of its own range and,
+   once that is empty, steals the back half of the fullest range left.
+   Both ends of a range live in one 64 bit word, so taking and stealing
+   are single compare-and-swaps and no lock is held per item.
+
+   ===================================================================
+ */
+
+#define WORK_CHUNKS_PER_THREAD 32
+
+typedef struct
 {
-    int work;
+    alignas( 64 ) std::atomic<uint64_t> range;	/* first item in the low 32 bits, end in the high */
+    double busy;								/* seconds spent running items */
+    int steals;
+} workQueue_t;
+
+static void ( *workfunction )( int );
+static const int* workorder;
+static workQueue_t* workqueues;
+static int workqueuecount;
+static int workchunk;
+static std::atomic<int> workdone;
+static std::atomic<int> workprinted;
+
+static inline uint64_t PackWorkRange( uint32_t first, uint32_t end )
+{
+    return ( uint64_t )end << 32 | first;
+}
+
+/*
+   =============
+   TakeThreadWork
+
+   takes up to workchunk items from the front of the thread's own range
+   =============
+ */
+static qboolean TakeThreadWork( workQueue_t* queue, int* first, int* end )
+{
+    uint64_t range = queue->range.load( std::memory_order_acquire );
+    uint32_t f, e, n;
+    
+    do
+    {
+        f = ( uint32_t )range;
+        e = ( uint32_t )( range >> 32 );
+        if ( f >= e )
+        {
+            return qfalse;
+        }
+        n = e - f < ( uint32_t )workchunk ? e - f : ( uint32_t )workchunk;
+    }
+    while ( !queue->range.compare_exchange_weak( range, PackWorkRange( f + n, e ), std::memory_order_acq_rel ) );
+    
+    *first = f;
+    *end = f + n;
+    return qtrue;
+}
+
+/*
+   =============
+   StealThreadWork
+
+   moves the back half of the fullest other range into the thread's own range
+   =============
+ */
+static qboolean StealThreadWork( int threadnum )
+{
+    int i, victim, best;
+    uint64_t range;
+    uint32_t f, e, n;
     
     while ( 1 )
     {
-        work = GetThreadWork();
-        if ( work == -1 )
+        victim = -1;
+        best = 0;
+        for ( i = 0; i < workqueuecount; i++ )
         {
-            break;
+            range = workqueues[ i ].range.load( std::memory_order_relaxed );
+            f = ( uint32_t )range;
+            e = ( uint32_t )( range >> 32 );
+            if ( i != threadnum && f < e && ( int )( e - f ) > best )
+            {
+                best = e - f;
+                victim = i;
+            }
+        }
+        
+        if ( victim < 0 )
+        {
+            return qfalse;
+        }
+        
+        range = workqueues[ victim ].range.load( std::memory_order_acquire );
+        f = ( uint32_t )range;
+        e = ( uint32_t )( range >> 32 );
+        if ( f >= e )
+        {
+            continue;
+        }
+        
+        n = ( e - f + 1 ) / 2;
+        if ( workqueues[ victim ].range.compare_exchange_strong( range, PackWorkRange( f, e - n ), std::memory_order_acq_rel ) )
+        {
+            /* only the owner refills its own empty range, thieves fail their compare-and-swap on it */
+            workqueues[ threadnum ].range.store( PackWorkRange( e - n, e ), std::memory_order_release );
+            workqueues[ threadnum ].steals++;
+            return qtrue;
         }
-        //Sys_Printf ("thread %i, work %i\n", threadnum, work);
-        workfunction( work );
     }
 }
 
-void RunThreadsOnIndividual( int workcnt, qboolean showpacifier, void ( *func )( int ) )
+/*
+   =============
+   UpdateThreadProgress
+
+   counts finished items without a lock, the lock is only taken to print a pacifier tick
+   =============
+ */
+static void UpdateThreadProgress( int count )
 {
+    int f;
+    
+    f = 40 * ( workdone.fetch_add( count, std::memory_order_relaxed ) + count ) / workcount;
+    if ( !pacifier || f <= workprinted.load( std::memory_order_relaxed ) )
+    {
+        return;
+    }
+    
+    ThreadLock();
+    while ( workprinted.load( std::memory_order_relaxed ) < f )
+    {
+        oldf = workprinted.fetch_add( 1, std::memory_order_relaxed ) + 1;
+        if ( oldf % 4 == 0 )
+        {
+            Sys_Printf( "%i", oldf / 4 );
+        }
+        else
+        {
+            Sys_Printf( "." );
+        }
+        fflush( stdout );
+    }
+    ThreadUnlock();
+}
+
+void ThreadWorkerFunction( int threadnum )
+{
+    int first, end, i;
+    workQueue_t* queue = &workqueues[ threadnum ];
+    std::chrono::steady_clock::time_point start;
+    
+    while ( TakeThreadWork( queue, &first, &end ) || ( StealThreadWork( threadnum ) && TakeThreadWork( queue, &first, &end ) ) )
+    {
+        start = std::chrono::steady_clock::now();
+        for ( i = first; i < end; i++ )
+        {
+            workfunction( workorder ? workorder[ i ] : i );
+        }
+        queue->busy += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        
+        UpdateThreadProgress( end - first );
+    }
+}
+
+/*
+   =============
+   RunThreadsOnPool
+
+   order, when given, lists the work items in the order they should start.
+   They are dealt round robin and handed out one at a time, so the threads
+   walk the list together instead of each owning a slab of it
+   =============
+ */
+static void RunThreadsOnPool( int workcnt, qboolean showpacifier, void ( *func )( int ), const int* order )
+{
+    int i, t, count, first, steals;
+    int* dealt = NULL;
+    double busy, wall;
+    std::chrono::steady_clock::time_point start;
+    
     if ( numthreads == -1 )
     {
         ThreadSetDefault();
     }
+    
     workfunction = func;
+    workqueuecount = numthreads;
+    workqueues = new workQueue_t[ workqueuecount ];
+    workdone = 0;
+    workprinted = -1;
+    
+    if ( order )
+    {
+        dealt = ( int* )safe_malloc( workcnt * sizeof( *dealt ) );
+        workchunk = 1;
+    }
+    else
+    {
+        workchunk = workcnt / ( workqueuecount * WORK_CHUNKS_PER_THREAD );
+        if ( workchunk < 1 )
+        {
+            workchunk = 1;
+        }
+    }
+    
+    for ( t = 0, first = 0; t < workqueuecount; t++ )
+    {
+        if ( order )
+        {
+            for ( i = t, count = 0; i < workcnt; i += workqueuecount, count++ )
+            {
+                dealt[ first + count ] = order[ i ];
+            }
+        }
+        else
+        {
+            count = workcnt / workqueuecount + ( t < workcnt % workqueuecount );
+        }
+        
+        workqueues[ t ].range = PackWorkRange( first, first + count );
+        workqueues[ t ].busy = 0;
+        workqueues[ t ].steals = 0;
+        first += count;
+    }
+    workorder = dealt;
+    
+    start = std::chrono::steady_clock::now();
     RunThreadsOn( workcnt, showpacifier, ThreadWorkerFunction );
+    wall = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    
+    busy = 0;
+    steals = 0;
+    for ( t = 0; t < workqueuecount; t++ )
+    {
+        busy += workqueues[ t ].busy;
+        steals += workqueues[ t ].steals;
+    }
+    
+    if ( workqueuecount > 1 && wall > 0 )
+    {
+        Sys_FPrintf( showpacifier ? SYS_STD : SYS_VRB, "%d%% core utilization over %d threads, %d steals\n",
+                     ( int )( 100 * busy / ( wall * workqueuecount ) ), workqueuecount, steals );
+    }
+    
+    delete[] workqueues;
+    workqueues = NULL;
+    workorder = NULL;
+    free( dealt );
+}
+
+void RunThreadsOnIndividual( int workcnt, qboolean showpacifier, void ( *func )( int ) )
+{
+    RunThreadsOnPool( workcnt, showpacifier, func, NULL );
+}
+
+/*
+   =============
+   RunThreadsOnIndividualInOrder
+
+   like RunThreadsOnIndividual, but items are started in index order across all threads
+   =============
+ */
+void RunThreadsOnIndividualInOrder( int workcnt, qboolean showpacifier, void ( *func )( int ) )
+{
+    int i;
+    int* order;
+    
+    order = ( int* )safe_malloc( workcnt * sizeof( *order ) );
+    for ( i = 0; i < workcnt; i++ )
+    {
+        order[ i ] = i;
+    }
+    
+    RunThreadsOnPool( workcnt, showpacifier, func, order );
+    
+    free( order );
+}
+
+/*
+   =============
+   RunThreadsOnIndividualByCost
+
+   like RunThreadsOnIndividual, but items with the highest cost are started first
+   =============
+ */
+static int ( *workcost )( int );
+
+static int CompareWorkCost( const void* a, const void* b )
+{
+    int ca = workcost( *( const int* )a ), cb = workcost( *( const int* )b );
+    
+    return ca > cb ? -1 : ( ca < cb ? 1 : *( const int* )a - *( const int* )b );
+}
+
+void RunThreadsOnIndividualByCost( int workcnt, qboolean showpacifier, void ( *func )( int ), int ( *cost )( int ) )
+{
+    int i;
+    int* order;
+    
+    order = ( int* )safe_malloc( workcnt * sizeof( *order ) );
+    for ( i = 0; i < workcnt; i++ )
+    {
+        order[ i ] = i;
+    }
+    
+    workcost = cost;
+    qsort( order, workcnt, sizeof( *order ), CompareWorkCost );
+    
+    RunThreadsOnPool( workcnt, showpacifier, func, order );
+    
+    free( order );
 }
 
 
@@ -145,7 +439,14 @@ void ThreadSetDefault( void )
     {
         GetSystemInfo( &info );
         numthreads = info.dwNumberOfProcessors;
-        if ( numthreads < 1 || numthreads > 32 )
+        
+        /* dwNumberOfProcessors only counts the processor group we run in,
+           RunThreadsOn spreads the threads over the other groups */
+        if ( GetActiveProcessorCount( ALL_PROCESSOR_GROUPS ) > ( DWORD )numthreads )
+        {
+            numthreads = GetActiveProcessorCount( ALL_PROCESSOR_GROUPS );
+        }
+        if ( numthreads < 1 )
         {
             numthreads = 1;
         }
@@ -183,6 +484,51 @@ void ThreadUnlock( void )
     LeaveCriticalSection( &crit );
 }
 
+/*
+   =============
+   SetThreadGroup
+
+   Windows starts every thread in the processor group of the process, so
+   without this the threads counted in the other groups of a machine with
+   more than 64 logical processors would all share the first one
+   =============
+ */
+static void SetThreadGroup( HANDLE thread, int threadnum )
+{
+    GROUP_AFFINITY affinity;
+    WORD group, numgroups;
+    DWORD count, total;
+    
+    total = GetActiveProcessorCount( ALL_PROCESSOR_GROUPS );
+    numgroups = GetActiveProcessorGroupCount();
+    if ( numgroups < 2 || total == 0 )
+    {
+        return;
+    }
+    
+    /* thread n goes to the group that holds logical processor n */
+    threadnum %= total;
+    for ( group = 0; group < numgroups; group++ )
+    {
+        count = GetActiveProcessorCount( group );
+        if ( ( DWORD )threadnum < count )
+        {
+            break;
+        }
+        threadnum -= count;
+    }
+    if ( group == numgroups || count == 0 )
+    {
+        return;
+    }
+    
+    memset( &affinity, 0, sizeof( affinity ) );
+    affinity.Group = group;
+    affinity.Mask = count >= sizeof( KAFFINITY ) * 8 ? ( KAFFINITY ) - 1 : ( ( KAFFINITY )1 << count ) - 1;
+    
+    SetThreadGroupAffinity( thread, &affinity, NULL );
+}
+
 /*
    =============
    RunThreadsOn
@@ -190,8 +536,8 @@ void ThreadUnlock( void )
  */
 void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
 {
-    int threadid[MAX_THREADS];
-    HANDLE threadhandle[MAX_THREADS];
+    int* threadid;
+    HANDLE* threadhandle;
     int i;
     int start, end;
     
@@ -213,6 +559,9 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
     }
     else
     {
+        threadid = ( int* )safe_malloc( numthreads * sizeof( *threadid ) );
+        threadhandle = ( HANDLE* )safe_malloc( numthreads * sizeof( *threadhandle ) );
+        
         for ( i = 0 ; i < numthreads ; i++ )
         {
             threadhandle[i] = CreateThread(
@@ -224,12 +573,18 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
                                   
                                   ( LPTHREAD_START_ROUTINE )func, // LPTHREAD_START_ROUTINE lpStartAddr,
                                   ( LPVOID )i, // LPVOID lpvThreadParm,
-                                  0,          //   DWORD fdwCreate,
+                                  CREATE_SUSPENDED,          //   DWORD fdwCreate,
                                   reinterpret_cast<LPDWORD>( &threadid[i] ) );
+            
+            SetThreadGroup( threadhandle[i], i );
+            ResumeThread( threadhandle[i] );
         }
         
         for ( i = 0 ; i < numthreads ; i++ )
             WaitForSingleObject( threadhandle[i], INFINITE );
+            
+        free( threadid );
+        free( threadhandle );
     }
     DeleteCriticalSection( &crit );
     
@@ -598,7 +953,7 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
 {
     pthread_mutexattr_t mattrib;
     pthread_attr_t attr;
-    pthread_t work_threads[MAX_THREADS];
+    pthread_t* work_threads;
     size_t stacksize;
     
     int start, end;
@@ -642,6 +997,8 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
         }
         recursive_mutex_init( mattrib );
         
+        work_threads = ( pthread_t* )safe_malloc( numthreads * sizeof( *work_threads ) );
+        
         for ( i = 0 ; i < numthreads ; i++ )
         {
             /* Default pthread attributes: joinable & non-realtime scheduling */
@@ -657,6 +1014,7 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) )
                 Error( "pthread_join failed" );
             }
         }
+        free( work_threads );
         pthread_mutexattr_destroy( &mattrib );
         threaded = qfalse;
     }
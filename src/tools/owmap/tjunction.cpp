@@ -86,6 +86,29 @@ int c_natural, c_rotate, c_cant;
 #define LINE_POSITION_EPSILON   0.25
 #define POINT_ON_LINE_EPSILON   0.25
 
+// edge lines are linked into the cells of a coarse grid over the
+// entity's surfaces that they pass through, so AddEdge only has to
+// test the lines that come near v1 instead of all of them
+#define EDGE_GRID_SIZE          32
+#define EDGE_GRID_MIN_CELL      64.0f
+#define EDGE_GRID_RADIUS        0.5f    // > POINT_ON_LINE_EPSILON * sqrt( 2 )
+
+typedef struct
+{
+    int line;
+    int next;
+} edgeGridLink_t;
+
+qboolean edgeGridValid = qfalse;
+vec3_t edgeGridMins;
+float edgeGridCell;
+int edgeGridDims[ 3 ];
+int edgeGridHeads[ EDGE_GRID_SIZE * EDGE_GRID_SIZE * EDGE_GRID_SIZE ];
+
+edgeGridLink_t*  edgeGridLinks = NULL;
+int numEdgeGridLinks;
+int allocatedEdgeGridLinks = 0;
+
 /*
    ====================
    InsertPointOnEdge
@@ -140,6 +163,280 @@ void InsertPointOnEdge( vec3_t v, edgeLine_t* e )
 }
 
 
+/*
+   SetupEdgeGrid()
+   sizes the edge line grid to the surfaces of an entity that will add edges
+ */
+
+static void SetupEdgeGrid( entity_t* ent )
+{
+    int i, j;
+    float size;
+    vec3_t mins, maxs;
+    mapDrawSurface_t*    ds;
+    shaderInfo_t*        si;
+    
+    
+    /* bound the surfaces FixTJunctions adds edges for */
+    ClearBounds( mins, maxs );
+    for ( i = ent->firstDrawSurf; i < numMapDrawSurfs; i++ )
+    {
+        ds = &mapDrawSurfs[ i ];
+        si = ds->shaderInfo;
+        if ( ( si->compileFlags & C_NODRAW ) || si->autosprite || si->notjunc || ( ds->type != SURFACE_FACE && ds->type != SURFACE_PATCH ) )
+        {
+            continue;
+        }
+        
+        for ( j = 0; j < ds->numVerts; j++ )
+        {
+            AddPointToBounds( ds->verts[ j ].xyz, mins, maxs );
+        }
+    }
+    
+    numEdgeGridLinks = 0;
+    edgeGridValid = mins[ 0 ] <= maxs[ 0 ] ? qtrue : qfalse;
+    if ( !edgeGridValid )
+    {
+        return;
+    }
+    
+    /* cubic cells, the longest axis gets EDGE_GRID_SIZE of them */
+    edgeGridCell = EDGE_GRID_MIN_CELL;
+    for ( i = 0; i < 3; i++ )
+    {
+        mins[ i ] -= EDGE_GRID_RADIUS + 1.0f;
+        maxs[ i ] += EDGE_GRID_RADIUS + 1.0f;
+        size = ( maxs[ i ] - mins[ i ] ) / EDGE_GRID_SIZE;
+        if ( size > edgeGridCell )
+        {
+            edgeGridCell = size;
+        }
+    }
+    
+    for ( i = 0; i < 3; i++ )
+    {
+        edgeGridDims[ i ] = ( int ) ceil( ( maxs[ i ] - mins[ i ] ) / edgeGridCell );
+        if ( edgeGridDims[ i ] < 1 )
+        {
+            edgeGridDims[ i ] = 1;
+        }
+        else if ( edgeGridDims[ i ] > EDGE_GRID_SIZE )
+        {
+            edgeGridDims[ i ] = EDGE_GRID_SIZE;
+        }
+    }
+    
+    VectorCopy( mins, edgeGridMins );
+    memset( edgeGridHeads, -1, sizeof( edgeGridHeads ) );
+}
+
+
+
+/*
+   EdgeGridCell()
+   returns the grid cell of a point, or -1 outside the grid
+ */
+
+static int EdgeGridCell( float x, float y, float z )
+{
+    int c[ 3 ], i;
+    
+    
+    c[ 0 ] = ( int ) floor( ( x - edgeGridMins[ 0 ] ) / edgeGridCell );
+    c[ 1 ] = ( int ) floor( ( y - edgeGridMins[ 1 ] ) / edgeGridCell );
+    c[ 2 ] = ( int ) floor( ( z - edgeGridMins[ 2 ] ) / edgeGridCell );
+    
+    for ( i = 0; i < 3; i++ )
+    {
+        if ( c[ i ] < 0 || c[ i ] >= edgeGridDims[ i ] )
+        {
+            return -1;
+        }
+    }
+    
+    return ( c[ 2 ] * EDGE_GRID_SIZE + c[ 1 ] ) * EDGE_GRID_SIZE + c[ 0 ];
+}
+
+
+
+/*
+   AddEdgeLineToGrid()
+   links an edge line into every grid cell it passes through
+ */
+
+static void AddEdgeLineToGrid( int lineNum )
+{
+    int i, cell, lastCell;
+    float t, t1, t2, tMin, tMax, step;
+    vec3_t maxs, pt;
+    edgeLine_t*      e;
+    
+    
+    e = &edgeLines[ lineNum ];
+    
+    /* clip the infinite line to the grid */
+    tMin = -1e30f;
+    tMax = 1e30f;
+    for ( i = 0; i < 3; i++ )
+    {
+        maxs[ i ] = edgeGridMins[ i ] + edgeGridDims[ i ] * edgeGridCell;
+        if ( fabs( e->dir[ i ] ) < 1e-6f )
+        {
+            if ( e->origin[ i ] < edgeGridMins[ i ] || e->origin[ i ] > maxs[ i ] )
+            {
+                return;
+            }
+            continue;
+        }
+        
+        t1 = ( edgeGridMins[ i ] - e->origin[ i ] ) / e->dir[ i ];
+        t2 = ( maxs[ i ] - e->origin[ i ] ) / e->dir[ i ];
+        if ( t1 > t2 )
+        {
+            t = t1;
+            t1 = t2;
+            t2 = t;
+        }
+        tMin = t1 > tMin ? t1 : tMin;
+        tMax = t2 < tMax ? t2 : tMax;
+    }
+    if ( tMin > tMax )
+    {
+        return;
+    }
+    
+    /* sample at half a cell, AddEdge widens its search by the other half */
+    step = edgeGridCell * 0.5f;
+    lastCell = -1;
+    for ( t = tMin; ; t += step )
+    {
+        if ( t > tMax )
+        {
+            t = tMax;
+        }
+        
+        VectorMA( e->origin, t, e->dir, pt );
+        cell = EdgeGridCell( pt[ 0 ], pt[ 1 ], pt[ 2 ] );
+        if ( cell >= 0 && cell != lastCell )
+        {
+            AUTOEXPAND_BY_REALLOC( edgeGridLink_t, edgeGridLinks, numEdgeGridLinks, allocatedEdgeGridLinks, 4096 );
+            edgeGridLinks[ numEdgeGridLinks ].line = lineNum;
+            edgeGridLinks[ numEdgeGridLinks ].next = edgeGridHeads[ cell ];
+            edgeGridHeads[ cell ] = numEdgeGridLinks;
+            numEdgeGridLinks++;
+            lastCell = cell;
+        }
+        
+        if ( t >= tMax )
+        {
+            break;
+        }
+    }
+}
+
+
+
+/*
+   PointsOnEdgeLine()
+   returns qtrue if both points are close enough to an edge line to share it
+ */
+
+static qboolean PointsOnEdgeLine( vec3_t v1, vec3_t v2, edgeLine_t* e )
+{
+    float d;
+    
+    
+    d = DotProduct( v1, e->normal1 ) - e->dist1;
+    if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
+    {
+        return qfalse;
+    }
+    d = DotProduct( v1, e->normal2 ) - e->dist2;
+    if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
+    {
+        return qfalse;
+    }
+    
+    d = DotProduct( v2, e->normal1 ) - e->dist1;
+    if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
+    {
+        return qfalse;
+    }
+    d = DotProduct( v2, e->normal2 ) - e->dist2;
+    if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
+    {
+        return qfalse;
+    }
+    
+    return qtrue;
+}
+
+
+
+/*
+   FindEdgeLine()
+   returns the lowest numbered edge line both points lie on, or -1
+ */
+
+static int FindEdgeLine( vec3_t v1, vec3_t v2 )
+{
+    int i, x, y, z, link, best, cellMins[ 3 ], cellMaxs[ 3 ];
+    float radius;
+    
+    
+    /* the grid only holds lines that pass within a cell of v1 */
+    if ( edgeGridValid )
+    {
+        radius = EDGE_GRID_RADIUS + edgeGridCell * 0.25f;
+        for ( i = 0; i < 3; i++ )
+        {
+            cellMins[ i ] = ( int ) floor( ( v1[ i ] - radius - edgeGridMins[ i ] ) / edgeGridCell );
+            cellMaxs[ i ] = ( int ) floor( ( v1[ i ] + radius - edgeGridMins[ i ] ) / edgeGridCell );
+            if ( cellMins[ i ] < 0 || cellMaxs[ i ] >= edgeGridDims[ i ] )
+            {
+                break;
+            }
+        }
+        
+        if ( i == 3 )
+        {
+            best = -1;
+            for ( z = cellMins[ 2 ]; z <= cellMaxs[ 2 ]; z++ )
+            {
+                for ( y = cellMins[ 1 ]; y <= cellMaxs[ 1 ]; y++ )
+                {
+                    for ( x = cellMins[ 0 ]; x <= cellMaxs[ 0 ]; x++ )
+                    {
+                        for ( link = edgeGridHeads[( z * EDGE_GRID_SIZE + y ) * EDGE_GRID_SIZE + x ]; link >= 0; link = edgeGridLinks[ link ].next )
+                        {
+                            i = edgeGridLinks[ link ].line;
+                            if ( ( best < 0 || i < best ) && PointsOnEdgeLine( v1, v2, &edgeLines[ i ] ) )
+                            {
+                                best = i;
+                            }
+                        }
+                    }
+                }
+            }
+            return best;
+        }
+    }
+    
+    /* v1 is outside the grid */
+    for ( i = 0 ; i < numEdgeLines ; i++ )
+    {
+        if ( PointsOnEdgeLine( v1, v2, &edgeLines[ i ] ) )
+        {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+
+
 /*
    ====================
    AddEdge
@@ -174,33 +471,11 @@ int AddEdge( vec3_t v1, vec3_t v2, qboolean createNonAxial )
         }
     }
     
-    for ( i = 0 ; i < numEdgeLines ; i++ )
+    i = FindEdgeLine( v1, v2 );
+    if ( i >= 0 )
     {
-        e = &edgeLines[i];
-        
-        d = DotProduct( v1, e->normal1 ) - e->dist1;
-        if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
-        {
-            continue;
-        }
-        d = DotProduct( v1, e->normal2 ) - e->dist2;
-        if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
-        {
-            continue;
-        }
-        
-        d = DotProduct( v2, e->normal1 ) - e->dist1;
-        if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
-        {
-            continue;
-        }
-        d = DotProduct( v2, e->normal2 ) - e->dist2;
-        if ( d < -POINT_ON_LINE_EPSILON || d > POINT_ON_LINE_EPSILON )
-        {
-            continue;
-        }
-        
         // this is the edge
+        e = &edgeLines[ i ];
         InsertPointOnEdge( v1, e );
         InsertPointOnEdge( v2, e );
         return i;
@@ -225,6 +500,11 @@ int AddEdge( vec3_t v1, vec3_t v2, qboolean createNonAxial )
     InsertPointOnEdge( v1, e );
     InsertPointOnEdge( v2, e );
     
+    if ( edgeGridValid )
+    {
+        AddEdgeLineToGrid( numEdgeLines - 1 );
+    }
+    
     return numEdgeLines - 1;
 }
 
@@ -690,6 +970,7 @@ void FixTJunctions( entity_t* ent )
     Sys_FPrintf( SYS_VRB, "--- FixTJunctions ---\n" );
     numEdgeLines = 0;
     numOriginalEdges = 0;
+    SetupEdgeGrid( ent );
     
     // add all the edges
     // this actually creates axial edges, but it
@@ -741,6 +1022,7 @@ void FixTJunctions( entity_t* ent )
     Sys_FPrintf( SYS_VRB, "%9d axial edge lines\n", axialEdgeLines );
     Sys_FPrintf( SYS_VRB, "%9d non-axial edge lines\n", numEdgeLines - axialEdgeLines );
     Sys_FPrintf( SYS_VRB, "%9d degenerate edges\n", c_degenerateEdges );
+    Sys_FPrintf( SYS_VRB, "%9d edge line grid links\n", numEdgeGridLinks );
     
     // insert any needed vertexes
     for ( i = ent->firstDrawSurf; i < numMapDrawSurfs ; i++ )
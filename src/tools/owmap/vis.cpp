@@ -40,6 +40,7 @@
 #undef max
 
 #include <vector>
+#include <chrono>
 #include <string>
 #include "tinyformat.h"
 
@@ -104,16 +105,22 @@ void prl( leaf_t* l )
    SortPortals
 
    Sorts the portals from the least complex, so the later ones can reuse
-   the earlier information.
+   the earlier information. The flows walk this list with every thread
+   together, so a portal starts once its cheaper neighbours are done or
+   underway and clips against their final portalvis instead of portalflood.
+   Ties go by portal number so the order doesn't depend on qsort.
    =============
  */
 int PComp( const void* a, const void* b )
 {
-    if ( ( *( const vportal_t * const* )a )->nummightsee == ( *( const vportal_t * const* )b )->nummightsee )
+    const vportal_t* pa = *( const vportal_t * const* )a;
+    const vportal_t* pb = *( const vportal_t * const* )b;
+    
+    if ( pa->nummightsee == pb->nummightsee )
     {
-        return 0;
+        return pa < pb ? -1 : ( pa > pb ? 1 : 0 );
     }
-    if ( ( *( const vportal_t * const* )a )->nummightsee < ( *( const vportal_t * const* )b )->nummightsee )
+    if ( pa->nummightsee < pb->nummightsee )
     {
         return -1;
     }
@@ -212,7 +219,7 @@ void ClusterMerge( int leafnum )
             Error( "portal not done" );
         }
         for ( j = 0 ; j < portallongs ; j++ )
-            ( ( long* )portalvector )[j] |= ( ( long* )p->portalvis )[j];
+            ( ( uint64_t* )portalvector )[j] |= ( ( uint64_t* )p->portalvis )[j];
         pnum = p - portals;
         portalvector[pnum >> 3] |= 1 << ( pnum & 7 );
     }
@@ -236,6 +243,28 @@ void ClusterMerge( int leafnum )
     memcpy( bspVisBytes + VIS_HEADER_SIZE + leafnum * leafbytes, uncompressed, leafbytes );
 }
 
+/*
+   ==================
+   FlowPortals
+
+   runs one of the flows over the sorted portals and reports its throughput
+   ==================
+ */
+static void FlowPortals( qboolean showpacifier, void ( *flow )( int ) )
+{
+    double seconds;
+    std::chrono::steady_clock::time_point start;
+    
+    start = std::chrono::steady_clock::now();
+    RunThreadsOnIndividualInOrder( numportals * 2, showpacifier, flow );
+    seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    
+    if ( showpacifier )
+    {
+        Sys_Printf( "%9d portals flowed in %.1f seconds, %.0f portals/sec\n", numportals * 2, seconds, seconds > 0 ? numportals * 2 / seconds : 0 );
+    }
+}
+
 /*
    ==================
    CalcPortalVis
@@ -246,11 +275,11 @@ void CalcPortalVis( void )
 #ifdef MREDEBUG
     Sys_Printf( "%6d portals out of %d", 0, numportals * 2 );
     //get rid of the counter
-    RunThreadsOnIndividual( numportals * 2, qfalse, PortalFlow );
+    FlowPortals( qfalse, PortalFlow );
 #else
-    RunThreadsOnIndividual( numportals * 2, qtrue, PortalFlow );
+    FlowPortals( qtrue, PortalFlow );
 #endif
-    
+
 }
 
 /*
@@ -267,14 +296,14 @@ void CalcPassageVis( void )
     RunThreadsOnIndividual( numportals * 2, qfalse, CreatePassages );
     _printf( "\n" );
     _printf( "%6d portals out of %d", 0, numportals * 2 );
-    RunThreadsOnIndividual( numportals * 2, qfalse, PassageFlow );
+    FlowPortals( qfalse, PassageFlow );
     _printf( "\n" );
 #else
     Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
     RunThreadsOnIndividual( numportals * 2, qtrue, CreatePassages );
     
     Sys_Printf( "\n--- PassageFlow (%d) ---\n", numportals * 2 );
-    RunThreadsOnIndividual( numportals * 2, qtrue, PassageFlow );
+    FlowPortals( qtrue, PassageFlow );
 #endif
 }
 
@@ -292,14 +321,14 @@ void CalcPassagePortalVis( void )
     RunThreadsOnIndividual( numportals * 2, qfalse, CreatePassages );
     Sys_Printf( "\n" );
     Sys_Printf( "%6d portals out of %d", 0, numportals * 2 );
-    RunThreadsOnIndividual( numportals * 2, qfalse, PassagePortalFlow );
+    FlowPortals( qfalse, PassagePortalFlow );
     Sys_Printf( "\n" );
 #else
     Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
     RunThreadsOnIndividual( numportals * 2, qtrue, CreatePassages );
     
     Sys_Printf( "\n--- PassagePortalFlow (%d) ---\n", numportals * 2 );
-    RunThreadsOnIndividual( numportals * 2, qtrue, PassagePortalFlow );
+    FlowPortals( qtrue, PassagePortalFlow );
 #endif
 }
 
@@ -1035,12 +1064,15 @@ void LoadPortals( char* name )
         Error( "MAX_PORTALS" );
     }
     
-    // these counts should take advantage of 64 bit systems automatically
+    // bit vectors are padded to 64 bit words so they can be merged a word or more at a time
     leafbytes = ( ( portalclusters + 63 ) & ~63 ) >> 3;
-    leaflongs = leafbytes / sizeof( long );
+    leaflongs = leafbytes / sizeof( uint64_t );
     
     portalbytes = ( ( numportals * 2 + 63 ) & ~63 ) >> 3;
-    portallongs = portalbytes / sizeof( long );
+    portallongs = portalbytes / sizeof( uint64_t );
+    
+    // a pooled flow recursion frame is a mightsee row followed by three windings, padded to a cache line
+    stackframebytes = ( portalbytes + 3 * sizeof( fixedWinding_t ) + 63 ) & ~63;
     
     // each file portal is split into two memory portals
     portals = static_cast<vportal_t*>( safe_malloc( 2 * numportals * sizeof( vportal_t ) ) );
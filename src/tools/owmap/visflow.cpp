@@ -36,6 +36,14 @@
 /* dependencies */
 #include "q3map2.h"
 
+/* portal bit vectors are merged 128 bits at a time where sse2 is available */
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define VIS_SSE                 1
+#include <emmintrin.h>
+#else
+#define VIS_SSE                 0
+#endif
+
 
 
 
@@ -58,13 +66,27 @@
    void CalcMightSee (leaf_t *leaf,
  */
 
+static inline int PopCount64( uint64_t v )
+{
+    v = v - ( ( v >> 1 ) & 0x5555555555555555ULL );
+    v = ( v & 0x3333333333333333ULL ) + ( ( v >> 2 ) & 0x3333333333333333ULL );
+    v = ( v + ( v >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    return ( int )( ( v * 0x0101010101010101ULL ) >> 56 );
+}
+
 int CountBits( byte* bits, int numbits )
 {
     int i;
     int c;
+    uint64_t word;
     
     c = 0;
-    for ( i = 0 ; i < numbits ; i++ )
+    for ( i = 0 ; i + 64 <= numbits ; i += 64 )
+    {
+        memcpy( &word, bits + ( i >> 3 ), sizeof( word ) );
+        c += PopCount64( word );
+    }
+    for ( ; i < numbits ; i++ )
         if ( bits[i >> 3] & ( 1 << ( i & 7 ) ) )
         {
             c++;
@@ -73,6 +95,52 @@ int CountBits( byte* bits, int numbits )
     return c;
 }
 
+/*
+   ==============
+   MergeMightSee
+
+   might = prevmight & test ( & test2 when given ), returns true if
+   might holds any portal that isn't in vis yet
+   ==============
+ */
+static inline qboolean MergeMightSee( uint64_t* might, const uint64_t* prevmight, const uint64_t* test, const uint64_t* test2, const uint64_t* vis )
+{
+    int j;
+    uint64_t m, more;
+#if VIS_SSE
+    __m128i mm, moremm;
+#endif
+    
+    j = 0;
+    more = 0;
+#if VIS_SSE
+    moremm = _mm_setzero_si128();
+    for ( ; j + 2 <= portallongs ; j += 2 )
+    {
+        mm = _mm_and_si128( _mm_loadu_si128( ( const __m128i* )( prevmight + j ) ), _mm_loadu_si128( ( const __m128i* )( test + j ) ) );
+        if ( test2 )
+        {
+            mm = _mm_and_si128( mm, _mm_loadu_si128( ( const __m128i* )( test2 + j ) ) );
+        }
+        _mm_storeu_si128( ( __m128i* )( might + j ), mm );
+        moremm = _mm_or_si128( moremm, _mm_andnot_si128( _mm_loadu_si128( ( const __m128i* )( vis + j ) ), mm ) );
+    }
+    more = _mm_movemask_epi8( _mm_cmpeq_epi8( moremm, _mm_setzero_si128() ) ) != 0xFFFF;
+#endif
+    for ( ; j < portallongs ; j++ )
+    {
+        m = prevmight[j] & test[j];
+        if ( test2 )
+        {
+            m &= test2[j];
+        }
+        might[j] = m;
+        more |= m & ~vis[j];
+    }
+    
+    return more ? qtrue : qfalse;
+}
+
 int c_fullskip;
 int c_chop, c_nochop;
 int active;
@@ -134,6 +202,45 @@ void FreeStackWinding( fixedWinding_t* w, pstack_t* stack )
     stack->freewindings[i] = 1;
 }
 
+/*
+   ==============
+   SetupStackFrame
+
+   points a recursion level at its pooled mightsee row and windings, the
+   frames of one flow are reused by every branch at the same depth
+   ==============
+ */
+static void SetupStackFrame( threaddata_t* thread, pstack_t* stack )
+{
+    int chunk;
+    byte* frame;
+    
+    chunk = stack->depth / STACK_FRAMES_PER_CHUNK;
+    while ( thread->numframechunks <= chunk )
+    {
+        if ( thread->numframechunks >= MAX_STACK_FRAME_CHUNKS )
+        {
+            Error( "SetupStackFrame: MAX_STACK_FRAME_CHUNKS" );
+        }
+        thread->framechunks[ thread->numframechunks++ ] = ( byte* )safe_malloc( STACK_FRAMES_PER_CHUNK * stackframebytes );
+    }
+    
+    frame = thread->framechunks[ chunk ] + ( stack->depth % STACK_FRAMES_PER_CHUNK ) * stackframebytes;
+    stack->mightsee = frame;
+    stack->windings = ( fixedWinding_t* )( frame + portalbytes );
+}
+
+static void FreeStackFrames( threaddata_t* thread )
+{
+    int i;
+    
+    for ( i = 0; i < thread->numframechunks; i++ )
+    {
+        free( thread->framechunks[ i ] );
+    }
+    thread->numframechunks = 0;
+}
+
 /*
    ==============
    VisChopWinding
@@ -468,8 +575,8 @@ void RecursiveLeafFlow( int leafnum, threaddata_t* thread, pstack_t* prevstack )
     vportal_t*   p;
     visPlane_t backplane;
     leaf_t*      leaf;
-    int i, j, n;
-    long*        test, *might, *prevmight, *vis, more;
+    int i, n;
+    uint64_t*    test, *might, *vis;
     int pnum;
     
     thread->c_chains++;
@@ -483,14 +590,15 @@ void RecursiveLeafFlow( int leafnum, threaddata_t* thread, pstack_t* prevstack )
     stack.leaf = leaf;
     stack.portal = NULL;
     stack.depth = prevstack->depth + 1;
+    SetupStackFrame( thread, &stack );
     
 #ifdef SEPERATORCACHE
     stack.numseperators[0] = 0;
     stack.numseperators[1] = 0;
 #endif
     
-    might = ( long* )stack.mightsee;
-    vis = ( long* )thread->base->portalvis;
+    might = ( uint64_t* )stack.mightsee;
+    vis = ( uint64_t* )thread->base->portalvis;
     
     // check all portals for flowing into other leafs
     for ( i = 0; i < leaf->numportals; i++ )
@@ -529,22 +637,14 @@ void RecursiveLeafFlow( int leafnum, threaddata_t* thread, pstack_t* prevstack )
         // if the portal can't see anything we haven't allready seen, skip it
         if ( p->status == stat_done )
         {
-            test = ( long* )p->portalvis;
+            test = ( uint64_t* )p->portalvis;
         }
         else
         {
-            test = ( long* )p->portalflood;
-        }
-        
-        more = 0;
-        prevmight = ( long* )prevstack->mightsee;
-        for ( j = 0 ; j < portallongs ; j++ )
-        {
-            might[j] = prevmight[j] & test[j];
-            more |= ( might[j] & ~vis[j] );
+            test = ( uint64_t* )p->portalflood;
         }
         
-        if ( !more &&
+        if ( !MergeMightSee( might, ( uint64_t* )prevstack->mightsee, test, NULL, vis ) &&
                 ( thread->base->portalvis[pnum >> 3] & ( 1 << ( pnum & 7 ) ) ) )   // can't see anything new
         {
             continue;
@@ -713,7 +813,6 @@ void RecursiveLeafFlow( int leafnum, threaddata_t* thread, pstack_t* prevstack )
 void PortalFlow( int portalnum )
 {
     threaddata_t data;
-    int i;
     vportal_t*       p;
     int c_might, c_can;
     
@@ -740,10 +839,11 @@ void PortalFlow( int portalnum )
     data.pstack_head.source = p->winding;
     data.pstack_head.portalplane = p->plane;
     data.pstack_head.depth = 0;
-    for ( i = 0 ; i < portallongs ; i++ )
-        ( ( long* )data.pstack_head.mightsee )[i] = ( ( long* )p->portalflood )[i];
-        
+    SetupStackFrame( &data, &data.pstack_head );
+    memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+    
     RecursiveLeafFlow( p->leaf, &data, &data.pstack_head );
+    FreeStackFrames( &data );
     
     p->status = stat_done;
     
@@ -764,8 +864,8 @@ void RecursivePassageFlow( vportal_t* portal, threaddata_t* thread, pstack_t* pr
     vportal_t*   p;
     leaf_t*      leaf;
     passage_t*   passage, *nextpassage;
-    int i, j;
-    long*        might, *vis, *prevmight, *cansee, *portalvis, more;
+    int i;
+    uint64_t*    might, *vis, *prevmight, *cansee, *portalvis;
     int pnum;
     
     leaf = &leafs[portal->leaf];
@@ -774,8 +874,9 @@ void RecursivePassageFlow( vportal_t* portal, threaddata_t* thread, pstack_t* pr
     
     stack.next = NULL;
     stack.depth = prevstack->depth + 1;
+    SetupStackFrame( thread, &stack );
     
-    vis = ( long* )thread->base->portalvis;
+    vis = ( uint64_t* )thread->base->portalvis;
     
     passage = portal->passages;
     nextpassage = passage;
@@ -798,35 +899,19 @@ void RecursivePassageFlow( vportal_t* portal, threaddata_t* thread, pstack_t* pr
         // mark the portal as visible
         thread->base->portalvis[pnum >> 3] |= ( 1 << ( pnum & 7 ) );
         
-        prevmight = ( long* )prevstack->mightsee;
-        cansee = ( long* )passage->cansee;
-        might = ( long* )stack.mightsee;
-        memcpy( might, prevmight, portalbytes );
+        prevmight = ( uint64_t* )prevstack->mightsee;
+        cansee = ( uint64_t* )passage->cansee;
+        might = ( uint64_t* )stack.mightsee;
         if ( p->status == stat_done )
         {
-            portalvis = ( long* ) p->portalvis;
+            portalvis = ( uint64_t* ) p->portalvis;
         }
         else
         {
-            portalvis = ( long* ) p->portalflood;
-        }
-        more = 0;
-        for ( j = 0; j < portallongs; j++ )
-        {
-            if ( *might )
-            {
-                *might &= *cansee++ & *portalvis++;
-                more |= ( *might & ~vis[j] );
-            }
-            else
-            {
-                cansee++;
-                portalvis++;
-            }
-            might++;
+            portalvis = ( uint64_t* ) p->portalflood;
         }
         
-        if ( !more )
+        if ( !MergeMightSee( might, prevmight, cansee, portalvis, vis ) )
         {
             // can't see anything new
             continue;
@@ -847,7 +932,6 @@ void RecursivePassageFlow( vportal_t* portal, threaddata_t* thread, pstack_t* pr
 void PassageFlow( int portalnum )
 {
     threaddata_t data;
-    int i;
     vportal_t*       p;
     //	int				c_might, c_can;
     
@@ -874,10 +958,11 @@ void PassageFlow( int portalnum )
     data.pstack_head.source = p->winding;
     data.pstack_head.portalplane = p->plane;
     data.pstack_head.depth = 0;
-    for ( i = 0 ; i < portallongs ; i++ )
-        ( ( long* )data.pstack_head.mightsee )[i] = ( ( long* )p->portalflood )[i];
-        
+    SetupStackFrame( &data, &data.pstack_head );
+    memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+    
     RecursivePassageFlow( p, &data, &data.pstack_head );
+    FreeStackFrames( &data );
     
     p->status = stat_done;
     
@@ -901,8 +986,8 @@ void RecursivePassagePortalFlow( vportal_t* portal, threaddata_t* thread, pstack
     leaf_t*      leaf;
     visPlane_t backplane;
     passage_t*   passage, *nextpassage;
-    int i, j, n;
-    long*        might, *vis, *prevmight, *cansee, *portalvis, more;
+    int i, n;
+    uint64_t*    might, *vis, *prevmight, *cansee, *portalvis;
     int pnum;
     
     //	thread->c_chains++;
@@ -916,13 +1001,14 @@ void RecursivePassagePortalFlow( vportal_t* portal, threaddata_t* thread, pstack
     stack.leaf = leaf;
     stack.portal = NULL;
     stack.depth = prevstack->depth + 1;
+    SetupStackFrame( thread, &stack );
     
 #ifdef SEPERATORCACHE
     stack.numseperators[0] = 0;
     stack.numseperators[1] = 0;
 #endif
     
-    vis = ( long* )thread->base->portalvis;
+    vis = ( uint64_t* )thread->base->portalvis;
     
     passage = portal->passages;
     nextpassage = passage;
@@ -942,35 +1028,19 @@ void RecursivePassagePortalFlow( vportal_t* portal, threaddata_t* thread, pstack
             continue;   // can't possibly see it
             
         }
-        prevmight = ( long* )prevstack->mightsee;
-        cansee = ( long* )passage->cansee;
-        might = ( long* )stack.mightsee;
-        memcpy( might, prevmight, portalbytes );
+        prevmight = ( uint64_t* )prevstack->mightsee;
+        cansee = ( uint64_t* )passage->cansee;
+        might = ( uint64_t* )stack.mightsee;
         if ( p->status == stat_done )
         {
-            portalvis = ( long* ) p->portalvis;
+            portalvis = ( uint64_t* ) p->portalvis;
         }
         else
         {
-            portalvis = ( long* ) p->portalflood;
-        }
-        more = 0;
-        for ( j = 0; j < portallongs; j++ )
-        {
-            if ( *might )
-            {
-                *might &= *cansee++ & *portalvis++;
-                more |= ( *might & ~vis[j] );
-            }
-            else
-            {
-                cansee++;
-                portalvis++;
-            }
-            might++;
+            portalvis = ( uint64_t* ) p->portalflood;
         }
         
-        if ( !more && ( thread->base->portalvis[pnum >> 3] & ( 1 << ( pnum & 7 ) ) ) )   // can't see anything new
+        if ( !MergeMightSee( might, prevmight, cansee, portalvis, vis ) && ( thread->base->portalvis[pnum >> 3] & ( 1 << ( pnum & 7 ) ) ) )   // can't see anything new
         {
             continue;
         }
@@ -1136,7 +1206,6 @@ void RecursivePassagePortalFlow( vportal_t* portal, threaddata_t* thread, pstack
 void PassagePortalFlow( int portalnum )
 {
     threaddata_t data;
-    int i;
     vportal_t*       p;
     //	int				c_might, c_can;
     
@@ -1163,10 +1232,11 @@ void PassagePortalFlow( int portalnum )
     data.pstack_head.source = p->winding;
     data.pstack_head.portalplane = p->plane;
     data.pstack_head.depth = 0;
-    for ( i = 0 ; i < portallongs ; i++ )
-        ( ( long* )data.pstack_head.mightsee )[i] = ( ( long* )p->portalflood )[i];
-        
+    SetupStackFrame( &data, &data.pstack_head );
+    memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+    
     RecursivePassagePortalFlow( p, &data, &data.pstack_head );
+    FreeStackFrames( &data );
     
     p->status = stat_done;
     
@@ -1463,11 +1533,12 @@ int AddSeperators( fixedWinding_t* source, fixedWinding_t* pass, qboolean flipcl
  */
 void CreatePassages( int portalnum )
 {
-    int i, j, k, n, numseperators, numsee;
+    int i, j, k, n, numseperators, numsee, numpassages;
     float d;
     vportal_t*       portal, *p, *target;
     leaf_t*          leaf;
     passage_t*       passage, *lastpassage;
+    byte*            passagepool;
     visPlane_t seperators[MAX_SEPERATORS * 2];
     fixedWinding_t*  w;
     fixedWinding_t in, out, *res;
@@ -1487,6 +1558,23 @@ void CreatePassages( int portalnum )
     
     lastpassage = NULL;
     leaf = &leafs[portal->leaf];
+    
+    /* all passages out of this portal share one block */
+    numpassages = 0;
+    for ( i = 0; i < leaf->numportals; i++ )
+    {
+        if ( !leaf->portals[i]->removed )
+        {
+            numpassages++;
+        }
+    }
+    if ( !numpassages )
+    {
+        return;
+    }
+    passagepool = ( byte* ) safe_malloc( numpassages * ( sizeof( passage_t ) + portalbytes ) );
+    memset( passagepool, 0, numpassages * ( sizeof( passage_t ) + portalbytes ) );
+    
     for ( i = 0; i < leaf->numportals; i++ )
     {
         target = leaf->portals[i];
@@ -1495,8 +1583,8 @@ void CreatePassages( int portalnum )
             continue;
         }
         
-        passage = ( passage_t* ) safe_malloc( sizeof( passage_t ) + portalbytes );
-        memset( passage, 0, sizeof( passage_t ) + portalbytes );
+        passage = ( passage_t* ) passagepool;
+        passagepool += sizeof( passage_t ) + portalbytes;
         numseperators = AddSeperators( portal->winding, target->winding, qfalse, seperators, MAX_SEPERATORS * 2 );
         numseperators += AddSeperators( target->winding, portal->winding, qtrue, &seperators[numseperators], MAX_SEPERATORS * 2 - numseperators );
         
@@ -1515,6 +1603,12 @@ void CreatePassages( int portalnum )
         //create the passage->cansee
         for ( j = 0; j < numportals * 2; j++ )
         {
+            // skip a whole word of portals that either side can't flood into
+            if ( !( j & 63 ) && !( ( ( uint64_t* )target->portalflood )[j >> 6] & ( ( uint64_t* )portal->portalflood )[j >> 6] ) )
+            {
+                j += 63;
+                continue;
+            }
             p = &portals[j];
             if ( p->removed )
             {
@@ -1606,7 +1700,8 @@ void CreatePassages( int portalnum )
 
 void PassageMemory( void )
 {
-    int i, j, totalmem, totalportals;
+    int i, j, totalportals;
+    size_t totalmem;
     vportal_t* portal, *target;
     leaf_t* leaf;
     
@@ -1632,7 +1727,7 @@ void PassageMemory( void )
         }
     }
     Sys_Printf( "%7i average number of passages per leaf\n", totalportals / numportals );
-    Sys_Printf( "%7i MB required passage memory\n", totalmem >> 10 >> 10 );
+    Sys_Printf( "%7i MB required passage memory\n", ( int )( totalmem >> 10 >> 10 ) );
 }
 
 /*
@@ -1866,8 +1961,7 @@ void RecursiveLeafBitFlow( int leafnum, byte* mightsee, byte* cansee )
 {
     vportal_t*   p;
     leaf_t*      leaf;
-    int i, j;
-    long more;
+    int i;
     int pnum;
     byte newmight[MAX_PORTALS / 8];
     
@@ -1890,15 +1984,7 @@ void RecursiveLeafBitFlow( int leafnum, byte* mightsee, byte* cansee )
         }
         
         // if this portal can see some portals we mightsee, recurse
-        more = 0;
-        for ( j = 0 ; j < portallongs ; j++ )
-        {
-            ( ( long* )newmight )[j] = ( ( long* )mightsee )[j]
-                                       & ( ( long* )p->portalflood )[j];
-            more |= ( ( long* )newmight )[j] & ~( ( long* )cansee )[j];
-        }
-        
-        if ( !more )
+        if ( !MergeMightSee( ( uint64_t* )newmight, ( uint64_t* )mightsee, ( uint64_t* )p->portalflood, NULL, ( uint64_t* )cansee ) )
         {
             continue;   // can't see anything new
             